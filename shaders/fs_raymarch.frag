@@ -6,6 +6,14 @@ layout (location = 2) in float inAspect;
 
 layout (location = 0) out vec4 outFragColor;
 
+// Colour of every simulation material by id, filled from the material registry
+layout (set = 2, binding = 0) uniform MaterialColours {
+	vec4 colours[256];
+} materialColours;
+
+// Material the sphere is drawn as, sand
+const int SPHERE_MATERIAL = 2;
+
 
 float sphereSDF(in vec3 p, in vec3 c, float r) {
 	return length(p - c) - r;
@@ -52,7 +60,7 @@ vec3 ray_march(in vec3 origin, in vec3 dir) {
 			
 			float diffuse_intensity =  max(0.05, dot(normal, direction_to_light));
 		
-			return vec3(1.0, 0.0, 0.0) * diffuse_intensity;
+			return materialColours.colours[SPHERE_MATERIAL].rgb * diffuse_intensity;
 		}
 		else if (t > 1000) {
 			break;
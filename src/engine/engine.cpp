@@ -3,6 +3,7 @@
 
 #include <chrono>
 #include <thread>
+#include <cstdio>
 
 
 
@@ -13,7 +14,7 @@ namespace engine {
 		return *loadedEngine;
 	}
 
-	VulkanEngine::VulkanEngine(const char* name) : mApplicationName{ name }, mRenderer{ rendering::Renderer(&mWindow) }, mWindow{ Window() } {
+	VulkanEngine::VulkanEngine(const char* name) : mApplicationName{ name }, mRenderer{ rendering::Renderer(&mWindow, &mJobSystem) }, mWindow{ Window() }, mSimulation{ mJobSystem, 4, 2, 4 }, mSimulationThread{ mSimulation } {
 	}
 
 	void VulkanEngine::init() {
@@ -34,13 +35,23 @@ namespace engine {
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.apiVersion = VK_API_VERSION_1_1;
 
+		// The rules and the colours the renderer uploads both come from the materials, so they are loaded first
+		if (!sim::MaterialRegistry::loadFromFile("../../assets/materials.txt"))
+			util::displayError("Could not load the materials.");
+
 		mRenderer.init(appInfo);
 
+		initSimulation();
+
+		mSimulationThread.start();
+
 		// Everything is initialized, so set mIsInitialized to true
 		mIsInitialized = true;
 	}
 
 	void VulkanEngine::cleanup() {
+		mSimulationThread.stop();
+
 		if (mIsInitialized) {
 			mRenderer.cleanup();
 
@@ -55,21 +66,81 @@ namespace engine {
 		if (!mIsInitialized)
 			return;
 
+		auto lastFrame = std::chrono::steady_clock::now();
+		auto lastReport = lastFrame;
+
 		// Main loop
 		while (!mWindow.shouldQuit()) {
 			mWindow.handleEvents();
 
+			auto now = std::chrono::steady_clock::now();
+			double elapsed = std::chrono::duration<double>(now - lastFrame).count();
+			lastFrame = now;
+
+			// The simulation ticks on its own thread, frames only pick up whatever it published last
+			mSimulationThread.acquireSnapshot();
+
+			if (now - lastReport >= std::chrono::seconds(2)) {
+				reportSimulationStats();
+				lastReport = now;
+			}
+
 			// Don't draw if minimized
 			if (mWindow.isMinimized()) {
 				// Throttle speed to avoid endless spinning
 				std::this_thread::sleep_for(std::chrono::milliseconds(100));
 			}
 			else {
-				mRenderer.draw();
+				mRenderer.draw((float)elapsed, mSimulationThread.getSnapshot());
 			}
 		}
 
 		// Ensure that no more graphics commands are being run
 		mRenderer.waitForGraphics();
 	}
+
+	void VulkanEngine::initSimulation() {
+		sim::World& world = mSimulation.getWorld();
+
+		int sizeX = world.getSizeX();
+		int sizeY = world.getSizeY();
+		int sizeZ = world.getSizeZ();
+
+		// Water settles into level pools that go back to sleep instead of sloshing about for ever
+		world.setLiquidModel(sim::LIQUID_MODEL_LEVELS);
+
+		// Sand dropped from high up lands in a few ticks instead of one per cell
+		world.setFastFalls(true);
+
+		// Stone dug out from under a ledge brings the ledge down
+		world.setDetachIslands(true);
+
+		// Stone floor with a sand pile and a block of water dropped on top of it
+		world.fillBox(0, 0, 0, sizeX - 1, 3, sizeZ - 1, sim::MATERIAL_STONE);
+		world.fillBox(sizeX / 4, sizeY / 2, sizeZ / 4, sizeX / 2, sizeY - 8, sizeZ / 2, sim::MATERIAL_SAND);
+		world.fillBox(sizeX / 2 + 8, sizeY / 3, sizeZ / 2 + 8, sizeX - 16, sizeY - 4, sizeZ - 16, sim::MATERIAL_WATER);
+	}
+
+	void VulkanEngine::reportSimulationStats() {
+		const sim::WorldSnapshot& snapshot = mSimulationThread.getSnapshot();
+		const sim::SimulationStats& totals = snapshot.getStats();
+
+		// The simulation belongs to its thread, so rates come from the difference between two snapshots
+		sim::SimulationStats stats;
+		stats.ticks = totals.ticks - mReportedStats.ticks;
+		stats.cellsUpdated = totals.cellsUpdated - mReportedStats.cellsUpdated;
+		stats.tickSeconds = totals.tickSeconds - mReportedStats.tickSeconds;
+
+		const sim::WorldMemoryStats& memory = snapshot.getWorldMemory();
+
+		char title[320];
+		snprintf(title, sizeof(title), "%s | tick %llu | %.1f Mcells/s | %.0f tick/s | %d threads at %.0f%% | world %.1f MB, %zu of %zu chunks compressed",
+			mApplicationName, (unsigned long long)snapshot.getTick(), stats.getCellsPerSecond() / 1e6, stats.getTicksPerSecond(),
+			snapshot.getThreadCount(), snapshot.getParallelEfficiency() * 100.0, memory.getTotalBytes() / (1024.0 * 1024.0),
+			memory.compressedChunks + memory.uniformChunks, memory.denseChunks + memory.compressedChunks + memory.uniformChunks);
+
+		mWindow.setTitle(title);
+
+		mReportedStats = totals;
+	}
 }
\ No newline at end of file
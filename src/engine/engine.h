@@ -1,7 +1,10 @@
 #pragma once
 
 #include "window.h"
+#include "jobs/job_system.h"
 #include "rendering/renderer.h"
+#include "../sim/simulation.h"
+#include "../sim/simulation_thread.h"
 
 #include <vulkan/vulkan.h>
 
@@ -24,13 +27,30 @@ namespace engine {
 		void cleanup();
 
 		void run();
+
+		jobs::JobSystem& getJobSystem() { return mJobSystem; }
 	private:
 		bool mIsInitialized{ false };
 		bool mStopRendering{ false };
 
 		const char* mApplicationName;
 
+		// Shared by every subsystem that wants to run work off the main thread
+		jobs::JobSystem mJobSystem;
+
 		Window mWindow;
 		rendering::Renderer mRenderer;
+
+		sim::Simulation mSimulation;
+
+		// Ticks mSimulation from the moment init() finishes, only edits may touch the world from this thread after that
+		sim::SimulationThread mSimulationThread;
+
+		// Totals from the snapshot at the last report, stats in the title are the difference since then
+		sim::SimulationStats mReportedStats;
+
+		void initSimulation();
+
+		void reportSimulationStats();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "job_system.h"
+#include "../../util/debug.h"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+	thread_local const engine::jobs::JobSystem* tCurrentSystem = nullptr;
+	thread_local int tWorkerIndex = -1;
+
+	// Slot of an outside thread in the last system it used
+	thread_local uint64_t tOutsideSystemId = 0;
+	thread_local int tOutsideIndex = -1;
+
+	std::atomic<uint64_t> gNextSystemId{ 1 };
+
+	// Rounds a worker spins looking for work before it goes to sleep
+	const int SPIN_ROUNDS = 64;
+}
+
+namespace engine {
+	namespace jobs {
+		JobSystem::JobSystem(int workerCount) : mId(gNextSystemId.fetch_add(1)) {
+			if (workerCount < 0) {
+				workerCount = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+			}
+
+			for (int i = 0; i < workerCount + MAX_OUTSIDE_THREADS; i++) {
+				mQueues.push_back(std::make_unique<WorkerQueue>());
+			}
+
+			for (int i = 0; i < workerCount; i++) {
+				mThreads.emplace_back(&JobSystem::workerLoop, this, i);
+			}
+		}
+
+		JobSystem::~JobSystem() {
+			{
+				std::lock_guard<std::mutex> lock(mSleepMutex);
+				mStopping = true;
+			}
+
+			mSleepCondition.notify_all();
+
+			for (auto& thread : mThreads) {
+				thread.join();
+			}
+		}
+
+		int JobSystem::getCurrentParticipant() const {
+			if (tCurrentSystem == this)
+				return tWorkerIndex;
+
+			if (tOutsideSystemId != mId) {
+				int slot = mOutsideThreads.fetch_add(1);
+
+				if (slot >= MAX_OUTSIDE_THREADS)
+					util::displayError("More than " + std::to_string(MAX_OUTSIDE_THREADS) + " threads outside of the job system ran jobs");
+
+				tOutsideSystemId = mId;
+				tOutsideIndex = getWorkerCount() + slot;
+			}
+
+			return tOutsideIndex;
+		}
+
+		void JobSystem::schedule(Job&& job, JobCounter* counter) {
+			if (counter != nullptr)
+				counter->mCount.fetch_add(1, std::memory_order_relaxed);
+
+			push(QueuedJob{ std::move(job), counter });
+		}
+
+		void JobSystem::scheduleAfter(JobCounter& dependency, Job&& job, JobCounter* counter) {
+			if (counter != nullptr)
+				counter->mCount.fetch_add(1, std::memory_order_relaxed);
+
+			{
+				std::lock_guard<std::mutex> lock(dependency.mContinuationMutex);
+
+				if (!dependency.isDone()) {
+					dependency.mContinuations.push_back(QueuedJob{ std::move(job), counter });
+					return;
+				}
+			}
+
+			push(QueuedJob{ std::move(job), counter });
+		}
+
+		void JobSystem::wait(JobCounter& counter) {
+			int participant = getCurrentParticipant();
+
+			while (!counter.isDone()) {
+				if (!runOne(participant)) {
+					std::this_thread::yield();
+				}
+			}
+
+			// The last job drops the count while holding this lock, so taking it here makes sure that
+			// job is done with the counter before the caller is free to destroy it
+			std::lock_guard<std::mutex> lock(counter.mContinuationMutex);
+		}
+
+		void JobSystem::parallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end, int participant)>& function) {
+			if (count == 0)
+				return;
+
+			grainSize = std::max<size_t>(grainSize, 1);
+
+			if (count <= grainSize) {
+				function(0, count, getCurrentParticipant());
+				return;
+			}
+
+			JobCounter counter;
+
+			for (size_t begin = 0; begin < count; begin += grainSize) {
+				size_t end = std::min(begin + grainSize, count);
+
+				schedule([this, begin, end, &function]() {
+					function(begin, end, getCurrentParticipant());
+				}, &counter);
+			}
+
+			wait(counter);
+		}
+
+		void JobSystem::workerLoop(int workerIndex) {
+			tCurrentSystem = this;
+			tWorkerIndex = workerIndex;
+
+			int idleRounds = 0;
+
+			while (true) {
+				if (runOne(workerIndex)) {
+					idleRounds = 0;
+					continue;
+				}
+
+				if (++idleRounds < SPIN_ROUNDS) {
+					std::this_thread::yield();
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(mSleepMutex);
+
+				mSleepingWorkers.fetch_add(1);
+				mSleepCondition.wait(lock, [this]() { return mStopping || mQueuedJobs.load() > 0; });
+				mSleepingWorkers.fetch_sub(1);
+
+				if (mStopping)
+					return;
+
+				idleRounds = 0;
+			}
+		}
+
+		void JobSystem::push(QueuedJob&& job) {
+			int queueIndex = getCurrentParticipant();
+
+			{
+				std::lock_guard<std::mutex> lock(mQueues[queueIndex]->mutex);
+				mQueues[queueIndex]->jobs.push_back(std::move(job));
+			}
+
+			mQueuedJobs.fetch_add(1);
+
+			// Taking the lock makes sure a worker that is about to sleep sees the new job
+			if (mSleepingWorkers.load() > 0) {
+				{
+					std::lock_guard<std::mutex> lock(mSleepMutex);
+				}
+
+				mSleepCondition.notify_one();
+			}
+		}
+
+		bool JobSystem::popOwn(int queueIndex, QueuedJob& outJob) {
+			WorkerQueue& queue = *mQueues[queueIndex];
+
+			std::lock_guard<std::mutex> lock(queue.mutex);
+
+			if (queue.jobs.empty())
+				return false;
+
+			outJob = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+
+			mQueuedJobs.fetch_sub(1);
+
+			return true;
+		}
+
+		bool JobSystem::steal(int thiefIndex, QueuedJob& outJob) {
+			int queueCount = (int)mQueues.size();
+
+			// Start with the next queue over so thieves spread across victims
+			for (int i = 1; i < queueCount; i++) {
+				WorkerQueue& queue = *mQueues[(thiefIndex + i) % queueCount];
+
+				std::lock_guard<std::mutex> lock(queue.mutex);
+
+				if (queue.jobs.empty())
+					continue;
+
+				outJob = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+
+				mQueuedJobs.fetch_sub(1);
+
+				return true;
+			}
+
+			return false;
+		}
+
+		bool JobSystem::runOne(int participant) {
+			if (mQueuedJobs.load(std::memory_order_relaxed) == 0)
+				return false;
+
+			QueuedJob job;
+
+			if (!popOwn(participant, job) && !steal(participant, job))
+				return false;
+
+			job.job();
+
+			finish(job.counter);
+
+			return true;
+		}
+
+		void JobSystem::finish(JobCounter* counter) {
+			if (counter == nullptr)
+				return;
+
+			std::vector<QueuedJob> continuations;
+
+			{
+				// Hold the lock while decrementing so scheduleAfter can't slip a continuation in between
+				std::lock_guard<std::mutex> lock(counter->mContinuationMutex);
+
+				if (counter->mCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+					return;
+
+				continuations.swap(counter->mContinuations);
+			}
+
+			for (auto& continuation : continuations) {
+				push(std::move(continuation));
+			}
+		}
+	}
+}
\ No newline at end of file
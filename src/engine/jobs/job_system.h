@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace engine {
+	namespace jobs {
+		using Job = std::function<void()>;
+
+		class JobCounter;
+
+		struct QueuedJob {
+			Job job;
+
+			// Already incremented for this job, decremented once it has run
+			JobCounter* counter;
+		};
+
+		// Counts outstanding jobs. Jobs scheduled with a counter increment it and decrement it
+		// once they finish, and continuations queued on the counter run when it reaches zero
+		class JobCounter {
+		public:
+			JobCounter() = default;
+
+			JobCounter(const JobCounter&) = delete;
+			JobCounter& operator=(const JobCounter&) = delete;
+
+			// Only a hint for polling, use JobSystem::wait before destroying a counter
+			bool isDone() const { return mCount.load(std::memory_order_acquire) == 0; }
+		private:
+			std::atomic<int> mCount{ 0 };
+
+			std::mutex mContinuationMutex;
+			std::vector<QueuedJob> mContinuations;
+
+			friend class JobSystem;
+		};
+
+		class JobSystem {
+		public:
+			// Number of worker threads to start. A negative count leaves one hardware thread for the thread that
+			// owns the system, which runs jobs whenever it waits. With 0 workers jobs only run inside wait()
+			explicit JobSystem(int workerCount = -1);
+			~JobSystem();
+
+			JobSystem(const JobSystem&) = delete;
+			JobSystem& operator=(const JobSystem&) = delete;
+
+			// Threads outside of the pool that can run jobs, each gets a participant slot the first time it schedules
+			// or waits on one. Past that getCurrentParticipant throws
+			static const int MAX_OUTSIDE_THREADS = 4;
+
+			// Push a job onto the calling thread's deque
+			void schedule(Job&& job, JobCounter* counter = nullptr);
+
+			// Run a job once every job tracked by dependency has finished
+			void scheduleAfter(JobCounter& dependency, Job&& job, JobCounter* counter = nullptr);
+
+			// Blocks until the counter reaches zero, running other jobs in the meantime
+			void wait(JobCounter& counter);
+
+			// Splits [0, count) into ranges of at most grainSize and runs them across the pool. The function
+			// receives the range and the index of the participant running it, which is in [0, getParticipantCount())
+			void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end, int participant)>& function);
+
+			int getWorkerCount() const { return (int)mThreads.size(); }
+
+			// Workers plus a slot for each thread outside of the pool
+			int getParticipantCount() const { return getWorkerCount() + MAX_OUTSIDE_THREADS; }
+
+			// Index of the calling thread, threads outside of the pool get one from getWorkerCount() on
+			int getCurrentParticipant() const;
+		private:
+			struct WorkerQueue {
+				std::mutex mutex;
+				std::deque<QueuedJob> jobs;
+			};
+
+			// One deque per participant, the ones of outside threads come after the workers'
+			std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+			std::vector<std::thread> mThreads;
+
+			// Tells systems apart in the slots threads remember, addresses can be reused
+			uint64_t mId;
+			mutable std::atomic<int> mOutsideThreads{ 0 };
+
+			std::mutex mSleepMutex;
+			std::condition_variable mSleepCondition;
+			std::atomic<int> mQueuedJobs{ 0 };
+			std::atomic<int> mSleepingWorkers{ 0 };
+			bool mStopping{ false };
+
+			void workerLoop(int workerIndex);
+
+			void push(QueuedJob&& job);
+
+			// The owner takes from the back of its own deque, thieves take from the front of everyone else's
+			bool popOwn(int queueIndex, QueuedJob& outJob);
+			bool steal(int thiefIndex, QueuedJob& outJob);
+
+			bool runOne(int participant);
+
+			void finish(JobCounter* counter);
+		};
+	}
+}
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "mesh.h"
 #include "tools/initializers.h"
 #include "../window.h"
+#include "../../sim/material.h"
 #include "../../util/debug.h"
 
 #include <glm/gtx/transform.hpp>
@@ -517,8 +518,19 @@ namespace engine {
 
 			Material::create("raymarch_sphere", Material::getMaterialLayout("raymarch_layout"))->finalize();
 
-			Material::createMaterialLayout("fs_raymarch_layout", "fs_raymarch", "fs_raymarch")->finalize(pDevice, renderPass);
-			Material::create("fs_raymarch_mat", Material::getMaterialLayout("fs_raymarch_layout"))->finalize();
+			MaterialColourData colourData{};
+
+			for (int i = 0; i < 256; i++) {
+				uint32_t colour = sim::getMaterialColour((uint8_t)i);
+
+				colourData.colours[i] = glm::vec4{ (colour & 0xFF) / 255.0f, ((colour >> 8) & 0xFF) / 255.0f, ((colour >> 16) & 0xFF) / 255.0f, (colour >> 24) / 255.0f };
+			}
+
+			Material::createMaterialLayout("fs_raymarch_layout", "fs_raymarch", "fs_raymarch")
+				->addDataBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, padUniformBufferSize(sizeof(MaterialColourData)), sizeof(MaterialColourData))
+				.finalize(pDevice, renderPass);
+
+			Material::create("fs_raymarch_mat", Material::getMaterialLayout("fs_raymarch_layout"))->writeBuffer(0, &colourData).finalize();
 
 
 			// Add buffers to deletion queue
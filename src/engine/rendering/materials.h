@@ -172,5 +172,10 @@ namespace engine {
 		struct BasicData {
 			glm::vec4 color;
 		};
+
+		// Colour of every simulation material, indexed by its id, taken from the material registry
+		struct MaterialColourData {
+			glm::vec4 colours[256];
+		};
 	}
 }
\ No newline at end of file
@@ -396,8 +396,9 @@ namespace engine {
 			"VK_LAYER_KHRONOS_validation"
 		};
 
-		Renderer::Renderer(Window* window) {
+		Renderer::Renderer(Window* window, jobs::JobSystem* jobSystem) {
 			mWindow = window;
+			pJobSystem = jobSystem;
 		}
 
 		void Renderer::init(VkApplicationInfo appInfo) {
@@ -434,36 +435,36 @@ namespace engine {
 			mMainDeletionQueue.pushFunction([=]() { cleanupSwapchain(); });
 		}
 
-		void Renderer::draw() {
+		void Renderer::draw(float deltaSeconds, const sim::WorldSnapshot& snapshot) {
 			float camMoveSpeed = 1.5f;
 			float camRotSpeed = 10.0f;
 
 			if (mWindow->holdingW) {
-				camPos.z += camMoveSpeed * 0.016f;
+				camPos.z += camMoveSpeed * deltaSeconds;
 			}
 			else if (mWindow->holdingS) {
-				camPos.z -= camMoveSpeed * 0.016f;
+				camPos.z -= camMoveSpeed * deltaSeconds;
 			}
 
 			if (mWindow->holdingA) {
-				camPos.x += camMoveSpeed * 0.016f;
+				camPos.x += camMoveSpeed * deltaSeconds;
 			}
 			else if (mWindow->holdingD) {
-				camPos.x -= camMoveSpeed * 0.016f;
+				camPos.x -= camMoveSpeed * deltaSeconds;
 			}
 
 			if (mWindow->holdingSpace) {
-				camPos.y -= camMoveSpeed * 0.016f;
+				camPos.y -= camMoveSpeed * deltaSeconds;
 			}
 			else if (mWindow->holdingCTRL) {
-				camPos.y += camMoveSpeed * 0.016f;
+				camPos.y += camMoveSpeed * deltaSeconds;
 			}
 
 			if (mWindow->holdingRight) {
-				camRot.y += camRotSpeed * 0.016f;
+				camRot.y += camRotSpeed * deltaSeconds;
 			}
 			else if (mWindow->holdingLeft) {
-				camRot.y -= camRotSpeed * 0.016f;
+				camRot.y -= camRotSpeed * deltaSeconds;
 			}
 
 			// Wait until the GPU has finished rendering the last frame. Timeout of 1 second
@@ -1267,12 +1268,16 @@ namespace engine {
 			mTriangleMesh.vertices[5].uv = { 1.f, 0.f };
 
 			Mesh cubeMesh{};
-			cubeMesh.loadFromObj("../../assets/cube2.obj");
 
-			mMesh.loadFromObj("../../assets/monkey_smooth.obj");
-			//mTeapotMesh.loadFromObj("../../assets/teapot.obj");
+			// Parse the obj files on the job system, only the uploads have to happen on this thread
+			jobs::JobCounter parseCounter;
 
-			mVikingRoom.loadFromObj("../../assets/viking_room.obj");
+			pJobSystem->schedule([&]() { cubeMesh.loadFromObj("../../assets/cube2.obj"); }, &parseCounter);
+			pJobSystem->schedule([&]() { mMesh.loadFromObj("../../assets/monkey_smooth.obj"); }, &parseCounter);
+			//pJobSystem->schedule([&]() { mTeapotMesh.loadFromObj("../../assets/teapot.obj"); }, &parseCounter);
+			pJobSystem->schedule([&]() { mVikingRoom.loadFromObj("../../assets/viking_room.obj"); }, &parseCounter);
+
+			pJobSystem->wait(parseCounter);
 
 			uploadMesh(mTriangleMesh);
 			uploadMesh(mMesh);
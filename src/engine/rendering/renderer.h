@@ -1,12 +1,14 @@
 #pragma once
 
 #include "../window.h"
+#include "../jobs/job_system.h"
 #include "device.h"
 #include "descriptors.h"
 #include "commands.h"
 #include "deletion_queue.h"
 #include "memory/memory_management.h"
 #include "mesh.h"
+#include "../../sim/snapshot.h"
 
 #include <vulkan/vulkan.h>
 
@@ -80,13 +82,15 @@ namespace engine {
 
 		class Renderer {
 		public:
-			Renderer(Window* window);
+			Renderer(Window* window, jobs::JobSystem* jobSystem);
 
 			void init(VkApplicationInfo appInfo);
 
 			void cleanup();
 
-			void draw();
+			// Draws a frame, moving the camera by the time elapsed since the last one. The snapshot must
+			// stay unchanged until draw returns
+			void draw(float deltaSeconds, const sim::WorldSnapshot& snapshot);
 
 			void waitForGraphics();
 
@@ -101,6 +105,7 @@ namespace engine {
 			int mFrameNumber{ 0 };
 
 			Window* mWindow;
+			jobs::JobSystem* pJobSystem;
 
 			// Vulkan objects
 			VkInstance mInstance;
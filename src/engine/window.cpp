@@ -110,6 +110,10 @@ namespace engine {
 		SDL_DestroyWindow(mWindow);
 	}
 
+	void Window::setTitle(const char* title) {
+		SDL_SetWindowTitle(mWindow, title);
+	}
+
 	Window& Window::getMainWindow() {
 		return *pMainWindow;
 	}
@@ -27,6 +27,8 @@ namespace engine {
 
 		void cleanup();
 
+		void setTitle(const char* title);
+
 		SDL_Window* getWindow() { return mWindow; }
 
 		VkExtent2D getExtent() { return mWindowExtent; }
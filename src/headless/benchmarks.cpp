@@ -0,0 +1,2026 @@
+#include "benchmarks.h"
+#include "report.h"
+#include "sim/world.h"
+#include "sim/scheduler.h"
+#include "sim/fall_kernel.h"
+#include "sim/liquid_kernel.h"
+#include "sim/heat.h"
+#include "sim/particles.h"
+#include "sim/material.h"
+#include "sim/random.h"
+#include "sim/world_io.h"
+#include "sim/snapshot.h"
+#include "util/bits.h"
+#include "util/block_pool.h"
+#include "util/cpu.h"
+#include "engine/jobs/job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+	// Fraction of the pile that starts out as sand, in percent
+	const uint32_t PILE_DENSITY = 60;
+
+	// Loose sand over a stone floor, so most grains have air somewhere below them and keep falling for a while
+	void buildSandPile(sim::World& world) {
+		world.setSeed(1);
+		world.fillBox(0, 0, 0, world.getSizeX() - 1, 0, world.getSizeZ() - 1, sim::MATERIAL_STONE);
+
+		for (int y = 8; y < world.getSizeY() - 8; y++) {
+			for (int z = 0; z < world.getSizeZ(); z++) {
+				for (int x = 0; x < world.getSizeX(); x++) {
+					if (sim::randomForCell(world.getSeed(), 0, x, y, z, 0) % 100 < PILE_DENSITY)
+						world.setMaterial(x, y, z, sim::MATERIAL_SAND);
+				}
+			}
+		}
+	}
+
+	// Raw kernel throughput on every layer of a chunk that has one below it
+	void benchmarkFallLayers(const char* label, sim::FallLayerFunction fallLayer) {
+		const int REPEATS = 2000;
+
+		// Linear like the kernels expect, whatever the layout of the chunks
+		std::vector<sim::Cell> chunkCells(sim::CHUNK_VOLUME);
+		sim::Cell* cells = chunkCells.data();
+
+		for (int i = 0; i < sim::CHUNK_VOLUME; i++) {
+			cells[i] = sim::Cell{ (uint8_t)(sim::mixBits(i) % 100 < PILE_DENSITY ? sim::MATERIAL_SAND : sim::MATERIAL_AIR), 0 };
+		}
+
+		std::vector<sim::Cell> pristine(chunkCells);
+
+		uint64_t layers = 0;
+		uint64_t fell = 0;
+		double seconds = 0.0;
+
+		for (int repeat = 0; repeat < REPEATS; repeat++) {
+			memcpy(cells, pristine.data(), sizeof(sim::Cell) * sim::CHUNK_VOLUME);
+
+			auto start = std::chrono::steady_clock::now();
+
+			for (int y = 1; y < sim::CHUNK_SIZE; y++) {
+				for (int z = 0; z < sim::CHUNK_SIZE; z += sim::BRICK_SIZE) {
+					for (int x = 0; x < sim::CHUNK_SIZE; x += sim::BRICK_SIZE) {
+						sim::Cell* layer = &cells[sim::LinearLayout::index(x, y, z)];
+
+						fell += util::popCount(fallLayer(layer, layer - sim::CHUNK_AREA, sim::CHUNK_SIZE, sim::MATERIAL_SAND, CELL_FLAG_STAMP));
+						layers++;
+					}
+				}
+			}
+
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		printf("  %-8s %7.2f ns/layer, %8.1f Mcells/s scanned, %llu falls\n", label, seconds * 1e9 / layers,
+			layers * (double)sim::BRICK_SIZE * sim::BRICK_SIZE / seconds / 1e6, (unsigned long long)fell);
+	}
+
+	struct PileResult {
+		double seconds;
+		uint64_t cellsMoved;
+		uint64_t checksum;
+	};
+
+	// Whole ticks on a single thread, so the kernels are compared without any scheduling noise
+	PileResult benchmarkSandPile(sim::FallKernel kernel, int ticks) {
+		sim::World world(2, 4, 2);
+		world.setFallKernel(kernel);
+
+		buildSandPile(world);
+
+		PileResult result{ 0.0, 0, 0 };
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int tick = 0; tick < ticks; tick++) {
+			result.cellsMoved += world.tick().cellsMoved;
+		}
+
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.checksum = world.computeChecksum();
+
+		return result;
+	}
+
+	bool benchmarkFall() {
+		const int TICKS = 200;
+
+		printf("AVX2 %s\n", util::cpuSupportsAVX2() && sim::getFallLayerAVX2() != nullptr ? "available" : "not available");
+
+		printf("Fall kernel, one 8x8 brick layer per call:\n");
+		benchmarkFallLayers("scalar", sim::fallLayerScalar);
+		benchmarkFallLayers("auto", sim::getFallLayerFunction(sim::FALL_KERNEL_AUTO));
+
+		printf("Dense sand pile, 64x128x64 cells, %d ticks on one thread:\n", TICKS);
+
+		const sim::FallKernel kernels[] = { sim::FALL_KERNEL_PER_CELL, sim::FALL_KERNEL_SCALAR, sim::FALL_KERNEL_AVX2 };
+
+		PileResult baseline{};
+		uint64_t bulkChecksum = 0;
+		bool matched = true;
+
+		for (sim::FallKernel kernel : kernels) {
+			PileResult result = benchmarkSandPile(kernel, TICKS);
+
+			if (kernel == sim::FALL_KERNEL_PER_CELL) {
+				baseline = result;
+			}
+			else if (bulkChecksum == 0) {
+				bulkChecksum = result.checksum;
+			}
+			else if (result.checksum != bulkChecksum) {
+				matched = false;
+			}
+
+			printf("  %-8s %8.3f ms/tick, %7.1f Mcells/s moved, %.2fx, checksum %016llx\n", sim::getFallKernelName(kernel),
+				result.seconds * 1000.0 / TICKS, result.cellsMoved / result.seconds / 1e6, baseline.seconds / result.seconds,
+				(unsigned long long)result.checksum);
+		}
+
+		// The per cell rules visit cells in a different order, only the two bulk kernels have to agree
+		printf("Scalar and AVX2 kernels %s\n", matched ? "match" : "DIFFER");
+
+		return matched;
+	}
+
+	// A mix of brush strokes spread over the whole world, mostly single cells with some larger shapes
+	sim::EditCommand makeRandomEdit(const sim::World& world, uint64_t index) {
+		uint64_t bits = sim::mixBits(index);
+
+		int x = (int)(bits % world.getSizeX());
+		int y = (int)((bits >> 16) % world.getSizeY());
+		int z = (int)((bits >> 32) % world.getSizeZ());
+		uint8_t material = (uint8_t)(1 + (bits >> 48) % (sim::MaterialRegistry::getCount() - 1));
+
+		switch ((bits >> 56) % 20) {
+		case 0:
+			return sim::EditCommand::impulse(x, y, z, 4);
+		case 1:
+			return sim::EditCommand::fillBox(x, y, z, x + 3, y + 3, z + 3, material);
+		case 2:
+		case 3:
+		case 4:
+		case 5:
+			return sim::EditCommand::fillSphere(x, y, z, 3, material);
+		default:
+			return sim::EditCommand::setCell(x, y, z, material);
+		}
+	}
+
+	bool benchmarkEdits() {
+		const int PRODUCERS = 3;
+		const uint64_t EDITS_PER_PRODUCER = 20000;
+		const uint64_t ORDER_CHECK_EDITS = 5000;
+
+		// Queued edits are applied chunk by chunk, which must end up the same as applying them one by one
+		sim::World batched(4, 2, 4);
+		sim::World sequential(4, 2, 4);
+
+		for (uint64_t i = 0; i < ORDER_CHECK_EDITS; i++) {
+			sim::EditCommand edit = makeRandomEdit(batched, i);
+
+			batched.queueEdit(edit);
+			sequential.applyEdit(edit);
+		}
+
+		batched.applyQueuedEdits();
+
+		bool matched = batched.computeChecksum() == sequential.computeChecksum();
+
+		printf("Batched and sequential edits %s\n", matched ? "match" : "DIFFER");
+
+		// Producers queue edits as fast as they can while this thread keeps ticking
+		sim::World world(4, 2, 4);
+
+		std::atomic<int> producersLeft{ PRODUCERS };
+		std::atomic<uint64_t> rejected{ 0 };
+		std::vector<std::thread> producers;
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int producer = 0; producer < PRODUCERS; producer++) {
+			producers.emplace_back([&, producer]() {
+				for (uint64_t i = 0; i < EDITS_PER_PRODUCER; i++) {
+					sim::EditCommand edit = makeRandomEdit(world, producer * EDITS_PER_PRODUCER + i);
+
+					while (!world.queueEdit(edit)) {
+						rejected.fetch_add(1, std::memory_order_relaxed);
+						std::this_thread::yield();
+					}
+				}
+
+				producersLeft.fetch_sub(1);
+			});
+		}
+
+		uint64_t ticks = 0;
+		uint64_t applied = 0;
+		uint64_t timedApplied = 0;
+		double applySeconds = 0.0;
+
+		while (true) {
+			// Read before draining, so the last edits of every producer are picked up by this round
+			bool producing = producersLeft.load() > 0;
+
+			auto applyStart = std::chrono::steady_clock::now();
+			size_t count = world.applyQueuedEdits();
+			applySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - applyStart).count();
+
+			timedApplied += count;
+
+			// The tick drains whatever was pushed since, which only counts towards the total
+			count += world.tick().editsApplied;
+			applied += count;
+			ticks++;
+
+			if (!producing && count == 0)
+				break;
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		for (auto& producer : producers) {
+			producer.join();
+		}
+
+		printf("%d producers, %llu edits over %llu ticks in %.3f s\n", PRODUCERS, (unsigned long long)applied, (unsigned long long)ticks, seconds);
+		printf("  %.1f k edits/s applied, %.3f us per edit, %llu pushes rejected while the queue was full\n", timedApplied / applySeconds / 1e3,
+			applySeconds * 1e6 / timedApplied, (unsigned long long)rejected.load());
+
+		bool complete = applied == PRODUCERS * EDITS_PER_PRODUCER;
+
+		if (!complete)
+			printf("Expected %llu edits\n", (unsigned long long)(PRODUCERS * EDITS_PER_PRODUCER));
+
+		return matched && complete;
+	}
+
+	// Runs of cells drawn from a set of distinct values, the kind of mix a settled chunk holds
+	void fillWithDistinctCells(sim::Cell* cells, int distinct) {
+		for (int i = 0; i < sim::CHUNK_VOLUME; i++) {
+			uint32_t value = (uint32_t)(sim::mixBits(i / 16) % distinct);
+
+			cells[i] = sim::Cell{ (uint8_t)value, (uint8_t)(value >> 8) };
+		}
+	}
+
+	bool benchmarkPackedCells() {
+		const int REPEATS = 200;
+		const int DISTINCT[] = { 2, 3, 4, 11, 200 };
+
+		bool matched = true;
+
+		printf("Packing one chunk, %d KiB dense:\n", (int)(sim::CHUNK_VOLUME * sizeof(sim::Cell) / 1024));
+
+		std::vector<sim::Cell> cells(sim::CHUNK_VOLUME);
+		std::vector<sim::Cell> unpacked(sim::CHUNK_VOLUME);
+
+		for (int distinct : DISTINCT) {
+			fillWithDistinctCells(cells.data(), distinct);
+
+			sim::PackedCells packed;
+			double packSeconds = 0.0;
+			double unpackSeconds = 0.0;
+
+			for (int repeat = 0; repeat < REPEATS; repeat++) {
+				auto start = std::chrono::steady_clock::now();
+				packed.pack(cells.data(), sim::CHUNK_VOLUME);
+				packSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+
+			for (int repeat = 0; repeat < REPEATS; repeat++) {
+				auto start = std::chrono::steady_clock::now();
+				packed.unpack(unpacked.data());
+				unpackSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+
+			bool roundTrip = memcmp(cells.data(), unpacked.data(), sizeof(sim::Cell) * sim::CHUNK_VOLUME) == 0;
+			matched = matched && roundTrip;
+
+			printf("  %3d distinct: %d bits, %6.2f KiB, pack %7.2f us, unpack %6.2f us%s\n", distinct, packed.getBitsPerCell(),
+				packed.getMemoryBytes() / 1024.0, packSeconds * 1e6 / REPEATS, unpackSeconds * 1e6 / REPEATS, roundTrip ? "" : ", round trip DIFFERS");
+		}
+
+		return matched;
+	}
+
+	// Settled ground with sand poured into one corner, so only a small part of the world stays awake
+	std::unique_ptr<sim::World> buildPouringWorld(bool compress) {
+		auto world = std::make_unique<sim::World>(8, 4, 8);
+		world->setSeed(3);
+		world->setCompressIdleChunks(compress);
+
+		world->fillBox(0, 0, 0, world->getSizeX() - 1, 39, world->getSizeZ() - 1, sim::MATERIAL_STONE);
+		world->fillBox(0, 40, 0, world->getSizeX() - 1, 63, world->getSizeZ() - 1, sim::MATERIAL_SAND);
+
+		// Veins of stone through the sand, so the palettes hold more than a single material
+		for (int i = 0; i < 400; i++) {
+			uint64_t bits = sim::mixBits(i);
+			int x = (int)(bits % world->getSizeX());
+			int y = 40 + (int)((bits >> 16) % 24);
+			int z = (int)((bits >> 32) % world->getSizeZ());
+
+			world->applyEdit(sim::EditCommand::fillSphere(x, y, z, 3, sim::MATERIAL_STONE));
+		}
+
+		return world;
+	}
+
+	bool benchmarkPalette() {
+		const int TICKS = 400;
+
+		bool matched = benchmarkPackedCells();
+
+		printf("World with sand poured into one corner, %d ticks on one thread:\n", TICKS);
+
+		uint64_t checksums[2] = { 0, 0 };
+		size_t totals[2] = { 0, 0 };
+
+		for (int compress = 0; compress < 2; compress++) {
+			std::unique_ptr<sim::World> world = buildPouringWorld(compress != 0);
+
+			uint64_t activeChunks = 0;
+			uint64_t allocatedChunks = 0;
+
+			auto start = std::chrono::steady_clock::now();
+
+			for (int tick = 0; tick < TICKS; tick++) {
+				world->queueEdit(sim::EditCommand::fillBox(8, 120, 8, 15, 120, 15, sim::MATERIAL_SAND));
+				world->tick();
+
+				for (auto& chunk : world->getChunks()) {
+					activeChunks += chunk->isActive() ? 1 : 0;
+				}
+
+				allocatedChunks += world->getChunkCount();
+			}
+
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			sim::WorldMemoryStats memory = world->getMemoryStats();
+
+			checksums[compress] = world->computeChecksum();
+			totals[compress] = memory.getTotalBytes();
+
+			printf("Compression %s, %.3f ms/tick, %.1f%% of chunks active on average, checksum %016llx\n", compress ? "on" : "off",
+				seconds * 1000.0 / TICKS, activeChunks * 100.0 / allocatedChunks, (unsigned long long)checksums[compress]);
+			headless::printWorldMemory(memory);
+		}
+
+		printf("Compressed world uses %.2fx less memory\n", totals[1] > 0 ? (double)totals[0] / totals[1] : 0.0);
+
+		// Compressed chunks act as walls for chunks that wake up mid tick, so the two runs may drift apart
+		printf("Checksums %s\n", checksums[0] == checksums[1] ? "match" : "differ");
+
+		return matched;
+	}
+
+	// A hollow stone hut on a sand floor, the same in every chunk it is stamped into
+	void buildStructure(sim::Cell* cells) {
+		for (int y = 0; y < sim::CHUNK_SIZE; y++) {
+			for (int z = 0; z < sim::CHUNK_SIZE; z++) {
+				for (int x = 0; x < sim::CHUNK_SIZE; x++) {
+					bool wall = x >= 4 && x < 28 && z >= 4 && z < 28 && y >= 2 && y < 20 && (x == 4 || x == 27 || z == 4 || z == 27 || y == 19);
+					uint8_t material = y < 2 ? sim::MATERIAL_SAND : (wall ? sim::MATERIAL_STONE : sim::MATERIAL_AIR);
+
+					cells[sim::Chunk::index(x, y, z)] = sim::Cell{ material, 0 };
+				}
+			}
+		}
+	}
+
+	// Two layers of bedrock chunks with a layer of stamped structures on top
+	void generateWorld(sim::World& world, bool dense, const std::vector<sim::Cell>& structure) {
+		std::shared_ptr<sim::PackedCells> shared = std::make_shared<sim::PackedCells>();
+		shared->pack(structure.data(), sim::CHUNK_VOLUME);
+
+		for (int chunkZ = 0; chunkZ < world.getChunksZ(); chunkZ++) {
+			for (int chunkX = 0; chunkX < world.getChunksX(); chunkX++) {
+				for (int chunkY = 0; chunkY < 3; chunkY++) {
+					if (!dense) {
+						if (chunkY < 2) {
+							world.setUniformChunk(chunkX, chunkY, chunkZ, sim::Cell{ sim::MATERIAL_STONE, 0 });
+						}
+						else {
+							world.setSharedChunk(chunkX, chunkY, chunkZ, shared);
+						}
+
+						continue;
+					}
+
+					// What generation had to do before, a full array for every chunk
+					sim::Chunk* chunk = world.getOrCreateChunk(chunkX, chunkY, chunkZ);
+					chunk->decompress();
+
+					if (chunkY < 2) {
+						std::fill(chunk->getCells(), chunk->getCells() + sim::CHUNK_VOLUME, sim::Cell{ sim::MATERIAL_STONE, 0 });
+						chunk->addFilledCells(sim::CHUNK_VOLUME);
+					}
+					else {
+						memcpy(chunk->getCells(), structure.data(), sizeof(sim::Cell) * sim::CHUNK_VOLUME);
+						chunk->addFilledCells(shared->getFilledCells());
+					}
+
+					chunk->markChanged();
+				}
+			}
+		}
+	}
+
+	bool benchmarkWorldGeneration() {
+		std::vector<sim::Cell> structure(sim::CHUNK_VOLUME);
+		buildStructure(structure.data());
+
+		std::unique_ptr<sim::World> worlds[2];
+		uint64_t checksums[2];
+		size_t totals[2];
+
+		printf("Generating 8x3x8 chunks, two layers of bedrock under a layer of stamped structures:\n");
+
+		for (int shared = 0; shared < 2; shared++) {
+			worlds[shared] = std::make_unique<sim::World>(8, 4, 8);
+
+			auto start = std::chrono::steady_clock::now();
+			generateWorld(*worlds[shared], shared == 0, structure);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			sim::WorldMemoryStats memory = worlds[shared]->getMemoryStats();
+
+			checksums[shared] = worlds[shared]->computeChecksum();
+			totals[shared] = memory.getTotalBytes();
+
+			printf("%s chunks, generated in %.3f ms, checksum %016llx\n", shared ? "Uniform and shared" : "Dense", seconds * 1000.0,
+				(unsigned long long)checksums[shared]);
+			headless::printWorldMemory(memory);
+		}
+
+		printf("Uniform and shared chunks use %.2fx less memory\n", totals[1] > 0 ? (double)totals[0] / totals[1] : 0.0);
+
+		bool matched = checksums[0] == checksums[1];
+		printf("Checksums %s\n", matched ? "match" : "DIFFER");
+
+		// Writing to one stamped chunk copies it out, every other chunk keeps sharing the original
+		sim::World& world = *worlds[1];
+		world.setMaterial(40, 64 + 10, 40, sim::MATERIAL_WATER);
+
+		const sim::Chunk* written = world.getChunk(1, 2, 1);
+		const sim::Chunk* other = world.getChunk(2, 2, 1);
+
+		bool copied = written->getStorage() == sim::CHUNK_STORAGE_DENSE && written->getCell(8, 10, 8).material == sim::MATERIAL_WATER;
+		bool untouched = other->getStorage() == sim::CHUNK_STORAGE_PACKED && other->getCell(8, 10, 8).material == sim::MATERIAL_AIR;
+
+		printf("Copy on write %s\n", copied && untouched ? "works" : "FAILED");
+
+		// The engine hands frames one of three snapshots, which only copy the chunks that are dense
+		engine::jobs::JobSystem jobSystem(0);
+		sim::Simulation simulation(jobSystem, 8, 4, 8);
+		generateWorld(simulation.getWorld(), false, structure);
+		simulation.getWorld().setMaterial(40, 64 + 10, 40, sim::MATERIAL_WATER);
+
+		bool snapshotMatches = true;
+		size_t snapshotBytes;
+		size_t recopied;
+		bool freed;
+
+		{
+			sim::WorldSnapshot snapshots[3];
+
+			for (sim::WorldSnapshot& snapshot : snapshots) {
+				snapshot.capture(simulation);
+			}
+
+			snapshotBytes = snapshots[2].getWorldMemory().snapshotBytes;
+
+			std::vector<sim::Cell> expected(sim::CHUNK_VOLUME);
+			std::vector<sim::Cell> actual(sim::CHUNK_VOLUME);
+
+			for (auto& chunk : simulation.getWorld().getChunks()) {
+				int slot = snapshots[0].findSlot(chunk->getId());
+
+				if (slot < 0) {
+					snapshotMatches = false;
+					break;
+				}
+
+				chunk->copyCells(expected.data());
+				snapshots[0].copyChunkCells(slot, actual.data());
+
+				snapshotMatches = snapshotMatches && memcmp(expected.data(), actual.data(), sizeof(sim::Cell) * sim::CHUNK_VOLUME) == 0;
+			}
+
+			// Freeing a chunk in the middle, away from the water, closes the gap it leaves in the world. The chunks
+			// after it keep their slots
+			sim::World& world = simulation.getWorld();
+			uint64_t freedId = world.getChunk(4, 0, 4)->getId();
+
+			world.setUniformChunk(4, 0, 4, sim::Cell{ sim::MATERIAL_AIR, 0 });
+			simulation.step();
+
+			recopied = snapshots[0].capture(simulation);
+			freed = world.getChunk(4, 0, 4) == nullptr && snapshots[0].findSlot(freedId) < 0;
+		}
+
+		size_t copiedBytes = 3 * simulation.getWorld().getChunkCount() * sim::CHUNK_VOLUME * sizeof(sim::Cell);
+		bool released = sim::WorldSnapshot::getLiveMemoryBytes() == 0;
+
+		printf("Three snapshots of it with one chunk written to: %.2f MiB against %.2f MiB copying every chunk, cells %s\n", snapshotBytes / (1024.0 * 1024.0),
+			copiedBytes / (1024.0 * 1024.0), snapshotMatches && released ? "match" : "DIFFER");
+		printf("Capturing again after a tick that freed a chunk copied %zu chunks, the freed one %s\n", recopied, freed ? "is gone" : "is STILL THERE");
+
+		// Only the chunks the water moved in and the ones created around them, not the 80 or so after the freed one
+		return matched && copied && untouched && snapshotMatches && released && snapshotBytes < copiedBytes / 16 && freed && recopied < 16;
+	}
+
+	// Nanoseconds to allocate and free one block, COUNT blocks at a time so the slabs are walked like a world would
+	template<typename Allocate, typename Free>
+	double timeAllocations(Allocate allocate, Free free) {
+		const int COUNT = 1024;
+		const int REPEATS = 200;
+
+		std::vector<void*> blocks(COUNT);
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int repeat = 0; repeat < REPEATS; repeat++) {
+			for (int i = 0; i < COUNT; i++) {
+				blocks[i] = allocate();
+			}
+
+			// Freed in a different order than they were allocated, as chunks are
+			for (int i = 0; i < COUNT; i++) {
+				free(blocks[(i * 7) % COUNT]);
+			}
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		return seconds * 1e9 / ((double)COUNT * REPEATS);
+	}
+
+	size_t countSlabs() {
+		size_t slabs = 0;
+
+		for (const util::BlockPoolStats& pool : util::getBlockPoolStats()) {
+			slabs += pool.slabs;
+		}
+
+		return slabs;
+	}
+
+	bool benchmarkBlockPool() {
+		const int WARMUP_TICKS = 150;
+		const int TICKS = 600;
+
+		// Chunks are created ahead of the falling sand and freed behind it for as long as it falls
+		sim::World world(2, sim::WORLD_UNBOUNDED, 2);
+		world.setSeed(5);
+		world.fillBox(8, 0, 8, 55, 31, 55, sim::MATERIAL_SAND);
+
+		size_t warmSlabs = 0;
+		size_t warmPeakChunks = 0;
+		size_t peakChunks = 0;
+		uint64_t chunksCreated = 0;
+
+		auto start = std::chrono::steady_clock::now();
+
+		// Ids only go up, so every id past the highest one seen so far is a new chunk
+		uint64_t highestId = 0;
+
+		for (int tick = 1; tick <= TICKS; tick++) {
+			world.tick();
+
+			uint64_t previousId = highestId;
+
+			for (auto& chunk : world.getChunks()) {
+				chunksCreated += chunk->getId() > previousId ? 1 : 0;
+				highestId = std::max(highestId, chunk->getId());
+			}
+
+			peakChunks = std::max(peakChunks, world.getChunkCount());
+
+			if (tick == WARMUP_TICKS) {
+				warmSlabs = countSlabs();
+				warmPeakChunks = peakChunks;
+			}
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		size_t slabs = countSlabs();
+
+		printf("Sand falling through an unbounded world, %d ticks at %.3f ms/tick:\n", TICKS, seconds * 1000.0 / TICKS);
+		printf("  %llu chunks created, %zu at the peak (%zu after %d ticks)\n", (unsigned long long)chunksCreated, peakChunks, warmPeakChunks, WARMUP_TICKS);
+		printf("  %zu slabs after %d ticks, %zu at the end\n", warmSlabs, WARMUP_TICKS, slabs);
+		headless::printBlockPools();
+
+		// Once the pools have grown to the peak, chunks that come and go only trade blocks
+		bool steady = peakChunks > warmPeakChunks || slabs == warmSlabs;
+		printf("Steady state %s\n", steady ? "allocates nothing from the heap" : "still ALLOCATES slabs");
+
+		// A chunk object and a dense array of cells
+		const size_t SIZES[] = { sizeof(sim::Chunk), sizeof(sim::Cell) * sim::CHUNK_VOLUME };
+
+		printf("Allocating and freeing 1024 blocks at a time:\n");
+
+		for (size_t bytes : SIZES) {
+			double pooled = timeAllocations([&]() { return util::allocateBlock(bytes); }, [&](void* block) { util::freeBlock(block, bytes); });
+			double heap = timeAllocations([&]() { return ::operator new(bytes); }, [&](void* block) { ::operator delete(block); });
+
+			printf("  %6zu B: pool %7.1f ns, new and delete %7.1f ns, %.2fx\n", bytes, pooled, heap, pooled > 0.0 ? heap / pooled : 0.0);
+		}
+
+		return steady;
+	}
+
+	// Worlds that stress different parts of a tick, shared by the benchmarks that compare ways of running one
+	const int TEST_WORLD_COUNT = 3;
+	const char* const TEST_WORLD_NAMES[TEST_WORLD_COUNT] = { "sand pile", "pouring", "unbounded" };
+
+	struct WorldRun {
+		double seconds;
+		uint64_t checksum;
+	};
+
+	std::unique_ptr<sim::World> buildTestWorld(int testWorld) {
+		std::unique_ptr<sim::World> world;
+
+		if (testWorld == 0) {
+			// Every brick of every chunk is awake
+			world = std::make_unique<sim::World>(2, 4, 2);
+			buildSandPile(*world);
+		}
+		else if (testWorld == 1) {
+			// A few active bricks per chunk
+			world = buildPouringWorld(true);
+		}
+		else {
+			// Sand crossing chunk faces all the time
+			world = std::make_unique<sim::World>(2, sim::WORLD_UNBOUNDED, 2);
+			world->setSeed(5);
+			world->fillBox(8, 0, 8, 55, 31, 55, sim::MATERIAL_SAND);
+		}
+
+		return world;
+	}
+
+	WorldRun runTestWorld(int testWorld, bool halos, int ticks) {
+		std::unique_ptr<sim::World> world = buildTestWorld(testWorld);
+		world->setChunkHalos(halos);
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int tick = 0; tick < ticks; tick++) {
+			if (testWorld == 1)
+				world->queueEdit(sim::EditCommand::fillBox(8, 120, 8, 15, 120, 15, sim::MATERIAL_SAND));
+
+			world->tick();
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		return WorldRun{ seconds, world->computeChecksum() };
+	}
+
+	bool benchmarkHalos() {
+		const int TICKS = 200;
+		const int RUNS = 3;
+
+		printf("Chunk updates with bounds checks against a one cell halo, %d ticks on one thread, best of %d runs:\n", TICKS, RUNS);
+
+		bool matched = true;
+
+		for (int world = 0; world < TEST_WORLD_COUNT; world++) {
+			WorldRun results[2] = { { 1e9, 0 }, { 1e9, 0 } };
+
+			// Alternating, so both see the same noise from the rest of the machine
+			for (int run = 0; run < RUNS * 2; run++) {
+				int halos = run & 1;
+				WorldRun result = runTestWorld(world, halos != 0, TICKS);
+
+				results[halos].seconds = std::min(results[halos].seconds, result.seconds);
+				results[halos].checksum = result.checksum;
+			}
+
+			bool same = results[0].checksum == results[1].checksum;
+			matched = matched && same;
+
+			printf("  %-10s bounds checks %7.3f ms/tick, halos %7.3f ms/tick, %.2fx, checksums %s\n", TEST_WORLD_NAMES[world], results[0].seconds * 1000.0 / TICKS,
+				results[1].seconds * 1000.0 / TICKS, results[1].seconds > 0.0 ? results[0].seconds / results[1].seconds : 0.0, same ? "match" : "DIFFER");
+		}
+
+		return matched;
+	}
+
+	struct ScheduledRun {
+		double seconds;
+		uint64_t checksum;
+		uint64_t cellsUpdated;
+		uint64_t cellsMoved;
+		uint64_t movesQueued;
+		uint64_t movesRejected;
+	};
+
+	// Runs a test world on the job system, so it is ticked the same way as scenarios are
+	ScheduledRun runScheduledWorld(int testWorld, sim::RuleExecutor executor, bool outboxes, int threads, int ticks) {
+		engine::jobs::JobSystem jobSystem(threads - 1);
+		sim::TickScheduler scheduler(jobSystem);
+
+		std::unique_ptr<sim::World> world = buildTestWorld(testWorld);
+		world->setRuleExecutor(executor);
+		world->setMoveOutboxes(outboxes);
+
+		ScheduledRun run{ 0.0, 0, 0, 0, 0, 0 };
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int tick = 0; tick < ticks; tick++) {
+			if (testWorld == 1)
+				world->queueEdit(sim::EditCommand::fillBox(8, 120, 8, 15, 120, 15, sim::MATERIAL_SAND));
+
+			sim::TickStats stats = scheduler.tick(*world);
+
+			run.cellsUpdated += stats.cellsUpdated;
+			run.cellsMoved += stats.cellsMoved;
+			run.movesQueued += stats.movesQueued;
+			run.movesRejected += stats.movesRejected;
+		}
+
+		run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		run.checksum = world->computeChecksum();
+
+		return run;
+	}
+
+	bool benchmarkOutboxes() {
+		const int TICKS = 200;
+		const int RUNS = 3;
+		const int THREAD_COUNTS[] = { 1, 2, 4 };
+
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+
+		printf("Parity classes against move outboxes, %d ticks, best of %d runs, %u hardware threads\n", TICKS, RUNS, hardwareThreads);
+		printf("Parity classes run %d waves per tick, outboxes one wave and a serial phase for the moves between chunks\n", sim::PARITY_CLASS_COUNT);
+
+		bool matched = true;
+
+		for (int world = 0; world < TEST_WORLD_COUNT; world++) {
+			printf("  %s:\n", TEST_WORLD_NAMES[world]);
+
+			for (int outboxes = 0; outboxes < 2; outboxes++) {
+				uint64_t firstChecksum = 0;
+
+				for (int i = 0; i < 3; i++) {
+					int threads = THREAD_COUNTS[i];
+					ScheduledRun best{ 1e9, 0, 0, 0, 0, 0 };
+
+					for (int run = 0; run < RUNS; run++) {
+						ScheduledRun result = runScheduledWorld(world, sim::RULE_EXECUTOR_SCAN, outboxes != 0, threads, TICKS);
+
+						if (result.seconds < best.seconds)
+							best = result;
+					}
+
+					if (i == 0)
+						firstChecksum = best.checksum;
+
+					// Either way the world may not depend on the number of threads
+					bool same = best.checksum == firstChecksum;
+					matched = matched && same;
+
+					printf("    %-8s %d threads %7.3f ms/tick", outboxes ? "outboxes" : "parity", threads, best.seconds * 1000.0 / TICKS);
+
+					if (outboxes) {
+						printf(", %8.1f moves queued/tick, %.2f%% rejected", (double)best.movesQueued / TICKS,
+							best.movesQueued > 0 ? best.movesRejected * 100.0 / best.movesQueued : 0.0);
+					}
+
+					printf(", checksum %016llx %s\n", (unsigned long long)best.checksum, same ? "" : "DIFFERS");
+				}
+			}
+		}
+
+		return matched;
+	}
+
+	bool benchmarkMargolus() {
+		const int TICKS = 200;
+		const int RUNS = 3;
+		const int THREAD_COUNTS[] = { 1, 2, 4 };
+		const sim::RuleExecutor EXECUTORS[] = { sim::RULE_EXECUTOR_SCAN, sim::RULE_EXECUTOR_MARGOLUS };
+
+		printf("Scan order against Margolus blocks, %d ticks, best of %d runs, %u hardware threads\n", TICKS, RUNS, std::thread::hardware_concurrency());
+
+		auto tableStart = std::chrono::steady_clock::now();
+		sim::MargolusTable::get();
+		printf("Block table of %d entries built in %.2f ms\n", sim::MARGOLUS_BLOCK_KEYS,
+			std::chrono::duration<double>(std::chrono::steady_clock::now() - tableStart).count() * 1000.0);
+
+		bool matched = true;
+
+		for (int world = 0; world < TEST_WORLD_COUNT; world++) {
+			printf("  %s:\n", TEST_WORLD_NAMES[world]);
+
+			for (sim::RuleExecutor executor : EXECUTORS) {
+				uint64_t firstChecksum = 0;
+
+				for (int i = 0; i < 3; i++) {
+					int threads = THREAD_COUNTS[i];
+					ScheduledRun best{ 1e9, 0, 0, 0, 0, 0 };
+
+					for (int run = 0; run < RUNS; run++) {
+						ScheduledRun result = runScheduledWorld(world, executor, false, threads, TICKS);
+
+						if (result.seconds < best.seconds)
+							best = result;
+					}
+
+					if (i == 0)
+						firstChecksum = best.checksum;
+
+					bool same = best.checksum == firstChecksum;
+					matched = matched && same;
+
+					printf("    %-8s %d threads %7.3f ms/tick, %7.1f Mcells/s updated, %8.1f cells moved/tick, checksum %016llx %s\n",
+						sim::getRuleExecutorName(executor), threads, best.seconds * 1000.0 / TICKS, best.seconds > 0.0 ? best.cellsUpdated / best.seconds / 1e6 : 0.0,
+						(double)best.cellsMoved / TICKS, (unsigned long long)best.checksum, same ? "" : "DIFFERS");
+				}
+			}
+		}
+
+		return matched;
+	}
+
+	// Raw flow kernel throughput on a chunk of liquid at random levels over air, every layer that has one below it.
+	// Returns a hash of the cells after the last repeat
+	uint64_t benchmarkFlowLayers(const char* label, sim::FlowLayerFunction flowLayer) {
+		const int REPEATS = 2000;
+
+		std::vector<sim::Cell> chunkCells(sim::CHUNK_VOLUME);
+		sim::Cell* cells = chunkCells.data();
+
+		for (int i = 0; i < sim::CHUNK_VOLUME; i++) {
+			int level = (int)(sim::mixBits(i) % (sim::LIQUID_LEVEL_FULL + 1));
+			sim::setLiquidLevel(cells[i], sim::MATERIAL_WATER, level);
+		}
+
+		std::vector<sim::Cell> pristine(chunkCells);
+
+		uint64_t layers = 0;
+		uint64_t flowed = 0;
+		double seconds = 0.0;
+
+		for (int repeat = 0; repeat < REPEATS; repeat++) {
+			memcpy(cells, pristine.data(), sizeof(sim::Cell) * sim::CHUNK_VOLUME);
+
+			auto start = std::chrono::steady_clock::now();
+
+			for (int y = 1; y < sim::CHUNK_SIZE; y++) {
+				for (int z = 0; z < sim::CHUNK_SIZE; z += sim::BRICK_SIZE) {
+					for (int x = 0; x < sim::CHUNK_SIZE; x += sim::BRICK_SIZE) {
+						sim::Cell* layer = &cells[sim::LinearLayout::index(x, y, z)];
+
+						flowed += util::popCount(flowLayer(layer, layer - sim::CHUNK_AREA, sim::CHUNK_SIZE, sim::MATERIAL_WATER, CELL_FLAG_STAMP).changed);
+						layers++;
+					}
+				}
+			}
+
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		uint64_t hash = 0;
+
+		for (int i = 0; i < sim::CHUNK_VOLUME; i++) {
+			hash = sim::mixBits(hash ^ ((uint64_t)cells[i].material | (uint64_t)cells[i].flags << 8));
+		}
+
+		printf("  %-8s %7.2f ns/layer, %8.1f Mcells/s scanned, %llu flows\n", label, seconds * 1e9 / layers,
+			layers * (double)sim::BRICK_SIZE * sim::BRICK_SIZE / seconds / 1e6, (unsigned long long)flowed);
+
+		return hash;
+	}
+
+	struct DamBreakRun {
+		double seconds;
+		int ticks;
+		uint64_t cellsUpdated;
+		uint64_t cellsMoved;
+		int64_t volume;
+		uint64_t checksum;
+	};
+
+	// Units of water in the world, a whole cell counts as full when liquids have no levels
+	int64_t measureWater(sim::World& world, sim::LiquidModel model) {
+		int64_t volume = 0;
+
+		for (int y = 0; y < world.getSizeY(); y++) {
+			for (int z = 0; z < world.getSizeZ(); z++) {
+				for (int x = 0; x < world.getSizeX(); x++) {
+					sim::Cell* cell = world.getCell(x, y, z);
+
+					if (cell != nullptr && cell->material == sim::MATERIAL_WATER)
+						volume += model == sim::LIQUID_MODEL_LEVELS ? sim::getLiquidLevel(*cell) : sim::LIQUID_LEVEL_FULL;
+				}
+			}
+		}
+
+		return volume;
+	}
+
+	// A wall of water against one side of a walled pool, let go at once. Ticks until no brick is awake any more
+	// or maxTicks have run
+	DamBreakRun runDamBreak(sim::LiquidModel model, sim::FallKernel kernel, bool halos, int maxTicks) {
+		sim::World world(2, 2, 2);
+		world.setSeed(3);
+		world.setLiquidModel(model);
+		world.setFallKernel(kernel);
+		world.setChunkHalos(halos);
+
+		world.fillBox(0, 0, 0, world.getSizeX() - 1, 0, world.getSizeZ() - 1, sim::MATERIAL_STONE);
+		world.fillBox(0, 1, 0, 15, 40, world.getSizeZ() - 1, sim::MATERIAL_WATER);
+
+		DamBreakRun run{ 0.0, 0, 0, 0, 0, 0 };
+
+		auto start = std::chrono::steady_clock::now();
+
+		while (run.ticks < maxTicks) {
+			sim::TickStats stats = world.tick();
+
+			run.ticks++;
+			run.cellsUpdated += stats.cellsUpdated;
+			run.cellsMoved += stats.cellsMoved;
+
+			if (stats.bricksUpdated == 0)
+				break;
+		}
+
+		run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		run.volume = measureWater(world, model);
+		run.checksum = world.computeChecksum();
+
+		return run;
+	}
+
+	bool benchmarkDamBreak() {
+		const int MAX_TICKS = 3000;
+		const sim::LiquidModel MODELS[] = { sim::LIQUID_MODEL_CELLS, sim::LIQUID_MODEL_LEVELS };
+
+		printf("AVX2 %s\n", util::cpuSupportsAVX2() && sim::getFlowLayerAVX2() != nullptr ? "available" : "not available");
+
+		printf("Level flow kernel, one 8x8 brick layer per call:\n");
+		uint64_t scalarHash = benchmarkFlowLayers("scalar", sim::flowLayerScalar);
+		uint64_t autoHash = benchmarkFlowLayers("auto", sim::getFlowLayerFunction(sim::FALL_KERNEL_AUTO));
+		bool matched = scalarHash == autoHash;
+
+		printf("Scalar and auto kernels %s\n", matched ? "match" : "DIFFER");
+
+		printf("Dam break, 16x40x64 cells of water in a 64x64x64 pool, on one thread until it comes to rest or %d ticks:\n", MAX_TICKS);
+
+		int64_t startVolume = 16 * 40 * 64 * (int64_t)sim::LIQUID_LEVEL_FULL;
+
+		for (sim::LiquidModel model : MODELS) {
+			DamBreakRun run = runDamBreak(model, sim::FALL_KERNEL_AUTO, false, MAX_TICKS);
+			bool conserved = run.volume == startVolume;
+			matched = matched && conserved;
+
+			printf("  %-6s %s after %4d ticks, %8.3f ms/tick, %7.1f Mcells/s updated, %8.1f cells moved/tick, volume %s, checksum %016llx\n",
+				sim::getLiquidModelName(model), run.ticks < MAX_TICKS ? "at rest" : "moving ", run.ticks, run.seconds * 1000.0 / run.ticks,
+				run.seconds > 0.0 ? run.cellsUpdated / run.seconds / 1e6 : 0.0, (double)run.cellsMoved / run.ticks, conserved ? "kept" : "CHANGED",
+				(unsigned long long)run.checksum);
+
+			if (model != sim::LIQUID_MODEL_LEVELS)
+				continue;
+
+			// The flow kernels and the halo have to give the same world as the default run
+			DamBreakRun scalar = runDamBreak(model, sim::FALL_KERNEL_SCALAR, false, MAX_TICKS);
+			DamBreakRun halos = runDamBreak(model, sim::FALL_KERNEL_AUTO, true, MAX_TICKS);
+			bool same = scalar.checksum == run.checksum && halos.checksum == run.checksum;
+			matched = matched && same;
+
+			printf("  Scalar kernel and halos %s\n", same ? "match" : "DIFFER");
+		}
+
+		return matched;
+	}
+
+	// One diffusion step after another on random temperatures. Returns a hash of the bits of the last result
+	uint64_t benchmarkDiffusion(const char* label, sim::DiffuseHeatFunction diffuse) {
+		const int REPEATS = 100000;
+
+		alignas(32) float padded[sim::HEAT_PADDED_VOLUME];
+		float temperatures[sim::HEAT_VOLUME];
+
+		for (int i = 0; i < sim::HEAT_PADDED_VOLUME; i++) {
+			padded[i] = (float)(sim::mixBits(i) % 2000) - 500.0f;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int repeat = 0; repeat < REPEATS; repeat++) {
+			diffuse(padded, temperatures);
+
+			// Feeds every result back in, so the steps can't be folded together
+			padded[repeat % sim::HEAT_PADDED_VOLUME] = temperatures[repeat % sim::HEAT_VOLUME];
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		uint64_t hash = 0;
+
+		for (float temperature : temperatures) {
+			uint32_t bits;
+			memcpy(&bits, &temperature, sizeof(bits));
+			hash = sim::mixBits(hash ^ bits);
+		}
+
+		printf("  %-8s %8.1f ns/step, %7.2f ns/block\n", label, seconds * 1e9 / REPEATS, seconds * 1e9 / REPEATS / sim::HEAT_VOLUME);
+
+		return hash;
+	}
+
+	struct HeatRun {
+		double seconds;
+		uint64_t cellsMoved;
+		uint64_t checksum;
+		sim::WorldMemoryStats memory;
+		size_t peakFields;
+
+		// What the pits and the block of ice turned into
+		int steam;
+		int ice;
+		int stone;
+	};
+
+	int countMaterial(sim::World& world, uint8_t material) {
+		int count = 0;
+
+		for (int y = 0; y < world.getSizeY(); y++) {
+			for (int z = 0; z < world.getSizeZ(); z++) {
+				for (int x = 0; x < world.getSizeX(); x++) {
+					count += world.getMaterial(x, y, z) == material ? 1 : 0;
+				}
+			}
+		}
+
+		return count;
+	}
+
+	// A pit of lava next to a pit of water in a thick stone floor, with a block of ice standing on the floor on
+	// the other side, in a world four times as wide as the pits. Needs the materials of assets/materials.txt
+	HeatRun runLavaPool(sim::FallKernel kernel, int ticks) {
+		uint8_t lava;
+		uint8_t ice;
+		uint8_t steam;
+		sim::findMaterial("lava", lava);
+		sim::findMaterial("ice", ice);
+		sim::findMaterial("steam", steam);
+
+		sim::World world(4, 2, 4);
+		world.setSeed(5);
+		world.setFallKernel(kernel);
+		world.setLiquidModel(sim::LIQUID_MODEL_LEVELS);
+
+		world.fillBox(0, 0, 0, world.getSizeX() - 1, 15, world.getSizeZ() - 1, sim::MATERIAL_STONE);
+		world.fillBox(40, 4, 40, 63, 13, 63, lava);
+		world.fillBox(66, 4, 40, 89, 15, 63, sim::MATERIAL_WATER);
+		world.fillBox(48, 16, 80, 55, 31, 87, ice);
+		world.wakeBox(40, 4, 40, 89, 31, 87);
+
+		HeatRun run{ 0.0, 0, 0, {}, 0, 0, 0, 0 };
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int tick = 0; tick < ticks; tick++) {
+			run.cellsMoved += world.tick().cellsMoved;
+
+			if (tick % 50 == 0)
+				run.peakFields = std::max(run.peakFields, world.getMemoryStats().heatFields);
+		}
+
+		run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		run.checksum = world.computeChecksum();
+		run.memory = world.getMemoryStats();
+		run.steam = countMaterial(world, steam);
+		run.ice = countMaterial(world, ice);
+		run.stone = countMaterial(world, sim::MATERIAL_STONE);
+
+		return run;
+	}
+
+	bool benchmarkHeat() {
+		const int TICKS = 600;
+
+		printf("AVX2 %s\n", util::cpuSupportsAVX2() && sim::getDiffuseHeatAVX2() != nullptr ? "available" : "not available");
+
+		printf("Heat diffusion, one 8x8x8 field of 4x4x4 blocks per step:\n");
+		uint64_t scalarHash = benchmarkDiffusion("scalar", sim::diffuseHeatScalar);
+		uint64_t autoHash = benchmarkDiffusion("auto", sim::getDiffuseHeatFunction(sim::FALL_KERNEL_AUTO));
+		bool matched = scalarHash == autoHash;
+
+		printf("Scalar and auto kernels %s\n", matched ? "match" : "DIFFER");
+
+		// Lava, water and ice only melt, boil and freeze with the materials of the game
+		if (!sim::MaterialRegistry::loadFromFile("assets/materials.txt"))
+			return false;
+
+		printf("Lava pit next to water and ice, 128x64x128 cells, %d ticks on one thread:\n", TICKS);
+
+		HeatRun run = runLavaPool(sim::FALL_KERNEL_AUTO, TICKS);
+		HeatRun scalar = runLavaPool(sim::FALL_KERNEL_SCALAR, TICKS);
+
+		sim::MaterialRegistry::reset();
+
+		size_t chunks = run.memory.denseChunks + run.memory.compressedChunks + run.memory.uniformChunks;
+
+		printf("  %8.3f ms/tick, %8.1f cells moved/tick\n", run.seconds * 1000.0 / TICKS, (double)run.cellsMoved / TICKS);
+		printf("  heat fields in %zu of %zu chunks at the end, %zu at the peak, %zu KiB against %zu KiB of cells\n",
+			run.memory.heatFields, chunks, run.peakFields, run.memory.heatBytes / 1024, (run.memory.denseCellBytes + run.memory.compressedCellBytes) / 1024);
+		printf("  %d cells of steam, %d of ice left, %d of stone, checksum %016llx\n", run.steam, run.ice, run.stone, (unsigned long long)run.checksum);
+
+		bool same = scalar.checksum == run.checksum;
+		matched = matched && same;
+
+		printf("  Scalar kernel %s\n", same ? "matches" : "DIFFERS");
+
+		return matched;
+	}
+
+	struct SmokeRun {
+		double seconds;
+		int ticks;
+		uint64_t cellsMoved;
+
+		// Summed over every tick, and the most on any one tick
+		uint64_t brickTicks;
+		uint64_t peakBricks;
+
+		int highest;
+		uint64_t checksum;
+	};
+
+	// A block of smoke on a stone floor in the middle of an open world, let go at once. Ticks until no brick is
+	// awake any more or maxTicks have run. Needs the materials of assets/materials.txt
+	SmokeRun runSmokePlume(sim::FallKernel kernel, bool halos, int maxTicks) {
+		uint8_t smoke;
+		sim::findMaterial("smoke", smoke);
+
+		sim::World world(4, 4, 4);
+		world.setSeed(7);
+		world.setFallKernel(kernel);
+		world.setChunkHalos(halos);
+
+		world.fillBox(0, 0, 0, world.getSizeX() - 1, 0, world.getSizeZ() - 1, sim::MATERIAL_STONE);
+		world.fillBox(56, 1, 56, 71, 8, 71, smoke);
+
+		SmokeRun run{ 0.0, 0, 0, 0, 0, 0, 0 };
+
+		auto start = std::chrono::steady_clock::now();
+
+		while (run.ticks < maxTicks) {
+			sim::TickStats stats = world.tick();
+
+			run.ticks++;
+			run.cellsMoved += stats.cellsMoved;
+			run.brickTicks += stats.bricksUpdated;
+			run.peakBricks = std::max(run.peakBricks, stats.bricksUpdated);
+
+			if (stats.bricksUpdated == 0)
+				break;
+
+			// Cheap enough next to the tick while the plume is still low
+			if (run.ticks % 10 == 0) {
+				for (int y = world.getSizeY() - 1; y > run.highest; y--) {
+					bool found = false;
+
+					for (int z = 0; z < world.getSizeZ() && !found; z++) {
+						for (int x = 0; x < world.getSizeX() && !found; x++) {
+							found = world.getMaterial(x, y, z) == smoke;
+						}
+					}
+
+					if (found) {
+						run.highest = y;
+						break;
+					}
+				}
+			}
+		}
+
+		run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		run.checksum = world.computeChecksum();
+
+		return run;
+	}
+
+	bool benchmarkSmoke() {
+		const int MAX_TICKS = 2000;
+
+		// Smoke is one of the materials of the game
+		if (!sim::MaterialRegistry::loadFromFile("assets/materials.txt"))
+			return false;
+
+		printf("Smoke plume, 16x8x16 cells let go in a 128x128x128 world, on one thread until it has dissolved or %d ticks:\n", MAX_TICKS);
+
+		SmokeRun run = runSmokePlume(sim::FALL_KERNEL_AUTO, false, MAX_TICKS);
+		SmokeRun scalar = runSmokePlume(sim::FALL_KERNEL_SCALAR, false, MAX_TICKS);
+		SmokeRun halos = runSmokePlume(sim::FALL_KERNEL_AUTO, true, MAX_TICKS);
+
+		sim::MaterialRegistry::reset();
+
+		printf("  %s after %d ticks, %8.3f ms/tick, %8.1f cells moved/tick\n", run.ticks < MAX_TICKS ? "asleep" : "moving", run.ticks,
+			run.seconds * 1000.0 / run.ticks, (double)run.cellsMoved / run.ticks);
+		printf("  %.1f bricks awake per tick on average, %llu at the peak, rose to y %d, checksum %016llx\n", (double)run.brickTicks / run.ticks,
+			(unsigned long long)run.peakBricks, run.highest, (unsigned long long)run.checksum);
+
+		bool same = scalar.checksum == run.checksum && halos.checksum == run.checksum;
+
+		printf("  Scalar kernel and halos %s\n", same ? "match" : "DIFFER");
+
+		return same && run.ticks < MAX_TICKS;
+	}
+
+	// Integrates a full buffer of particles thrown every which way, over and over. Returns a hash of the bits of
+	// the positions at the end
+	uint64_t benchmarkIntegration(const char* label, sim::IntegrateParticlesFunction integrate) {
+		const int REPEATS = 200;
+
+		sim::ParticleBuffer particles;
+
+		for (size_t i = 0; i < sim::PARTICLE_CAPACITY; i++) {
+			uint64_t bits = sim::mixBits(i);
+
+			particles.add((int)(bits & 0xFF), (int)((bits >> 8) & 0xFF), (int)((bits >> 16) & 0xFF), ((bits >> 24) & 0xFF) / 64.0f - 2.0f,
+				((bits >> 32) & 0xFF) / 64.0f - 2.0f, ((bits >> 40) & 0xFF) / 64.0f - 2.0f, sim::MATERIAL_SAND);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int repeat = 0; repeat < REPEATS; repeat++) {
+			integrate(particles);
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		uint64_t hash = 0;
+
+		for (size_t i = 0; i < particles.size(); i++) {
+			uint32_t bits[3];
+			memcpy(&bits[0], &particles.positionsX[i], sizeof(float));
+			memcpy(&bits[1], &particles.positionsY[i], sizeof(float));
+			memcpy(&bits[2], &particles.positionsZ[i], sizeof(float));
+			hash = sim::mixBits(hash ^ bits[0] ^ ((uint64_t)bits[1] << 32));
+			hash = sim::mixBits(hash ^ bits[2]);
+		}
+
+		printf("  %-8s %7.3f ns/particle, %8.1f Mparticles/s\n", label, seconds * 1e9 / REPEATS / particles.size(),
+			REPEATS * particles.size() / seconds / 1e6);
+
+		return hash;
+	}
+
+	uint64_t countFilledCells(const sim::World& world) {
+		uint64_t count = 0;
+
+		for (auto& chunk : world.getChunks()) {
+			count += chunk->getFilledCells();
+		}
+
+		return count;
+	}
+
+	struct FallRun {
+		double seconds;
+		int ticks;
+		uint64_t brickTicks;
+		uint64_t checksum;
+	};
+
+	// A column of sand let go high above a stone floor. Ticks until no brick is awake any more or maxTicks have run
+	FallRun runHighFall(bool fastFalls, int maxTicks) {
+		sim::World world(2, 8, 2);
+		world.setSeed(3);
+		world.setFastFalls(fastFalls);
+
+		world.fillBox(0, 0, 0, world.getSizeX() - 1, 3, world.getSizeZ() - 1, sim::MATERIAL_STONE);
+		world.fillBox(24, 200, 24, 39, 231, 39, sim::MATERIAL_SAND);
+
+		FallRun run{ 0.0, 0, 0, 0 };
+
+		auto start = std::chrono::steady_clock::now();
+
+		while (run.ticks < maxTicks) {
+			sim::TickStats stats = world.tick();
+
+			run.ticks++;
+			run.brickTicks += stats.bricksUpdated;
+
+			if (stats.bricksUpdated == 0)
+				break;
+		}
+
+		run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		run.checksum = world.computeChecksum();
+
+		return run;
+	}
+
+	struct ExplosionRun {
+		double seconds;
+		int ticks;
+		size_t thrown;
+		uint64_t landed;
+		uint64_t lost;
+		size_t peakParticleBytes;
+
+		// Cells that aren't air, before the explosion and once everything has landed
+		uint64_t cellsBefore;
+		uint64_t cellsAfter;
+
+		uint64_t checksum;
+	};
+
+	// An explosion in a layer of sand on a stone floor, with fast falls like the game. Ticks until every particle
+	// has landed and no brick is awake any more, or maxTicks have run. An unbounded world has no ceiling to stop
+	// the particles thrown highest
+	ExplosionRun runExplosion(sim::FallKernel kernel, bool unbounded, int maxTicks) {
+		sim::World world(4, unbounded ? sim::WORLD_UNBOUNDED : 2, 4);
+		world.setSeed(9);
+		world.setFallKernel(kernel);
+		world.setFastFalls(true);
+
+		world.fillBox(0, 0, 0, world.getSizeX() - 1, 3, world.getSizeZ() - 1, sim::MATERIAL_STONE);
+		world.fillBox(0, 4, 0, world.getSizeX() - 1, 19, world.getSizeZ() - 1, sim::MATERIAL_SAND);
+
+		ExplosionRun run{ 0.0, 0, 0, 0, 0, 0, 0, 0, 0 };
+		run.cellsBefore = countFilledCells(world);
+
+		world.applyEdit(sim::EditCommand::explode(64, 16, 64, 12));
+		run.thrown = world.getParticles().size();
+
+		auto start = std::chrono::steady_clock::now();
+
+		while (run.ticks < maxTicks) {
+			sim::TickStats stats = world.tick();
+
+			run.ticks++;
+			run.landed += stats.particlesLanded;
+			run.lost += stats.particlesLost;
+			run.peakParticleBytes = std::max(run.peakParticleBytes, world.getMemoryStats().particleBytes);
+
+			if (stats.bricksUpdated == 0 && world.getParticles().empty())
+				break;
+		}
+
+		run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		run.cellsAfter = countFilledCells(world);
+		run.checksum = world.computeChecksum();
+
+		return run;
+	}
+
+	bool benchmarkParticles() {
+		const int MAX_TICKS = 3000;
+
+		printf("AVX2 %s\n", util::cpuSupportsAVX2() && sim::getIntegrateParticlesAVX2() != nullptr ? "available" : "not available");
+
+		printf("Particle integration, %zu particles per step:\n", sim::PARTICLE_CAPACITY);
+		uint64_t scalarHash = benchmarkIntegration("scalar", sim::integrateParticlesScalar);
+		uint64_t autoHash = benchmarkIntegration("auto", sim::getIntegrateParticlesFunction(sim::FALL_KERNEL_AUTO));
+		bool matched = scalarHash == autoHash;
+
+		printf("Scalar and auto kernels %s\n", matched ? "match" : "DIFFER");
+
+		printf("16x32x16 sand column let go 196 cells above the floor, until it is asleep:\n");
+
+		FallRun slow = runHighFall(false, MAX_TICKS);
+		FallRun fast = runHighFall(true, MAX_TICKS);
+
+		printf("  %-11s %5d ticks, %8.1f bricks awake per tick, %8.3f ms in all\n", "cell a tick", slow.ticks, (double)slow.brickTicks / slow.ticks,
+			slow.seconds * 1000.0);
+		printf("  %-11s %5d ticks, %8.1f bricks awake per tick, %8.3f ms in all\n", "fast falls", fast.ticks, (double)fast.brickTicks / fast.ticks,
+			fast.seconds * 1000.0);
+
+		printf("Explosion of radius 12 in a sand layer, 128x64x128 cells, until everything has landed and is asleep:\n");
+
+		ExplosionRun run = runExplosion(sim::FALL_KERNEL_AUTO, false, MAX_TICKS);
+		ExplosionRun scalar = runExplosion(sim::FALL_KERNEL_SCALAR, false, MAX_TICKS);
+
+		printf("  %zu cells thrown, %llu landed, %llu lost, %d ticks, %8.3f ms/tick, %zu KiB of particles at the peak\n", run.thrown,
+			(unsigned long long)run.landed, (unsigned long long)run.lost, run.ticks, run.seconds * 1000.0 / run.ticks, run.peakParticleBytes / 1024);
+
+		// Every cell thrown out comes back, unless it had nowhere to land
+		bool kept = run.cellsBefore == run.cellsAfter + run.lost && run.landed + run.lost == run.thrown;
+
+		printf("  %llu cells before, %llu after, %s, checksum %016llx\n", (unsigned long long)run.cellsBefore, (unsigned long long)run.cellsAfter,
+			kept ? "every particle accounted for" : "cells went MISSING", (unsigned long long)run.checksum);
+
+		bool same = scalar.checksum == run.checksum;
+
+		printf("  Scalar kernel %s\n", same ? "matches" : "DIFFERS");
+
+		printf("The same explosion in a world unbounded along y:\n");
+
+		ExplosionRun unbounded = runExplosion(sim::FALL_KERNEL_AUTO, true, MAX_TICKS);
+
+		// Nothing is out of the top of an unbounded world, so no particle may be lost
+		bool unboundedKept = unbounded.cellsBefore == unbounded.cellsAfter && unbounded.lost == 0 && unbounded.landed == unbounded.thrown;
+
+		printf("  %zu cells thrown, %llu landed, %llu lost, %d ticks, %llu cells before, %llu after, %s\n", unbounded.thrown,
+			(unsigned long long)unbounded.landed, (unsigned long long)unbounded.lost, unbounded.ticks, (unsigned long long)unbounded.cellsBefore,
+			(unsigned long long)unbounded.cellsAfter, unboundedKept ? "every particle accounted for" : "cells went MISSING");
+
+		return matched && same && kept && unboundedKept && fast.ticks < slow.ticks && run.ticks < MAX_TICKS && unbounded.ticks < MAX_TICKS;
+	}
+
+	// A stone slab on a stone floor, with holes dug into it at random. Every hole checks the cells around it, which
+	// are all still held up by the floor. Returns the seconds the ticks took
+	double runSlabDigging(bool detachIslands, int ticks, int holesPerTick, uint64_t& outChecksum) {
+		sim::World world(4, 2, 4);
+		world.setDetachIslands(detachIslands);
+
+		world.fillBox(0, 0, 0, world.getSizeX() - 1, 15, world.getSizeZ() - 1, sim::MATERIAL_STONE);
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int tick = 0; tick < ticks; tick++) {
+			for (int hole = 0; hole < holesPerTick; hole++) {
+				uint64_t bits = sim::mixBits((uint64_t)tick * holesPerTick + hole);
+
+				world.queueEdit(sim::EditCommand::setCell((int)(bits & 0x7F), 1 + (int)((bits >> 8) % 15), (int)((bits >> 16) & 0x7F), sim::MATERIAL_AIR));
+			}
+
+			world.tick();
+		}
+
+		outChecksum = world.computeChecksum();
+
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// A wide slab held up by a single column, which is then cut. Returns the seconds the tick that found the island
+	// took and its size
+	double runSlabCut(size_t& outCells) {
+		sim::World world(4, 2, 4);
+		world.setDetachIslands(true);
+
+		world.fillBox(0, 0, 0, world.getSizeX() - 1, 3, world.getSizeZ() - 1, sim::MATERIAL_STONE);
+		world.fillBox(62, 4, 62, 65, 40, 65, sim::MATERIAL_STONE);
+		world.fillBox(32, 41, 32, 95, 50, 95, sim::MATERIAL_STONE);
+		world.tick();
+
+		world.queueEdit(sim::EditCommand::fillBox(62, 20, 62, 65, 20, 65, sim::MATERIAL_AIR));
+
+		auto start = std::chrono::steady_clock::now();
+		world.tick();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		outCells = world.getBodies().empty() ? 0 : world.getBodies()[0].size();
+
+		return seconds;
+	}
+
+	void buildCollapse(sim::World& world) {
+		world.setDetachIslands(true);
+
+		world.fillBox(0, 0, 0, world.getSizeX() - 1, 3, world.getSizeZ() - 1, sim::MATERIAL_STONE);
+
+		// A tower with an arm reaching far past it, its top tips over the stump once it has dropped onto it
+		world.fillBox(24, 4, 24, 31, 44, 31, sim::MATERIAL_STONE);
+		world.fillBox(32, 40, 24, 64, 44, 31, sim::MATERIAL_STONE);
+		world.fillBox(24, 20, 24, 31, 22, 31, sim::MATERIAL_AIR);
+
+		// A bridge with sand on it that follows it down
+		world.fillBox(80, 4, 88, 83, 30, 91, sim::MATERIAL_STONE);
+		world.fillBox(112, 4, 88, 115, 30, 91, sim::MATERIAL_STONE);
+		world.fillBox(84, 28, 88, 111, 30, 91, sim::MATERIAL_STONE);
+		world.fillBox(90, 31, 88, 105, 34, 91, sim::MATERIAL_SAND);
+		world.fillBox(84, 28, 88, 85, 30, 91, sim::MATERIAL_AIR);
+		world.fillBox(110, 28, 88, 111, 30, 91, sim::MATERIAL_AIR);
+	}
+
+	struct CollapseRun {
+		double seconds;
+		int ticks;
+		uint64_t detached;
+		uint64_t landed;
+		uint64_t cellsBefore;
+		uint64_t cellsAfter;
+		uint64_t checksum;
+
+		// Taken on COLLAPSE_AIRBORNE_TICK, while the bodies are still falling outside of the grid
+		size_t airborneBodies;
+		uint64_t airborneChecksum;
+	};
+
+	const int COLLAPSE_AIRBORNE_TICK = 4;
+
+	// Ticks the collapse on the job system until every body has landed and no brick is awake, or maxTicks have run
+	CollapseRun runCollapse(bool outboxes, int threads, int maxTicks) {
+		engine::jobs::JobSystem jobSystem(threads - 1);
+		sim::TickScheduler scheduler(jobSystem);
+
+		sim::World world(4, 2, 4);
+		world.setMoveOutboxes(outboxes);
+		buildCollapse(world);
+
+		CollapseRun run{ 0.0, 0, 0, 0, 0, 0, 0, 0, 0 };
+		run.cellsBefore = countFilledCells(world);
+
+		auto start = std::chrono::steady_clock::now();
+
+		while (run.ticks < maxTicks) {
+			sim::TickStats stats = scheduler.tick(world);
+
+			run.ticks++;
+			run.detached += stats.bodiesDetached;
+			run.landed += stats.bodiesLanded;
+
+			if (run.ticks == COLLAPSE_AIRBORNE_TICK) {
+				run.airborneBodies = world.getBodies().size();
+				run.airborneChecksum = world.computeChecksum();
+			}
+
+			if (stats.bricksUpdated == 0 && world.getBodies().empty())
+				break;
+		}
+
+		run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		run.cellsAfter = countFilledCells(world);
+		run.checksum = world.computeChecksum();
+
+		return run;
+	}
+
+	uint64_t countGasCells(const sim::World& world) {
+		std::vector<sim::Cell> cells(sim::CHUNK_VOLUME);
+		uint64_t count = 0;
+
+		for (auto& chunk : world.getChunks()) {
+			chunk->copyCells(cells.data());
+
+			for (const sim::Cell& cell : cells) {
+				if (cell.material != sim::MATERIAL_AIR && sim::getMaterialState(cell.material) == sim::MATERIAL_STATE_GAS)
+					count++;
+			}
+		}
+
+		return count;
+	}
+
+	// The collapse with smoke lying where both bodies land. Margolus blocks never spread gas or let it dissolve, so
+	// only landing could change how much there is. Needs the materials of assets/materials.txt
+	CollapseRun runCollapseIntoSmoke(int maxTicks, uint64_t& outGasBefore, uint64_t& outGasAfter) {
+		uint8_t smoke;
+		sim::findMaterial("smoke", smoke);
+
+		sim::World world(4, 2, 4);
+		world.setRuleExecutor(sim::RULE_EXECUTOR_MARGOLUS);
+		buildCollapse(world);
+
+		world.fillBox(33, 4, 16, 80, 9, 40, smoke);
+		world.fillBox(86, 4, 84, 109, 9, 95, smoke);
+
+		CollapseRun run{ 0.0, 0, 0, 0, 0, 0, 0, 0, 0 };
+		run.cellsBefore = countFilledCells(world);
+		outGasBefore = countGasCells(world);
+
+		auto start = std::chrono::steady_clock::now();
+
+		while (run.ticks < maxTicks) {
+			sim::TickStats stats = world.tick();
+
+			run.ticks++;
+			run.detached += stats.bodiesDetached;
+			run.landed += stats.bodiesLanded;
+
+			if (stats.bricksUpdated == 0 && world.getBodies().empty())
+				break;
+		}
+
+		run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		run.cellsAfter = countFilledCells(world);
+		outGasAfter = countGasCells(world);
+		run.checksum = world.computeChecksum();
+
+		return run;
+	}
+
+	bool benchmarkBodies() {
+		const int DIG_TICKS = 64;
+		const int HOLES_PER_TICK = 16;
+		const int MAX_TICKS = 2000;
+
+		printf("Digging %d holes a tick into a 128x16x128 stone slab for %d ticks:\n", HOLES_PER_TICK, DIG_TICKS);
+
+		uint64_t plainChecksum;
+		uint64_t checkedChecksum;
+		double plain = runSlabDigging(false, DIG_TICKS, HOLES_PER_TICK, plainChecksum);
+		double checked = runSlabDigging(true, DIG_TICKS, HOLES_PER_TICK, checkedChecksum);
+
+		// Nothing comes loose, so checking may not change the world
+		bool same = plainChecksum == checkedChecksum;
+
+		printf("  %-9s %8.3f ms/tick\n", "unchecked", plain * 1000.0 / DIG_TICKS);
+		printf("  %-9s %8.3f ms/tick, %.2f us per check, world %s\n", "checked", checked * 1000.0 / DIG_TICKS,
+			(checked - plain) * 1e6 / (DIG_TICKS * HOLES_PER_TICK), same ? "unchanged" : "CHANGED");
+
+		size_t islandCells;
+		double cut = runSlabCut(islandCells);
+
+		printf("Cutting the column under a 64x10x64 slab: %zu cells came loose in %.3f ms, %.1f cells/us\n", islandCells, cut * 1000.0,
+			islandCells / (cut * 1e6));
+
+		printf("A tower top tipping over and a bridge with sand on it falling, until everything has landed and is asleep:\n");
+
+		// The slab and the part of the column above the cut
+		bool matched = same && islandCells == 64 * 10 * 64 + 4 * 4 * 20;
+		uint64_t firstChecksum = 0;
+		uint64_t firstAirborneChecksum = 0;
+		const int THREAD_COUNTS[] = { 1, 4 };
+
+		for (int outboxes = 0; outboxes < 2; outboxes++) {
+			for (int i = 0; i < 2; i++) {
+				CollapseRun run = runCollapse(outboxes != 0, THREAD_COUNTS[i], MAX_TICKS);
+
+				if (i == 0) {
+					firstChecksum = run.checksum;
+					firstAirborneChecksum = run.airborneChecksum;
+				}
+
+				// Bodies are put back one cell at a time, a cell lands above the grid only out of the top of it
+				bool kept = run.cellsBefore == run.cellsAfter;
+
+				// Both bodies are still in the air on the earlier tick, so their poses have to agree as well
+				bool sameChecksum = run.checksum == firstChecksum && run.airborneChecksum == firstAirborneChecksum && run.airborneBodies == 2;
+
+				matched = matched && kept && sameChecksum && run.detached == 2 && run.landed == 2 && run.ticks < MAX_TICKS;
+
+				printf("  %-8s %d threads %3d ticks, %llu detached, %llu landed, %8.3f ms/tick, %llu cells before and %llu after, checksum %016llx %s\n",
+					outboxes ? "outboxes" : "parity", THREAD_COUNTS[i], run.ticks, (unsigned long long)run.detached, (unsigned long long)run.landed,
+					run.seconds * 1000.0 / run.ticks, (unsigned long long)run.cellsBefore, (unsigned long long)run.cellsAfter,
+					(unsigned long long)run.checksum, sameChecksum ? "" : "DIFFERS");
+			}
+		}
+
+		// Smoke is one of the materials of the game
+		if (!sim::MaterialRegistry::loadFromFile("assets/materials.txt"))
+			return false;
+
+		uint64_t gasBefore;
+		uint64_t gasAfter;
+		CollapseRun smoke = runCollapseIntoSmoke(MAX_TICKS, gasBefore, gasAfter);
+
+		sim::MaterialRegistry::reset();
+
+		bool gasKept = smoke.cellsBefore == smoke.cellsAfter && gasBefore == gasAfter;
+		matched = matched && gasKept && smoke.detached == 2 && smoke.landed == 2 && smoke.ticks < MAX_TICKS;
+
+		printf("The same collapse into smoke with Margolus blocks, which leave gas be:\n");
+		printf("  %3d ticks, %llu detached, %llu landed, %llu cells before and %llu after, %llu gas cells before and %llu after, %s\n", smoke.ticks,
+			(unsigned long long)smoke.detached, (unsigned long long)smoke.landed, (unsigned long long)smoke.cellsBefore,
+			(unsigned long long)smoke.cellsAfter, (unsigned long long)gasBefore, (unsigned long long)gasAfter, gasKept ? "kept" : "gas went MISSING");
+
+		return matched;
+	}
+
+	// Reads the 3x3x3 neighbourhood of every cell that has one inside the chunk, in the order the rules visit
+	// cells. Returns the time per cell
+	template<typename Layout>
+	double sweepNeighbourhoods(const std::vector<sim::Cell>& linear, uint64_t& outSum) {
+		const int REPEATS = 20;
+
+		std::vector<sim::Cell> cells(sim::CHUNK_VOLUME);
+
+		for (int y = 0; y < sim::CHUNK_SIZE; y++) {
+			for (int z = 0; z < sim::CHUNK_SIZE; z++) {
+				for (int x = 0; x < sim::CHUNK_SIZE; x++) {
+					cells[Layout::index(x, y, z)] = linear[sim::LinearLayout::index(x, y, z)];
+				}
+			}
+		}
+
+		uint64_t sum = 0;
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int repeat = 0; repeat < REPEATS; repeat++) {
+			for (int y = 1; y < sim::CHUNK_MASK; y++) {
+				for (int z = 1; z < sim::CHUNK_MASK; z++) {
+					for (int x = 1; x < sim::CHUNK_MASK; x++) {
+						for (int dy = -1; dy <= 1; dy++) {
+							for (int dz = -1; dz <= 1; dz++) {
+								for (int dx = -1; dx <= 1; dx++) {
+									sum += cells[Layout::index(x + dx, y + dy, z + dz)].material;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		outSum = sum;
+
+		return seconds * 1e9 / (REPEATS * (double)(sim::CHUNK_SIZE - 2) * (sim::CHUNK_SIZE - 2) * (sim::CHUNK_SIZE - 2));
+	}
+
+	bool benchmarkLayouts() {
+		const int TICKS = 200;
+		const int RUNS = 3;
+
+		std::vector<sim::Cell> linear(sim::CHUNK_VOLUME);
+
+		for (int i = 0; i < sim::CHUNK_VOLUME; i++) {
+			linear[i] = sim::Cell{ (uint8_t)(sim::mixBits(i) % sim::MaterialRegistry::getCount()), 0 };
+		}
+
+		uint64_t sums[3];
+		double linearTime = sweepNeighbourhoods<sim::LinearLayout>(linear, sums[0]);
+		double brickTime = sweepNeighbourhoods<sim::BrickLayout>(linear, sums[1]);
+		double mortonTime = sweepNeighbourhoods<sim::MortonLayout>(linear, sums[2]);
+
+		printf("3x3x3 neighbourhood of every cell in one chunk:\n");
+		printf("  %-8s %6.2f ns/cell\n", sim::LinearLayout::NAME, linearTime);
+		printf("  %-8s %6.2f ns/cell\n", sim::BrickLayout::NAME, brickTime);
+		printf("  %-8s %6.2f ns/cell\n", sim::MortonLayout::NAME, mortonTime);
+
+		bool matched = sums[0] == sums[1] && sums[0] == sums[2];
+
+		// The rest needs a build per layout, see FS3D_CELL_LAYOUT and FS3D_LAYOUT_VARIANTS
+		printf("Simulation built with the %s layout, %d ticks on one thread, best of %d runs:\n", sim::CellLayout::NAME, TICKS, RUNS);
+
+		for (int world = 0; world < TEST_WORLD_COUNT; world++) {
+			WorldRun best{ 1e9, 0 };
+
+			for (int run = 0; run < RUNS; run++) {
+				WorldRun result = runTestWorld(world, false, TICKS);
+
+				best.seconds = std::min(best.seconds, result.seconds);
+				best.checksum = result.checksum;
+			}
+
+			printf("  %-10s %7.3f ms/tick, checksum %016llx\n", TEST_WORLD_NAMES[world], best.seconds * 1000.0 / TICKS, (unsigned long long)best.checksum);
+		}
+
+		printf("Neighbourhood sums %s\n", matched ? "match" : "DIFFER");
+
+		return matched;
+	}
+
+	// Height of the ground at a column, rolling hills between 576 and 704 cells up
+	int getTerrainHeight(int x, int z) {
+		uint32_t hill = sim::randomForCell(7, 0, x >> 5, 0, z >> 5, 1) % 64;
+		uint32_t bump = sim::randomForCell(7, 0, x >> 3, 0, z >> 3, 2) % 8;
+
+		return 600 + (int)hill + (int)bump;
+	}
+
+	// Stone with caves and sand pockets in blobs of 4x4x4 cells up to a sand band under the hills, water filling
+	// the hollows below 640, air above. Solid stone below 256
+	sim::Cell getTerrainCell(int x, int y, int z, int height) {
+		if (y < 256)
+			return sim::Cell{ sim::MATERIAL_STONE, 0 };
+
+		if (y >= height)
+			return sim::Cell{ y < 640 ? sim::MATERIAL_WATER : sim::MATERIAL_AIR, 0 };
+
+		if (y >= height - 8)
+			return sim::Cell{ sim::MATERIAL_SAND, 0 };
+
+		uint32_t blob = sim::randomForCell(7, 0, x >> 2, y >> 2, z >> 2, 3) % 100;
+
+		return sim::Cell{ blob < 8 ? sim::MATERIAL_AIR : blob < 12 ? sim::MATERIAL_SAND : sim::MATERIAL_STONE, 0 };
+	}
+
+	// Builds the terrain chunk by chunk on every participant, packing each one as it goes, and puts them into the
+	// world on this thread. Chunks that are all one cell stay uniform, the ones that are all air aren't created
+	void generateTerrain(sim::World& world, engine::jobs::JobSystem& jobSystem) {
+		struct GeneratedChunk {
+			sim::Cell uniformCell;
+			std::shared_ptr<const sim::PackedCells> packedCells;
+		};
+
+		int chunksX = world.getChunksX();
+		int chunksZ = world.getChunksZ();
+		size_t chunkCount = (size_t)chunksX * world.getChunksY() * chunksZ;
+
+		std::vector<GeneratedChunk> generated(chunkCount);
+		std::vector<std::vector<sim::Cell>> scratch(jobSystem.getParticipantCount());
+
+		jobSystem.parallelFor(chunkCount, 16, [&](size_t begin, size_t end, int participant) {
+			std::vector<sim::Cell>& cells = scratch[participant];
+			cells.resize(sim::CHUNK_VOLUME);
+
+			for (size_t i = begin; i < end; i++) {
+				int chunkX = (int)(i % chunksX);
+				int chunkZ = (int)(i / chunksX % chunksZ);
+				int chunkY = (int)(i / chunksX / chunksZ);
+
+				int originX = chunkX * sim::CHUNK_SIZE;
+				int originY = chunkY * sim::CHUNK_SIZE;
+				int originZ = chunkZ * sim::CHUNK_SIZE;
+
+				for (int z = 0; z < sim::CHUNK_SIZE; z++) {
+					for (int x = 0; x < sim::CHUNK_SIZE; x++) {
+						int height = getTerrainHeight(originX + x, originZ + z);
+
+						for (int y = 0; y < sim::CHUNK_SIZE; y++) {
+							cells[sim::Chunk::index(x, y, z)] = getTerrainCell(originX + x, originY + y, originZ + z, height);
+						}
+					}
+				}
+
+				std::shared_ptr<sim::PackedCells> packed = std::make_shared<sim::PackedCells>();
+				packed->pack(cells.data(), sim::CHUNK_VOLUME);
+
+				if (packed->getPaletteSize() == 1)
+					generated[i].uniformCell = cells[0];
+				else
+					generated[i].packedCells = std::move(packed);
+			}
+		});
+
+		for (size_t i = 0; i < chunkCount; i++) {
+			int chunkX = (int)(i % chunksX);
+			int chunkZ = (int)(i / chunksX % chunksZ);
+			int chunkY = (int)(i / chunksX / chunksZ);
+
+			if (generated[i].packedCells != nullptr)
+				world.setSharedChunk(chunkX, chunkY, chunkZ, std::move(generated[i].packedCells));
+			else if (generated[i].uniformCell.material != sim::MATERIAL_AIR)
+				world.setUniformChunk(chunkX, chunkY, chunkZ, generated[i].uniformCell);
+		}
+	}
+
+	bool benchmarkPersistence() {
+		const int CHUNKS = 32;
+		const int RANDOM_CHUNKS = 1000;
+
+		std::string directory = (std::filesystem::temp_directory_path() / "fs3d_bench_persistence").string();
+
+		unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<int> threadCounts = { 1 };
+
+		if (hardwareThreads > 1)
+			threadCounts.push_back((int)hardwareThreads);
+
+		sim::World world(CHUNKS, CHUNKS, CHUNKS);
+		world.setSeed(7);
+
+		double generateSeconds;
+
+		{
+			engine::jobs::JobSystem jobSystem(-1);
+
+			auto start = std::chrono::steady_clock::now();
+			generateTerrain(world, jobSystem);
+			generateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		uint64_t checksum = world.computeChecksum();
+
+		printf("Terrain of %dx%dx%d chunks, %.2f G cells, generated in %.3f s on %u threads, %zu chunks that aren't air\n", CHUNKS, CHUNKS, CHUNKS,
+			(double)CHUNKS * CHUNKS * CHUNKS * sim::CHUNK_VOLUME / 1e9, generateSeconds, hardwareThreads, world.getChunkCount());
+		headless::printWorldMemory(world.getMemoryStats());
+
+		bool matched = true;
+		std::unique_ptr<sim::World> loaded;
+
+		for (int threads : threadCounts) {
+			engine::jobs::JobSystem jobSystem(threads - 1);
+
+			printf("On %d threads, to %s:\n", threads, directory.c_str());
+
+			sim::WorldIOStats saveStats;
+			sim::WorldIOStats loadStats;
+
+			if (!sim::saveWorld(world, directory, jobSystem, saveStats))
+				return false;
+
+			headless::printWorldIO("  Saved", saveStats);
+
+			// Let go of the last copy first, two of them are as large as the original
+			loaded.reset();
+			loaded = std::make_unique<sim::World>(CHUNKS, CHUNKS, CHUNKS);
+
+			if (!sim::loadWorld(*loaded, directory, jobSystem, loadStats))
+				return false;
+
+			headless::printWorldIO("  Loaded", loadStats);
+
+			bool same = loaded->computeChecksum() == checksum;
+			matched = matched && same;
+
+			printf("  Loaded world %s\n", same ? "matches" : "DIFFERS");
+		}
+
+		// Chunks anywhere in the world, a quarter of them get a pool of water, which makes some too large for the sectors they had
+		std::vector<const sim::Chunk*> chunks;
+
+		for (int i = 0; i < RANDOM_CHUNKS; i++) {
+			uint32_t pick = sim::randomForCell(7, 0, i, 0, 0, 4) % world.getChunkCount();
+			chunks.push_back(world.getChunks()[pick].get());
+		}
+
+		for (int i = 0; i < RANDOM_CHUNKS; i += 4) {
+			int x = chunks[i]->getX() * sim::CHUNK_SIZE;
+			int y = chunks[i]->getY() * sim::CHUNK_SIZE;
+			int z = chunks[i]->getZ() * sim::CHUNK_SIZE;
+
+			world.applyEdit(sim::EditCommand::fillBox(x + 3, y + 5, z + 7, x + 20, y + 19, z + 11, sim::MATERIAL_WATER));
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		bool written = true;
+
+		for (const sim::Chunk* chunk : chunks) {
+			written = sim::saveChunk(world, chunk->getX(), chunk->getY(), chunk->getZ(), directory) && written;
+		}
+
+		double saveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+
+		for (const sim::Chunk* chunk : chunks) {
+			written = sim::loadChunk(*loaded, chunk->getX(), chunk->getY(), chunk->getZ(), directory) && written;
+		}
+
+		double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// Edits and loads tick nothing, only the cells have to agree
+		bool same = written && loaded->computeChecksum() == world.computeChecksum();
+		matched = matched && same;
+
+		printf("%d single chunks, a quarter of them edited first, opening their region every time:\n", RANDOM_CHUNKS);
+		printf("  saved  %8.0f chunks/s, %.2f us each\n", RANDOM_CHUNKS / saveSeconds, saveSeconds * 1e6 / RANDOM_CHUNKS);
+		printf("  loaded %8.0f chunks/s, %.2f us each\n", RANDOM_CHUNKS / loadSeconds, loadSeconds * 1e6 / RANDOM_CHUNKS);
+		printf("  Loaded world %s\n", same ? "matches" : "DIFFERS");
+
+		std::error_code error;
+		std::filesystem::remove_all(directory, error);
+
+		return matched;
+	}
+
+	struct Benchmark {
+		const char* name;
+		const char* description;
+		bool(*run)();
+	};
+
+	const Benchmark BENCHMARKS[] = {
+		{ "fall", "Bulk granular fall kernels against the per cell rules", benchmarkFall },
+		{ "edits", "Edits queued from several threads and applied between ticks", benchmarkEdits },
+		{ "palette", "Palette compression of chunks and the memory it saves", benchmarkPalette },
+		{ "worldgen", "World generation with uniform and copy on write chunks", benchmarkWorldGeneration },
+		{ "pool", "Pooled chunk and cell blocks against the heap, and whether a churning world stops allocating", benchmarkBlockPool },
+		{ "halo", "Chunk updates through a one cell halo against bounds checked neighbour lookups", benchmarkHalos },
+		{ "layout", "Neighbourhood reads in each cell layout, and the simulation in the one it was built with", benchmarkLayouts },
+		{ "outbox", "Every chunk ticked at once with move outboxes against parity class waves", benchmarkOutboxes },
+		{ "margolus", "Margolus block executor against the scan order rules", benchmarkMargolus },
+		{ "dambreak", "Liquid levels against whole liquid cells in a dam break, ticks to come to rest", benchmarkDamBreak },
+		{ "heat", "Heat diffusion kernels, and a lava pool melting, boiling and freezing its surroundings", benchmarkHeat },
+		{ "smoke", "A smoke plume rising, thinning out and dissolving until its bricks are asleep", benchmarkSmoke },
+		{ "particles", "Particle integration kernels, fast falls against a cell a tick, and an explosion landing again", benchmarkParticles },
+		{ "bodies", "Connectivity checks while digging, and solid islands cut loose falling and landing as rigid bodies", benchmarkBodies },
+		{ "persistence", "Saving and loading a billion cell terrain as region files, and single chunks read and written at random", benchmarkPersistence }
+	};
+}
+
+namespace headless {
+	int runBenchmark(const char* name) {
+		for (const Benchmark& benchmark : BENCHMARKS) {
+			if (strcmp(benchmark.name, name) == 0) {
+				if (benchmark.run())
+					return 0;
+
+				printf("Benchmark %s FAILED\n", name);
+				return 2;
+			}
+		}
+
+		printf("Unknown benchmark '%s', the benchmarks are:\n", name);
+		printBenchmarks();
+
+		return 1;
+	}
+
+	void printBenchmarks() {
+		for (const Benchmark& benchmark : BENCHMARKS) {
+			printf("  %-12s %s\n", benchmark.name, benchmark.description);
+		}
+	}
+}
\ No newline at end of file
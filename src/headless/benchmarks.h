@@ -0,0 +1,9 @@
+#pragma once
+
+namespace headless {
+	// Runs a named microbenchmark and prints its results. Returns the exit code for the process, 1 for an
+	// unknown name and 2 if the benchmark's own consistency check failed
+	int runBenchmark(const char* name);
+
+	void printBenchmarks();
+}
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include "benchmarks.h"
+#include "report.h"
+#include "sim/simulation.h"
+#include "sim/scenario.h"
+#include "sim/world_io.h"
+#include "engine/jobs/job_system.h"
+#include "util/debug.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+	void printUsage(const char* program) {
+		printf("Usage: %s <scenario file> [--ticks N] [--threads N] [--seed N] [--report N] [--verify N] [--kernel K] [--no-compress] [--halos] [--outboxes] [--executor E] [--liquids L] [--fast-falls] [--rigid-bodies] [--materials F] [--load DIR] [--save DIR]\n", program);
+		printf("  --ticks N    Override the number of ticks from the scenario\n");
+		printf("  --threads N  Override the number of threads, 0 uses every hardware thread\n");
+		printf("  --seed N     Override the random seed from the scenario\n");
+		printf("  --report N   Print throughput every N ticks\n");
+		printf("  --verify N   Run the scenario again on N threads and check that both runs end in the same state\n");
+		printf("  --kernel K   Fall kernel to use: auto, cell, scalar or avx2\n");
+		printf("  --no-compress  Keep every chunk dense instead of palette compressing the ones that sleep\n");
+		printf("  --halos      Update chunks through a copy with a one cell halo instead of checking the chunk bounds\n");
+		printf("  --outboxes   Tick every chunk at once and move cells between chunks afterwards, instead of in parity classes\n");
+		printf("  --executor E Rule executor to use: scan or margolus\n");
+		printf("  --liquids L  How liquids move: cells or levels\n");
+		printf("  --fast-falls Let granular cells fall faster and faster, several cells per tick along a line\n");
+		printf("  --rigid-bodies  Let islands of solid cells that edits cut loose fall, tip over and land as one body\n");
+		printf("  --materials F  Load material definitions from a file, on top of the built in ones\n");
+		printf("  --load DIR   Start from a saved world instead of the edits of the scenario, which still gives the ticks\n");
+		printf("  --save DIR   Save the world once every tick has run\n");
+		printf("Or: %s --bench <name>\n", program);
+		headless::printBenchmarks();
+	}
+
+	void printWorkerStats(const sim::TickScheduler& scheduler) {
+		const std::vector<sim::WorkerStats>& workers = scheduler.getWorkerStats();
+
+		size_t workerCount = (size_t)scheduler.getThreadCount() - 1;
+
+		for (size_t i = 0; i < workers.size(); i++) {
+			const sim::WorkerStats& worker = workers[i];
+
+			// Slots after the pool workers belong to outside threads, only this one ticks
+			if (i >= workerCount && worker.busySeconds == 0.0 && worker.chunksUpdated == 0)
+				continue;
+
+			printf("  %s %2zu: busy %8.3f s (%5.1f%%), %10llu chunks, %12llu cells\n", i >= workerCount ? "main  " : "worker", i,
+				worker.busySeconds, scheduler.getTickSeconds() > 0.0 ? worker.busySeconds / scheduler.getTickSeconds() * 100.0 : 0.0,
+				(unsigned long long)worker.chunksUpdated, (unsigned long long)worker.cellsUpdated);
+		}
+
+		printf("  parallel efficiency %.1f%%\n", scheduler.getParallelEfficiency() * 100.0);
+	}
+
+	std::string describeAxis(int chunks) {
+		return chunks == sim::WORLD_UNBOUNDED ? std::string("unbounded") : std::to_string(chunks);
+	}
+
+	// Returns the checksum of the world once every tick has run
+	uint64_t runScenario(const sim::Scenario& scenario, int threads, sim::FallKernel fallKernel, bool compressIdleChunks, bool chunkHalos, bool moveOutboxes, sim::RuleExecutor ruleExecutor, sim::LiquidModel liquidModel, bool fastFalls, bool detachIslands, const char* loadDirectory, const char* saveDirectory, uint64_t reportInterval, bool printStats) {
+		// This thread ticks alongside the pool, so it counts as one of the threads
+		engine::jobs::JobSystem jobSystem(threads > 0 ? threads - 1 : -1);
+
+		sim::Simulation simulation(jobSystem, scenario.chunksX, scenario.chunksY, scenario.chunksZ);
+		sim::World& world = simulation.getWorld();
+
+		// Before the scenario, so the cuts it makes are checked as well
+		world.setDetachIslands(detachIslands);
+
+		if (loadDirectory != nullptr) {
+			sim::WorldIOStats loadStats;
+
+			if (!sim::loadWorld(world, loadDirectory, jobSystem, loadStats))
+				util::displayError(std::string("Could not load ") + loadDirectory);
+
+			if (printStats)
+				headless::printWorldIO("Loaded", loadStats);
+		}
+		else {
+			scenario.apply(world);
+		}
+
+		world.setFallKernel(fallKernel);
+		world.setCompressIdleChunks(compressIdleChunks);
+		world.setChunkHalos(chunkHalos);
+		world.setMoveOutboxes(moveOutboxes);
+		world.setRuleExecutor(ruleExecutor);
+		world.setLiquidModel(liquidModel);
+		world.setFastFalls(fastFalls);
+
+		if (printStats) {
+			printf("World %s x %s x %s chunks, %zu allocated (%.1f M cells), seed %llu\n", describeAxis(world.getChunksX()).c_str(),
+				describeAxis(world.getChunksY()).c_str(), describeAxis(world.getChunksZ()).c_str(), world.getChunkCount(), world.getCellCount() / 1e6,
+				(unsigned long long)world.getSeed());
+			if (ruleExecutor == sim::RULE_EXECUTOR_SCAN) {
+				printf("Running %llu ticks on %d threads with the %s fall kernel, liquid %s%s%s%s%s\n", (unsigned long long)scenario.ticks, jobSystem.getWorkerCount() + 1,
+					sim::getFallKernelName(fallKernel), sim::getLiquidModelName(liquidModel), chunkHalos ? " and chunk halos" : "", moveOutboxes ? " and move outboxes" : "", fastFalls ? " and fast falls" : "",
+					detachIslands ? " and rigid bodies" : "");
+			}
+			else {
+				printf("Running %llu ticks on %d threads with the %s executor\n", (unsigned long long)scenario.ticks, jobSystem.getWorkerCount() + 1,
+					sim::getRuleExecutorName(ruleExecutor));
+			}
+		}
+
+		// Chunks come and go, so activity is measured against the bricks that existed on each tick
+		uint64_t allocatedBricks = 0;
+		size_t peakChunks = world.getChunkCount();
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (uint64_t tick = 1; tick <= scenario.ticks; tick++) {
+			simulation.step();
+
+			allocatedBricks += world.getChunkCount() * sim::BRICK_COUNT;
+			peakChunks = std::max(peakChunks, world.getChunkCount());
+
+			if (reportInterval > 0 && tick % reportInterval == 0) {
+				const sim::SimulationStats& stats = simulation.getStats();
+
+				printf("tick %8llu: %8.1f tick/s, %9.1f Mcells/s, %5.1f%% bricks active, %6zu chunks\n", (unsigned long long)tick, stats.getTicksPerSecond(),
+					stats.getCellsPerSecond() / 1e6, allocatedBricks > 0 ? stats.bricksUpdated * 100.0 / allocatedBricks : 0.0, world.getChunkCount());
+			}
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (printStats) {
+			const sim::TickScheduler& scheduler = simulation.getScheduler();
+
+			uint64_t bricksUpdated = 0;
+			uint64_t cellsUpdated = 0;
+			uint64_t cellsMoved = 0;
+
+			for (const sim::WorkerStats& worker : scheduler.getWorkerStats()) {
+				bricksUpdated += worker.bricksUpdated;
+				cellsUpdated += worker.cellsUpdated;
+				cellsMoved += worker.cellsMoved;
+			}
+
+			printf("Ran %llu ticks in %.3f s\n", (unsigned long long)scenario.ticks, seconds);
+			printf("  %.1f tick/s, %.3f ms/tick\n", seconds > 0.0 ? scenario.ticks / seconds : 0.0, scenario.ticks > 0 ? seconds * 1000.0 / scenario.ticks : 0.0);
+			printf("  %.1f Mcells/s updated, %.1f Mcells/s moved\n", seconds > 0.0 ? cellsUpdated / seconds / 1e6 : 0.0, seconds > 0.0 ? cellsMoved / seconds / 1e6 : 0.0);
+			printf("  %.2f%% of allocated bricks active on average\n", allocatedBricks > 0 ? bricksUpdated * 100.0 / allocatedBricks : 0.0);
+			printf("  %zu chunks allocated at the end, %zu at the peak\n", world.getChunkCount(), peakChunks);
+
+			printWorkerStats(scheduler);
+
+			printf("Memory at the end:\n");
+			headless::printWorldMemory(world.getMemoryStats());
+
+			printf("Block pools at the end:\n");
+			headless::printBlockPools();
+		}
+
+		// Before the particles and bodies are put back for the save, so a run that saves ends like one that doesn't
+		uint64_t checksum = world.computeChecksum();
+
+		if (saveDirectory != nullptr) {
+			sim::WorldIOStats saveStats;
+
+			world.settleTransients();
+
+			if (!sim::saveWorld(world, saveDirectory, jobSystem, saveStats))
+				util::displayError(std::string("Could not save ") + saveDirectory);
+
+			if (printStats)
+				headless::printWorldIO("Saved", saveStats);
+		}
+
+		return checksum;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	if (strcmp(argv[1], "--bench") == 0) {
+		if (argc != 3) {
+			printUsage(argv[0]);
+			return 1;
+		}
+
+		return headless::runBenchmark(argv[2]);
+	}
+
+	// Scenarios name their materials, so those have to be known before the scenario is read
+	for (int i = 2; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--materials") == 0 && !sim::MaterialRegistry::loadFromFile(argv[i + 1]))
+			return 1;
+	}
+
+	sim::Scenario scenario;
+
+	if (!scenario.loadFromFile(argv[1]))
+		return 1;
+
+	uint64_t reportInterval = 0;
+	int verifyThreads = -1;
+	sim::FallKernel fallKernel = sim::FALL_KERNEL_AUTO;
+	bool compressIdleChunks = true;
+	bool chunkHalos = false;
+	bool moveOutboxes = false;
+	sim::RuleExecutor ruleExecutor = sim::RULE_EXECUTOR_SCAN;
+	sim::LiquidModel liquidModel = sim::LIQUID_MODEL_CELLS;
+	bool fastFalls = false;
+	bool detachIslands = false;
+	const char* loadDirectory = nullptr;
+	const char* saveDirectory = nullptr;
+
+	for (int i = 2; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+
+		if (strcmp(argv[i], "--ticks") == 0 && hasValue) {
+			scenario.ticks = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+			scenario.threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+			scenario.seed = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--verify") == 0 && hasValue) {
+			verifyThreads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--report") == 0 && hasValue) {
+			reportInterval = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--kernel") == 0 && hasValue) {
+			const char* name = argv[++i];
+
+			if (strcmp(name, "auto") == 0) {
+				fallKernel = sim::FALL_KERNEL_AUTO;
+			}
+			else if (strcmp(name, "cell") == 0) {
+				fallKernel = sim::FALL_KERNEL_PER_CELL;
+			}
+			else if (strcmp(name, "scalar") == 0) {
+				fallKernel = sim::FALL_KERNEL_SCALAR;
+			}
+			else if (strcmp(name, "avx2") == 0) {
+				fallKernel = sim::FALL_KERNEL_AVX2;
+			}
+			else {
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--materials") == 0 && hasValue) {
+			// Already loaded
+			i++;
+		}
+		else if (strcmp(argv[i], "--no-compress") == 0) {
+			compressIdleChunks = false;
+		}
+		else if (strcmp(argv[i], "--halos") == 0) {
+			chunkHalos = true;
+		}
+		else if (strcmp(argv[i], "--outboxes") == 0) {
+			moveOutboxes = true;
+		}
+		else if (strcmp(argv[i], "--fast-falls") == 0) {
+			fastFalls = true;
+		}
+		else if (strcmp(argv[i], "--rigid-bodies") == 0) {
+			detachIslands = true;
+		}
+		else if (strcmp(argv[i], "--load") == 0 && hasValue) {
+			loadDirectory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--save") == 0 && hasValue) {
+			saveDirectory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--executor") == 0 && hasValue) {
+			const char* name = argv[++i];
+
+			if (strcmp(name, "scan") == 0) {
+				ruleExecutor = sim::RULE_EXECUTOR_SCAN;
+			}
+			else if (strcmp(name, "margolus") == 0) {
+				ruleExecutor = sim::RULE_EXECUTOR_MARGOLUS;
+			}
+			else {
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--liquids") == 0 && hasValue) {
+			const char* name = argv[++i];
+
+			if (strcmp(name, "cells") == 0) {
+				liquidModel = sim::LIQUID_MODEL_CELLS;
+			}
+			else if (strcmp(name, "levels") == 0) {
+				liquidModel = sim::LIQUID_MODEL_LEVELS;
+			}
+			else {
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
+		else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	// The save knows how large its world is
+	if (loadDirectory != nullptr) {
+		sim::WorldInfo info;
+
+		if (!sim::readWorldInfo(loadDirectory, info))
+			return 1;
+
+		scenario.chunksX = info.chunksX;
+		scenario.chunksY = info.chunksY;
+		scenario.chunksZ = info.chunksZ;
+	}
+
+	printf("Scenario %s\n", argv[1]);
+
+	try {
+		uint64_t checksum = runScenario(scenario, scenario.threads, fallKernel, compressIdleChunks, chunkHalos, moveOutboxes, ruleExecutor, liquidModel, fastFalls, detachIslands, loadDirectory, saveDirectory, reportInterval, true);
+
+		printf("Checksum %016llx\n", (unsigned long long)checksum);
+
+		if (verifyThreads >= 0) {
+			uint64_t verifyChecksum = runScenario(scenario, verifyThreads, fallKernel, compressIdleChunks, chunkHalos, moveOutboxes, ruleExecutor, liquidModel, fastFalls, detachIslands, loadDirectory, nullptr, 0, false);
+
+			if (verifyChecksum != checksum) {
+				printf("Verify FAILED: %016llx on %d threads\n", (unsigned long long)verifyChecksum, verifyThreads);
+				return 2;
+			}
+
+			printf("Verify passed on %d threads\n", verifyThreads);
+		}
+	}
+	catch (const std::exception&) {
+		// The message was already printed by util::displayError
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "report.h"
+#include "util/block_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+	double toMiB(size_t bytes) {
+		return bytes / (1024.0 * 1024.0);
+	}
+}
+
+namespace headless {
+	void printWorldMemory(const sim::WorldMemoryStats& memory) {
+		printf("  %-18s %9.2f MiB, %zu chunks\n", "dense cells", toMiB(memory.denseCellBytes), memory.denseChunks);
+		printf("  %-18s %9.2f MiB, %zu chunks\n", "compressed cells", toMiB(memory.compressedCellBytes), memory.compressedChunks);
+		printf("  %-18s %9.2f MiB, %zu chunks\n", "uniform cells", 0.0, memory.uniformChunks);
+		printf("  %-18s %9.2f MiB\n", "chunk objects", toMiB(memory.chunkBytes));
+		printf("  %-18s %9.2f MiB\n", "chunk map", toMiB(memory.chunkMapBytes));
+		printf("  %-18s %9.2f MiB\n", "tick buffers", toMiB(memory.tickBytes));
+		printf("  %-18s %9.2f MiB\n", "edit queue", toMiB(memory.editQueueBytes));
+		printf("  %-18s %9.2f MiB, %zu chunks\n", "heat fields", toMiB(memory.heatBytes), memory.heatFields);
+		printf("  %-18s %9.2f MiB, %zu particles\n", "particles", toMiB(memory.particleBytes), memory.particles);
+		printf("  %-18s %9.2f MiB, %zu falling\n", "rigid bodies", toMiB(memory.bodyBytes), memory.bodies);
+		printf("  %-18s %9.2f MiB\n", "snapshots", toMiB(memory.snapshotBytes));
+		printf("  %-18s %9.2f MiB\n", "total", toMiB(memory.getTotalBytes()));
+	}
+
+	void printBlockPools() {
+		for (const util::BlockPoolStats& pool : util::getBlockPoolStats()) {
+			printf("  %6zu B blocks: %7zu live, %7zu free, %7zu peak, %4zu slabs, %8.2f MiB reserved\n", pool.blockSize, pool.liveBlocks,
+				pool.freeBlocks, pool.peakBlocks, pool.slabs, toMiB(pool.reservedBytes));
+		}
+	}
+
+	void printWorldIO(const char* label, const sim::WorldIOStats& stats) {
+		double seconds = std::max(stats.seconds, 1e-9);
+
+		printf("%s %zu chunks in %zu regions in %.3f s\n", label, stats.chunks, stats.regions, stats.seconds);
+		printf("  %.2f MiB of cells in %.2f MiB of files (%.1fx), %.2f MiB of payloads\n", toMiB(stats.getCellBytes()), toMiB(stats.fileBytes),
+			stats.fileBytes > 0 ? (double)stats.getCellBytes() / stats.fileBytes : 0.0, toMiB(stats.payloadBytes));
+		printf("  %.0f chunks/s, %.1f MiB/s of files, %.1f MiB/s of cells\n", stats.chunks / seconds, toMiB(stats.fileBytes) / seconds,
+			toMiB(stats.getCellBytes()) / seconds);
+	}
+}
\ No newline at end of file
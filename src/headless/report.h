@@ -0,0 +1,15 @@
+#pragma once
+
+#include "sim/world.h"
+#include "sim/world_io.h"
+
+namespace headless {
+	// One line per part of the world, then the total
+	void printWorldMemory(const sim::WorldMemoryStats& memory);
+
+	// One line per block size the pools have reserved memory for
+	void printBlockPools();
+
+	// Chunks, regions and bytes a save or load went through, and how fast, labelled with what it did
+	void printWorldIO(const char* label, const sim::WorldIOStats& stats);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "material.h"
+
+#include <cstdint>
+
+namespace sim {
+	// Set on a cell when it is visited by a tick, holds the parity of that tick
+	// so a cell that moves ahead of the scan is not updated twice
+#define CELL_FLAG_STAMP 0x01
+
+	// Set on a cell waiting in a chunk outbox to move into a neighbouring chunk. It holds its place, and nothing
+	// can displace it, until the outboxes are applied at the end of the tick
+#define CELL_FLAG_OUTBOX 0x02
+
+	// Fill level of a liquid cell when liquids have levels, see liquid_kernel.h. Every other cell keeps it clear
+#define CELL_LEVEL_SHIFT 2
+#define CELL_LEVEL_MASK 0xFC
+
+	// Velocity of a granular cell with fast falls, see World::setFastFalls. The cells it falls per tick, and
+	// whether and to which side it drifts while falling. Granular cells have no level, so they use its bits
+#define CELL_FALL_SPEED_SHIFT 2
+#define CELL_FALL_SPEED_MASK 0x1C
+#define CELL_FLAG_DRIFT 0x20
+#define CELL_DRIFT_SHIFT 6
+#define CELL_DRIFT_MASK 0xC0
+
+	struct Cell {
+		uint8_t material;
+		uint8_t flags;
+	};
+
+	static_assert(sizeof(Cell) == 2, "Cells must stay 16 bits");
+}
\ No newline at end of file
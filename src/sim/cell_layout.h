@@ -0,0 +1,94 @@
+#pragma once
+
+// Order of the cells of a chunk in memory. Picked when the simulation is built, FS3D_CELL_LAYOUT in CMake
+#define CELL_LAYOUT_LINEAR 0
+#define CELL_LAYOUT_BRICK 1
+#define CELL_LAYOUT_MORTON 2
+
+#ifndef CELL_LAYOUT
+#define CELL_LAYOUT CELL_LAYOUT_LINEAR
+#endif
+
+namespace sim {
+	constexpr int CHUNK_SHIFT = 5;
+	constexpr int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+	constexpr int CHUNK_MASK = CHUNK_SIZE - 1;
+	constexpr int CHUNK_AREA = CHUNK_SIZE * CHUNK_SIZE;
+	constexpr int CHUNK_VOLUME = CHUNK_AREA * CHUNK_SIZE;
+
+	// Every layout places each axis on its own, so the index of a cell is the sum of one entry per axis and
+	// the offset to a neighbour is the difference of two entries along each axis it moves on
+	struct AxisTables {
+		int x[CHUNK_SIZE];
+		int y[CHUNK_SIZE];
+		int z[CHUNK_SIZE];
+	};
+
+	// x fastest, then z, then y, so each row along x and each horizontal slab is contiguous
+	struct LinearLayout {
+		static constexpr const char* NAME = "linear";
+
+		// Only this layout keeps whole rows along x next to each other, the bulk kernels and plain copies rely on it
+		static constexpr bool CONTIGUOUS_ROWS = true;
+
+		static constexpr int index(int x, int y, int z) { return x | (z << CHUNK_SHIFT) | (y << (CHUNK_SHIFT * 2)); }
+	};
+
+	constexpr AxisTables buildBrickTables() {
+		AxisTables tables{};
+
+		// Cells within a 4x4x4 tile in x, z, y order, then the tiles themselves in the same order
+		for (int i = 0; i < CHUNK_SIZE; i++) {
+			tables.x[i] = (i & 3) | ((i >> 2) << 6);
+			tables.z[i] = ((i & 3) << 2) | ((i >> 2) << (6 + CHUNK_SHIFT - 2));
+			tables.y[i] = ((i & 3) << 4) | ((i >> 2) << (6 + (CHUNK_SHIFT - 2) * 2));
+		}
+
+		return tables;
+	}
+
+	// 4x4x4 tiles of 64 cells, two cache lines each, so a cell and most of its neighbours share a tile
+	struct BrickLayout {
+		static constexpr const char* NAME = "brick";
+		static constexpr bool CONTIGUOUS_ROWS = false;
+
+		static constexpr AxisTables TABLES = buildBrickTables();
+
+		static constexpr int index(int x, int y, int z) { return TABLES.x[x] + TABLES.y[y] + TABLES.z[z]; }
+	};
+
+	constexpr AxisTables buildMortonTables() {
+		AxisTables tables{};
+
+		// Bit b of x goes to bit 3b, z to 3b + 1 and y to 3b + 2
+		for (int i = 0; i < CHUNK_SIZE; i++) {
+			for (int bit = 0; bit < CHUNK_SHIFT; bit++) {
+				int set = (i >> bit) & 1;
+
+				tables.x[i] |= set << (bit * 3);
+				tables.z[i] |= set << (bit * 3 + 1);
+				tables.y[i] |= set << (bit * 3 + 2);
+			}
+		}
+
+		return tables;
+	}
+
+	// Z-order curve, every aligned cube of 2^n cells on a side is contiguous at every scale
+	struct MortonLayout {
+		static constexpr const char* NAME = "morton";
+		static constexpr bool CONTIGUOUS_ROWS = false;
+
+		static constexpr AxisTables TABLES = buildMortonTables();
+
+		static constexpr int index(int x, int y, int z) { return TABLES.x[x] + TABLES.y[y] + TABLES.z[z]; }
+	};
+
+#if CELL_LAYOUT == CELL_LAYOUT_BRICK
+	using CellLayout = BrickLayout;
+#elif CELL_LAYOUT == CELL_LAYOUT_MORTON
+	using CellLayout = MortonLayout;
+#else
+	using CellLayout = LinearLayout;
+#endif
+}
\ No newline at end of file
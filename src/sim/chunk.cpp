@@ -0,0 +1,258 @@
+#include "chunk.h"
+#include "chunk_map.h"
+#include "heat.h"
+#include "random.h"
+#include "../util/bits.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+	uint64_t hashCells(uint64_t checksum, const sim::Cell* cells) {
+		// Four cells at a time
+		const uint8_t* bytes = (const uint8_t*)cells;
+
+		for (size_t i = 0; i < sim::CHUNK_VOLUME * sizeof(sim::Cell); i += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, bytes + i, sizeof(word));
+
+			checksum = sim::mixBits(checksum ^ word) + i;
+		}
+
+		return checksum;
+	}
+}
+
+namespace sim {
+	Cell* allocateChunkCells() {
+		return static_cast<Cell*>(util::allocateBlock(sizeof(Cell) * CHUNK_VOLUME));
+	}
+
+	void freeChunkCells(Cell* cells) {
+		util::freeBlock(cells, sizeof(Cell) * CHUNK_VOLUME);
+	}
+
+	Chunk::Chunk(int chunkX, int chunkY, int chunkZ, uint64_t id) : mChunkX{ chunkX }, mChunkY{ chunkY }, mChunkZ{ chunkZ }, mId{ id } {
+		mNeighbours[neighbourIndex(0, 0, 0)] = this;
+	}
+
+	Chunk::~Chunk() {
+		freeDenseCells();
+		releaseBorder();
+		freeHeat();
+	}
+
+	HeatField* Chunk::createHeat() {
+		if (mHeat != nullptr)
+			return mHeat;
+
+		mHeat = static_cast<HeatField*>(util::allocateBlock(sizeof(HeatField)));
+		mHeat->current = 0;
+
+		std::fill(mHeat->temperatures[0], mHeat->temperatures[0] + HEAT_VOLUME, HEAT_AMBIENT);
+		std::fill(mHeat->sources, mHeat->sources + HEAT_VOLUME, MATERIAL_NO_TEMPERATURE);
+		std::fill(mHeat->heatingPoints, mHeat->heatingPoints + HEAT_VOLUME, MATERIAL_NEVER_MELTS);
+		std::fill(mHeat->coolingPoints, mHeat->coolingPoints + HEAT_VOLUME, MATERIAL_NEVER_FREEZES);
+
+		mHeat->sourceBlocks = 0;
+		mHeat->scanned = false;
+		mHeat->warmFaces = 0;
+		mHeat->settledTicks = 0;
+
+		return mHeat;
+	}
+
+	void Chunk::freeHeat() {
+		if (mHeat == nullptr)
+			return;
+
+		util::freeBlock(mHeat, sizeof(HeatField));
+		mHeat = nullptr;
+	}
+
+	void Chunk::fill(uint8_t material) {
+		setUniform(Cell{ material, 0 });
+
+		wakeBricks(~0ull);
+		markChanged();
+	}
+
+	uint64_t Chunk::computeChecksum() const {
+		// Chunk keys give every position its own bits, so chunks that swap places change the checksum
+		uint64_t checksum = mixBits(packChunkKey(mChunkX, mChunkY, mChunkZ));
+
+		const bool linearLayout = std::is_same<CellLayout, LinearLayout>::value;
+
+		if (isDense() && linearLayout)
+			return hashCells(checksum, mCells);
+
+		// Same hash as dense cells in the linear layout would give, so builds with different layouts can be compared
+		Cell* cells = allocateChunkCells();
+		copyCells(cells);
+
+		if (!linearLayout) {
+			Cell* linear = allocateChunkCells();
+
+			for (int y = 0; y < CHUNK_SIZE; y++) {
+				for (int z = 0; z < CHUNK_SIZE; z++) {
+					for (int x = 0; x < CHUNK_SIZE; x++) {
+						linear[LinearLayout::index(x, y, z)] = cells[index(x, y, z)];
+					}
+				}
+			}
+
+			freeChunkCells(cells);
+			cells = linear;
+		}
+
+		checksum = hashCells(checksum, cells);
+		freeChunkCells(cells);
+
+		return checksum;
+	}
+
+	void Chunk::copyCells(Cell* outCells) const {
+		switch (getStorage()) {
+		case CHUNK_STORAGE_DENSE:
+			memcpy(outCells, mCells, sizeof(Cell) * CHUNK_VOLUME);
+			break;
+		case CHUNK_STORAGE_UNIFORM:
+			std::fill(outCells, outCells + CHUNK_VOLUME, mUniformCell);
+			break;
+		case CHUNK_STORAGE_PACKED:
+			mPackedCells->unpack(outCells);
+			break;
+		}
+	}
+
+	bool Chunk::compress() {
+		if (!isDense())
+			return true;
+
+		Cell first = mCells[0];
+		bool uniform = true;
+
+		for (int i = 1; i < CHUNK_VOLUME; i++) {
+			if (mCells[i].material != first.material || mCells[i].flags != first.flags) {
+				uniform = false;
+				break;
+			}
+		}
+
+		if (uniform) {
+			mUniformCell = first;
+		}
+		else {
+			// The packed cells and their reference count share one pooled block
+			std::shared_ptr<PackedCells> packed = std::allocate_shared<PackedCells>(util::PoolAllocator<PackedCells>());
+
+			if (!packed->pack(mCells, CHUNK_VOLUME))
+				return false;
+
+			mPackedCells = std::move(packed);
+		}
+
+		freeDenseCells();
+
+		return true;
+	}
+
+	void Chunk::decompress() {
+		if (isDense())
+			return;
+
+		// Filled in before it is swapped in, the storage is told apart by whether there is a dense array
+		Cell* cells = allocateChunkCells();
+		copyCells(cells);
+
+		mCells = cells;
+
+		// Other chunks may still be sharing them
+		mPackedCells.reset();
+	}
+
+	void Chunk::setUniform(Cell cell) {
+		freeDenseCells();
+		mPackedCells.reset();
+		mUniformCell = cell;
+
+		mFilledCells.store(cell.material != MATERIAL_AIR ? CHUNK_VOLUME : 0, std::memory_order_relaxed);
+		markChanged();
+	}
+
+	void Chunk::setSharedCells(std::shared_ptr<const PackedCells> cells) {
+		freeDenseCells();
+		mFilledCells.store(cells->getFilledCells(), std::memory_order_relaxed);
+		mPackedCells = std::move(cells);
+
+		markChanged();
+	}
+
+	std::shared_ptr<const PackedCells> Chunk::getSharedCells() {
+		compress();
+
+		return mPackedCells;
+	}
+
+	size_t Chunk::getCellMemoryBytes() const {
+		if (mPackedCells == nullptr)
+			return isDense() ? util::getBlockPool(sizeof(Cell) * CHUNK_VOLUME).getBlockSize() : 0;
+
+		return mPackedCells->getMemoryBytes() / mPackedCells.use_count();
+	}
+
+	void Chunk::captureBorder() {
+		if (mBorderCells == nullptr)
+			mBorderCells = static_cast<Cell*>(util::allocateBlock(sizeof(Cell) * CHUNK_AREA * 6));
+
+		for (int a = 0; a < CHUNK_SIZE; a++) {
+			for (int b = 0; b < CHUNK_SIZE; b++) {
+				for (int side = 0; side < 2; side++) {
+					int edge = side == 0 ? 0 : CHUNK_MASK;
+
+					mBorderCells[getBorderIndex(edge, a, b)] = at(edge, a, b);
+					mBorderCells[getBorderIndex(a, edge, b)] = at(a, edge, b);
+					mBorderCells[getBorderIndex(a, b, edge)] = at(a, b, edge);
+				}
+			}
+		}
+	}
+
+	void Chunk::releaseBorder() {
+		if (mBorderCells == nullptr)
+			return;
+
+		util::freeBlock(mBorderCells, sizeof(Cell) * CHUNK_AREA * 6);
+		mBorderCells = nullptr;
+	}
+
+	void Chunk::freeDenseCells() {
+		if (mCells == nullptr)
+			return;
+
+		freeChunkCells(mCells);
+		mCells = nullptr;
+	}
+
+	uint64_t Chunk::beginTick() {
+		uint64_t woken = mWokenBricks.exchange(0, std::memory_order_relaxed);
+
+		for (uint64_t bits = woken; bits != 0; bits &= bits - 1) {
+			mQuietTicks[util::countTrailingZeros(bits)] = 0;
+		}
+
+		mActiveBricks |= woken;
+
+		return mActiveBricks;
+	}
+
+	void Chunk::endBrick(int brick, bool moved) {
+		if (moved) {
+			mQuietTicks[brick] = 0;
+		}
+		else if (++mQuietTicks[brick] >= BRICK_SLEEP_TICKS) {
+			mActiveBricks &= ~(1ull << brick);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "cell.h"
+#include "cell_layout.h"
+#include "packed_cells.h"
+#include "../util/block_pool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sim {
+	// Chunks are split into 4x4x4 bricks of 8x8x8 cells, so the activity of a whole chunk fits in 64 bits
+	constexpr int BRICK_SHIFT = 3;
+	constexpr int BRICK_SIZE = 1 << BRICK_SHIFT;
+	constexpr int BRICK_VOLUME = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+	constexpr int BRICKS_PER_AXIS = CHUNK_SIZE / BRICK_SIZE;
+	constexpr int BRICK_COUNT = BRICKS_PER_AXIS * BRICKS_PER_AXIS * BRICKS_PER_AXIS;
+
+	static_assert(BRICK_COUNT == 64, "Brick masks are 64 bits");
+
+	// Ticks a brick has to go without a single move before it falls asleep
+	constexpr int BRICK_SLEEP_TICKS = 4;
+
+	// Ticks a chunk has to stay asleep before its cells are palette compressed, so chunks that only rest for a
+	// moment aren't packed and unpacked over and over
+	constexpr uint32_t CHUNK_COMPRESS_TICKS = 32;
+
+	// Offsets -1 to 1 along every axis, the chunk itself sits in the middle
+	constexpr int CHUNK_NEIGHBOUR_COUNT = 27;
+
+	enum ChunkStorage : uint8_t {
+		// An array of cells owned by the chunk, the only form the rules can update
+		CHUNK_STORAGE_DENSE,
+
+		// Every cell is the same, nothing is allocated
+		CHUNK_STORAGE_UNIFORM,
+
+		// Packed cells that other chunks may share, copied out to a dense array on the first write
+		CHUNK_STORAGE_PACKED
+	};
+
+	// CHUNK_VOLUME cells from the block pools. Chunks and copies of their cells use these, so the memory of a
+	// freed chunk goes straight to the next one
+	Cell* allocateChunkCells();
+	void freeChunkCells(Cell* cells);
+
+	class Chunk;
+	struct HeatField;
+
+	// A move into a neighbouring chunk found while every chunk ticks at once, applied after they are all done
+	struct OutboxMove {
+		Chunk* target;
+
+		// Positions within the chunk that queued the move and within the target
+		uint8_t sourceX;
+		uint8_t sourceY;
+		uint8_t sourceZ;
+		uint8_t targetX;
+		uint8_t targetY;
+		uint8_t targetZ;
+
+		// What the target held when the tick started, the move only happens if it still does
+		Cell expected;
+	};
+
+	class Chunk {
+	public:
+		// Ids are never reused within a world, so a chunk that was freed and created again can't be confused with the old one.
+		// Chunks start out as uniform air
+		Chunk(int chunkX, int chunkY, int chunkZ, uint64_t id);
+		~Chunk();
+
+		Chunk(const Chunk&) = delete;
+		Chunk& operator=(const Chunk&) = delete;
+
+		// Chunks are created and freed all the time as the world changes, so they come from a pool too
+		static void* operator new(size_t bytes) { return util::allocateBlock(bytes); }
+		static void operator delete(void* chunk, size_t bytes) { util::freeBlock(chunk, bytes); }
+
+		// Where a cell is stored in the array, in whichever layout the simulation was built with
+		static int index(int x, int y, int z) { return CellLayout::index(x, y, z); }
+
+		// Bricks follow the same x, z, y order as cells
+		static int brickIndex(int x, int y, int z) { return (x >> BRICK_SHIFT) | ((z >> BRICK_SHIFT) << 2) | ((y >> BRICK_SHIFT) << 4); }
+
+		// Neighbours follow the same x, z, y order as cells
+		static int neighbourIndex(int offsetX, int offsetY, int offsetZ) { return (offsetX + 1) + (offsetZ + 1) * 3 + (offsetY + 1) * 9; }
+
+		// Direct access to the cells is only valid while the chunk is dense
+		Cell& at(int x, int y, int z) { return mCells[index(x, y, z)]; }
+		const Cell& at(int x, int y, int z) const { return mCells[index(x, y, z)]; }
+
+		Cell* getCells() { return mCells; }
+		const Cell* getCells() const { return mCells; }
+
+		// Works with every kind of storage
+		Cell getCell(int x, int y, int z) const {
+			if (isDense())
+				return mCells[index(x, y, z)];
+
+			return mPackedCells != nullptr ? mPackedCells->get(index(x, y, z)) : mUniformCell;
+		}
+
+		// Writes all CHUNK_VOLUME cells to outCells in the order of index, whatever the storage
+		void copyCells(Cell* outCells) const;
+
+		ChunkStorage getStorage() const {
+			if (isDense())
+				return CHUNK_STORAGE_DENSE;
+
+			return mPackedCells != nullptr ? CHUNK_STORAGE_PACKED : CHUNK_STORAGE_UNIFORM;
+		}
+
+		bool isDense() const { return mCells != nullptr; }
+
+		// What a chunk that isn't dense holds, for copies that keep it in the same form. The uniform cell only
+		// counts while there are no packed cells
+		Cell getUniformCell() const { return mUniformCell; }
+		const std::shared_ptr<const PackedCells>& getPackedCells() const { return mPackedCells; }
+
+		// Frees the dense array, keeping a single cell if they are all the same and packed cells otherwise.
+		// Returns false and stays dense if there are too many distinct cells for a palette. Only call between ticks
+		bool compress();
+
+		// Gives the chunk its own dense array, does nothing if it already has one. Only call between ticks
+		void decompress();
+
+		// Replaces every cell without allocating anything. Doesn't wake the chunk, only call between ticks
+		void setUniform(Cell cell);
+
+		// Shares packed cells with any number of other chunks, without copying them. Doesn't wake the chunk,
+		// only call between ticks
+		void setSharedCells(std::shared_ptr<const PackedCells> cells);
+
+		// Compresses the chunk if it is dense and returns its packed cells, ready to be shared with other chunks.
+		// nullptr if the chunk is uniform or has too many distinct cells
+		std::shared_ptr<const PackedCells> getSharedCells();
+
+		// Bytes used by the cells in whichever form they are stored. Shared packed cells are split evenly
+		// between the chunks sharing them
+		size_t getCellMemoryBytes() const;
+
+		// Counts another tick without an active brick, or starts over if there is one. Returns the ticks in a row
+		// this chunk has been asleep
+		uint32_t updateIdleTicks() {
+			mIdleTicks = isActive() ? 0 : mIdleTicks + 1;
+			return mIdleTicks;
+		}
+
+		int getX() const { return mChunkX; }
+		int getY() const { return mChunkY; }
+		int getZ() const { return mChunkZ; }
+
+		uint64_t getId() const { return mId; }
+
+		// Offsets are -1, 0 or 1. Returns nullptr where there is no chunk, (0, 0, 0) is this chunk
+		Chunk* getNeighbour(int offsetX, int offsetY, int offsetZ) const { return mNeighbours[neighbourIndex(offsetX, offsetY, offsetZ)]; }
+		void setNeighbour(int offsetX, int offsetY, int offsetZ, Chunk* chunk) { mNeighbours[neighbourIndex(offsetX, offsetY, offsetZ)] = chunk; }
+
+		// Number of cells that aren't air. Moves into neighbours change it from other threads, so it is atomic
+		int getFilledCells() const { return mFilledCells.load(std::memory_order_relaxed); }
+		void addFilledCells(int count) { mFilledCells.fetch_add(count, std::memory_order_relaxed); }
+
+		bool isEmpty() const { return getFilledCells() == 0; }
+
+		// Sets every cell to the material and wakes the whole chunk. Leaves it uniform, so nothing is allocated
+		void fill(uint8_t material);
+
+		// Hash of every cell including its flags
+		uint64_t computeChecksum() const;
+
+		// Safe to call from any thread, the brick is picked up the next time this chunk starts a tick
+		void wakeBricks(uint64_t brickMask) { mWokenBricks.fetch_or(brickMask, std::memory_order_relaxed); }
+
+		// Merges the bricks woken since the last tick and returns every brick that has to be updated
+		uint64_t beginTick();
+
+		// Records whether anything moved in a brick, bricks that stay quiet for long enough fall asleep
+		void endBrick(int brick, bool moved);
+
+		uint64_t getActiveBricks() const { return mActiveBricks; }
+
+		// Bricks woken since the chunk last began a tick
+		uint64_t getWokenBricks() const { return mWokenBricks.load(std::memory_order_relaxed); }
+
+		// Moves out of this chunk queued during the current tick, see World::setMoveOutboxes
+		std::vector<OutboxMove>& getOutbox() { return mOutbox; }
+
+		// Copies the cells on the faces of the chunk, so neighbours ticking at the same time see them as they
+		// were when the tick started. Only call between ticks, on a dense chunk
+		void captureBorder();
+		void releaseBorder();
+
+		// A cell on a face of the chunk, from the copy while there is one. At least one coordinate is 0 or CHUNK_MASK
+		Cell getBorderCell(int x, int y, int z) const {
+			if (mBorderCells == nullptr)
+				return at(x, y, z);
+
+			return mBorderCells[getBorderIndex(x, y, z)];
+		}
+
+		// Temperatures of the chunk, nullptr while it is all at ambient, see heat.h
+		HeatField* getHeat() const { return mHeat; }
+
+		// A field from the block pools at ambient everywhere, still to be scanned. Does nothing if there is one
+		HeatField* createHeat();
+		void freeHeat();
+
+		bool isActive() const { return mActiveBricks != 0 || mWokenBricks.load(std::memory_order_relaxed) != 0; }
+
+		// Bumped whenever cells of this chunk change, so copies of it can tell when they are stale. Safe to
+		// call from any thread, neighbours mark a chunk when they move cells into it
+		void markChanged() { mRevision.fetch_add(1, std::memory_order_relaxed); }
+		uint64_t getRevision() const { return mRevision.load(std::memory_order_relaxed); }
+	private:
+		int mChunkX;
+		int mChunkY;
+		int mChunkZ;
+
+		uint64_t mId;
+
+		Chunk* mNeighbours[CHUNK_NEIGHBOUR_COUNT]{};
+
+		std::atomic<int> mFilledCells{ 0 };
+
+		// A dense chunk owns a pooled array of cells. Otherwise its cells are packed, or are all mUniformCell if
+		// there are no packed cells either
+		Cell* mCells{ nullptr };
+		std::shared_ptr<const PackedCells> mPackedCells;
+		Cell mUniformCell{ MATERIAL_AIR, 0 };
+
+		uint32_t mIdleTicks{ 0 };
+
+		uint64_t mActiveBricks{ 0 };
+		std::atomic<uint64_t> mWokenBricks{ 0 };
+		uint8_t mQuietTicks[BRICK_COUNT]{};
+
+		std::atomic<uint64_t> mRevision{ 1 };
+
+		std::vector<OutboxMove> mOutbox;
+
+		HeatField* mHeat{ nullptr };
+
+		// The six faces one after the other, nullptr outside of ticks that use outboxes
+		Cell* mBorderCells{ nullptr };
+
+		// Hands the dense array back to the pool, if there is one
+		void freeDenseCells();
+
+		static int getBorderIndex(int x, int y, int z) {
+			if (x == 0 || x == CHUNK_MASK)
+				return (x == 0 ? 0 : 1) * CHUNK_AREA + y * CHUNK_SIZE + z;
+
+			if (y == 0 || y == CHUNK_MASK)
+				return (y == 0 ? 2 : 3) * CHUNK_AREA + x * CHUNK_SIZE + z;
+
+			return (z == 0 ? 4 : 5) * CHUNK_AREA + x * CHUNK_SIZE + y;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "chunk_map.h"
+
+namespace {
+	const size_t INITIAL_CAPACITY = 64;
+}
+
+namespace sim {
+	ChunkMap::ChunkMap() : mSlots(INITIAL_CAPACITY, Slot{ EMPTY_KEY, nullptr }), mMask{ INITIAL_CAPACITY - 1 } {
+	}
+
+	void ChunkMap::insert(uint64_t key, Chunk* chunk) {
+		// Stay at most half full so probes stay short
+		if ((mCount + 1) * 2 > mSlots.size())
+			grow();
+
+		size_t slot = getHomeSlot(key);
+
+		while (mSlots[slot].key != EMPTY_KEY) {
+			slot = (slot + 1) & mMask;
+		}
+
+		mSlots[slot] = Slot{ key, chunk };
+		mCount++;
+	}
+
+	void ChunkMap::erase(uint64_t key) {
+		size_t slot = getHomeSlot(key);
+
+		while (mSlots[slot].key != key) {
+			if (mSlots[slot].key == EMPTY_KEY)
+				return;
+
+			slot = (slot + 1) & mMask;
+		}
+
+		// Pull later entries of the same probe run back into the hole, so lookups never stop early
+		size_t hole = slot;
+		size_t next = slot;
+
+		while (true) {
+			next = (next + 1) & mMask;
+
+			if (mSlots[next].key == EMPTY_KEY)
+				break;
+
+			size_t home = getHomeSlot(mSlots[next].key);
+
+			// An entry may only move back if its home isn't between the hole and where it is now
+			bool canMove = hole <= next ? (home <= hole || home > next) : (home <= hole && home > next);
+
+			if (canMove) {
+				mSlots[hole] = mSlots[next];
+				hole = next;
+			}
+		}
+
+		mSlots[hole] = Slot{ EMPTY_KEY, nullptr };
+		mCount--;
+	}
+
+	void ChunkMap::grow() {
+		std::vector<Slot> oldSlots(mSlots.size() * 2, Slot{ EMPTY_KEY, nullptr });
+		oldSlots.swap(mSlots);
+
+		mMask = mSlots.size() - 1;
+		mCount = 0;
+
+		for (const Slot& slot : oldSlots) {
+			if (slot.key != EMPTY_KEY)
+				insert(slot.key, slot.chunk);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "random.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sim {
+	class Chunk;
+
+	// Chunk coordinates are packed 21 bits per axis into one key, which limits them to +- CHUNK_COORD_LIMIT
+	constexpr int CHUNK_KEY_BITS = 21;
+	constexpr int CHUNK_COORD_LIMIT = 1 << (CHUNK_KEY_BITS - 1);
+
+	inline uint64_t packChunkKey(int chunkX, int chunkY, int chunkZ) {
+		const uint64_t mask = (1ull << CHUNK_KEY_BITS) - 1;
+
+		return ((uint64_t)(chunkX + CHUNK_COORD_LIMIT) & mask) | (((uint64_t)(chunkZ + CHUNK_COORD_LIMIT) & mask) << CHUNK_KEY_BITS)
+			| (((uint64_t)(chunkY + CHUNK_COORD_LIMIT) & mask) << (CHUNK_KEY_BITS * 2));
+	}
+
+	// Open addressing hash table from packed chunk keys to chunks. Slots are a flat array probed linearly, so
+	// a lookup is usually a single cache line. Removal shifts the following entries back instead of leaving
+	// tombstones, which keeps probe lengths short as chunks come and go
+	class ChunkMap {
+	public:
+		ChunkMap();
+
+		ChunkMap(const ChunkMap&) = delete;
+		ChunkMap& operator=(const ChunkMap&) = delete;
+
+		// Returns nullptr if there is no chunk with this key
+		Chunk* find(uint64_t key) const {
+			size_t slot = getHomeSlot(key);
+
+			while (true) {
+				const Slot& entry = mSlots[slot];
+
+				if (entry.key == key)
+					return entry.chunk;
+
+				if (entry.key == EMPTY_KEY)
+					return nullptr;
+
+				slot = (slot + 1) & mMask;
+			}
+		}
+
+		// The key must not be in the map yet
+		void insert(uint64_t key, Chunk* chunk);
+
+		// Does nothing if the key isn't in the map
+		void erase(uint64_t key);
+
+		size_t getCount() const { return mCount; }
+		size_t getCapacity() const { return mSlots.size(); }
+
+		size_t getMemoryBytes() const { return mSlots.capacity() * sizeof(Slot); }
+	private:
+		// Packed keys only use 63 bits, so this can never be a real key
+		static constexpr uint64_t EMPTY_KEY = ~0ull;
+
+		struct Slot {
+			uint64_t key;
+			Chunk* chunk;
+		};
+
+		std::vector<Slot> mSlots;
+		size_t mMask;
+		size_t mCount{ 0 };
+
+		// Neighbouring chunks have nearly identical keys, mixing spreads them over the table
+		size_t getHomeSlot(uint64_t key) const { return (size_t)mixBits(key) & mMask; }
+
+		void grow();
+	};
+}
\ No newline at end of file
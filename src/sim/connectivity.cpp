@@ -0,0 +1,246 @@
+#include "connectivity.h"
+#include "world.h"
+
+#include <utility>
+
+namespace {
+	// Offsets are packed 21 bits per axis like chunk keys, which reaches a million cells from the corner of a check
+	constexpr int KEY_BITS = 21;
+	constexpr int KEY_LIMIT = 1 << (KEY_BITS - 1);
+
+	// The cell below comes last, so it is the first one taken off the stack
+	constexpr int NEIGHBOUR_OFFSETS[6][3] = { { 0, 1, 0 }, { -1, 0, 0 }, { 1, 0, 0 }, { 0, 0, -1 }, { 0, 0, 1 }, { 0, -1, 0 } };
+
+	bool isInWorld(const sim::World& world, int x, int y, int z) {
+		return world.isInBounds(x >> sim::CHUNK_SHIFT, y >> sim::CHUNK_SHIFT, z >> sim::CHUNK_SHIFT);
+	}
+
+	// Out of bounds reads as stone, so check the bounds first
+	bool isSolid(sim::World& world, int x, int y, int z) {
+		return isInWorld(world, x, y, z) && sim::getMaterialState(world.getMaterial(x, y, z)) == sim::MATERIAL_STATE_SOLID;
+	}
+}
+
+namespace sim {
+	void SolidConnectivity::addCheck(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, bool shellOnly) {
+		mChecks.push_back(Check{ minX, minY, minZ, maxX, maxY, maxZ, shellOnly });
+	}
+
+	bool SolidConnectivity::runNextCheck(World& world, std::vector<std::vector<CellPosition>>& outIslands) {
+		outIslands.clear();
+
+		if (mNextCheck == mChecks.size()) {
+			mChecks.clear();
+			mNextCheck = 0;
+
+			return false;
+		}
+
+		runCheck(world, mChecks[mNextCheck++], outIslands);
+
+		return true;
+	}
+
+	void SolidConnectivity::runCheck(World& world, const Check& check, std::vector<std::vector<CellPosition>>& outIslands) {
+		mFillCount = 0;
+		mParents.clear();
+		mSizes.clear();
+		mHeld.clear();
+		mOwners.clear();
+
+		mOriginX = check.minX;
+		mOriginY = check.minY;
+		mOriginZ = check.minZ;
+
+		// One fill from every solid cell around the box that no earlier fill got to
+		for (int y = check.minY - 1; y <= check.maxY + 1; y++) {
+			for (int z = check.minZ - 1; z <= check.maxZ + 1; z++) {
+				// Rows through the box only have their two ends outside of it
+				bool rowInside = y >= check.minY && y <= check.maxY && z >= check.minZ && z <= check.maxZ;
+				int step = check.shellOnly && rowInside ? check.maxX - check.minX + 2 : 1;
+
+				for (int x = check.minX - 1; x <= check.maxX + 1; x += step) {
+					uint64_t key;
+
+					if (!isSolid(world, x, y, z) || !getKey(x, y, z, key) || mOwners.count(key) != 0)
+						continue;
+
+					startFill(x, y, z, key);
+				}
+			}
+		}
+
+		// Fills take turns until every set is held up or has run out of cells
+		bool working = true;
+
+		while (working) {
+			working = false;
+
+			for (uint32_t fill = 0; fill < mFillCount; fill++) {
+				std::vector<CellPosition>& stack = mFills[fill].stack;
+
+				if (stack.empty())
+					continue;
+
+				if (mHeld[findRoot(fill)]) {
+					stack.clear();
+					continue;
+				}
+
+				for (int step = 0; step < CONNECTIVITY_FILL_STEP && !stack.empty(); step++) {
+					CellPosition cell = stack.back();
+					stack.pop_back();
+
+					expand(world, fill, cell);
+
+					if (mHeld[findRoot(fill)])
+						break;
+				}
+
+				working = true;
+			}
+		}
+
+		// Every set that isn't held up is a whole island, its fills looked at every neighbour of every cell in it
+		std::vector<int> islands(mFillCount, -1);
+
+		for (uint32_t fill = 0; fill < mFillCount; fill++) {
+			uint32_t root = findRoot(fill);
+
+			if (mHeld[root])
+				continue;
+
+			if (islands[root] < 0) {
+				islands[root] = (int)outIslands.size();
+				outIslands.emplace_back();
+			}
+
+			std::vector<CellPosition>& island = outIslands[islands[root]];
+			island.insert(island.end(), mFills[fill].cells.begin(), mFills[fill].cells.end());
+		}
+	}
+
+	bool SolidConnectivity::getKey(int x, int y, int z, uint64_t& outKey) const {
+		int offsetX = x - mOriginX;
+		int offsetY = y - mOriginY;
+		int offsetZ = z - mOriginZ;
+
+		if (offsetX < -KEY_LIMIT || offsetX >= KEY_LIMIT || offsetY < -KEY_LIMIT || offsetY >= KEY_LIMIT || offsetZ < -KEY_LIMIT || offsetZ >= KEY_LIMIT)
+			return false;
+
+		const uint64_t mask = (1ull << KEY_BITS) - 1;
+
+		outKey = ((uint64_t)(offsetX + KEY_LIMIT) & mask) | (((uint64_t)(offsetZ + KEY_LIMIT) & mask) << KEY_BITS)
+			| (((uint64_t)(offsetY + KEY_LIMIT) & mask) << (KEY_BITS * 2));
+
+		return true;
+	}
+
+	void SolidConnectivity::startFill(int x, int y, int z, uint64_t key) {
+		uint32_t fill = (uint32_t)mFillCount++;
+
+		if (mFills.size() < mFillCount)
+			mFills.emplace_back();
+
+		mFills[fill].stack.clear();
+		mFills[fill].cells.clear();
+		mFills[fill].stack.push_back(CellPosition{ x, y, z });
+		mFills[fill].cells.push_back(CellPosition{ x, y, z });
+
+		mParents.push_back(fill);
+		mSizes.push_back(1);
+		mHeld.push_back(0);
+
+		mOwners.emplace(key, fill);
+	}
+
+	void SolidConnectivity::expand(World& world, uint32_t fill, const CellPosition& cell) {
+		for (int i = 0; i < 6; i++) {
+			int x = cell.x + NEIGHBOUR_OFFSETS[i][0];
+			int y = cell.y + NEIGHBOUR_OFFSETS[i][1];
+			int z = cell.z + NEIGHBOUR_OFFSETS[i][2];
+
+			uint64_t key;
+
+			// The walls of the world hold up whatever touches them. Cells too far away to get a key are taken to
+			// be held up as well, like a set that grows past the search limit
+			if (!isInWorld(world, x, y, z) || !getKey(x, y, z, key)) {
+				mHeld[findRoot(fill)] = 1;
+				return;
+			}
+
+			uint8_t material = world.getMaterial(x, y, z);
+			MaterialState state = getMaterialState(material);
+
+			if (state != MATERIAL_STATE_SOLID) {
+				// Resting on sand or liquid holds it up as well, only air and gas let it fall
+				if (NEIGHBOUR_OFFSETS[i][1] < 0 && material != MATERIAL_AIR && state != MATERIAL_STATE_GAS) {
+					mHeld[findRoot(fill)] = 1;
+					return;
+				}
+
+				continue;
+			}
+
+			auto owner = mOwners.find(key);
+
+			if (owner != mOwners.end()) {
+				unite(fill, owner->second);
+				continue;
+			}
+
+			mOwners.emplace(key, fill);
+			mFills[fill].stack.push_back(CellPosition{ x, y, z });
+			mFills[fill].cells.push_back(CellPosition{ x, y, z });
+
+			uint32_t root = findRoot(fill);
+
+			if (++mSizes[root] > CONNECTIVITY_SEARCH_LIMIT)
+				mHeld[root] = 1;
+		}
+	}
+
+	uint32_t SolidConnectivity::findRoot(uint32_t fill) {
+		// Path halving, every other fill on the way points to its grandparent afterwards
+		while (mParents[fill] != fill) {
+			mParents[fill] = mParents[mParents[fill]];
+			fill = mParents[fill];
+		}
+
+		return fill;
+	}
+
+	void SolidConnectivity::unite(uint32_t a, uint32_t b) {
+		a = findRoot(a);
+		b = findRoot(b);
+
+		if (a == b)
+			return;
+
+		// The smaller set goes under the larger one, and the lower fill wins a tie so islands keep their order
+		if (mSizes[a] < mSizes[b] || (mSizes[a] == mSizes[b] && b < a))
+			std::swap(a, b);
+
+		mParents[b] = a;
+		mSizes[a] += mSizes[b];
+		mHeld[a] = mHeld[a] | mHeld[b];
+
+		if (mSizes[a] > CONNECTIVITY_SEARCH_LIMIT)
+			mHeld[a] = 1;
+	}
+
+	size_t SolidConnectivity::getMemoryBytes() const {
+		size_t bytes = mChecks.capacity() * sizeof(Check) + mFills.capacity() * sizeof(Fill);
+
+		for (const Fill& fill : mFills) {
+			bytes += (fill.stack.capacity() + fill.cells.capacity()) * sizeof(CellPosition);
+		}
+
+		bytes += (mParents.capacity() + mSizes.capacity()) * sizeof(uint32_t) + mHeld.capacity();
+
+		// Roughly a node per entry and a pointer per bucket
+		bytes += mOwners.size() * (sizeof(uint64_t) + sizeof(uint32_t) + 2 * sizeof(void*)) + mOwners.bucket_count() * sizeof(void*);
+
+		return bytes;
+	}
+}
\ No newline at end of file
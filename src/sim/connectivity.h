@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace sim {
+	class World;
+
+	// Solid cells a set of connected fills visits before it stops and takes its cells as held up. Keeps a cut through
+	// a large structure cheap, and is also the most cells a detached island can have
+	constexpr uint32_t CONNECTIVITY_SEARCH_LIMIT = 1 << 16;
+
+	// Cells each fill expands before the next one has its turn
+	constexpr int CONNECTIVITY_FILL_STEP = 64;
+
+	struct CellPosition {
+		int x;
+		int y;
+		int z;
+	};
+
+	// Finds islands of solid cells that nothing holds up any more. Solid cells are held up by the walls of a bounded
+	// world, and by anything other than air or gas right below one of them. Edits that take solid cells away add a
+	// check, and every check runs a fill from each solid cell around it. The fills take turns, so the one on the
+	// side of a cut that is still attached to the ground stops as soon as it gets there, and a small island on the
+	// other side is found after visiting only its own cells. Fills that meet are merged in a union-find: a set is
+	// held up as soon as one of its fills is, and is an island once all of them have run out of cells
+	class SolidConnectivity {
+	public:
+		// Solid cells around the box, or also inside it unless the edit filled all of it with something that isn't
+		// solid, may have lost what held them up
+		void addCheck(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, bool shellOnly);
+
+		// Runs the oldest check left and puts the cells of each island it finds into outIslands, in the order the
+		// fills that found them started. Returns false once there are no checks left. Take the islands out of the
+		// grid before the next check, which would find them again otherwise
+		bool runNextCheck(World& world, std::vector<std::vector<CellPosition>>& outIslands);
+
+		size_t getMemoryBytes() const;
+	private:
+		struct Check {
+			int minX;
+			int minY;
+			int minZ;
+			int maxX;
+			int maxY;
+			int maxZ;
+			bool shellOnly;
+		};
+
+		struct Fill {
+			// Cells reached but not expanded yet, the one below last so a fill heads for the ground first
+			std::vector<CellPosition> stack;
+			std::vector<CellPosition> cells;
+		};
+
+		std::vector<Check> mChecks;
+		size_t mNextCheck{ 0 };
+
+		// Kept between checks so they don't allocate once they have run a few times
+		std::vector<Fill> mFills;
+		size_t mFillCount{ 0 };
+
+		// Union-find over the fills of one check. Sizes and whether the set is held up are only kept for roots
+		std::vector<uint32_t> mParents;
+		std::vector<uint32_t> mSizes;
+		std::vector<uint8_t> mHeld;
+
+		// Fill that reached each cell, by its offset from the corner of the check
+		std::unordered_map<uint64_t, uint32_t> mOwners;
+
+		int mOriginX{ 0 };
+		int mOriginY{ 0 };
+		int mOriginZ{ 0 };
+
+		void runCheck(World& world, const Check& check, std::vector<std::vector<CellPosition>>& outIslands);
+
+		// Returns false if the cell is too far from the corner of the check to get a key
+		bool getKey(int x, int y, int z, uint64_t& outKey) const;
+
+		void startFill(int x, int y, int z, uint64_t key);
+
+		// Looks at the six neighbours of a cell of the fill, reaching the solid ones and merging with the fills
+		// that got to them first
+		void expand(World& world, uint32_t fill, const CellPosition& cell);
+
+		uint32_t findRoot(uint32_t fill);
+		void unite(uint32_t a, uint32_t b);
+	};
+}
\ No newline at end of file
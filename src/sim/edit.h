@@ -0,0 +1,60 @@
+#pragma once
+
+#include "cell.h"
+
+#include <cstdint>
+
+namespace sim {
+	enum EditType : uint8_t {
+		EDIT_TYPE_SET_CELL,
+		EDIT_TYPE_FILL_BOX,
+		EDIT_TYPE_FILL_SPHERE,
+
+		// Wakes everything within the radius without changing any cells, so a settled region re-evaluates its
+		// rules
+		EDIT_TYPE_IMPULSE,
+
+		// Throws every cell within the radius out of the grid as a free particle, away from the center and
+		// faster the closer it was. Gas is blown away, see World::updateParticles
+		EDIT_TYPE_EXPLODE
+	};
+
+	// A change to the world, queued from any thread and applied between ticks. Every edit covers the
+	// box min - max, spheres, impulses and explosions also keep their center and radius
+	struct EditCommand {
+		EditType type;
+		uint8_t material;
+
+		int minX;
+		int minY;
+		int minZ;
+		int maxX;
+		int maxY;
+		int maxZ;
+
+		int centerX;
+		int centerY;
+		int centerZ;
+		int radius;
+
+		static EditCommand setCell(int x, int y, int z, uint8_t material) {
+			return EditCommand{ EDIT_TYPE_SET_CELL, material, x, y, z, x, y, z, x, y, z, 0 };
+		}
+
+		static EditCommand fillBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, uint8_t material) {
+			return EditCommand{ EDIT_TYPE_FILL_BOX, material, minX, minY, minZ, maxX, maxY, maxZ, 0, 0, 0, 0 };
+		}
+
+		static EditCommand fillSphere(int x, int y, int z, int radius, uint8_t material) {
+			return EditCommand{ EDIT_TYPE_FILL_SPHERE, material, x - radius, y - radius, z - radius, x + radius, y + radius, z + radius, x, y, z, radius };
+		}
+
+		static EditCommand impulse(int x, int y, int z, int radius) {
+			return EditCommand{ EDIT_TYPE_IMPULSE, MATERIAL_AIR, x - radius, y - radius, z - radius, x + radius, y + radius, z + radius, x, y, z, radius };
+		}
+
+		static EditCommand explode(int x, int y, int z, int radius) {
+			return EditCommand{ EDIT_TYPE_EXPLODE, MATERIAL_AIR, x - radius, y - radius, z - radius, x + radius, y + radius, z + radius, x, y, z, radius };
+		}
+	};
+}
\ No newline at end of file
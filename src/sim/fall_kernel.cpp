@@ -0,0 +1,66 @@
+#include "fall_kernel.h"
+#include "chunk.h"
+#include "../util/cpu.h"
+
+namespace sim {
+	uint64_t fallLayerScalar(Cell* layer, Cell* below, int rowStride, uint8_t material, uint8_t stamp) {
+		uint64_t fell = 0;
+
+		for (int z = 0; z < BRICK_SIZE; z++) {
+			Cell* row = layer + z * rowStride;
+			Cell* rowBelow = below + z * rowStride;
+
+			for (int x = 0; x < BRICK_SIZE; x++) {
+				Cell& cell = row[x];
+				Cell& target = rowBelow[x];
+
+				if (cell.material != material || (cell.flags & CELL_FLAG_STAMP) == stamp || target.material != MATERIAL_AIR)
+					continue;
+
+				Cell moved = cell;
+				cell = target;
+				target = moved;
+
+				cell.flags = (cell.flags & ~CELL_FLAG_STAMP) | stamp;
+				target.flags = (target.flags & ~CELL_FLAG_STAMP) | stamp;
+
+				fell |= 1ull << (x + z * BRICK_SIZE);
+			}
+		}
+
+		return fell;
+	}
+
+	FallLayerFunction getFallLayerFunction(FallKernel kernel) {
+		switch (kernel) {
+		case FALL_KERNEL_PER_CELL:
+			return nullptr;
+		case FALL_KERNEL_SCALAR:
+			return fallLayerScalar;
+		default:
+			break;
+		}
+
+		FallLayerFunction avx2 = getFallLayerAVX2();
+
+		if (avx2 != nullptr && util::cpuSupportsAVX2())
+			return avx2;
+
+		return fallLayerScalar;
+	}
+
+	const char* getFallKernelName(FallKernel kernel) {
+		switch (kernel) {
+		case FALL_KERNEL_AUTO:
+			return "auto";
+		case FALL_KERNEL_PER_CELL:
+			return "per cell";
+		case FALL_KERNEL_SCALAR:
+			return "scalar";
+		case FALL_KERNEL_AVX2:
+			return "avx2";
+		default:
+			return "unknown";
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "cell.h"
+
+#include <cstdint>
+
+namespace sim {
+	enum FallKernel {
+		// AVX2 when the processor has it, otherwise the scalar version of the same kernel
+		FALL_KERNEL_AUTO,
+
+		// No bulk pass, every cell goes through the per cell rules
+		FALL_KERNEL_PER_CELL,
+
+		FALL_KERNEL_SCALAR,
+		FALL_KERNEL_AVX2
+	};
+
+	// Moves every unstamped cell of the given material in one 8x8 layer of a brick into the air directly below it,
+	// stamping both cells of every swap. Rows of the layer are rowStride cells apart, CHUNK_SIZE in a chunk and
+	// more in a haloed copy of one, and below points at the layer one level down. Returns a mask with bit x + 8 * z set for every cell that fell
+	//
+	// The scalar and AVX2 versions give bit identical results, so the dispatch never changes the outcome of a tick
+	using FallLayerFunction = uint64_t(*)(Cell* layer, Cell* below, int rowStride, uint8_t material, uint8_t stamp);
+
+	uint64_t fallLayerScalar(Cell* layer, Cell* below, int rowStride, uint8_t material, uint8_t stamp);
+
+	// Returns nullptr when the build has no AVX2 version, such as on non x86 targets
+	FallLayerFunction getFallLayerAVX2();
+
+	// Picks the function for a kernel choice, nullptr for FALL_KERNEL_PER_CELL. Asking for AVX2 on a
+	// processor without it gives the scalar version
+	FallLayerFunction getFallLayerFunction(FallKernel kernel);
+
+	const char* getFallKernelName(FallKernel kernel);
+
+	// Most cells a granular cell falls on one tick with fast falls, as many as the speed bits hold
+	constexpr int FALL_SPEED_MAX = CELL_FALL_SPEED_MASK >> CELL_FALL_SPEED_SHIFT;
+
+	// Sideways step of each drift, in the order the rules try the sides in
+	constexpr int FALL_DRIFT_OFFSETS[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+	constexpr int FALL_NO_DRIFT = -1;
+
+	inline int getFallSpeed(Cell cell) {
+		return (cell.flags & CELL_FALL_SPEED_MASK) >> CELL_FALL_SPEED_SHIFT;
+	}
+
+	// Index into FALL_DRIFT_OFFSETS, or FALL_NO_DRIFT
+	inline int getFallDrift(Cell cell) {
+		return (cell.flags & CELL_FLAG_DRIFT) != 0 ? (cell.flags & CELL_DRIFT_MASK) >> CELL_DRIFT_SHIFT : FALL_NO_DRIFT;
+	}
+
+	// The other flags stay as they are
+	inline void setFallVelocity(Cell& cell, int speed, int drift) {
+		uint8_t velocity = (uint8_t)(speed << CELL_FALL_SPEED_SHIFT);
+
+		if (drift != FALL_NO_DRIFT)
+			velocity |= CELL_FLAG_DRIFT | (uint8_t)(drift << CELL_DRIFT_SHIFT);
+
+		cell.flags = (cell.flags & ~(CELL_FALL_SPEED_MASK | CELL_FLAG_DRIFT | CELL_DRIFT_MASK)) | velocity;
+	}
+}
\ No newline at end of file
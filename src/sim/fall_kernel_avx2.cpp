@@ -0,0 +1,79 @@
+#include "fall_kernel.h"
+#include "chunk.h"
+
+#include <cstddef>
+
+// This file is the only one built with AVX2 enabled, nothing in it runs unless the processor was checked first
+#ifdef __AVX2__
+#include <immintrin.h>
+
+namespace {
+	// Two rows of a brick layer, 8 cells each, as one register
+	__m256i loadRows(const sim::Cell* row, int rowStride) {
+		__m128i low = _mm_loadu_si128((const __m128i*)row);
+		__m128i high = _mm_loadu_si128((const __m128i*)(row + rowStride));
+
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+	}
+
+	void storeRows(sim::Cell* row, int rowStride, __m256i rows) {
+		_mm_storeu_si128((__m128i*)row, _mm256_castsi256_si128(rows));
+		_mm_storeu_si128((__m128i*)(row + rowStride), _mm256_extracti128_si256(rows, 1));
+	}
+
+	uint64_t fallLayerAVX2(sim::Cell* layer, sim::Cell* below, int rowStride, uint8_t material, uint8_t stamp) {
+		static_assert(sizeof(sim::Cell) == 2 && offsetof(sim::Cell, material) == 0, "Lanes expect the material in the low byte");
+
+		// Each 16 bit lane is one cell, material in the low byte and flags in the high byte
+		const __m256i materialMask = _mm256_set1_epi16(0x00FF);
+		const __m256i eligibleMask = _mm256_set1_epi16((short)(0x00FF | (CELL_FLAG_STAMP << 8)));
+		const __m256i eligibleValue = _mm256_set1_epi16((short)(material | ((stamp ^ CELL_FLAG_STAMP) << 8)));
+		const __m256i airValue = _mm256_set1_epi16(sim::MATERIAL_AIR);
+		const __m256i keepFlags = _mm256_set1_epi16((short)~(CELL_FLAG_STAMP << 8));
+		const __m256i stampFlags = _mm256_set1_epi16((short)(stamp << 8));
+
+		uint64_t fell = 0;
+
+		for (int z = 0; z < sim::BRICK_SIZE; z += 2) {
+			sim::Cell* rows = layer + z * rowStride;
+			sim::Cell* rowsBelow = below + z * rowStride;
+
+			__m256i cells = loadRows(rows, rowStride);
+			__m256i targets = loadRows(rowsBelow, rowStride);
+
+			__m256i eligible = _mm256_cmpeq_epi16(_mm256_and_si256(cells, eligibleMask), eligibleValue);
+			__m256i empty = _mm256_cmpeq_epi16(_mm256_and_si256(targets, materialMask), airValue);
+			__m256i falling = _mm256_and_si256(eligible, empty);
+
+			if (_mm256_testz_si256(falling, falling))
+				continue;
+
+			__m256i stampedCells = _mm256_or_si256(_mm256_and_si256(cells, keepFlags), stampFlags);
+			__m256i stampedTargets = _mm256_or_si256(_mm256_and_si256(targets, keepFlags), stampFlags);
+
+			storeRows(rows, rowStride, _mm256_blendv_epi8(cells, stampedTargets, falling));
+			storeRows(rowsBelow, rowStride, _mm256_blendv_epi8(targets, stampedCells, falling));
+
+			// Packing narrows every lane to a byte, leaving the first row in bits 0-7 and the second in bits 16-23
+			uint32_t bits = (uint32_t)_mm256_movemask_epi8(_mm256_packs_epi16(falling, _mm256_setzero_si256()));
+
+			fell |= (uint64_t)(bits & 0xFF) << (z * sim::BRICK_SIZE);
+			fell |= (uint64_t)((bits >> 16) & 0xFF) << ((z + 1) * sim::BRICK_SIZE);
+		}
+
+		return fell;
+	}
+}
+
+namespace sim {
+	FallLayerFunction getFallLayerAVX2() {
+		return fallLayerAVX2;
+	}
+}
+#else
+namespace sim {
+	FallLayerFunction getFallLayerAVX2() {
+		return nullptr;
+	}
+}
+#endif
\ No newline at end of file
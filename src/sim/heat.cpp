@@ -0,0 +1,329 @@
+#include "heat.h"
+#include "chunk.h"
+#include "random.h"
+#include "world.h"
+#include "../util/bits.h"
+#include "../util/cpu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	// Blocks along each axis of a brick
+	constexpr int BRICK_BLOCKS = sim::BRICK_SIZE / sim::HEAT_BLOCK_SIZE;
+
+	float getDeviation(float temperature) {
+		return std::fabs(temperature - sim::HEAT_AMBIENT);
+	}
+
+	// Looks at the materials of one block again
+	void scanBlock(const sim::Chunk& chunk, sim::HeatField& field, int blockX, int blockY, int blockZ) {
+		const sim::MaterialTables& tables = sim::MaterialRegistry::getTables();
+
+		int16_t source = sim::MATERIAL_NO_TEMPERATURE;
+		int16_t heatingPoint = sim::MATERIAL_NEVER_MELTS;
+		int16_t coolingPoint = sim::MATERIAL_NEVER_FREEZES;
+
+		for (int y = blockY * sim::HEAT_BLOCK_SIZE; y < (blockY + 1) * sim::HEAT_BLOCK_SIZE; y++) {
+			for (int z = blockZ * sim::HEAT_BLOCK_SIZE; z < (blockZ + 1) * sim::HEAT_BLOCK_SIZE; z++) {
+				for (int x = blockX * sim::HEAT_BLOCK_SIZE; x < (blockX + 1) * sim::HEAT_BLOCK_SIZE; x++) {
+					uint8_t material = chunk.getCell(x, y, z).material;
+					int16_t temperature = tables.temperatures[material];
+
+					if (temperature != sim::MATERIAL_NO_TEMPERATURE && (source == sim::MATERIAL_NO_TEMPERATURE || getDeviation(temperature) > getDeviation(source)))
+						source = temperature;
+
+					heatingPoint = std::min(heatingPoint, std::min(tables.meltingPoints[material], tables.ignitionPoints[material]));
+					coolingPoint = std::max(coolingPoint, tables.freezingPoints[material]);
+				}
+			}
+		}
+
+		int block = sim::HeatField::index(blockX, blockY, blockZ);
+
+		// Whatever was put there arrives at its own temperature
+		if (source != sim::MATERIAL_NO_TEMPERATURE && field.sources[block] == sim::MATERIAL_NO_TEMPERATURE)
+			field.temperatures[field.current][block] = source;
+
+		field.sourceBlocks += (source != sim::MATERIAL_NO_TEMPERATURE ? 1 : 0) - (field.sources[block] != sim::MATERIAL_NO_TEMPERATURE ? 1 : 0);
+		field.sources[block] = source;
+		field.heatingPoints[block] = heatingPoint;
+		field.coolingPoints[block] = coolingPoint;
+	}
+
+	void scanBricks(const sim::Chunk& chunk, sim::HeatField& field, uint64_t bricks) {
+		while (bricks != 0) {
+			int brick = util::countTrailingZeros(bricks);
+			bricks &= bricks - 1;
+
+			// Bricks are in x, z, y order, 4 to an axis
+			int startX = (brick & 3) * BRICK_BLOCKS;
+			int startZ = ((brick >> 2) & 3) * BRICK_BLOCKS;
+			int startY = (brick >> 4) * BRICK_BLOCKS;
+
+			for (int blockY = startY; blockY < startY + BRICK_BLOCKS; blockY++) {
+				for (int blockZ = startZ; blockZ < startZ + BRICK_BLOCKS; blockZ++) {
+					for (int blockX = startX; blockX < startX + BRICK_BLOCKS; blockX++) {
+						scanBlock(chunk, field, blockX, blockY, blockZ);
+					}
+				}
+			}
+		}
+	}
+
+	bool holdsHeatSource(const sim::Chunk& chunk, uint64_t bricks) {
+		const sim::MaterialTables& tables = sim::MaterialRegistry::getTables();
+
+		while (bricks != 0) {
+			int brick = util::countTrailingZeros(bricks);
+			bricks &= bricks - 1;
+
+			int startX = (brick & 3) * sim::BRICK_SIZE;
+			int startZ = ((brick >> 2) & 3) * sim::BRICK_SIZE;
+			int startY = (brick >> 4) * sim::BRICK_SIZE;
+
+			for (int y = startY; y < startY + sim::BRICK_SIZE; y++) {
+				for (int z = startZ; z < startZ + sim::BRICK_SIZE; z++) {
+					for (int x = startX; x < startX + sim::BRICK_SIZE; x++) {
+						if (tables.temperatures[chunk.getCell(x, y, z).material] != sim::MATERIAL_NO_TEMPERATURE)
+							return true;
+					}
+				}
+			}
+		}
+
+		return false;
+	}
+
+	// Current temperatures of the neighbour holding a block, which is given relative to the chunk and may be
+	// one block outside of it. nullptr where that neighbour has no field
+	const float* getNeighbourTemperatures(const sim::Chunk& chunk, int blockX, int blockY, int blockZ) {
+		int offsetX = blockX < 0 ? -1 : (blockX >= sim::HEAT_SIZE ? 1 : 0);
+		int offsetY = blockY < 0 ? -1 : (blockY >= sim::HEAT_SIZE ? 1 : 0);
+		int offsetZ = blockZ < 0 ? -1 : (blockZ >= sim::HEAT_SIZE ? 1 : 0);
+
+		sim::Chunk* neighbour = chunk.getNeighbour(offsetX, offsetY, offsetZ);
+
+		return neighbour != nullptr && neighbour->getHeat() != nullptr ? neighbour->getHeat()->getTemperatures() : nullptr;
+	}
+
+	// The blocks of the chunk and one block of its neighbours around them, ambient where there is no field
+	void gatherPadded(const sim::Chunk& chunk, float* padded) {
+		for (int y = -1; y <= sim::HEAT_SIZE; y++) {
+			for (int z = -1; z <= sim::HEAT_SIZE; z++) {
+				float* row = padded + (z + 1) * sim::HEAT_PADDED_SIZE + (y + 1) * sim::HEAT_PADDED_AREA;
+
+				int localY = y & (sim::HEAT_SIZE - 1);
+				int localZ = z & (sim::HEAT_SIZE - 1);
+
+				// The middle of the row comes from one chunk, each end from the one next to it
+				const float* middle = getNeighbourTemperatures(chunk, 0, y, z);
+				const float* left = getNeighbourTemperatures(chunk, -1, y, z);
+				const float* right = getNeighbourTemperatures(chunk, sim::HEAT_SIZE, y, z);
+
+				if (middle != nullptr)
+					memcpy(row + 1, middle + sim::HeatField::index(0, localY, localZ), sizeof(float) * sim::HEAT_SIZE);
+				else
+					std::fill(row + 1, row + 1 + sim::HEAT_SIZE, sim::HEAT_AMBIENT);
+
+				row[0] = left != nullptr ? left[sim::HeatField::index(sim::HEAT_SIZE - 1, localY, localZ)] : sim::HEAT_AMBIENT;
+				row[sim::HEAT_SIZE + 1] = right != nullptr ? right[sim::HeatField::index(0, localY, localZ)] : sim::HEAT_AMBIENT;
+			}
+		}
+	}
+
+	// HEAT_FACE_ flags of the faces of the chunk the block lies on
+	uint8_t getBlockFaces(int blockX, int blockY, int blockZ) {
+		const int last = sim::HEAT_SIZE - 1;
+
+		return (blockX == 0 ? HEAT_FACE_NEGATIVE_X : 0) | (blockX == last ? HEAT_FACE_POSITIVE_X : 0)
+			| (blockY == 0 ? HEAT_FACE_NEGATIVE_Y : 0) | (blockY == last ? HEAT_FACE_POSITIVE_Y : 0)
+			| (blockZ == 0 ? HEAT_FACE_NEGATIVE_Z : 0) | (blockZ == last ? HEAT_FACE_POSITIVE_Z : 0);
+	}
+
+	// Turns the cells of a block that are past one of their points at its temperature into what they become.
+	// Returns whether a cell changed
+	bool changeBlock(sim::World& world, sim::Chunk& chunk, int blockX, int blockY, int blockZ, float temperature, uint64_t tick) {
+		const sim::MaterialTables& tables = sim::MaterialRegistry::getTables();
+
+		int baseX = chunk.getX() * sim::CHUNK_SIZE;
+		int baseY = chunk.getY() * sim::CHUNK_SIZE;
+		int baseZ = chunk.getZ() * sim::CHUNK_SIZE;
+
+		bool changed = false;
+		int filled = 0;
+
+		for (int y = blockY * sim::HEAT_BLOCK_SIZE; y < (blockY + 1) * sim::HEAT_BLOCK_SIZE; y++) {
+			for (int z = blockZ * sim::HEAT_BLOCK_SIZE; z < (blockZ + 1) * sim::HEAT_BLOCK_SIZE; z++) {
+				for (int x = blockX * sim::HEAT_BLOCK_SIZE; x < (blockX + 1) * sim::HEAT_BLOCK_SIZE; x++) {
+					uint8_t material = chunk.getCell(x, y, z).material;
+
+					// Only catching fire is left to chance
+					uint32_t roll = temperature >= tables.ignitionPoints[material]
+						? sim::randomForCell(world.getSeed(), tick, baseX + x, baseY + y, baseZ + z, sim::RANDOM_SALT_HEAT) : 0;
+					uint8_t result = sim::getHeatTransition(material, temperature, roll);
+
+					if (result == sim::MATERIAL_NONE)
+						continue;
+
+					// Packed cells can't be written during a tick, woken up the chunk is expanded for the next one
+					if (!chunk.isDense()) {
+						chunk.wakeBricks(1ull << sim::Chunk::brickIndex(x, y, z));
+						return false;
+					}
+
+					sim::Cell& cell = chunk.at(x, y, z);
+
+					filled += (result != sim::MATERIAL_AIR ? 1 : 0) - (material != sim::MATERIAL_AIR ? 1 : 0);
+
+					// Whatever it turns into is a whole cell
+					cell.material = result;
+					cell.flags &= ~CELL_LEVEL_MASK;
+
+					world.wakeAround(baseX + x, baseY + y, baseZ + z);
+					changed = true;
+				}
+			}
+		}
+
+		if (filled != 0)
+			chunk.addFilledCells(filled);
+
+		return changed;
+	}
+}
+
+namespace sim {
+	void diffuseHeatScalar(const float* padded, float* outTemperatures) {
+		const float side = HEAT_DIFFUSION;
+		const float middle = 1.0f - 2.0f * HEAT_DIFFUSION;
+
+		// Every padded row blurred along x, then every padded layer along z
+		float alongX[HEAT_PADDED_AREA][HEAT_SIZE];
+		float alongZ[HEAT_PADDED_SIZE][HEAT_SIZE][HEAT_SIZE];
+
+		for (int row = 0; row < HEAT_PADDED_AREA; row++) {
+			const float* in = padded + row * HEAT_PADDED_SIZE;
+
+			for (int x = 0; x < HEAT_SIZE; x++) {
+				alongX[row][x] = side * in[x] + middle * in[x + 1] + side * in[x + 2];
+			}
+		}
+
+		for (int y = 0; y < HEAT_PADDED_SIZE; y++) {
+			for (int z = 0; z < HEAT_SIZE; z++) {
+				const float* in = alongX[y * HEAT_PADDED_SIZE + z];
+
+				for (int x = 0; x < HEAT_SIZE; x++) {
+					alongZ[y][z][x] = side * in[x] + middle * in[x + HEAT_SIZE] + side * in[x + 2 * HEAT_SIZE];
+				}
+			}
+		}
+
+		for (int y = 0; y < HEAT_SIZE; y++) {
+			for (int z = 0; z < HEAT_SIZE; z++) {
+				for (int x = 0; x < HEAT_SIZE; x++) {
+					outTemperatures[HeatField::index(x, y, z)] = side * alongZ[y][z][x] + middle * alongZ[y + 1][z][x] + side * alongZ[y + 2][z][x];
+				}
+			}
+		}
+	}
+
+	DiffuseHeatFunction getDiffuseHeatFunction(FallKernel kernel) {
+		if (kernel == FALL_KERNEL_SCALAR || kernel == FALL_KERNEL_PER_CELL)
+			return diffuseHeatScalar;
+
+		DiffuseHeatFunction avx2 = getDiffuseHeatAVX2();
+
+		if (avx2 != nullptr && util::cpuSupportsAVX2())
+			return avx2;
+
+		return diffuseHeatScalar;
+	}
+
+	uint8_t getHeatTransition(uint8_t material, float temperature, uint32_t roll) {
+		const MaterialTables& tables = MaterialRegistry::getTables();
+
+		if (temperature >= tables.meltingPoints[material])
+			return tables.meltsInto[material];
+
+		if (temperature <= tables.freezingPoints[material])
+			return tables.freezesInto[material];
+
+		if (temperature >= tables.ignitionPoints[material] && (roll & 0xFF) < tables.flammabilities[material])
+			return tables.burnsInto[material];
+
+		return MATERIAL_NONE;
+	}
+
+	void scanHeatSources(Chunk& chunk) {
+		HeatField* field = chunk.getHeat();
+		uint64_t bricks = chunk.getActiveBricks() | chunk.getWokenBricks();
+
+		if (field == nullptr) {
+			if (MaterialRegistry::getTables().heatSourceCount == 0 || !holdsHeatSource(chunk, bricks))
+				return;
+
+			field = chunk.createHeat();
+		}
+
+		if (!field->scanned) {
+			bricks = ~0ull;
+			field->scanned = true;
+		}
+
+		scanBricks(chunk, *field, bricks);
+	}
+
+	void updateHeat(World& world, Chunk& chunk, uint64_t tick) {
+		HeatField& field = *chunk.getHeat();
+
+		// Fields handed out by World::spreadHeat haven't been scanned yet
+		if (!field.scanned) {
+			scanBricks(chunk, field, ~0ull);
+			field.scanned = true;
+		}
+
+		alignas(32) float padded[HEAT_PADDED_VOLUME];
+		gatherPadded(chunk, padded);
+
+		float* next = field.temperatures[field.current ^ 1];
+		getDiffuseHeatFunction(world.getFallKernel())(padded, next);
+
+		float largest = 0.0f;
+		uint8_t warmFaces = 0;
+		bool changed = false;
+
+		for (int blockY = 0; blockY < HEAT_SIZE; blockY++) {
+			for (int blockZ = 0; blockZ < HEAT_SIZE; blockZ++) {
+				for (int blockX = 0; blockX < HEAT_SIZE; blockX++) {
+					int block = HeatField::index(blockX, blockY, blockZ);
+
+					next[block] += (HEAT_AMBIENT - next[block]) * HEAT_LOSS;
+
+					if (field.sources[block] != MATERIAL_NO_TEMPERATURE)
+						next[block] += (field.sources[block] - next[block]) * HEAT_SOURCE_RATE;
+
+					float temperature = next[block];
+					float deviation = getDeviation(temperature);
+
+					largest = std::max(largest, deviation);
+
+					if (deviation > HEAT_SPREAD_THRESHOLD)
+						warmFaces |= getBlockFaces(blockX, blockY, blockZ);
+
+					if (temperature >= field.heatingPoints[block] || temperature <= field.coolingPoints[block])
+						changed = changeBlock(world, chunk, blockX, blockY, blockZ, temperature, tick) || changed;
+				}
+			}
+		}
+
+		// Changed blocks are scanned again once their bricks have woken up
+		if (changed)
+			chunk.markChanged();
+
+		field.warmFaces = warmFaces;
+		field.settledTicks = field.sourceBlocks == 0 && largest < HEAT_SETTLED ? field.settledTicks + 1 : 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "cell_layout.h"
+#include "fall_kernel.h"
+#include "material.h"
+
+#include <cstdint>
+
+// Faces of a field, see HeatField::warmFaces
+#define HEAT_FACE_NEGATIVE_X 0x01
+#define HEAT_FACE_POSITIVE_X 0x02
+#define HEAT_FACE_NEGATIVE_Y 0x04
+#define HEAT_FACE_POSITIVE_Y 0x08
+#define HEAT_FACE_NEGATIVE_Z 0x10
+#define HEAT_FACE_POSITIVE_Z 0x20
+
+namespace sim {
+	// Offset to the neighbour on each face, in the order of the HEAT_FACE_ flags
+	constexpr int HEAT_FACE_OFFSETS[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+
+	class Chunk;
+	class World;
+
+	// Temperature is kept for blocks of 4x4x4 cells, 8x8x8 of them to a chunk, so a row of blocks is one AVX2
+	// register of floats. A field takes an 8 KiB block where the cells of the chunk take 64 KiB
+	constexpr int HEAT_SHIFT = 2;
+	constexpr int HEAT_BLOCK_SIZE = 1 << HEAT_SHIFT;
+	constexpr int HEAT_SIZE = CHUNK_SIZE >> HEAT_SHIFT;
+	constexpr int HEAT_AREA = HEAT_SIZE * HEAT_SIZE;
+	constexpr int HEAT_VOLUME = HEAT_AREA * HEAT_SIZE;
+
+	// The blocks of a chunk with the neighbouring block on every side, what one diffusion step reads
+	constexpr int HEAT_PADDED_SIZE = HEAT_SIZE + 2;
+	constexpr int HEAT_PADDED_AREA = HEAT_PADDED_SIZE * HEAT_PADDED_SIZE;
+	constexpr int HEAT_PADDED_VOLUME = HEAT_PADDED_AREA * HEAT_PADDED_SIZE;
+
+	// Temperature of every chunk without a field, and of missing chunks
+	constexpr float HEAT_AMBIENT = 20.0f;
+
+	// Share of its temperature a block hands to each of its two neighbours along every axis on one tick
+	constexpr float HEAT_DIFFUSION = 0.125f;
+
+	// Share of the difference to ambient every block loses on one tick, to the air around it. Without it the heat
+	// of a source would end up spread over every chunk it can reach, with it a field fades within a few blocks
+	// of its sources
+	constexpr float HEAT_LOSS = 1.0f / 16.0f;
+
+	// Share of the difference to its source a block makes up on one tick. Heat flowing out keeps small sources
+	// below their own temperature, a lone lava block ends up a good deal cooler than the middle of a pool
+	constexpr float HEAT_SOURCE_RATE = 0.5f;
+
+	// A field with a block on one of its faces further than this from ambient gives the neighbour on that face a
+	// field too
+	constexpr float HEAT_SPREAD_THRESHOLD = 2.0f;
+
+	// A field without sources is freed once every block has stayed within HEAT_SETTLED of ambient for
+	// HEAT_SETTLE_TICKS ticks
+	constexpr float HEAT_SETTLED = 0.5f;
+	constexpr int HEAT_SETTLE_TICKS = 32;
+
+	// Temperatures of a chunk that holds something hot or cold, or sits next to one that does. Blocks in x, z, y
+	// order like cells
+	struct HeatField {
+		// The current temperatures and the next ones. Chunks read the current ones of their neighbours while
+		// they write their own next ones, so fields can be updated in any order on any thread
+		float temperatures[2][HEAT_VOLUME];
+		int current;
+
+		// Temperature each block is held at, the one furthest from ambient of the materials in it, or
+		// MATERIAL_NO_TEMPERATURE. A block that gets a source starts out at its temperature
+		int16_t sources[HEAT_VOLUME];
+
+		// Lowest temperature at which anything in the block melts or ignites, and highest at which anything
+		// freezes. Blocks in between are left alone
+		int16_t heatingPoints[HEAT_VOLUME];
+		int16_t coolingPoints[HEAT_VOLUME];
+
+		// Blocks with a source
+		int sourceBlocks;
+
+		// Cleared for a new field, whose blocks have to be looked at before the first step
+		bool scanned;
+
+		// HEAT_FACE_ flags of the faces of the chunk where the last step left a block far enough from ambient to
+		// spread
+		uint8_t warmFaces;
+
+		// Ticks in a row without sources and with every block close to ambient
+		int settledTicks;
+
+		const float* getTemperatures() const { return temperatures[current]; }
+
+		static int index(int blockX, int blockY, int blockZ) { return blockX + blockZ * HEAT_SIZE + blockY * HEAT_AREA; }
+	};
+
+	// One diffusion step over the blocks of a chunk. Blurs the padded blocks with HEAT_DIFFUSION along x, then z,
+	// then y, which keeps every weight positive however long it runs. The scalar and AVX2 versions give bit
+	// identical results
+	using DiffuseHeatFunction = void(*)(const float* padded, float* outTemperatures);
+
+	void diffuseHeatScalar(const float* padded, float* outTemperatures);
+
+	// Returns nullptr when the build has no AVX2 version
+	DiffuseHeatFunction getDiffuseHeatAVX2();
+
+	// Follows the choice of fall kernel like the liquid kernel, the scalar version unless AVX2 would be used
+	DiffuseHeatFunction getDiffuseHeatFunction(FallKernel kernel);
+
+	// What a cell of the material turns into at the temperature, MATERIAL_NONE if it stays. Catching fire also
+	// depends on the roll, out of 256 against the flammability
+	uint8_t getHeatTransition(uint8_t material, float temperature, uint32_t roll);
+
+	// First phase of the heat of a tick, once every cell has moved. Looks at the materials in the bricks of the
+	// chunk that were awake, and gives the chunk a field if it finds a source and has none. Only touches the
+	// chunk itself, so chunks can be scanned on any thread
+	void scanHeatSources(Chunk& chunk);
+
+	// Second phase, after World::spreadHeat. Takes the field of the chunk one diffusion step further, holds the
+	// blocks with sources at their temperature and turns cells that got hot or cold enough into what they melt,
+	// freeze or burn into. Reads the current temperatures of the neighbours and writes the next ones of the
+	// chunk and its cells, so chunks can be updated on any thread. A compressed chunk is only woken where a
+	// cell would change, it changes once it is expanded
+	void updateHeat(World& world, Chunk& chunk, uint64_t tick);
+}
\ No newline at end of file
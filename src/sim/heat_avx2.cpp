@@ -0,0 +1,59 @@
+#include "heat.h"
+
+// This file is built with AVX2 enabled, nothing in it runs unless the processor was checked first
+#ifdef __AVX2__
+#include <immintrin.h>
+
+namespace {
+	// Blurs three rows of 8 blocks into one. Multiplies and adds in the order of the scalar version, without
+	// fused multiply-add, so both round the same way
+	__m256 blurRows(const float* left, const float* middle, const float* right) {
+		const __m256 sideWeight = _mm256_set1_ps(sim::HEAT_DIFFUSION);
+		const __m256 middleWeight = _mm256_set1_ps(1.0f - 2.0f * sim::HEAT_DIFFUSION);
+
+		__m256 sum = _mm256_add_ps(_mm256_mul_ps(sideWeight, _mm256_loadu_ps(left)), _mm256_mul_ps(middleWeight, _mm256_loadu_ps(middle)));
+
+		return _mm256_add_ps(sum, _mm256_mul_ps(sideWeight, _mm256_loadu_ps(right)));
+	}
+
+	void diffuseHeatAVX2(const float* padded, float* outTemperatures) {
+		alignas(32) float alongX[sim::HEAT_PADDED_AREA * sim::HEAT_SIZE];
+		alignas(32) float alongZ[sim::HEAT_PADDED_SIZE * sim::HEAT_AREA];
+
+		// Along x the neighbours are the same row one float to either side
+		for (int row = 0; row < sim::HEAT_PADDED_AREA; row++) {
+			const float* in = padded + row * sim::HEAT_PADDED_SIZE;
+
+			_mm256_store_ps(alongX + row * sim::HEAT_SIZE, blurRows(in, in + 1, in + 2));
+		}
+
+		for (int y = 0; y < sim::HEAT_PADDED_SIZE; y++) {
+			for (int z = 0; z < sim::HEAT_SIZE; z++) {
+				const float* in = alongX + (y * sim::HEAT_PADDED_SIZE + z) * sim::HEAT_SIZE;
+
+				_mm256_store_ps(alongZ + (y * sim::HEAT_SIZE + z) * sim::HEAT_SIZE, blurRows(in, in + sim::HEAT_SIZE, in + 2 * sim::HEAT_SIZE));
+			}
+		}
+
+		for (int y = 0; y < sim::HEAT_SIZE; y++) {
+			for (int z = 0; z < sim::HEAT_SIZE; z++) {
+				const float* in = alongZ + (y * sim::HEAT_SIZE + z) * sim::HEAT_SIZE;
+
+				_mm256_storeu_ps(outTemperatures + sim::HeatField::index(0, y, z), blurRows(in, in + sim::HEAT_AREA, in + 2 * sim::HEAT_AREA));
+			}
+		}
+	}
+}
+
+namespace sim {
+	DiffuseHeatFunction getDiffuseHeatAVX2() {
+		return diffuseHeatAVX2;
+	}
+}
+#else
+namespace sim {
+	DiffuseHeatFunction getDiffuseHeatAVX2() {
+		return nullptr;
+	}
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace sim {
+	// Integer DDA from one cell to another. Steps one cell along the longest axis at a time and rounds the other
+	// two to the nearest cell, so every step goes to a neighbour, diagonals included
+	class LineWalk {
+	public:
+		LineWalk(int fromX, int fromY, int fromZ, int toX, int toY, int toZ)
+			: mX{ fromX }, mY{ fromY }, mZ{ fromZ }, mFromX{ fromX }, mFromY{ fromY }, mFromZ{ fromZ }, mDeltaX{ toX - fromX }, mDeltaY{ toY - fromY },
+			mDeltaZ{ toZ - fromZ } {
+			mSteps = std::max(std::abs(mDeltaX), std::max(std::abs(mDeltaY), std::abs(mDeltaZ)));
+		}
+
+		// Moves to the next cell of the line, returns false once the last one was reached
+		bool next() {
+			if (mStep == mSteps)
+				return false;
+
+			mStep++;
+
+			mX = mFromX + along(mDeltaX);
+			mY = mFromY + along(mDeltaY);
+			mZ = mFromZ + along(mDeltaZ);
+
+			return true;
+		}
+
+		// The cell the walk is at, the first one until next is called
+		int getX() const { return mX; }
+		int getY() const { return mY; }
+		int getZ() const { return mZ; }
+	private:
+		int mX;
+		int mY;
+		int mZ;
+
+		int mFromX;
+		int mFromY;
+		int mFromZ;
+		int mDeltaX;
+		int mDeltaY;
+		int mDeltaZ;
+
+		int mSteps;
+		int mStep{ 0 };
+
+		// Share of the delta covered after the current step, halves rounded away from zero
+		int along(int delta) const {
+			return (2 * delta * mStep + (delta >= 0 ? mSteps : -mSteps)) / (2 * mSteps);
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "liquid_kernel.h"
+#include "chunk.h"
+#include "../util/cpu.h"
+
+namespace sim {
+	const char* getLiquidModelName(LiquidModel model) {
+		switch (model) {
+		case LIQUID_MODEL_CELLS:
+			return "cells";
+		case LIQUID_MODEL_LEVELS:
+			return "levels";
+		default:
+			return "unknown";
+		}
+	}
+
+	LayerFlow flowLayerScalar(Cell* layer, Cell* below, int rowStride, uint8_t material, uint8_t stamp) {
+		LayerFlow flow{ 0, 0 };
+
+		for (int z = 0; z < BRICK_SIZE; z++) {
+			Cell* row = layer + z * rowStride;
+			Cell* rowBelow = below + z * rowStride;
+
+			for (int x = 0; x < BRICK_SIZE; x++) {
+				bool changed = false;
+
+				flow.filled += flowDown(row[x], rowBelow[x], material, stamp, changed);
+
+				if (changed)
+					flow.changed |= 1ull << (x + z * BRICK_SIZE);
+			}
+		}
+
+		return flow;
+	}
+
+	FlowLayerFunction getFlowLayerFunction(FallKernel kernel) {
+		if (kernel == FALL_KERNEL_SCALAR || kernel == FALL_KERNEL_PER_CELL)
+			return flowLayerScalar;
+
+		FlowLayerFunction avx2 = getFlowLayerAVX2();
+
+		if (avx2 != nullptr && util::cpuSupportsAVX2())
+			return avx2;
+
+		return flowLayerScalar;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "cell.h"
+#include "fall_kernel.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace sim {
+	enum LiquidModel {
+		// A liquid cell is always full and moves like a granular one that also spreads sideways
+		LIQUID_MODEL_CELLS,
+
+		// Liquid cells hold a fill level that flows down, sideways and, under pressure, through full cells until
+		// it settles
+		LIQUID_MODEL_LEVELS
+	};
+
+	const char* getLiquidModelName(LiquidModel model);
+
+	// Units of liquid in a full cell, as many as the level bits hold
+	constexpr int LIQUID_LEVEL_FULL = CELL_LEVEL_MASK >> CELL_LEVEL_SHIFT;
+
+	// Units a cell passes on to each neighbour at most on one tick
+	constexpr int LIQUID_FLOW_BUDGET = LIQUID_LEVEL_FULL;
+
+	// Cells a level looks along the surface in each direction for the lowest one to flow to. Partly filled cells
+	// on the way pass the pressure on, so a surface evens out over this many cells at once instead of one per tick
+	constexpr int LIQUID_REACH = 8;
+
+	// Full cells a surface cell searches through at most for an open cell lower down to push its liquid into.
+	// That is how a column presses liquid up the other side of a U bend
+	constexpr int LIQUID_PRESSURE_REACH = 256;
+
+	// Gas cells hold their density in the same level bits, whatever the liquid model. Gas rises through flowDown
+	// run the other way up, from a cell into the one above it, and spreads sideways like a liquid level. A gas
+	// cell spread this thin turns into air, which is how a plume thins out and its bricks go back to sleep
+	constexpr int GAS_DISSOLVE_LEVEL = 2;
+
+	// Levels are stored as the difference from a full cell, so the clear flags every edit writes make a full cell
+	inline int getLiquidLevel(Cell cell) {
+		return ((cell.flags >> CELL_LEVEL_SHIFT) + LIQUID_LEVEL_FULL) & (CELL_LEVEL_MASK >> CELL_LEVEL_SHIFT);
+	}
+
+	// A level of zero leaves air behind, the other flags stay with the position
+	inline void setLiquidLevel(Cell& cell, uint8_t material, int level) {
+		cell.material = level > 0 ? material : (uint8_t)MATERIAL_AIR;
+		cell.flags = (cell.flags & ~CELL_LEVEL_MASK) | (level > 0 ? ((level - LIQUID_LEVEL_FULL) & (CELL_LEVEL_MASK >> CELL_LEVEL_SHIFT)) << CELL_LEVEL_SHIFT : 0);
+	}
+
+	// Moves liquid from the top cell into the bottom one until that one is full. Gas passes the cells the other
+	// way around, the lower one as top. Each has to be air or hold the material, at least one has to hold it,
+	// neither may wait in an outbox and the top one must not have moved this tick. Returns the change in cells
+	// that aren't air, or 0 with changed left alone if nothing flowed
+	inline int flowDown(Cell& top, Cell& bottom, uint8_t material, uint8_t stamp, bool& changed) {
+		bool topLiquid = top.material == material;
+		bool bottomLiquid = bottom.material == material;
+
+		if (!(topLiquid || top.material == MATERIAL_AIR) || !(bottomLiquid || bottom.material == MATERIAL_AIR) || !(topLiquid || bottomLiquid))
+			return 0;
+
+		if (((top.flags | bottom.flags) & CELL_FLAG_OUTBOX) != 0 || (topLiquid && (top.flags & CELL_FLAG_STAMP) == stamp))
+			return 0;
+
+		int above = topLiquid ? getLiquidLevel(top) : 0;
+		int below = bottomLiquid ? getLiquidLevel(bottom) : 0;
+		int total = above + below;
+		int settled = std::min(std::min(total, LIQUID_LEVEL_FULL), below + LIQUID_FLOW_BUDGET);
+
+		if (settled == below)
+			return 0;
+
+		setLiquidLevel(bottom, material, settled);
+		setLiquidLevel(top, material, total - settled);
+
+		changed = true;
+
+		return (settled > 0 ? 1 : 0) + (total - settled > 0 ? 1 : 0) - (above > 0 ? 1 : 0) - (below > 0 ? 1 : 0);
+	}
+
+	// Result of flowing one 8x8 layer of a brick into the one below it
+	struct LayerFlow {
+		// Bit x + 8 * z set for every column where liquid moved
+		uint64_t changed;
+
+		// Change in cells that aren't air
+		int filled;
+	};
+
+	// Runs flowDown for every column of one 8x8 layer of a brick and the layer below it, laid out like for
+	// FallLayerFunction. The scalar and AVX2 versions give bit identical results
+	using FlowLayerFunction = LayerFlow(*)(Cell* layer, Cell* below, int rowStride, uint8_t material, uint8_t stamp);
+
+	LayerFlow flowLayerScalar(Cell* layer, Cell* below, int rowStride, uint8_t material, uint8_t stamp);
+
+	// Returns nullptr when the build has no AVX2 version
+	FlowLayerFunction getFlowLayerAVX2();
+
+	// Follows the choice of fall kernel: the AVX2 version where that would be used, the scalar one otherwise.
+	// Liquid levels always flow layer by layer, so the per cell choice gets the scalar version too
+	FlowLayerFunction getFlowLayerFunction(FallKernel kernel);
+}
\ No newline at end of file
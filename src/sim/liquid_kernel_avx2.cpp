@@ -0,0 +1,128 @@
+#include "liquid_kernel.h"
+#include "chunk.h"
+#include "../util/bits.h"
+
+#include <cstddef>
+
+// This file is built with AVX2 enabled, nothing in it runs unless the processor was checked first
+#ifdef __AVX2__
+#include <immintrin.h>
+
+namespace {
+	// Two rows of a brick layer, 8 cells each, as one register
+	__m256i loadRows(const sim::Cell* row, int rowStride) {
+		__m128i low = _mm_loadu_si128((const __m128i*)row);
+		__m128i high = _mm_loadu_si128((const __m128i*)(row + rowStride));
+
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+	}
+
+	void storeRows(sim::Cell* row, int rowStride, __m256i rows) {
+		_mm_storeu_si128((__m128i*)row, _mm256_castsi256_si128(rows));
+		_mm_storeu_si128((__m128i*)(row + rowStride), _mm256_extracti128_si256(rows, 1));
+	}
+
+	// Where the level starts in a lane, the flags being the high byte
+	const int LEVEL_SHIFT = 8 + CELL_LEVEL_SHIFT;
+
+	// One bit per lane of a 16 bit mask, the first row in bits 0-7 and the second in bits 16-23
+	uint32_t laneBits(__m256i mask) {
+		return (uint32_t)_mm256_movemask_epi8(_mm256_packs_epi16(mask, _mm256_setzero_si256()));
+	}
+
+	int countLanes(__m256i mask) {
+		return util::popCount(laneBits(mask));
+	}
+
+	sim::LayerFlow flowLayerAVX2(sim::Cell* layer, sim::Cell* below, int rowStride, uint8_t material, uint8_t stamp) {
+		static_assert(sizeof(sim::Cell) == 2 && offsetof(sim::Cell, material) == 0, "Lanes expect the material in the low byte");
+
+		// Each 16 bit lane is one cell, material in the low byte and flags in the high byte, the level in its top bits
+		const __m256i materialMask = _mm256_set1_epi16(0x00FF);
+		const __m256i materialValue = _mm256_set1_epi16(material);
+		const __m256i airValue = _mm256_set1_epi16(sim::MATERIAL_AIR);
+		const __m256i stampMask = _mm256_set1_epi16((short)(CELL_FLAG_STAMP << 8));
+		const __m256i stampValue = _mm256_set1_epi16((short)(stamp << 8));
+		const __m256i outboxMask = _mm256_set1_epi16((short)(CELL_FLAG_OUTBOX << 8));
+		const __m256i keepFlags = _mm256_set1_epi16((short)((0xFF & ~CELL_LEVEL_MASK) << 8));
+		const __m256i levelMask = _mm256_set1_epi16(CELL_LEVEL_MASK >> CELL_LEVEL_SHIFT);
+		const __m256i full = _mm256_set1_epi16(sim::LIQUID_LEVEL_FULL);
+		const __m256i budget = _mm256_set1_epi16(sim::LIQUID_FLOW_BUDGET);
+		const __m256i zero = _mm256_setzero_si256();
+
+		sim::LayerFlow flow{ 0, 0 };
+
+		for (int z = 0; z < sim::BRICK_SIZE; z += 2) {
+			sim::Cell* rows = layer + z * rowStride;
+			sim::Cell* rowsBelow = below + z * rowStride;
+
+			__m256i tops = loadRows(rows, rowStride);
+			__m256i bottoms = loadRows(rowsBelow, rowStride);
+
+			__m256i topLiquid = _mm256_cmpeq_epi16(_mm256_and_si256(tops, materialMask), materialValue);
+			__m256i bottomLiquid = _mm256_cmpeq_epi16(_mm256_and_si256(bottoms, materialMask), materialValue);
+			__m256i topAir = _mm256_cmpeq_epi16(_mm256_and_si256(tops, materialMask), airValue);
+			__m256i bottomAir = _mm256_cmpeq_epi16(_mm256_and_si256(bottoms, materialMask), airValue);
+
+			__m256i eligible = _mm256_and_si256(_mm256_or_si256(topLiquid, topAir), _mm256_or_si256(bottomLiquid, bottomAir));
+			eligible = _mm256_and_si256(eligible, _mm256_or_si256(topLiquid, bottomLiquid));
+
+			__m256i waiting = _mm256_and_si256(_mm256_or_si256(tops, bottoms), outboxMask);
+			__m256i moved = _mm256_and_si256(topLiquid, _mm256_cmpeq_epi16(_mm256_and_si256(tops, stampMask), stampValue));
+			eligible = _mm256_andnot_si256(moved, _mm256_and_si256(eligible, _mm256_cmpeq_epi16(waiting, zero)));
+
+			if (_mm256_testz_si256(eligible, eligible))
+				continue;
+
+			__m256i above = _mm256_and_si256(_mm256_and_si256(_mm256_add_epi16(_mm256_srli_epi16(tops, LEVEL_SHIFT), full), levelMask), topLiquid);
+			__m256i under = _mm256_and_si256(_mm256_and_si256(_mm256_add_epi16(_mm256_srli_epi16(bottoms, LEVEL_SHIFT), full), levelMask), bottomLiquid);
+			__m256i total = _mm256_add_epi16(above, under);
+
+			__m256i settled = _mm256_min_epi16(_mm256_min_epi16(total, full), _mm256_add_epi16(under, budget));
+
+			__m256i changed = _mm256_andnot_si256(_mm256_cmpeq_epi16(settled, under), eligible);
+
+			if (_mm256_testz_si256(changed, changed))
+				continue;
+
+			__m256i rest = _mm256_sub_epi16(total, settled);
+			__m256i settledFilled = _mm256_cmpgt_epi16(settled, zero);
+			__m256i restFilled = _mm256_cmpgt_epi16(rest, zero);
+
+			// Filled cells get the material and the level, emptied ones become air, both keep their other flags
+			__m256i newBottoms = _mm256_and_si256(bottoms, keepFlags);
+			newBottoms = _mm256_or_si256(newBottoms, _mm256_and_si256(settledFilled,
+				_mm256_or_si256(materialValue, _mm256_slli_epi16(_mm256_and_si256(_mm256_sub_epi16(settled, full), levelMask), LEVEL_SHIFT))));
+
+			__m256i newTops = _mm256_and_si256(tops, keepFlags);
+			newTops = _mm256_or_si256(newTops, _mm256_and_si256(restFilled,
+				_mm256_or_si256(materialValue, _mm256_slli_epi16(_mm256_and_si256(_mm256_sub_epi16(rest, full), levelMask), LEVEL_SHIFT))));
+
+			storeRows(rows, rowStride, _mm256_blendv_epi8(tops, newTops, changed));
+			storeRows(rowsBelow, rowStride, _mm256_blendv_epi8(bottoms, newBottoms, changed));
+
+			flow.filled += countLanes(_mm256_and_si256(changed, settledFilled)) + countLanes(_mm256_and_si256(changed, restFilled))
+				- countLanes(_mm256_and_si256(changed, topLiquid)) - countLanes(_mm256_and_si256(changed, bottomLiquid));
+
+			uint32_t bits = laneBits(changed);
+
+			flow.changed |= (uint64_t)(bits & 0xFF) << (z * sim::BRICK_SIZE);
+			flow.changed |= (uint64_t)((bits >> 16) & 0xFF) << ((z + 1) * sim::BRICK_SIZE);
+		}
+
+		return flow;
+	}
+}
+
+namespace sim {
+	FlowLayerFunction getFlowLayerAVX2() {
+		return flowLayerAVX2;
+	}
+}
+#else
+namespace sim {
+	FlowLayerFunction getFlowLayerAVX2() {
+		return nullptr;
+	}
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,379 @@
+#include "margolus.h"
+#include "rules.h"
+#include "random.h"
+#include "../util/bits.h"
+
+#include <utility>
+
+namespace {
+	const uint32_t CLASS_GAS = 0;
+	const uint32_t CLASS_LIQUID = 1;
+	const uint32_t CLASS_GRANULAR = 2;
+
+	// Bricks on the low x and z faces of a chunk, bricks follow the x, z, y order of cells
+	const uint64_t LOW_X_BRICKS = 0x1111111111111111ull;
+	const uint64_t LOW_Z_BRICKS = 0x000F000F000F000Full;
+
+	// Blocks that are all one state never change, whichever way they are mirrored
+	bool isUniformKey(uint32_t key) {
+		return key == 0 || key == 0x5555 || key == 0xAAAA || key == 0xFFFF;
+	}
+
+	// One step of the rules for a block of classes, see MargolusTable
+	uint32_t buildTransition(uint32_t key) {
+		uint32_t classes[sim::MARGOLUS_BLOCK_CELLS];
+		int sources[sim::MARGOLUS_BLOCK_CELLS];
+		bool moved[sim::MARGOLUS_BLOCK_CELLS];
+
+		for (int i = 0; i < sim::MARGOLUS_BLOCK_CELLS; i++) {
+			classes[i] = (key >> (i * 2)) & 3;
+			sources[i] = i;
+			moved[i] = false;
+		}
+
+		auto isLoose = [&](int cell) { return classes[cell] == CLASS_GRANULAR || classes[cell] == CLASS_LIQUID; };
+		auto canDisplace = [&](int mover, int target) { return classes[target] != sim::MargolusTable::CLASS_SOLID && classes[target] < classes[mover]; };
+
+		auto swap = [&](int a, int b) {
+			std::swap(classes[a], classes[b]);
+			std::swap(sources[a], sources[b]);
+			moved[a] = true;
+			moved[b] = true;
+		};
+
+		// Columns of the block, the top cell is four slots above the bottom one
+		for (int column = 0; column < 4; column++) {
+			if (isLoose(column + 4) && canDisplace(column + 4, column))
+				swap(column + 4, column);
+		}
+
+		// Slides down along x, then z, then both, only past a column that is open at the top as well
+		for (int column = 0; column < 4; column++) {
+			int top = column + 4;
+
+			if (moved[top] || !isLoose(top))
+				continue;
+
+			for (int side = 1; side < 4; side++) {
+				int below = column ^ side;
+
+				if (!moved[below] && canDisplace(top, below) && canDisplace(top, below + 4)) {
+					swap(top, below);
+					break;
+				}
+			}
+		}
+
+		// Liquids that are left spread sideways into gas
+		for (int cell = 0; cell < sim::MARGOLUS_BLOCK_CELLS; cell++) {
+			if (moved[cell] || classes[cell] != CLASS_LIQUID)
+				continue;
+
+			for (int side = 1; side < 3; side++) {
+				int target = cell ^ side;
+
+				if (!moved[target] && classes[target] == CLASS_GAS) {
+					swap(cell, target);
+					break;
+				}
+			}
+		}
+
+		uint32_t transition = 0;
+		uint32_t swapped = 0;
+
+		for (int i = 0; i < sim::MARGOLUS_BLOCK_CELLS; i++) {
+			transition |= (uint32_t)sources[i] << (i * 3);
+			swapped += sources[i] != i ? 1 : 0;
+		}
+
+		// A cell only ever swaps once, count it as one move like the scan order does
+		return transition | ((swapped / 2) << 24);
+	}
+
+	// Updates the blocks whose lowest corner is in the chunk. With odd offsets the blocks on the high faces reach
+	// one cell into the neighbours, and the cells on the low faces belong to the blocks of the neighbours
+	struct MargolusUpdater {
+		sim::Chunk& chunk;
+		sim::Cell* cells;
+
+		int baseX;
+		int baseY;
+		int baseZ;
+
+		uint64_t seed;
+		uint64_t tick;
+
+		// 0 or 1 along every axis, flips every tick
+		int offset;
+
+		const sim::MargolusTable& table;
+
+		uint64_t localWakes;
+		bool brickMoved;
+		uint64_t cellsMoved;
+
+		static bool isInside(int x, int y, int z) {
+			return (unsigned)x < sim::CHUNK_SIZE && (unsigned)y < sim::CHUNK_SIZE && (unsigned)z < sim::CHUNK_SIZE;
+		}
+
+		sim::Chunk* neighbourChunk(int x, int y, int z) {
+			return chunk.getNeighbour(x >> sim::CHUNK_SHIFT, y >> sim::CHUNK_SHIFT, z >> sim::CHUNK_SHIFT);
+		}
+
+		// Position relative to this chunk, may be up to one chunk outside of it
+		void wakeBrick(int x, int y, int z) {
+			if (isInside(x, y, z)) {
+				localWakes |= 1ull << sim::Chunk::brickIndex(x, y, z);
+				return;
+			}
+
+			sim::Chunk* other = neighbourChunk(x, y, z);
+
+			if (other != nullptr)
+				other->wakeBricks(1ull << sim::Chunk::brickIndex(x & sim::CHUNK_MASK, y & sim::CHUNK_MASK, z & sim::CHUNK_MASK));
+		}
+
+		// Every brick next to a cell of the block. The block and its neighbours span four cells along each
+		// axis, so they touch at most two bricks along each and the corners reach all of them
+		void wakeBlock(int x, int y, int z) {
+			for (int i = 0; i < 8; i++) {
+				wakeBrick(x + ((i & 1) ? 2 : -1), y + ((i & 2) ? 2 : -1), z + ((i & 4) ? 2 : -1));
+			}
+		}
+
+		// Mirrors the block along x with bit 0 and along z with bit 1, slots of the table are xored with it
+		uint32_t getMirror(int x, int y, int z) {
+			return sim::randomForCell(seed, tick, baseX + x, baseY + y, baseZ + z, sim::RANDOM_SALT_BLOCK) & 3;
+		}
+
+		static int slotX(int slot) { return slot & 1; }
+		static int slotZ(int slot) { return (slot >> 1) & 1; }
+		static int slotY(int slot) { return slot >> 2; }
+
+		void updateBlock(int x, int y, int z) {
+			int indices[sim::MARGOLUS_BLOCK_CELLS];
+			uint32_t physicalKey = 0;
+
+			for (int slot = 0; slot < sim::MARGOLUS_BLOCK_CELLS; slot++) {
+				indices[slot] = sim::Chunk::index(x + slotX(slot), y + slotY(slot), z + slotZ(slot));
+				physicalKey |= sim::MargolusTable::getCellClass(cells[indices[slot]].material) << (slot * 2);
+			}
+
+			if (isUniformKey(physicalKey))
+				return;
+
+			uint32_t mirror = getMirror(x, y, z);
+			uint32_t key = 0;
+
+			for (int slot = 0; slot < sim::MARGOLUS_BLOCK_CELLS; slot++) {
+				key |= ((physicalKey >> ((slot ^ mirror) * 2)) & 3) << (slot * 2);
+			}
+
+			uint32_t transition = table.getTransition(key);
+
+			if (transition == sim::MARGOLUS_IDENTITY)
+				return;
+
+			sim::Cell block[sim::MARGOLUS_BLOCK_CELLS];
+
+			for (int slot = 0; slot < sim::MARGOLUS_BLOCK_CELLS; slot++) {
+				block[slot] = cells[indices[slot ^ mirror]];
+			}
+
+			for (int slot = 0; slot < sim::MARGOLUS_BLOCK_CELLS; slot++) {
+				cells[indices[slot ^ mirror]] = block[(transition >> (slot * 3)) & 7];
+			}
+
+			cellsMoved += transition >> 24;
+			brickMoved = true;
+
+			wakeBlock(x, y, z);
+		}
+
+		// A block on the high faces, some of its cells are in neighbouring chunks. Cells of missing and
+		// compressed chunks count as solid, so they are never written
+		void updateEdgeBlock(int x, int y, int z) {
+			sim::Cell* blockCells[sim::MARGOLUS_BLOCK_CELLS];
+			sim::Chunk* owners[sim::MARGOLUS_BLOCK_CELLS];
+
+			uint32_t mirror = getMirror(x, y, z);
+			uint32_t key = 0;
+
+			for (int slot = 0; slot < sim::MARGOLUS_BLOCK_CELLS; slot++) {
+				int physical = slot ^ mirror;
+				int cellX = x + slotX(physical);
+				int cellY = y + slotY(physical);
+				int cellZ = z + slotZ(physical);
+
+				sim::Chunk* owner = isInside(cellX, cellY, cellZ) ? &chunk : neighbourChunk(cellX, cellY, cellZ);
+
+				if (owner == nullptr || !owner->isDense()) {
+					blockCells[slot] = nullptr;
+					owners[slot] = nullptr;
+					key |= sim::MargolusTable::CLASS_SOLID << (slot * 2);
+					continue;
+				}
+
+				blockCells[slot] = &owner->at(cellX & sim::CHUNK_MASK, cellY & sim::CHUNK_MASK, cellZ & sim::CHUNK_MASK);
+				owners[slot] = owner;
+				key |= sim::MargolusTable::getCellClass(blockCells[slot]->material) << (slot * 2);
+			}
+
+			uint32_t transition = table.getTransition(key);
+
+			if (transition == sim::MARGOLUS_IDENTITY)
+				return;
+
+			sim::Cell block[sim::MARGOLUS_BLOCK_CELLS]{};
+
+			for (int slot = 0; slot < sim::MARGOLUS_BLOCK_CELLS; slot++) {
+				if (blockCells[slot] != nullptr)
+					block[slot] = *blockCells[slot];
+			}
+
+			// Solid cells never move, so only cells that can be written are ever written or read from
+			for (int slot = 0; slot < sim::MARGOLUS_BLOCK_CELLS; slot++) {
+				int source = (transition >> (slot * 3)) & 7;
+
+				if (source == slot)
+					continue;
+
+				sim::Cell moved = block[source];
+
+				if (owners[slot] != &chunk) {
+					// Moves across a chunk face change how many filled cells each side holds
+					int filled = (moved.material != sim::MATERIAL_AIR ? 1 : 0) - (blockCells[slot]->material != sim::MATERIAL_AIR ? 1 : 0);
+
+					if (filled != 0) {
+						owners[slot]->addFilledCells(filled);
+						chunk.addFilledCells(-filled);
+					}
+
+					owners[slot]->markChanged();
+				}
+
+				*blockCells[slot] = moved;
+			}
+
+			cellsMoved += transition >> 24;
+			brickMoved = true;
+
+			wakeBlock(x, y, z);
+		}
+
+		sim::TickStats run() {
+			sim::TickStats stats;
+
+			// Every chunk began the tick before any of them ran, see World::tick
+			uint64_t activeBricks = chunk.getActiveBricks();
+
+			// Blocks of odd ticks that start in a brick cover the bricks above it along each axis as well, so the
+			// bricks below active ones are updated too
+			uint64_t bricks = activeBricks;
+			bricks |= (bricks & ~LOW_X_BRICKS) >> 1;
+			bricks |= (bricks & ~LOW_Z_BRICKS) >> 4;
+			bricks |= bricks >> 16;
+
+			for (uint64_t remaining = bricks; remaining != 0; remaining &= remaining - 1) {
+				int brick = util::countTrailingZeros(remaining);
+
+				int startX = (brick & 3) << sim::BRICK_SHIFT;
+				int startZ = ((brick >> 2) & 3) << sim::BRICK_SHIFT;
+				int startY = (brick >> 4) << sim::BRICK_SHIFT;
+
+				// The same goes for the chunks below, which only find out next tick
+				if ((activeBricks >> brick) & 1) {
+					for (int i = 1; i < 8; i++) {
+						int x = startX - (i & 1);
+						int y = startY - ((i >> 1) & 1);
+						int z = startZ - ((i >> 2) & 1);
+
+						if (!isInside(x, y, z))
+							wakeBrick(x, y, z);
+					}
+				}
+
+				brickMoved = false;
+
+				int endX = startX + sim::BRICK_SIZE;
+				int endY = startY + sim::BRICK_SIZE;
+				int endZ = startZ + sim::BRICK_SIZE;
+
+				for (int y = startY + offset; y < endY; y += 2) {
+					for (int z = startZ + offset; z < endZ; z += 2) {
+						for (int x = startX + offset; x < endX; x += 2) {
+							if (x < sim::CHUNK_MASK && y < sim::CHUNK_MASK && z < sim::CHUNK_MASK) {
+								updateBlock(x, y, z);
+							}
+							else {
+								updateEdgeBlock(x, y, z);
+							}
+						}
+					}
+				}
+
+				// Bricks that are only along for the blocks reaching into them don't keep themselves awake
+				if ((activeBricks >> brick) & 1)
+					chunk.endBrick(brick, brickMoved);
+
+				stats.bricksUpdated++;
+			}
+
+			if (localWakes != 0)
+				chunk.wakeBricks(localWakes);
+
+			if (cellsMoved != 0)
+				chunk.markChanged();
+
+			stats.cellsUpdated = stats.bricksUpdated * sim::BRICK_VOLUME;
+			stats.cellsMoved = cellsMoved;
+
+			return stats;
+		}
+	};
+}
+
+namespace sim {
+	const char* getRuleExecutorName(RuleExecutor executor) {
+		switch (executor) {
+		case RULE_EXECUTOR_SCAN:
+			return "scan";
+		case RULE_EXECUTOR_MARGOLUS:
+			return "margolus";
+		default:
+			return "unknown";
+		}
+	}
+
+	const MargolusTable& MargolusTable::get() {
+		// Built by whichever thread gets here first, the others wait for it
+		static const MargolusTable* table = new MargolusTable();
+		return *table;
+	}
+
+	MargolusTable::MargolusTable() {
+		for (uint32_t key = 0; key < MARGOLUS_BLOCK_KEYS; key++) {
+			mTransitions[key] = buildTransition(key);
+		}
+	}
+
+	TickStats updateChunkMargolus(World& world, Chunk& chunk, uint64_t tick) {
+		MargolusUpdater updater{
+			chunk,
+			chunk.getCells(),
+			chunk.getX() * CHUNK_SIZE,
+			chunk.getY() * CHUNK_SIZE,
+			chunk.getZ() * CHUNK_SIZE,
+			world.getSeed(),
+			tick,
+			(int)(tick & 1),
+			MargolusTable::get(),
+			0,
+			false,
+			0
+		};
+
+		return updater.run();
+	}
+}
\ No newline at end of file
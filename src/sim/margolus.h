@@ -0,0 +1,54 @@
+#pragma once
+
+#include "cell.h"
+
+#include <cstdint>
+
+namespace sim {
+	enum RuleExecutor {
+		// Cells are visited one at a time, bottom up, each moving into whatever its neighbours hold right then
+		RULE_EXECUTOR_SCAN,
+
+		// The world is cut into 2x2x2 blocks that are each rearranged at once, see MargolusTable
+		RULE_EXECUTOR_MARGOLUS
+	};
+
+	const char* getRuleExecutorName(RuleExecutor executor);
+
+	// Cells of a block in x, z, y order, the bottom layer first
+	constexpr int MARGOLUS_BLOCK_CELLS = 8;
+
+	// Every cell of a block is reduced to its state, two bits each, which makes 4^8 possible blocks
+	constexpr int MARGOLUS_BLOCK_KEYS = 1 << (MARGOLUS_BLOCK_CELLS * 2);
+
+	// Where each cell of a block comes from after one step, three bits per cell, and the number of swaps in the
+	// top byte. Blocks that don't change map to MARGOLUS_IDENTITY
+	constexpr uint32_t MARGOLUS_IDENTITY = 0 | (1 << 3) | (2 << 6) | (3 << 9) | (4 << 12) | (5 << 15) | (6 << 18) | (7 << 21);
+
+	// The Margolus neighbourhood. Blocks start on even coordinates on even ticks and on odd ones on odd ticks,
+	// so a cell shares its block with different neighbours every other tick. Within a tick blocks never
+	// overlap, so they can be updated in any order on any thread with the same result.
+	//
+	// Every block is looked up in a table built once from the same rules as the scan order: granular and liquid
+	// cells fall, then slide down diagonally, then liquids spread sideways. The result is always a permutation
+	// of the block, so nothing is created or lost. The rules are written for one orientation; blocks are mirrored
+	// along x and z at random before the lookup so none of the directions is favoured
+	class MargolusTable {
+	public:
+		static const MargolusTable& get();
+
+		uint32_t getTransition(uint32_t key) const { return mTransitions[key]; }
+
+		// Cell state as used in the keys, solid also stands for cells the block can't write to
+		static uint32_t getCellClass(uint8_t material) { return CLASS_OF_STATE[getMaterialState(material)]; }
+
+		static constexpr uint32_t CLASS_SOLID = 3;
+	private:
+		// Ordered like the densities of the states, so a cell can displace any class below its own except solid
+		static constexpr uint32_t CLASS_OF_STATE[MATERIAL_STATE_COUNT] = { 0, CLASS_SOLID, 2, 1 };
+
+		uint32_t mTransitions[MARGOLUS_BLOCK_KEYS];
+
+		MargolusTable();
+	};
+}
\ No newline at end of file
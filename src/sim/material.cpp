@@ -0,0 +1,323 @@
+#include "material.h"
+#include "../util/debug.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+	const sim::MaterialInfo BUILTIN_MATERIALS[sim::MATERIAL_BUILTIN_COUNT] = {
+		{ "air", sim::MATERIAL_STATE_GAS, 0, 0, 0, sim::MATERIAL_NEVER_MELTS, sim::MATERIAL_NONE, sim::MATERIAL_NEVER_FREEZES, sim::MATERIAL_NONE, sim::MATERIAL_NEVER_MELTS, sim::MATERIAL_NONE, sim::MATERIAL_NO_TEMPERATURE, 0x00000000, {} },
+		{ "stone", sim::MATERIAL_STATE_SOLID, 4, 0, 0, sim::MATERIAL_NEVER_MELTS, sim::MATERIAL_NONE, sim::MATERIAL_NEVER_FREEZES, sim::MATERIAL_NONE, sim::MATERIAL_NEVER_MELTS, sim::MATERIAL_NONE, sim::MATERIAL_NO_TEMPERATURE, 0xFF808080, {} },
+		{ "sand", sim::MATERIAL_STATE_GRANULAR, 3, 0, 0, sim::MATERIAL_NEVER_MELTS, sim::MATERIAL_NONE, sim::MATERIAL_NEVER_FREEZES, sim::MATERIAL_NONE, sim::MATERIAL_NEVER_MELTS, sim::MATERIAL_NONE, sim::MATERIAL_NO_TEMPERATURE, 0xFF80B2C2, {} },
+		{ "water", sim::MATERIAL_STATE_LIQUID, 2, 0, 0, sim::MATERIAL_NEVER_MELTS, sim::MATERIAL_NONE, sim::MATERIAL_NEVER_FREEZES, sim::MATERIAL_NONE, sim::MATERIAL_NEVER_MELTS, sim::MATERIAL_NONE, sim::MATERIAL_NO_TEMPERATURE, 0xA0C85A28, {} }
+	};
+
+	// What a material named before it is described starts out as
+	const sim::MaterialInfo UNDESCRIBED_MATERIAL = { "", sim::MATERIAL_STATE_GAS, 0, 0, 0, sim::MATERIAL_NEVER_MELTS, sim::MATERIAL_NONE, sim::MATERIAL_NEVER_FREEZES, sim::MATERIAL_NONE, sim::MATERIAL_NEVER_MELTS, sim::MATERIAL_NONE, sim::MATERIAL_NO_TEMPERATURE, 0, {} };
+
+	const char* STATE_NAMES[sim::MATERIAL_STATE_COUNT] = { "gas", "solid", "granular", "liquid" };
+
+	std::vector<sim::MaterialInfo> getBuiltinMaterials() {
+		return std::vector<sim::MaterialInfo>(BUILTIN_MATERIALS, BUILTIN_MATERIALS + sim::MATERIAL_BUILTIN_COUNT);
+	}
+
+	sim::MaterialTables buildTables(const std::vector<sim::MaterialInfo>& infos) {
+		sim::MaterialTables tables{};
+
+		for (int i = 0; i < 256; i++) {
+			tables.meltingPoints[i] = sim::MATERIAL_NEVER_MELTS;
+			tables.meltsInto[i] = sim::MATERIAL_NONE;
+			tables.freezingPoints[i] = sim::MATERIAL_NEVER_FREEZES;
+			tables.freezesInto[i] = sim::MATERIAL_NONE;
+			tables.ignitionPoints[i] = sim::MATERIAL_NEVER_MELTS;
+			tables.burnsInto[i] = sim::MATERIAL_NONE;
+			tables.temperatures[i] = sim::MATERIAL_NO_TEMPERATURE;
+		}
+
+		for (size_t material = 0; material < infos.size(); material++) {
+			const sim::MaterialInfo& info = infos[material];
+
+			tables.states[material] = info.state;
+			tables.densities[material] = info.density;
+			tables.resistances[material] = info.state == sim::MATERIAL_STATE_SOLID ? 0xFF : info.density;
+			tables.viscosities[material] = info.viscosity;
+			tables.flammabilities[material] = info.flammability;
+			tables.meltingPoints[material] = info.meltingPoint;
+			tables.meltsInto[material] = info.meltsInto;
+			tables.freezingPoints[material] = info.freezingPoint;
+			tables.freezesInto[material] = info.freezesInto;
+			tables.ignitionPoints[material] = info.ignitionPoint;
+			tables.burnsInto[material] = info.burnsInto;
+			tables.temperatures[material] = info.temperature;
+			tables.colours[material] = info.colour;
+
+			tables.firstReactions[material] = (uint16_t)tables.reactions.size();
+			tables.reactionCounts[material] = (uint8_t)info.reactions.size();
+			tables.reactions.insert(tables.reactions.end(), info.reactions.begin(), info.reactions.end());
+
+			if (info.state == sim::MATERIAL_STATE_GRANULAR)
+				tables.granularMaterials[tables.granularCount++] = (uint8_t)material;
+
+			if (info.state == sim::MATERIAL_STATE_LIQUID)
+				tables.liquidMaterials[tables.liquidCount++] = (uint8_t)material;
+
+			// Air is the absence of gas
+			if (info.state == sim::MATERIAL_STATE_GAS && material != sim::MATERIAL_AIR)
+				tables.gasMaterials[tables.gasCount++] = (uint8_t)material;
+
+			if (info.temperature != sim::MATERIAL_NO_TEMPERATURE)
+				tables.heatSourceCount++;
+		}
+
+		return tables;
+	}
+
+	bool parseFailed(const char* filename, int lineNumber, const std::string& line, const std::string& reason) {
+		util::displayMessage(std::string(filename) + ":" + std::to_string(lineNumber) + ": " + reason + " in '" + line + "'", DISPLAY_TYPE_ERR);
+
+		return false;
+	}
+
+	// Reads a whole number within 0 to max from the stream
+	bool readValue(std::istringstream& stream, int max, int& outValue) {
+		return (stream >> outValue) && outValue >= 0 && outValue <= max;
+	}
+
+	// Materials named in a file that aren't described yet are added as placeholders, described must be set for
+	// every one of them by the end of the file
+	class MaterialFileParser {
+	public:
+		std::vector<sim::MaterialInfo> infos = getBuiltinMaterials();
+		std::vector<bool> described = std::vector<bool>(sim::MATERIAL_BUILTIN_COUNT, true);
+
+		// Returns false once every id is taken
+		bool getMaterial(const std::string& name, uint8_t& outMaterial) {
+			for (size_t i = 0; i < infos.size(); i++) {
+				if (infos[i].name == name) {
+					outMaterial = (uint8_t)i;
+					return true;
+				}
+			}
+
+			if (infos.size() >= sim::MATERIAL_MAX_COUNT)
+				return false;
+
+			outMaterial = (uint8_t)infos.size();
+
+			infos.push_back(UNDESCRIBED_MATERIAL);
+			infos.back().name = name;
+			described.push_back(false);
+
+			return true;
+		}
+	};
+}
+
+namespace sim {
+	std::vector<MaterialInfo> MaterialRegistry::sInfos = getBuiltinMaterials();
+	MaterialTables MaterialRegistry::sTables = buildTables(sInfos);
+
+	bool MaterialRegistry::loadFromFile(const char* filename) {
+		std::ifstream file(filename);
+
+		if (!file.is_open()) {
+			util::displayMessage(std::string("File not found: ") + filename, DISPLAY_TYPE_ERR);
+			return false;
+		}
+
+		MaterialFileParser parser;
+		MaterialInfo* info = nullptr;
+
+		std::string line;
+		int lineNumber = 0;
+
+		while (std::getline(file, line)) {
+			lineNumber++;
+
+			// Strip comments
+			std::string content = line.substr(0, line.find('#'));
+
+			std::istringstream stream(content);
+
+			std::string command;
+			if (!(stream >> command))
+				continue;
+
+			if (command == "material") {
+				std::string name;
+				std::string stateName;
+				uint8_t material;
+
+				if (!(stream >> name >> stateName))
+					return parseFailed(filename, lineNumber, line, "Expected a name and a state");
+
+				if (!parser.getMaterial(name, material))
+					return parseFailed(filename, lineNumber, line, "Too many materials");
+
+				if (parser.described[material] && material >= MATERIAL_BUILTIN_COUNT)
+					return parseFailed(filename, lineNumber, line, "Material '" + name + "' is described twice");
+
+				int state = 0;
+
+				while (state < MATERIAL_STATE_COUNT && stateName != STATE_NAMES[state]) {
+					state++;
+				}
+
+				if (state == MATERIAL_STATE_COUNT)
+					return parseFailed(filename, lineNumber, line, "Unknown state '" + stateName + "'");
+
+				// Air fills every empty cell, the rules rely on it never moving
+				if (material == MATERIAL_AIR && state != MATERIAL_STATE_GAS)
+					return parseFailed(filename, lineNumber, line, "Air has to stay a gas");
+
+				info = &parser.infos[material];
+				info->state = (MaterialState)state;
+				info->reactions.clear();
+
+				parser.described[material] = true;
+				continue;
+			}
+
+			if (info == nullptr)
+				return parseFailed(filename, lineNumber, line, "Expected a material first");
+
+			if (command == "density" || command == "viscosity" || command == "flammability") {
+				int value;
+
+				if (!readValue(stream, 255, value))
+					return parseFailed(filename, lineNumber, line, "Expected a value from 0 to 255");
+
+				if (command == "density") {
+					info->density = (uint8_t)value;
+				}
+				else if (command == "viscosity") {
+					info->viscosity = (uint8_t)value;
+				}
+				else {
+					info->flammability = (uint8_t)value;
+				}
+			}
+			else if (command == "colour") {
+				int red;
+				int green;
+				int blue;
+				int alpha;
+
+				if (!readValue(stream, 255, red) || !readValue(stream, 255, green) || !readValue(stream, 255, blue))
+					return parseFailed(filename, lineNumber, line, "Expected red, green and blue from 0 to 255");
+
+				// Alpha is optional, colours are opaque without it
+				if (!(stream >> alpha)) {
+					if (!stream.eof())
+						return parseFailed(filename, lineNumber, line, "Expected an alpha from 0 to 255");
+
+					alpha = 255;
+				}
+				else if (alpha < 0 || alpha > 255) {
+					return parseFailed(filename, lineNumber, line, "Expected an alpha from 0 to 255");
+				}
+
+				info->colour = (uint32_t)red | ((uint32_t)green << 8) | ((uint32_t)blue << 16) | ((uint32_t)alpha << 24);
+			}
+			else if (command == "melts" || command == "boils" || command == "freezes" || command == "condenses" || command == "ignites") {
+				int temperature;
+				std::string resultName;
+
+				// Placeholders can move the vector, so the material is looked up again afterwards
+				size_t material = info - parser.infos.data();
+				uint8_t result;
+
+				// The limits of int16_t stand for never
+				if (!(stream >> temperature >> resultName) || temperature <= INT16_MIN || temperature >= INT16_MAX)
+					return parseFailed(filename, lineNumber, line, "Expected a temperature and a material");
+
+				if (!parser.getMaterial(resultName, result))
+					return parseFailed(filename, lineNumber, line, "Too many materials");
+
+				info = &parser.infos[material];
+
+				if (command == "melts" || command == "boils") {
+					info->meltingPoint = (int16_t)temperature;
+					info->meltsInto = result;
+				}
+				else if (command == "ignites") {
+					info->ignitionPoint = (int16_t)temperature;
+					info->burnsInto = result;
+				}
+				else {
+					info->freezingPoint = (int16_t)temperature;
+					info->freezesInto = result;
+				}
+			}
+			else if (command == "temperature") {
+				int temperature;
+
+				if (!(stream >> temperature) || temperature <= INT16_MIN || temperature > INT16_MAX)
+					return parseFailed(filename, lineNumber, line, "Expected a temperature");
+
+				info->temperature = (int16_t)temperature;
+			}
+			else if (command == "react") {
+				std::string triggerName;
+				std::string resultName;
+				double chance;
+
+				size_t material = info - parser.infos.data();
+				MaterialReaction reaction{};
+
+				if (!(stream >> triggerName >> resultName >> chance) || chance < 0.0 || chance > 1.0)
+					return parseFailed(filename, lineNumber, line, "Expected a trigger, a result and a chance from 0 to 1");
+
+				if (!parser.getMaterial(triggerName, reaction.trigger) || !parser.getMaterial(resultName, reaction.result))
+					return parseFailed(filename, lineNumber, line, "Too many materials");
+
+				reaction.chance = (uint16_t)std::min(std::lround(chance * 65536.0), 65535l);
+
+				info = &parser.infos[material];
+
+				if (info->reactions.size() == UINT8_MAX)
+					return parseFailed(filename, lineNumber, line, "Too many reactions");
+
+				info->reactions.push_back(reaction);
+			}
+			else {
+				return parseFailed(filename, lineNumber, line, "Unknown command '" + command + "'");
+			}
+		}
+
+		for (size_t i = 0; i < parser.infos.size(); i++) {
+			if (!parser.described[i]) {
+				util::displayMessage(std::string(filename) + ": Material '" + parser.infos[i].name + "' is used but never described", DISPLAY_TYPE_ERR);
+				return false;
+			}
+		}
+
+		sInfos = std::move(parser.infos);
+		sTables = buildTables(sInfos);
+
+		return true;
+	}
+
+	void MaterialRegistry::reset() {
+		sInfos = getBuiltinMaterials();
+		sTables = buildTables(sInfos);
+	}
+
+	const char* getMaterialName(uint8_t material) {
+		return material < MaterialRegistry::getCount() ? MaterialRegistry::getInfo(material).name.c_str() : "unknown";
+	}
+
+	bool findMaterial(const char* name, uint8_t& outMaterial) {
+		for (int i = 0; i < MaterialRegistry::getCount(); i++) {
+			if (strcmp(getMaterialName((uint8_t)i), name) == 0) {
+				outMaterial = (uint8_t)i;
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sim {
+	// Materials every build knows, they keep these ids whatever a material file adds after them
+	enum MaterialType : uint8_t {
+		MATERIAL_AIR = 0,
+		MATERIAL_STONE,
+		MATERIAL_SAND,
+		MATERIAL_WATER,
+
+		MATERIAL_BUILTIN_COUNT
+	};
+
+	// Each state has its own update kernel, every material of a state moves the same way and only its density
+	// decides what it can push aside
+	enum MaterialState : uint8_t {
+		MATERIAL_STATE_GAS,
+		MATERIAL_STATE_SOLID,
+		MATERIAL_STATE_GRANULAR,
+		MATERIAL_STATE_LIQUID,
+
+		MATERIAL_STATE_COUNT
+	};
+
+	// Stands for no material where one is optional, so there can be at most 255 of them
+	constexpr uint8_t MATERIAL_NONE = 0xFF;
+	constexpr int MATERIAL_MAX_COUNT = MATERIAL_NONE;
+
+	// Melting and ignition point of materials that never melt or burn
+	constexpr int16_t MATERIAL_NEVER_MELTS = INT16_MAX;
+
+	// Freezing point of materials that never freeze
+	constexpr int16_t MATERIAL_NEVER_FREEZES = INT16_MIN;
+
+	// Temperature of materials that take on the temperature around them instead of giving off heat or cold
+	constexpr int16_t MATERIAL_NO_TEMPERATURE = INT16_MIN;
+
+	// A cell of the material touching a face of a cell of the trigger turns into the result, with the given chance
+	// out of 65536 per tick
+	struct MaterialReaction {
+		uint8_t trigger;
+		uint8_t result;
+		uint16_t chance;
+	};
+
+	// Everything known about one material, as written in a material file
+	struct MaterialInfo {
+		std::string name;
+		MaterialState state;
+
+		// Moving cells push aside anything with a lower density that isn't solid
+		uint8_t density;
+
+		// Chance out of 256 that a liquid cell stays put instead of spreading sideways on a tick
+		uint8_t viscosity;
+
+		// Chance out of 256 per tick that the cell catches fire while it is at or above its ignition point
+		uint8_t flammability;
+
+		// Temperature at or above which the cell turns into meltsInto, melting or boiling
+		int16_t meltingPoint;
+		uint8_t meltsInto;
+
+		// Temperature at or below which the cell turns into freezesInto, freezing or condensing
+		int16_t freezingPoint;
+		uint8_t freezesInto;
+
+		// Temperature at or above which the cell may catch fire and turn into burnsInto
+		int16_t ignitionPoint;
+		uint8_t burnsInto;
+
+		// Cells of the material hold the heat field around them at this temperature, see heat.h
+		int16_t temperature;
+
+		// Red in the low byte, then green, blue and alpha
+		uint32_t colour;
+
+		std::vector<MaterialReaction> reactions;
+	};
+
+	// The per cell lookups of the tick, one array per property with an entry for every possible byte so they
+	// never need a bounds check. Ids without a material behave like air
+	struct MaterialTables {
+		MaterialState states[256];
+		uint8_t densities[256];
+
+		// What it takes to push a cell aside, its density or more than any density for solids
+		uint8_t resistances[256];
+		uint8_t viscosities[256];
+		uint8_t flammabilities[256];
+		int16_t meltingPoints[256];
+		uint8_t meltsInto[256];
+		int16_t freezingPoints[256];
+		uint8_t freezesInto[256];
+		int16_t ignitionPoints[256];
+		uint8_t burnsInto[256];
+		int16_t temperatures[256];
+		uint32_t colours[256];
+
+		// The reactions of a material are reactionCounts[material] entries of reactions from firstReactions[material]
+		uint16_t firstReactions[256];
+		uint8_t reactionCounts[256];
+		std::vector<MaterialReaction> reactions;
+
+		// Granular, liquid and gas materials other than air in id order, the bulk kernels run once for each
+		uint8_t granularMaterials[256];
+		int granularCount;
+		uint8_t liquidMaterials[256];
+		int liquidCount;
+		uint8_t gasMaterials[256];
+		int gasCount;
+
+		// Materials with a temperature, without any the heat fields stay off
+		int heatSourceCount;
+	};
+
+	// Holds the materials of the process. The built in ones are there from the start, a material file can
+	// change them and add more. Loading replaces the tables the tick reads, so it has to happen before any world
+	// ticks, at startup
+	class MaterialRegistry {
+	public:
+		// Material files have one command per line and # for comments. Each material starts with its name and
+		// state, the lines after it describe it until the next one:
+		//   material <name> <gas|solid|granular|liquid>
+		//   density <0-255>
+		//   viscosity <0-255>
+		//   flammability <0-255>
+		//   colour <r> <g> <b> [a]                     0-255 each
+		//   melts <temperature> <material>             or boils, at or above the temperature
+		//   freezes <temperature> <material>           or condenses, at or below the temperature
+		//   ignites <temperature> <material>           at or above the temperature, the flammability is the chance
+		//   temperature <degrees>                      gives off heat or cold, see heat.h
+		//   react <trigger material> <result material> <chance per tick, 0-1>
+		// Built in materials named in the file are changed in place, new names get the next free id. Materials may
+		// be used before they are described. Returns false and prints the offending line if the file can't be read
+		// or parsed, the registry is left as it was then
+		static bool loadFromFile(const char* filename);
+
+		// Back to only the built in materials
+		static void reset();
+
+		static int getCount() { return (int)sInfos.size(); }
+		static const MaterialInfo& getInfo(uint8_t material) { return sInfos[material]; }
+
+		static const MaterialTables& getTables() { return sTables; }
+	private:
+		static std::vector<MaterialInfo> sInfos;
+		static MaterialTables sTables;
+	};
+
+	inline MaterialState getMaterialState(uint8_t material) { return MaterialRegistry::getTables().states[material]; }
+	inline int getMaterialDensity(uint8_t material) { return MaterialRegistry::getTables().densities[material]; }
+	inline uint8_t getMaterialViscosity(uint8_t material) { return MaterialRegistry::getTables().viscosities[material]; }
+	inline uint32_t getMaterialColour(uint8_t material) { return MaterialRegistry::getTables().colours[material]; }
+
+	// Whether a moving cell of the mover can take the place of a cell of the target
+	inline bool canDisplace(uint8_t mover, uint8_t target) {
+		const MaterialTables& tables = MaterialRegistry::getTables();
+
+		return tables.resistances[target] < tables.densities[mover];
+	}
+
+	const char* getMaterialName(uint8_t material);
+
+	// Returns false if no material has that name
+	bool findMaterial(const char* name, uint8_t& outMaterial);
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "packed_cells.h"
+#include "../util/block_pool.h"
+
+#include <cstring>
+
+namespace {
+	// Cells compared as one 16 bit value
+	uint16_t getCellKey(const sim::Cell& cell) {
+		uint16_t key;
+		memcpy(&key, &cell, sizeof(key));
+		return key;
+	}
+
+	// Palette index of every possible cell, only valid for the cells of the palette being built. One per thread
+	// so chunks can be packed concurrently
+	thread_local uint8_t tPaletteIndices[1 << 16];
+
+	// The width is a template argument so the shifts and the cells per word are constants
+	template<int BITS>
+	void packIndices(const sim::Cell* cells, int count, uint64_t* outIndices) {
+		const int CELLS_PER_WORD = 64 / BITS;
+
+		for (int first = 0; first < count; first += CELLS_PER_WORD) {
+			int last = first + CELLS_PER_WORD < count ? first + CELLS_PER_WORD : count;
+			uint64_t word = 0;
+
+			for (int i = first; i < last; i++) {
+				word |= (uint64_t)tPaletteIndices[getCellKey(cells[i])] << ((i - first) * BITS);
+			}
+
+			outIndices[first / CELLS_PER_WORD] = word;
+		}
+	}
+
+	template<int BITS>
+	void unpackIndices(const sim::Cell* palette, const uint64_t* indices, int count, sim::Cell* outCells) {
+		const int CELLS_PER_WORD = 64 / BITS;
+		const uint64_t MASK = (1ull << BITS) - 1;
+
+		int fullWords = count / CELLS_PER_WORD;
+
+		for (int word = 0; word < fullWords; word++) {
+			uint64_t bits = indices[word];
+			sim::Cell* out = outCells + word * CELLS_PER_WORD;
+
+			for (int i = 0; i < CELLS_PER_WORD; i++) {
+				out[i] = palette[(bits >> (i * BITS)) & MASK];
+			}
+		}
+
+		for (int i = fullWords * CELLS_PER_WORD; i < count; i++) {
+			outCells[i] = palette[(indices[fullWords] >> ((i % CELLS_PER_WORD) * BITS)) & MASK];
+		}
+	}
+}
+
+namespace sim {
+	bool PackedCells::pack(const Cell* cells, int count) {
+		clear();
+
+		// One bit for every possible cell, set once it is in the palette
+		uint64_t seen[(1 << 16) / 64] = {};
+
+		Cell palette[1 << PACKED_CELLS_MAX_BITS];
+		int paletteSize = 0;
+		int filledCells = 0;
+
+		for (int i = 0; i < count; i++) {
+			uint16_t key = getCellKey(cells[i]);
+			filledCells += cells[i].material != MATERIAL_AIR ? 1 : 0;
+			uint64_t bit = 1ull << (key & 63);
+
+			if (seen[key >> 6] & bit)
+				continue;
+
+			if (paletteSize == (1 << PACKED_CELLS_MAX_BITS))
+				return false;
+
+			seen[key >> 6] |= bit;
+			tPaletteIndices[key] = (uint8_t)paletteSize;
+			palette[paletteSize++] = cells[i];
+		}
+
+		// Smallest power of two width that reaches every palette entry
+		int bits = 1;
+		while ((1 << bits) < paletteSize) {
+			bits <<= 1;
+		}
+
+		mBitsPerCell = bits;
+		mCellsPerWordShift = 6;
+
+		for (int width = bits; width > 1; width >>= 1) {
+			mCellsPerWordShift--;
+		}
+
+		int cellsPerWord = 1 << mCellsPerWordShift;
+
+		// Sized for what is packed, the point is to use less memory
+		mWordCount = (count + cellsPerWord - 1) / cellsPerWord;
+		mIndices = static_cast<uint64_t*>(util::allocateBlock(mWordCount * sizeof(uint64_t)));
+
+		switch (bits) {
+		case 1:
+			packIndices<1>(cells, count, mIndices);
+			break;
+		case 2:
+			packIndices<2>(cells, count, mIndices);
+			break;
+		case 4:
+			packIndices<4>(cells, count, mIndices);
+			break;
+		default:
+			packIndices<8>(cells, count, mIndices);
+			break;
+		}
+
+		mPaletteSize = paletteSize;
+		mPalette = static_cast<Cell*>(util::allocateBlock(paletteSize * sizeof(Cell)));
+		memcpy(mPalette, palette, paletteSize * sizeof(Cell));
+
+		mCount = count;
+		mFilledCells = filledCells;
+
+		return true;
+	}
+
+	void PackedCells::unpack(Cell* outCells) const {
+		// A local copy, the compiler can't tell that writing cells leaves the palette alone
+		Cell palette[1 << PACKED_CELLS_MAX_BITS];
+		memcpy(palette, mPalette, mPaletteSize * sizeof(Cell));
+
+		switch (mBitsPerCell) {
+		case 1:
+			unpackIndices<1>(palette, mIndices, mCount, outCells);
+			break;
+		case 2:
+			unpackIndices<2>(palette, mIndices, mCount, outCells);
+			break;
+		case 4:
+			unpackIndices<4>(palette, mIndices, mCount, outCells);
+			break;
+		default:
+			unpackIndices<8>(palette, mIndices, mCount, outCells);
+			break;
+		}
+	}
+
+	size_t PackedCells::getMemoryBytes() const {
+		if (mCount == 0)
+			return 0;
+
+		return util::getBlockPool(mPaletteSize * sizeof(Cell)).getBlockSize() + util::getBlockPool(mWordCount * sizeof(uint64_t)).getBlockSize();
+	}
+
+	void PackedCells::clear() {
+		if (mCount > 0) {
+			util::freeBlock(mPalette, mPaletteSize * sizeof(Cell));
+			util::freeBlock(mIndices, mWordCount * sizeof(uint64_t));
+		}
+
+		mPalette = nullptr;
+		mIndices = nullptr;
+		mPaletteSize = 0;
+		mWordCount = 0;
+
+		mCount = 0;
+		mFilledCells = 0;
+		mBitsPerCell = 0;
+		mCellsPerWordShift = 0;
+	}
+}
\ No newline at end of file
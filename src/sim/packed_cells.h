@@ -0,0 +1,66 @@
+#pragma once
+
+#include "cell.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sim {
+	// Widest index a palette can use, so it holds at most 256 distinct cells
+	constexpr int PACKED_CELLS_MAX_BITS = 8;
+
+	// Cells stored as a palette of the distinct cells they hold plus one index into it per cell, packed 1, 2, 4
+	// or 8 bits each. Indices never straddle two words, so reading one is a shift and a mask. Nothing changes
+	// packed cells once they are built, so any number of chunks can share them
+	class PackedCells {
+	public:
+		PackedCells() = default;
+		~PackedCells() { clear(); }
+
+		PackedCells(const PackedCells&) = delete;
+		PackedCells& operator=(const PackedCells&) = delete;
+
+		// Returns false and stays empty if the cells hold more distinct values than the widest index can tell apart
+		bool pack(const Cell* cells, int count);
+
+		// outCells has to hold as many cells as were packed
+		void unpack(Cell* outCells) const;
+
+		Cell get(int index) const {
+			uint64_t word = mIndices[index >> mCellsPerWordShift];
+			int shift = (index & ((1 << mCellsPerWordShift) - 1)) * mBitsPerCell;
+
+			return mPalette[(word >> shift) & ((1ull << mBitsPerCell) - 1)];
+		}
+
+		bool isEmpty() const { return mCount == 0; }
+
+		int getCount() const { return mCount; }
+
+		// Cells that aren't air
+		int getFilledCells() const { return mFilledCells; }
+
+		int getBitsPerCell() const { return mBitsPerCell; }
+		size_t getPaletteSize() const { return mPaletteSize; }
+
+		// Size of the pooled blocks holding the palette and the indices
+		size_t getMemoryBytes() const;
+
+		// Frees everything
+		void clear();
+	private:
+		// Both come from the block pools, sized for what was packed
+		Cell* mPalette{ nullptr };
+		uint64_t* mIndices{ nullptr };
+
+		size_t mPaletteSize{ 0 };
+		size_t mWordCount{ 0 };
+
+		int mCount{ 0 };
+		int mFilledCells{ 0 };
+		int mBitsPerCell{ 0 };
+
+		// Log2 of the indices that fit in one word
+		int mCellsPerWordShift{ 0 };
+	};
+}
\ No newline at end of file
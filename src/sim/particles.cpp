@@ -0,0 +1,80 @@
+#include "particles.h"
+#include "../util/cpu.h"
+
+#include <algorithm>
+
+namespace sim {
+	void ParticleBuffer::add(int x, int y, int z, float velocityX, float velocityY, float velocityZ, uint8_t material) {
+		positionsX.push_back(x + 0.5f);
+		positionsY.push_back(y + 0.5f);
+		positionsZ.push_back(z + 0.5f);
+		velocitiesX.push_back(velocityX);
+		velocitiesY.push_back(velocityY);
+		velocitiesZ.push_back(velocityZ);
+		cellsX.push_back(x);
+		cellsY.push_back(y);
+		cellsZ.push_back(z);
+		materials.push_back(material);
+		ages.push_back(0);
+	}
+
+	void ParticleBuffer::move(size_t from, size_t to) {
+		positionsX[to] = positionsX[from];
+		positionsY[to] = positionsY[from];
+		positionsZ[to] = positionsZ[from];
+		velocitiesX[to] = velocitiesX[from];
+		velocitiesY[to] = velocitiesY[from];
+		velocitiesZ[to] = velocitiesZ[from];
+		cellsX[to] = cellsX[from];
+		cellsY[to] = cellsY[from];
+		cellsZ[to] = cellsZ[from];
+		materials[to] = materials[from];
+		ages[to] = ages[from];
+	}
+
+	void ParticleBuffer::resize(size_t count) {
+		positionsX.resize(count);
+		positionsY.resize(count);
+		positionsZ.resize(count);
+		velocitiesX.resize(count);
+		velocitiesY.resize(count);
+		velocitiesZ.resize(count);
+		cellsX.resize(count);
+		cellsY.resize(count);
+		cellsZ.resize(count);
+		materials.resize(count);
+		ages.resize(count);
+	}
+
+	size_t ParticleBuffer::getMemoryBytes() const {
+		// Every array grows together, so they all have the capacity of the first
+		size_t perParticle = 6 * sizeof(float) + 3 * sizeof(int) + sizeof(uint8_t) + sizeof(uint16_t);
+
+		return positionsX.capacity() * perParticle;
+	}
+
+	void integrateParticlesScalar(ParticleBuffer& particles) {
+		size_t count = particles.size();
+
+		for (size_t i = 0; i < count; i++) {
+			float velocityY = std::max(particles.velocitiesY[i] - PARTICLE_GRAVITY, -PARTICLE_MAX_FALL_SPEED);
+
+			particles.velocitiesY[i] = velocityY;
+			particles.positionsX[i] += particles.velocitiesX[i];
+			particles.positionsY[i] += velocityY;
+			particles.positionsZ[i] += particles.velocitiesZ[i];
+		}
+	}
+
+	IntegrateParticlesFunction getIntegrateParticlesFunction(FallKernel kernel) {
+		if (kernel == FALL_KERNEL_SCALAR || kernel == FALL_KERNEL_PER_CELL)
+			return integrateParticlesScalar;
+
+		IntegrateParticlesFunction avx2 = getIntegrateParticlesAVX2();
+
+		if (avx2 != nullptr && util::cpuSupportsAVX2())
+			return avx2;
+
+		return integrateParticlesScalar;
+	}
+}
\ No newline at end of file
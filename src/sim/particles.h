@@ -0,0 +1,76 @@
+#pragma once
+
+#include "fall_kernel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sim {
+	// Cells per tick squared that particles fall with
+	constexpr float PARTICLE_GRAVITY = 1.0f / 16.0f;
+
+	// Fastest particles fall in cells per tick, which keeps the line traced for each one short
+	constexpr float PARTICLE_MAX_FALL_SPEED = 8.0f;
+
+	// A particle still in the air after this many ticks lands where it is
+	constexpr int PARTICLE_MAX_AGE = 512;
+
+	// Particles a world holds at most, an explosion that would throw out more cells removes the rest
+	constexpr size_t PARTICLE_CAPACITY = 1 << 18;
+
+	// Speed in cells per tick a cell at the center of an explosion is thrown out with, less towards its edge
+	constexpr float EXPLOSION_SPEED = 2.0f;
+
+	// Upward speed every cell thrown out by an explosion gets on top, so the crater is thrown up and out
+	constexpr float EXPLOSION_LIFT = 0.75f;
+
+	// A particle landing with a sideways speed of at least this drifts while it falls on as a cell
+	constexpr float PARTICLE_DRIFT_SPEED = 0.5f;
+
+	// Cells that were thrown out of the grid, one entry per particle in every array. Kept as a structure of
+	// arrays so the integration runs over whole registers of particles, and the renderer can draw them as
+	// instances straight from the positions and materials
+	struct ParticleBuffer {
+		std::vector<float> positionsX;
+		std::vector<float> positionsY;
+		std::vector<float> positionsZ;
+		std::vector<float> velocitiesX;
+		std::vector<float> velocitiesY;
+		std::vector<float> velocitiesZ;
+
+		// Cell each particle was in after the last tick, where the line traced for the next one starts
+		std::vector<int> cellsX;
+		std::vector<int> cellsY;
+		std::vector<int> cellsZ;
+
+		std::vector<uint8_t> materials;
+		std::vector<uint16_t> ages;
+
+		size_t size() const { return materials.size(); }
+		bool empty() const { return materials.empty(); }
+
+		// Starts at the center of the cell
+		void add(int x, int y, int z, float velocityX, float velocityY, float velocityZ, uint8_t material);
+
+		// Copies particle from over particle to, for compacting the arrays
+		void move(size_t from, size_t to);
+
+		void resize(size_t count);
+		void clear() { resize(0); }
+
+		size_t getMemoryBytes() const;
+	};
+
+	// Applies gravity to every particle and moves it by its velocity. The scalar and AVX2 versions give bit
+	// identical results
+	using IntegrateParticlesFunction = void(*)(ParticleBuffer& particles);
+
+	void integrateParticlesScalar(ParticleBuffer& particles);
+
+	// Returns nullptr when the build has no AVX2 version
+	IntegrateParticlesFunction getIntegrateParticlesAVX2();
+
+	// Follows the choice of fall kernel like the liquid kernel, the scalar version unless AVX2 would be used
+	IntegrateParticlesFunction getIntegrateParticlesFunction(FallKernel kernel);
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+namespace sim {
+	// Distinguishes the different random decisions a single cell can make in one tick
+	enum RandomSalt : uint32_t {
+		RANDOM_SALT_DIAGONAL = 1,
+		RANDOM_SALT_LATERAL = 2,
+		RANDOM_SALT_BLOCK = 3,
+		RANDOM_SALT_REACTION = 4,
+		RANDOM_SALT_VISCOSITY = 5,
+		RANDOM_SALT_HEAT = 6,
+		RANDOM_SALT_EXPLOSION = 7
+	};
+
+	// Splitmix64 finalizer, every input bit affects every output bit
+	inline uint64_t mixBits(uint64_t value) {
+		value ^= value >> 30;
+		value *= 0xBF58476D1CE4E5B9ull;
+		value ^= value >> 27;
+		value *= 0x94D049BB133111EBull;
+		value ^= value >> 31;
+		return value;
+	}
+
+	// Stateless random number for a decision made by the cell at a world position during a tick. Because it
+	// only depends on its inputs, the outcome can't change with the order or the thread that cells are updated on
+	inline uint32_t randomForCell(uint64_t seed, uint64_t tick, int x, int y, int z, uint32_t salt) {
+		uint64_t value = mixBits(seed ^ (tick * 0x9E3779B97F4A7C15ull));
+		value = mixBits(value ^ ((uint64_t)(uint32_t)x | ((uint64_t)(uint32_t)z << 32)));
+		value = mixBits(value ^ ((uint64_t)(uint32_t)y | ((uint64_t)salt << 32)));
+		return (uint32_t)value;
+	}
+}
\ No newline at end of file
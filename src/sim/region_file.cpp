@@ -0,0 +1,449 @@
+#include "region_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	const char REGION_MAGIC[4] = { 'F', 'S', 'R', 'G' };
+
+	// Magic, version, region coordinates and sector count, then the table
+	constexpr size_t HEADER_FIELDS_BYTES = 4 + 4 + 3 * 4 + 4;
+	constexpr size_t ENTRY_BYTES = 8;
+	constexpr size_t HEADER_BYTES = HEADER_FIELDS_BYTES + sim::REGION_CHUNKS * ENTRY_BYTES;
+	constexpr uint32_t HEADER_SECTORS = (uint32_t)((HEADER_BYTES + sim::REGION_SECTOR_SIZE - 1) / sim::REGION_SECTOR_SIZE);
+
+	constexpr size_t SECTOR_COUNT_OFFSET = 4 + 4 + 3 * 4;
+
+	// Encoding, flags, and for each encoding what comes before the cells
+	constexpr size_t PAYLOAD_HEADER_BYTES = 2;
+	constexpr size_t PALETTE_HEADER_BYTES = PAYLOAD_HEADER_BYTES + 2;
+	constexpr size_t RUNS_HEADER_BYTES = PAYLOAD_HEADER_BYTES + 4;
+	constexpr size_t RUN_BYTES = 4;
+
+	void putUint16(uint8_t* bytes, uint32_t value) {
+		bytes[0] = (uint8_t)value;
+		bytes[1] = (uint8_t)(value >> 8);
+	}
+
+	void putUint32(uint8_t* bytes, uint32_t value) {
+		for (int i = 0; i < 4; i++) {
+			bytes[i] = (uint8_t)(value >> (i * 8));
+		}
+	}
+
+	uint32_t getUint16(const uint8_t* bytes) {
+		return bytes[0] | ((uint32_t)bytes[1] << 8);
+	}
+
+	uint32_t getUint32(const uint8_t* bytes) {
+		return bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+	}
+
+	uint32_t getCellKey(sim::Cell cell) {
+		return cell.material | ((uint32_t)cell.flags << 8);
+	}
+
+	// Where the cell at position i of the linear order is stored in the layout of the build, the same index for
+	// the linear layout
+	int toLayoutIndex(int i) {
+		return sim::Chunk::index(i & sim::CHUNK_MASK, i >> (sim::CHUNK_SHIFT * 2), (i >> sim::CHUNK_SHIFT) & sim::CHUNK_MASK);
+	}
+
+	uint32_t getSectorCount(size_t bytes) {
+		return (uint32_t)((bytes + sim::REGION_SECTOR_SIZE - 1) / sim::REGION_SECTOR_SIZE);
+	}
+}
+
+namespace sim {
+	void encodeChunk(const Chunk& chunk, std::vector<uint8_t>& outPayload, Cell* scratch) {
+		uint8_t flags = chunk.isActive() ? CHUNK_PAYLOAD_AWAKE : 0;
+
+		outPayload.clear();
+
+		if (chunk.getStorage() == CHUNK_STORAGE_UNIFORM) {
+			Cell cell = chunk.getCell(0, 0, 0);
+
+			outPayload = { CHUNK_ENCODING_UNIFORM, flags, cell.material, cell.flags };
+			return;
+		}
+
+		if (std::is_same<CellLayout, LinearLayout>::value) {
+			chunk.copyCells(scratch);
+		}
+		else {
+			for (int i = 0; i < CHUNK_VOLUME; i++) {
+				scratch[i] = chunk.getCell(i & CHUNK_MASK, i >> (CHUNK_SHIFT * 2), (i >> CHUNK_SHIFT) & CHUNK_MASK);
+			}
+		}
+
+		// Distinct cells are only looked for where a run starts, the cells of a run share the palette entry of
+		// its first one. Past 256 distinct cells only runs are left
+		Cell palette[256];
+		int paletteSize = 0;
+		size_t runs = 0;
+		uint32_t lastKey = UINT32_MAX;
+
+		for (int i = 0; i < CHUNK_VOLUME; i++) {
+			uint32_t key = getCellKey(scratch[i]);
+
+			if (key == lastKey)
+				continue;
+
+			lastKey = key;
+			runs++;
+
+			if (paletteSize > 256)
+				continue;
+
+			bool found = false;
+
+			for (int entry = 0; entry < paletteSize && !found; entry++) {
+				found = getCellKey(palette[entry]) == key;
+			}
+
+			if (!found) {
+				if (paletteSize < 256)
+					palette[paletteSize] = scratch[i];
+
+				paletteSize++;
+			}
+		}
+
+		if (paletteSize == 1) {
+			outPayload = { CHUNK_ENCODING_UNIFORM, flags, scratch[0].material, scratch[0].flags };
+			return;
+		}
+
+		int bits = paletteSize <= 2 ? 1 : paletteSize <= 4 ? 2 : paletteSize <= 16 ? 4 : 8;
+		size_t paletteBytes = paletteSize <= 256 ? PALETTE_HEADER_BYTES + paletteSize * 2 + CHUNK_VOLUME * bits / 8 : SIZE_MAX;
+		size_t runsBytes = RUNS_HEADER_BYTES + runs * RUN_BYTES;
+
+		if (runsBytes <= paletteBytes) {
+			outPayload.resize(runsBytes);
+
+			uint8_t* bytes = outPayload.data();
+			bytes[0] = CHUNK_ENCODING_RUNS;
+			bytes[1] = flags;
+			putUint32(bytes + 2, (uint32_t)runs);
+			bytes += RUNS_HEADER_BYTES;
+
+			int start = 0;
+
+			for (int i = 1; i <= CHUNK_VOLUME; i++) {
+				if (i < CHUNK_VOLUME && getCellKey(scratch[i]) == getCellKey(scratch[start]))
+					continue;
+
+				putUint16(bytes, (uint32_t)(i - start - 1));
+				bytes[2] = scratch[start].material;
+				bytes[3] = scratch[start].flags;
+				bytes += RUN_BYTES;
+
+				start = i;
+			}
+
+			return;
+		}
+
+		outPayload.assign(paletteBytes, 0);
+
+		uint8_t* bytes = outPayload.data();
+		bytes[0] = CHUNK_ENCODING_PALETTE;
+		bytes[1] = flags;
+		bytes[2] = (uint8_t)bits;
+		bytes[3] = (uint8_t)(paletteSize - 1);
+
+		for (int entry = 0; entry < paletteSize; entry++) {
+			bytes[PALETTE_HEADER_BYTES + entry * 2] = palette[entry].material;
+			bytes[PALETTE_HEADER_BYTES + entry * 2 + 1] = palette[entry].flags;
+		}
+
+		uint8_t* indices = bytes + PALETTE_HEADER_BYTES + paletteSize * 2;
+		int cellsPerByte = 8 / bits;
+		uint32_t lastIndex = 0;
+		lastKey = UINT32_MAX;
+
+		for (int i = 0; i < CHUNK_VOLUME; i++) {
+			uint32_t key = getCellKey(scratch[i]);
+
+			if (key != lastKey) {
+				lastKey = key;
+				lastIndex = 0;
+
+				while (getCellKey(palette[lastIndex]) != key) {
+					lastIndex++;
+				}
+			}
+
+			indices[i / cellsPerByte] |= (uint8_t)(lastIndex << ((i % cellsPerByte) * bits));
+		}
+	}
+
+	bool decodeChunk(const uint8_t* payload, size_t size, DecodedChunk& outChunk, Cell* scratch) {
+		if (size < PAYLOAD_HEADER_BYTES)
+			return false;
+
+		outChunk.flags = payload[1];
+		outChunk.packedCells = nullptr;
+		outChunk.denseCells.clear();
+
+		switch (payload[0]) {
+		case CHUNK_ENCODING_UNIFORM:
+			if (size != PAYLOAD_HEADER_BYTES + 2)
+				return false;
+
+			outChunk.storage = CHUNK_STORAGE_UNIFORM;
+			outChunk.uniformCell = Cell{ payload[2], payload[3] };
+
+			return true;
+		case CHUNK_ENCODING_PALETTE: {
+			if (size < PALETTE_HEADER_BYTES)
+				return false;
+
+			int bits = payload[2];
+			int paletteSize = payload[3] + 1;
+
+			if ((bits != 1 && bits != 2 && bits != 4 && bits != 8) || paletteSize > (1 << bits)
+				|| size != PALETTE_HEADER_BYTES + paletteSize * 2 + (size_t)CHUNK_VOLUME * bits / 8)
+				return false;
+
+			Cell palette[256];
+
+			for (int entry = 0; entry < paletteSize; entry++) {
+				palette[entry] = Cell{ payload[PALETTE_HEADER_BYTES + entry * 2], payload[PALETTE_HEADER_BYTES + entry * 2 + 1] };
+			}
+
+			const uint8_t* indices = payload + PALETTE_HEADER_BYTES + paletteSize * 2;
+			int cellsPerByte = 8 / bits;
+			uint32_t mask = (1u << bits) - 1;
+
+			for (int i = 0; i < CHUNK_VOLUME; i++) {
+				uint32_t index = (indices[i / cellsPerByte] >> ((i % cellsPerByte) * bits)) & mask;
+
+				if ((int)index >= paletteSize)
+					return false;
+
+				scratch[toLayoutIndex(i)] = palette[index];
+			}
+
+			break;
+		}
+		case CHUNK_ENCODING_RUNS: {
+			if (size < RUNS_HEADER_BYTES)
+				return false;
+
+			size_t runs = getUint32(payload + 2);
+
+			if (size != RUNS_HEADER_BYTES + runs * RUN_BYTES)
+				return false;
+
+			const uint8_t* run = payload + RUNS_HEADER_BYTES;
+			int position = 0;
+
+			for (size_t i = 0; i < runs; i++, run += RUN_BYTES) {
+				int length = (int)getUint16(run) + 1;
+
+				if (position + length > CHUNK_VOLUME)
+					return false;
+
+				Cell cell{ run[2], run[3] };
+
+				for (int end = position + length; position < end; position++) {
+					scratch[toLayoutIndex(position)] = cell;
+				}
+			}
+
+			if (position != CHUNK_VOLUME)
+				return false;
+
+			break;
+		}
+		default:
+			return false;
+		}
+
+		// Palettes of up to 256 cells always pack, runs may have more distinct cells than that. The packed cells and
+		// their reference count share one pooled block like the ones chunks pack themselves
+		std::shared_ptr<PackedCells> packed = std::allocate_shared<PackedCells>(util::PoolAllocator<PackedCells>());
+
+		if (packed->pack(scratch, CHUNK_VOLUME)) {
+			if (packed->getPaletteSize() == 1) {
+				outChunk.storage = CHUNK_STORAGE_UNIFORM;
+				outChunk.uniformCell = scratch[0];
+
+				return true;
+			}
+
+			outChunk.storage = CHUNK_STORAGE_PACKED;
+			outChunk.packedCells = std::move(packed);
+
+			return true;
+		}
+
+		outChunk.storage = CHUNK_STORAGE_DENSE;
+		outChunk.denseCells.assign(scratch, scratch + CHUNK_VOLUME);
+
+		return true;
+	}
+
+	bool RegionFile::create(const std::string& path, int regionX, int regionY, int regionZ) {
+		close();
+
+		mFile = fopen(path.c_str(), "wb+");
+
+		if (mFile == nullptr)
+			return false;
+
+		mRegionX = regionX;
+		mRegionY = regionY;
+		mRegionZ = regionZ;
+		mSectorCount = HEADER_SECTORS;
+
+		std::fill(mEntries, mEntries + REGION_CHUNKS, Entry{ 0, 0 });
+		std::fill(mDirty, mDirty + REGION_CHUNKS, false);
+		mAnyDirty = false;
+
+		return writeHeader();
+	}
+
+	bool RegionFile::open(const std::string& path) {
+		close();
+
+		mFile = fopen(path.c_str(), "rb+");
+
+		if (mFile == nullptr)
+			return false;
+
+		std::vector<uint8_t> header(HEADER_BYTES);
+
+		if (fread(header.data(), 1, HEADER_BYTES, mFile) != HEADER_BYTES || memcmp(header.data(), REGION_MAGIC, 4) != 0
+			|| getUint32(header.data() + 4) != REGION_VERSION) {
+			close();
+			return false;
+		}
+
+		mRegionX = (int)getUint32(header.data() + 8);
+		mRegionY = (int)getUint32(header.data() + 12);
+		mRegionZ = (int)getUint32(header.data() + 16);
+		mSectorCount = getUint32(header.data() + SECTOR_COUNT_OFFSET);
+
+		for (int i = 0; i < REGION_CHUNKS; i++) {
+			const uint8_t* entry = header.data() + HEADER_FIELDS_BYTES + i * ENTRY_BYTES;
+
+			mEntries[i] = Entry{ getUint32(entry), getUint32(entry + 4) };
+			mDirty[i] = false;
+
+			// A table pointing into the header or past the end of the file is broken
+			if (mEntries[i].bytes != 0 && (mEntries[i].sector < HEADER_SECTORS || mEntries[i].sector + getSectorCount(mEntries[i].bytes) > mSectorCount)) {
+				close();
+				return false;
+			}
+		}
+
+		mAnyDirty = false;
+
+		return true;
+	}
+
+	void RegionFile::close() {
+		if (mFile == nullptr)
+			return;
+
+		flush();
+		fclose(mFile);
+
+		mFile = nullptr;
+	}
+
+	bool RegionFile::flush() {
+		if (mFile == nullptr)
+			return false;
+
+		if (!mAnyDirty)
+			return true;
+
+		uint8_t bytes[ENTRY_BYTES];
+
+		for (int i = 0; i < REGION_CHUNKS; i++) {
+			if (!mDirty[i])
+				continue;
+
+			putUint32(bytes, mEntries[i].sector);
+			putUint32(bytes + 4, mEntries[i].bytes);
+
+			if (fseek(mFile, (long)(HEADER_FIELDS_BYTES + i * ENTRY_BYTES), SEEK_SET) != 0 || fwrite(bytes, 1, ENTRY_BYTES, mFile) != ENTRY_BYTES)
+				return false;
+
+			mDirty[i] = false;
+		}
+
+		putUint32(bytes, mSectorCount);
+
+		if (fseek(mFile, (long)SECTOR_COUNT_OFFSET, SEEK_SET) != 0 || fwrite(bytes, 1, 4, mFile) != 4)
+			return false;
+
+		mAnyDirty = false;
+
+		return fflush(mFile) == 0;
+	}
+
+	bool RegionFile::readChunk(int index, std::vector<uint8_t>& outPayload) {
+		const Entry& entry = mEntries[index];
+
+		outPayload.resize(entry.bytes);
+
+		if (entry.bytes == 0)
+			return true;
+
+		return fseek(mFile, (long)((size_t)entry.sector * REGION_SECTOR_SIZE), SEEK_SET) == 0 && fread(outPayload.data(), 1, entry.bytes, mFile) == entry.bytes;
+	}
+
+	bool RegionFile::writeChunk(int index, const std::vector<uint8_t>& payload) {
+		Entry& entry = mEntries[index];
+
+		uint32_t sectors = getSectorCount(payload.size());
+		uint32_t sector = entry.bytes != 0 && sectors <= getSectorCount(entry.bytes) ? entry.sector : mSectorCount;
+
+		if (fseek(mFile, (long)((size_t)sector * REGION_SECTOR_SIZE), SEEK_SET) != 0 || fwrite(payload.data(), 1, payload.size(), mFile) != payload.size())
+			return false;
+
+		// The last payload is padded out to its sector, so the file always ends on a sector
+		if (sector == mSectorCount) {
+			static const uint8_t PADDING[REGION_SECTOR_SIZE] = {};
+			size_t padding = (size_t)sectors * REGION_SECTOR_SIZE - payload.size();
+
+			if (fwrite(PADDING, 1, padding, mFile) != padding)
+				return false;
+
+			mSectorCount += sectors;
+		}
+
+		entry = Entry{ sector, (uint32_t)payload.size() };
+		mDirty[index] = true;
+		mAnyDirty = true;
+
+		return true;
+	}
+
+	void RegionFile::removeChunk(int index) {
+		mEntries[index] = Entry{ 0, 0 };
+		mDirty[index] = true;
+		mAnyDirty = true;
+	}
+
+	std::string RegionFile::getFileName(int regionX, int regionY, int regionZ) {
+		return "r." + std::to_string(regionX) + "." + std::to_string(regionY) + "." + std::to_string(regionZ) + ".region";
+	}
+
+	bool RegionFile::writeHeader() {
+		std::vector<uint8_t> header((size_t)HEADER_SECTORS * REGION_SECTOR_SIZE, 0);
+
+		memcpy(header.data(), REGION_MAGIC, 4);
+		putUint32(header.data() + 4, REGION_VERSION);
+		putUint32(header.data() + 8, (uint32_t)mRegionX);
+		putUint32(header.data() + 12, (uint32_t)mRegionY);
+		putUint32(header.data() + 16, (uint32_t)mRegionZ);
+		putUint32(header.data() + SECTOR_COUNT_OFFSET, mSectorCount);
+
+		return fseek(mFile, 0, SEEK_SET) == 0 && fwrite(header.data(), 1, header.size(), mFile) == header.size() && fflush(mFile) == 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "chunk.h"
+#include "packed_cells.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Flags of a chunk payload
+#define CHUNK_PAYLOAD_AWAKE 0x01
+
+namespace sim {
+	// Regions are 8x8x8 chunks, 256 cells on a side, one file each
+	constexpr int REGION_SHIFT = 3;
+	constexpr int REGION_SIZE = 1 << REGION_SHIFT;
+	constexpr int REGION_MASK = REGION_SIZE - 1;
+	constexpr int REGION_CHUNKS = REGION_SIZE * REGION_SIZE * REGION_SIZE;
+
+	// Payloads start on a sector and take whole sectors. Small enough that a uniform chunk wastes little, a
+	// palette of two bits per cell takes 33 of them
+	constexpr size_t REGION_SECTOR_SIZE = 256;
+
+	constexpr uint32_t REGION_VERSION = 1;
+
+	// How the cells of a chunk are stored in its payload. Every payload starts with its encoding and the
+	// CHUNK_PAYLOAD_ flags, the cells follow in the linear x, z, y order whatever layout the build uses
+	enum ChunkEncoding : uint8_t {
+		// A single cell
+		CHUNK_ENCODING_UNIFORM,
+
+		// Bits per cell, palette size - 1, the palette and the indices, packed from the lowest bit of each byte
+		CHUNK_ENCODING_PALETTE,
+
+		// Run count, then a length - 1 and a cell for every run
+		CHUNK_ENCODING_RUNS
+	};
+
+	// A chunk read back from a payload, in whichever form takes the least memory
+	struct DecodedChunk {
+		ChunkStorage storage;
+		Cell uniformCell;
+		std::shared_ptr<const PackedCells> packedCells;
+
+		// Only for chunks with more distinct cells than a palette holds, in the order of Chunk::index
+		std::vector<Cell> denseCells;
+
+		uint8_t flags;
+	};
+
+	// Writes the payload of a chunk to outPayload, as runs or a palette, whichever is smaller. Only reads the chunk,
+	// so chunks can be encoded on any thread between ticks. scratch has to hold CHUNK_VOLUME cells
+	void encodeChunk(const Chunk& chunk, std::vector<uint8_t>& outPayload, Cell* scratch);
+
+	// Returns false if the payload is cut short or doesn't make sense. scratch has to hold CHUNK_VOLUME cells
+	bool decodeChunk(const uint8_t* payload, size_t size, DecodedChunk& outChunk, Cell* scratch);
+
+	// One file holding the chunks of a region. A header with an offset table of every chunk comes first, then the
+	// payloads, each starting on a sector. A chunk can be read or written on its own: a payload that still fits
+	// into the sectors it had is written over them, a larger one goes to the end of the file. Changed table
+	// entries are written by flush. Files are little endian whatever the machine. Not thread safe, but distinct
+	// files can be used from distinct threads
+	class RegionFile {
+	public:
+		RegionFile() = default;
+		~RegionFile() { close(); }
+
+		RegionFile(const RegionFile&) = delete;
+		RegionFile& operator=(const RegionFile&) = delete;
+
+		// Replaces whatever file is at the path with a region without chunks. Returns false if it can't be created
+		bool create(const std::string& path, int regionX, int regionY, int regionZ);
+
+		// Returns false if the file can't be opened or isn't a region file
+		bool open(const std::string& path);
+
+		// Flushes and closes the file, if one is open
+		void close();
+
+		// Writes the table entries that changed since the last flush
+		bool flush();
+
+		bool hasChunk(int index) const { return mEntries[index].bytes != 0; }
+
+		// Payload of the chunk, empty if the region doesn't have it
+		bool readChunk(int index, std::vector<uint8_t>& outPayload);
+
+		bool writeChunk(int index, const std::vector<uint8_t>& payload);
+
+		// The sectors of a removed chunk stay in the file until the region is written again as a whole
+		void removeChunk(int index);
+
+		int getRegionX() const { return mRegionX; }
+		int getRegionY() const { return mRegionY; }
+		int getRegionZ() const { return mRegionZ; }
+
+		size_t getFileBytes() const { return (size_t)mSectorCount * REGION_SECTOR_SIZE; }
+
+		// Chunks of a region follow the x, z, y order of cells
+		static int chunkIndex(int localX, int localY, int localZ) { return localX | (localZ << REGION_SHIFT) | (localY << (REGION_SHIFT * 2)); }
+
+		// Name of the file of a region inside a save directory
+		static std::string getFileName(int regionX, int regionY, int regionZ);
+	private:
+		struct Entry {
+			// First sector of the payload and its exact size, 0 bytes for a missing chunk
+			uint32_t sector;
+			uint32_t bytes;
+		};
+
+		FILE* mFile{ nullptr };
+
+		int mRegionX{ 0 };
+		int mRegionY{ 0 };
+		int mRegionZ{ 0 };
+
+		Entry mEntries[REGION_CHUNKS]{};
+		bool mDirty[REGION_CHUNKS]{};
+		bool mAnyDirty{ false };
+
+		// Sectors in the file, the header included
+		uint32_t mSectorCount{ 0 };
+
+		bool writeHeader();
+	};
+}
\ No newline at end of file
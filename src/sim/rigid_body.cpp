@@ -0,0 +1,75 @@
+#include "rigid_body.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sim {
+	void RigidBody::add(int offsetX, int offsetY, int offsetZ, uint8_t material) {
+		offsetsX.push_back(offsetX);
+		offsetsY.push_back(offsetY);
+		offsetsZ.push_back(offsetZ);
+		materials.push_back(material);
+
+		radius = std::max(radius, std::sqrt((float)(offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ)));
+	}
+
+	void RigidBody::getCellCenter(size_t cell, float& outX, float& outY, float& outZ) const {
+		const float* rotation = pose.rotation;
+
+		float x = (float)offsetsX[cell];
+		float y = (float)offsetsY[cell];
+		float z = (float)offsetsZ[cell];
+
+		outX = pose.position[0] + rotation[0] * x + rotation[1] * y + rotation[2] * z;
+		outY = pose.position[1] + rotation[3] * x + rotation[4] * y + rotation[5] * z;
+		outZ = pose.position[2] + rotation[6] * x + rotation[7] * y + rotation[8] * z;
+	}
+
+	void RigidBody::getCell(size_t cell, int& outX, int& outY, int& outZ) const {
+		float x, y, z;
+		getCellCenter(cell, x, y, z);
+
+		outX = (int)std::floor(x);
+		outY = (int)std::floor(y);
+		outZ = (int)std::floor(z);
+	}
+
+	void RigidBody::rotate(int axis, float angle, float pivotX, float pivotY, float pivotZ) {
+		float c = std::cos(angle);
+		float s = std::sin(angle);
+
+		// Around x it turns y towards z, around z it turns x towards y
+		float turn[9];
+
+		if (axis == 0) {
+			float around[9] = { 1.0f, 0.0f, 0.0f, 0.0f, c, -s, 0.0f, s, c };
+			std::copy(around, around + 9, turn);
+		}
+		else {
+			float around[9] = { c, -s, 0.0f, s, c, 0.0f, 0.0f, 0.0f, 1.0f };
+			std::copy(around, around + 9, turn);
+		}
+
+		float rotation[9];
+
+		for (int row = 0; row < 3; row++) {
+			for (int column = 0; column < 3; column++) {
+				rotation[row * 3 + column] = turn[row * 3] * pose.rotation[column] + turn[row * 3 + 1] * pose.rotation[3 + column]
+					+ turn[row * 3 + 2] * pose.rotation[6 + column];
+			}
+		}
+
+		std::copy(rotation, rotation + 9, pose.rotation);
+
+		float relative[3] = { pose.position[0] - pivotX, pose.position[1] - pivotY, pose.position[2] - pivotZ };
+		float pivot[3] = { pivotX, pivotY, pivotZ };
+
+		for (int row = 0; row < 3; row++) {
+			pose.position[row] = pivot[row] + turn[row * 3] * relative[0] + turn[row * 3 + 1] * relative[1] + turn[row * 3 + 2] * relative[2];
+		}
+	}
+
+	size_t RigidBody::getMemoryBytes() const {
+		return sizeof(RigidBody) + offsetsX.capacity() * 3 * sizeof(int) + materials.capacity();
+	}
+}
\ No newline at end of file
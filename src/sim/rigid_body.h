@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sim {
+	// A body still falling after this many ticks is put back into the grid where it is, one falling out of an
+	// unbounded world would never land otherwise
+	constexpr int BODY_MAX_TICKS = 512;
+
+	// Radians per tick a body tipping over an edge gains every tick it rests on it, and the most it turns in one
+	constexpr float BODY_TIP_ACCELERATION = 0.02f;
+	constexpr float BODY_MAX_SPIN = 0.15f;
+
+	// Where a body is and which way it faces. Cells are turned by the rotation, a 3x3 matrix in rows, and moved
+	// to the position
+	struct BodyPose {
+		float position[3];
+		float rotation[9];
+	};
+
+	// An island of solid cells that lost its support, falling as one object outside of the grid until it lands
+	// and is put back. Falls like fast falling cells, one cell a tick faster every tick up to FALL_SPEED_MAX, and
+	// tips over the edge of whatever it lands on when its center is past it
+	struct RigidBody {
+		// Offset of every cell from the one the body turns around, which starts out as the cell nearest the middle
+		// of the island. Kept as integers so a body that hasn't turned puts its cells back exactly where they were
+		std::vector<int> offsetsX;
+		std::vector<int> offsetsY;
+		std::vector<int> offsetsZ;
+		std::vector<uint8_t> materials;
+
+		// Center of the cell the body turns around
+		BodyPose pose{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f } };
+
+		// Cells per tick
+		int fallSpeed{ 0 };
+
+		// Radians per tick around the x axis (0) or the z axis (2), kept while it falls after tipping over
+		float spin{ 0.0f };
+		int spinAxis{ 0 };
+
+		// Furthest any cell center is from the one the body turns around, in cells
+		float radius{ 0.0f };
+
+		int ticks{ 0 };
+
+		size_t size() const { return materials.size(); }
+
+		void add(int offsetX, int offsetY, int offsetZ, uint8_t material);
+
+		// Center of a cell in world coordinates, and the cell it is in
+		void getCellCenter(size_t cell, float& outX, float& outY, float& outZ) const;
+		void getCell(size_t cell, int& outX, int& outY, int& outZ) const;
+
+		// Turns the body by the angle around the x or z axis through the pivot
+		void rotate(int axis, float angle, float pivotX, float pivotY, float pivotZ);
+
+		size_t getMemoryBytes() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,1277 @@
+#include "rules.h"
+#include "line_walk.h"
+#include "random.h"
+#include "../util/bits.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	// Cells that are blocked beneath try these horizontal offsets, first one level down and then (for liquids) level.
+	// The same order as FALL_DRIFT_OFFSETS, so a side is also a drift
+	const int SIDE_OFFSETS[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+
+	// A chunk with a one cell border all around, holding copies of the neighbouring cells
+	const int HALO_SIZE = sim::CHUNK_SIZE + 2;
+	const int HALO_AREA = HALO_SIZE * HALO_SIZE;
+	const int HALO_VOLUME = HALO_AREA * HALO_SIZE;
+
+	// Where cell (0, 0, 0) of the chunk sits in the haloed copy
+	const int HALO_ORIGIN = 1 + HALO_SIZE + HALO_AREA;
+
+	// Stands in for cells of missing and compressed chunks, nothing can move into it
+	const sim::Cell HALO_WALL{ sim::MATERIAL_STONE, 0 };
+
+	// Active bricks from which the whole chunk is copied at once. A box around a brick is about twice the size of
+	// the brick and is copied a few cells at a time, so this comes well before the boxes add up to the whole chunk
+	const int HALO_WHOLE_CHUNK_BRICKS = 24;
+
+	// Fresh cells start with a clear stamp, so the first tick has to stamp with a set bit
+	uint8_t getTickStamp(uint64_t tick) {
+		return (uint8_t)((tick & 1) == 0 ? CELL_FLAG_STAMP : 0);
+	}
+
+	// Wakes every brick that a cell at x, y, z relative to the chunk could affect, in whichever chunks they are
+	void wakeAround(sim::Chunk& chunk, int x, int y, int z) {
+		for (int i = 0; i < 8; i++) {
+			int wakeX = x + ((i & 1) ? 1 : -1);
+			int wakeY = y + ((i & 2) ? 1 : -1);
+			int wakeZ = z + ((i & 4) ? 1 : -1);
+
+			sim::Chunk* other = chunk.getNeighbour(wakeX >> sim::CHUNK_SHIFT, wakeY >> sim::CHUNK_SHIFT, wakeZ >> sim::CHUNK_SHIFT);
+
+			if (other != nullptr)
+				other->wakeBricks(1ull << sim::Chunk::brickIndex(wakeX & sim::CHUNK_MASK, wakeY & sim::CHUNK_MASK, wakeZ & sim::CHUNK_MASK));
+		}
+	}
+
+	// One haloed chunk per thread, chunks are updated one at a time on each of them
+	thread_local sim::Cell tHaloCells[HALO_VOLUME];
+
+	// Cells of the haloed chunk the pressure searches have been through, marked with the number of the chunk update
+	// plus the height the search started from
+	thread_local uint16_t tPressureVisits[HALO_VOLUME];
+	thread_local uint16_t tPressureSearch;
+
+	// With HALO set, the cells of every active brick and one cell around it are copied into a haloed chunk first,
+	// so the rules index a single array wherever a move goes and never check the chunk bounds. Moves that end up
+	// in the halo are written back to the neighbouring chunks once the chunk is done. Both give the same world.
+	//
+	// With OUTBOX set, every chunk ticks at the same time as its neighbours. Neighbouring cells are read from the
+	// copies of their faces taken before the tick, and moves into them are queued in the outbox of the chunk
+	template<bool HALO, bool OUTBOX>
+	struct ChunkUpdater {
+		static_assert(!HALO || !OUTBOX, "Outboxes work on the chunk itself");
+
+		// Distance between rows and between layers of whichever array the rules work on
+		static constexpr int ROW_STRIDE = HALO ? HALO_SIZE : sim::CHUNK_SIZE;
+		static constexpr int LAYER_STRIDE = HALO ? HALO_AREA : sim::CHUNK_AREA;
+
+		sim::World& world;
+		sim::Chunk& chunk;
+		sim::Cell* cells;
+
+		int baseX;
+		int baseY;
+		int baseZ;
+
+		uint8_t stamp;
+
+		uint64_t seed;
+		uint64_t tick;
+
+		// Bricks of this chunk woken by moves, handed to the chunk in one go once the tick is done
+		uint64_t localWakes;
+
+		bool brickMoved;
+
+		uint64_t cellsMoved;
+
+		// Bulk kernel for granular cells falling straight down, nullptr to leave everything to updateCell
+		sim::FallLayerFunction fallLayer;
+
+		// Bulk kernel for liquid levels flowing down, nullptr when liquids move as whole cells
+		sim::FlowLayerFunction flowLayer;
+
+		// The same kernel for gas rising, nullptr when there are no gases
+		sim::FlowLayerFunction riseLayer;
+
+		// Granular cells move along the line of their velocity, see World::setFastFalls
+		bool fastFalls;
+
+		// The first of the numbers the pressure searches of this chunk update mark cells with, one for each
+		// height, see pushUnderPressure
+		uint16_t pressureSearch;
+
+		// Where the last successful move went, relative to this chunk
+		int targetX;
+		int targetY;
+		int targetZ;
+
+		// Position of the cell being updated, for moves queued in the outbox
+		int sourceX;
+		int sourceY;
+		int sourceZ;
+
+		static bool isInside(int x, int y, int z) {
+			return (unsigned)x < sim::CHUNK_SIZE && (unsigned)y < sim::CHUNK_SIZE && (unsigned)z < sim::CHUNK_SIZE;
+		}
+
+		// The halo is always linear and reaches one cell past the chunk, chunks use their own layout
+		static int cellIndex(int x, int y, int z) {
+			return HALO ? x + z * ROW_STRIDE + y * LAYER_STRIDE : sim::Chunk::index(x, y, z);
+		}
+
+		// Chunk holding a position next to this chunk, through the cached neighbour pointers
+		sim::Chunk* neighbourChunk(int x, int y, int z) {
+			return chunk.getNeighbour(x >> sim::CHUNK_SHIFT, y >> sim::CHUNK_SHIFT, z >> sim::CHUNK_SHIFT);
+		}
+
+		sim::Cell* neighbour(int x, int y, int z) {
+			// Missing and compressed chunks are walls in the halo, so there is always a cell to look at
+			if (HALO || isInside(x, y, z)) {
+				return &cells[cellIndex(x, y, z)];
+			}
+
+			// Out of bounds, or a chunk that wasn't created or expanded because nothing next to it was active
+			sim::Chunk* other = neighbourChunk(x, y, z);
+
+			return other != nullptr && other->isDense() ? &other->at(x & sim::CHUNK_MASK, y & sim::CHUNK_MASK, z & sim::CHUNK_MASK) : nullptr;
+		}
+
+		// The cell stays where it is, flagged, until the outboxes are applied
+		bool queueMove(sim::Cell& cell, int x, int y, int z) {
+			sim::Chunk* other = neighbourChunk(x, y, z);
+
+			if (other == nullptr || !other->isDense())
+				return false;
+
+			int localX = x & sim::CHUNK_MASK;
+			int localY = y & sim::CHUNK_MASK;
+			int localZ = z & sim::CHUNK_MASK;
+
+			sim::Cell target = other->getBorderCell(localX, localY, localZ);
+
+			if (!sim::canDisplace(cell.material, target.material))
+				return false;
+
+			chunk.getOutbox().push_back(sim::OutboxMove{ other, (uint8_t)sourceX, (uint8_t)sourceY, (uint8_t)sourceZ,
+				(uint8_t)localX, (uint8_t)localY, (uint8_t)localZ, target });
+
+			cell.flags = (cell.flags & ~CELL_FLAG_STAMP) | stamp | CELL_FLAG_OUTBOX;
+			brickMoved = true;
+
+			targetX = x;
+			targetY = y;
+			targetZ = z;
+
+			return true;
+		}
+
+		bool tryMove(sim::Cell& cell, int x, int y, int z) {
+			if (OUTBOX && !isInside(x, y, z))
+				return queueMove(cell, x, y, z);
+
+			sim::Cell* target = neighbour(x, y, z);
+
+			if (target == nullptr || !sim::canDisplace(cell.material, target->material))
+				return false;
+
+			// A cell waiting to leave can't be pushed aside, the outbox expects to find it there
+			if (OUTBOX && (target->flags & CELL_FLAG_OUTBOX) != 0)
+				return false;
+
+			sim::Cell moved = cell;
+			cell = *target;
+			*target = moved;
+
+			brickMoved = true;
+
+			// This chunk is marked once the whole tick is done, neighbours have to be told right away. The halo
+			// is written back in one go, which tells them then
+			if (!HALO && !isInside(x, y, z)) {
+				sim::Chunk* other = neighbourChunk(x, y, z);
+
+				// Only moves across a chunk face change how many filled cells each side holds
+				int filled = (moved.material != sim::MATERIAL_AIR ? 1 : 0) - (cell.material != sim::MATERIAL_AIR ? 1 : 0);
+
+				if (filled != 0) {
+					other->addFilledCells(filled);
+					chunk.addFilledCells(-filled);
+				}
+
+				other->markChanged();
+			}
+
+			targetX = x;
+			targetY = y;
+			targetZ = z;
+
+			// Stamp both cells so neither is updated again this tick
+			cell.flags = (cell.flags & ~CELL_FLAG_STAMP) | stamp;
+			target->flags = (target->flags & ~CELL_FLAG_STAMP) | stamp;
+
+			return true;
+		}
+
+		// x, y, z is the position of the cell, the sides are tried one level below it when down is set
+		bool trySides(sim::Cell& cell, int x, int y, int z, bool down) {
+			uint32_t salt = down ? sim::RANDOM_SALT_DIAGONAL : sim::RANDOM_SALT_LATERAL;
+			int start = sim::randomForCell(seed, tick, baseX + x, baseY + y, baseZ + z, salt) & 3;
+
+			if (down)
+				y--;
+
+			for (int i = 0; i < 4; i++) {
+				const int* offset = SIDE_OFFSETS[(start + i) & 3];
+
+				if (tryMove(cell, x + offset[0], y, z + offset[1]))
+					return true;
+			}
+
+			return false;
+		}
+
+		bool updateGranular(sim::Cell& cell, int x, int y, int z) {
+			if (fastFalls)
+				return fallFast(cell, x, y, z);
+
+			return tryMove(cell, x, y - 1, z) || trySides(cell, x, y, z, true);
+		}
+
+		// Where the cell of the last successful move is now. One waiting in the outbox is still where it was
+		sim::Cell* movedCell(sim::Cell& cell) {
+			return OUTBOX && !isInside(targetX, targetY, targetZ) ? &cell : neighbour(targetX, targetY, targetZ);
+		}
+
+		// Falls one cell per tick faster than on the last one, up to FALL_SPEED_MAX, along the line its speed and
+		// drift take it, through air only. Where something is in the way the cell stops, and keeps no more speed
+		// than that has, so a falling column stays together and a cell landing on the ground comes to rest. One
+		// at rest that can't take the first step of its line falls or slides a single cell like without fast
+		// falls, and drifts on towards the side it slid to. A line reaches FALL_SPEED_MAX cells into the chunk
+		// below at most and one cell to the side, chunks of the same parity class are much further apart. With
+		// outboxes leaving the chunk ends the line, the next tick carries on from there
+		bool fallFast(sim::Cell& cell, int x, int y, int z) {
+			int speed = std::min(sim::getFallSpeed(cell) + 1, sim::FALL_SPEED_MAX);
+			int drift = sim::getFallDrift(cell);
+			int endX = x + (drift != sim::FALL_NO_DRIFT ? sim::FALL_DRIFT_OFFSETS[drift][0] : 0);
+			int endZ = z + (drift != sim::FALL_NO_DRIFT ? sim::FALL_DRIFT_OFFSETS[drift][1] : 0);
+
+			// The cells passed are all air, so the cell swaps with the last of them in one move
+			sim::LineWalk line(x, y, z, endX, y - speed, endZ);
+			int toX = x;
+			int toY = y;
+			int toZ = z;
+			bool landed = false;
+			int blockerSpeed = 0;
+
+			while (line.next()) {
+				sim::Cell next = peekCell(line.getX(), line.getY(), line.getZ());
+
+				if (next.material != sim::MATERIAL_AIR) {
+					blockerSpeed = sim::getMaterialState(next.material) == sim::MATERIAL_STATE_GRANULAR ? sim::getFallSpeed(next) : 0;
+					landed = true;
+					break;
+				}
+
+				toX = line.getX();
+				toY = line.getY();
+				toZ = line.getZ();
+
+				// A neighbour ticking at the same time takes a single move
+				if (OUTBOX && !isInside(toX, toY, toZ))
+					break;
+			}
+
+			bool moved = toY != y && tryMove(cell, toX, toY, toZ);
+			sim::Cell* moving = moved ? movedCell(cell) : &cell;
+
+			// Resting on a cell that is still falling, it was woken by that cell and tries again once it moved
+			if (!moved && blockerSpeed > 0) {
+				sim::setFallVelocity(cell, std::min(speed, blockerSpeed), sim::FALL_NO_DRIFT);
+				return false;
+			}
+
+			if (!moved) {
+				// Starts over from rest
+				sim::setFallVelocity(cell, 0, sim::FALL_NO_DRIFT);
+
+				if (!tryMove(cell, x, y - 1, z) && !trySides(cell, x, y, z, true))
+					return false;
+
+				moving = movedCell(cell);
+				landed = false;
+				speed = 1;
+				drift = sim::FALL_NO_DRIFT;
+
+				for (int side = 0; side < 4; side++) {
+					if (targetX - x == SIDE_OFFSETS[side][0] && targetZ - z == SIDE_OFFSETS[side][1])
+						drift = side;
+				}
+			}
+
+			if (landed)
+				sim::setFallVelocity(*moving, std::min(speed, blockerSpeed), sim::FALL_NO_DRIFT);
+			else
+				sim::setFallVelocity(*moving, speed, drift);
+
+			return true;
+		}
+
+		bool updateLiquid(sim::Cell& cell, int x, int y, int z) {
+			return tryMove(cell, x, y - 1, z) || trySides(cell, x, y, z, true) || (spreads(cell, x, y, z) && trySides(cell, x, y, z, false));
+		}
+
+		// Liquid with levels already flowed down into air and its own kind in flowLayerDown, here it only sinks
+		// through lighter materials as a whole cell and then evens out with its sides
+		bool updateLevels(sim::Cell& cell, int x, int y, int z) {
+			// Across a face ticking at the same time it can only move as a whole cell, through the outbox
+			if (OUTBOX && !isInside(x, y - 1, z)) {
+				if (tryMove(cell, x, y - 1, z))
+					return true;
+			}
+			else {
+				sim::Cell* below = neighbour(x, y - 1, z);
+
+				if (below != nullptr && below->material != sim::MATERIAL_AIR && below->material != cell.material && tryMove(cell, x, y - 1, z))
+					return true;
+			}
+
+			return spreads(cell, x, y, z) && (spreadLevels(cell, x, y, z) || pushUnderPressure(cell, x, y, z));
+		}
+
+		// Gas already rose in riseGas, here it thins out sideways or, once it is too thin, dissolves
+		bool updateGas(sim::Cell& cell, int x, int y, int z) {
+			if (sim::getLiquidLevel(cell) > sim::GAS_DISSOLVE_LEVEL)
+				return spreads(cell, x, y, z) && spreadLevels(cell, x, y, z);
+
+			sim::setLiquidLevel(cell, cell.material, 0);
+			chunk.addFilledCells(-1);
+
+			targetX = x;
+			targetY = y;
+			targetZ = z;
+
+			return true;
+		}
+
+		// Looks along each side for the lowest level within reach, over partly filled cells of the same liquid up to
+		// the first air or full cell, and hands it half the difference if that is two or more, up to the flow budget.
+		// The sides are visited from a random one on, each sees what the ones before it left. A difference of one is
+		// left alone, so a body of liquid comes to rest once its surface is level to within a unit over the reach
+		bool spreadLevels(sim::Cell& cell, int x, int y, int z) {
+			int start = sim::randomForCell(seed, tick, baseX + x, baseY + y, baseZ + z, sim::RANDOM_SALT_LATERAL) & 3;
+			int level = sim::getLiquidLevel(cell);
+			bool spread = false;
+
+			for (int i = 0; i < 4 && level > 1; i++) {
+				const int* offset = SIDE_OFFSETS[(start + i) & 3];
+
+				sim::Cell* lowest = nullptr;
+				int lowestLevel = level;
+				int lowestX = 0;
+				int lowestZ = 0;
+
+				for (int step = 1; step <= sim::LIQUID_REACH; step++) {
+					int sideX = x + offset[0] * step;
+					int sideZ = z + offset[1] * step;
+
+					// Neighbours ticking at the same time only take whole cells
+					if (OUTBOX && !isInside(sideX, y, sideZ))
+						break;
+
+					sim::Cell* side = neighbour(sideX, y, sideZ);
+
+					if (side == nullptr || (side->material != sim::MATERIAL_AIR && side->material != cell.material))
+						break;
+
+					if (OUTBOX && (side->flags & CELL_FLAG_OUTBOX) != 0)
+						break;
+
+					int sideLevel = side->material == sim::MATERIAL_AIR ? 0 : sim::getLiquidLevel(*side);
+
+					if (sideLevel < lowestLevel) {
+						lowest = side;
+						lowestLevel = sideLevel;
+						lowestX = sideX;
+						lowestZ = sideZ;
+					}
+
+					// Only the open surface carries the pressure on, and a halo only reaches one cell past the chunk
+					if (sideLevel == 0 || sideLevel >= sim::LIQUID_LEVEL_FULL || !isInside(sideX, y, sideZ))
+						break;
+				}
+
+				int flow = std::min((level - lowestLevel) / 2, sim::LIQUID_FLOW_BUDGET);
+
+				if (flow <= 0)
+					continue;
+
+				if (lowestLevel == 0)
+					levelFilled(lowestX, y, lowestZ, 1);
+
+				level -= flow;
+
+				sim::setLiquidLevel(*lowest, cell.material, lowestLevel + flow);
+				lowest->flags = (lowest->flags & ~CELL_FLAG_STAMP) | stamp;
+
+				wakeAround(lowestX, y, lowestZ);
+				spread = true;
+			}
+
+			if (!spread)
+				return false;
+
+			// Never runs dry, at least one unit stays
+			sim::setLiquidLevel(cell, cell.material, level);
+
+			targetX = x;
+			targetY = y;
+			targetZ = z;
+
+			return true;
+		}
+
+		// A surface cell resting on its own liquid searches down into it through full cells, depth first, for a cell
+		// below its own height with room left and pushes as much there as fits. The search goes down while it can,
+		// then on the way it was going and then up, so it follows a U bend up the other side. Every push moves
+		// liquid down, so the pushing comes to an end once both sides of a body are level to within a cell. The
+		// search stays within one cell of the chunk, so the top layer of a chunk pushes for the liquid above it
+		bool pushUnderPressure(sim::Cell& cell, int x, int y, int z) {
+			const int DIRECTIONS[6][3] = { { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 }, { -1, 0, 0 }, { 0, 0, -1 }, { 0, 1, 0 } };
+
+			// The order of the directions after arriving in each of them
+			const int ORDERS[6][6] = { { 0, 1, 2, 3, 4, 5 }, { 0, 1, 5, 2, 3, 4 }, { 0, 2, 5, 1, 3, 4 }, { 0, 3, 5, 1, 2, 4 }, { 0, 4, 5, 1, 2, 3 }, { 5, 1, 2, 3, 4, 0 } };
+
+			// Neighbours ticking at the same time can't be searched
+			if (OUTBOX && y == 0)
+				return false;
+
+			sim::Cell* below = neighbour(x, y - 1, z);
+
+			if (below == nullptr || below->material != cell.material || sim::getLiquidLevel(*below) < sim::LIQUID_LEVEL_FULL)
+				return false;
+
+			// Liquid further down is pressed on by the surface above it already
+			if (y < sim::CHUNK_MASK && peekMaterial(x, y + 1, z) == cell.material)
+				return false;
+
+			uint16_t& start = tPressureVisits[HALO_ORIGIN + x + z * HALO_SIZE + (y - 1) * HALO_AREA];
+			uint16_t search = pressureSearch + y;
+
+			// Searches from the same height share their marks during a chunk update, a cell an earlier one went
+			// through is left to it. That keeps a level body from being searched all over again from every cell of
+			// its surface, and lets a narrow passage carry only as many pushes as it has cells
+			if (start == search)
+				return false;
+
+			start = search;
+
+			// Position, the direction it was entered in and the number of directions tried of every cell on the way
+			int path[sim::LIQUID_PRESSURE_REACH][5];
+			int depth = 1;
+			int visited = 1;
+
+			path[0][0] = x;
+			path[0][1] = y - 1;
+			path[0][2] = z;
+			path[0][3] = 0;
+			path[0][4] = 0;
+
+			while (depth > 0) {
+				int* from = path[depth - 1];
+
+				if (from[4] == 6) {
+					depth--;
+					continue;
+				}
+
+				int directionIndex = ORDERS[from[3]][from[4]++];
+				const int* direction = DIRECTIONS[directionIndex];
+				int nextX = from[0] + direction[0];
+				int nextY = from[1] + direction[1];
+				int nextZ = from[2] + direction[2];
+
+				// Never up to the height of the surface, and no further out than a halo reaches
+				if (nextY >= y || (OUTBOX && !isInside(nextX, nextY, nextZ)))
+					continue;
+
+				if ((unsigned)(nextX + 1) >= HALO_SIZE || (unsigned)(nextY + 1) >= HALO_SIZE || (unsigned)(nextZ + 1) >= HALO_SIZE)
+					continue;
+
+				uint16_t& visit = tPressureVisits[HALO_ORIGIN + nextX + nextZ * HALO_SIZE + nextY * HALO_AREA];
+
+				if (visit == search)
+					continue;
+
+				visit = search;
+
+				sim::Cell* next = neighbour(nextX, nextY, nextZ);
+
+				if (next == nullptr || (next->material != sim::MATERIAL_AIR && next->material != cell.material))
+					continue;
+
+				if (OUTBOX && (next->flags & CELL_FLAG_OUTBOX) != 0)
+					continue;
+
+				int nextLevel = next->material == sim::MATERIAL_AIR ? 0 : sim::getLiquidLevel(*next);
+
+				if (nextLevel < sim::LIQUID_LEVEL_FULL) {
+					pushInto(cell, x, y, z, *next, nextX, nextY, nextZ, nextLevel);
+					return true;
+				}
+
+				if (visited == sim::LIQUID_PRESSURE_REACH)
+					return false;
+
+				int* step = path[depth++];
+				step[0] = nextX;
+				step[1] = nextY;
+				step[2] = nextZ;
+				step[3] = directionIndex;
+				step[4] = 0;
+				visited++;
+			}
+
+			return false;
+		}
+
+		void pushInto(sim::Cell& cell, int x, int y, int z, sim::Cell& target, int targetX, int targetY, int targetZ, int targetLevel) {
+			int level = sim::getLiquidLevel(cell);
+			int flow = std::min(std::min(level, sim::LIQUID_LEVEL_FULL - targetLevel), sim::LIQUID_FLOW_BUDGET);
+
+			if (targetLevel == 0)
+				levelFilled(targetX, targetY, targetZ, 1);
+
+			if (flow == level)
+				levelFilled(x, y, z, -1);
+
+			sim::setLiquidLevel(target, cell.material, targetLevel + flow);
+			target.flags = (target.flags & ~CELL_FLAG_STAMP) | stamp;
+
+			sim::setLiquidLevel(cell, cell.material, level - flow);
+
+			this->targetX = targetX;
+			this->targetY = targetY;
+			this->targetZ = targetZ;
+		}
+
+		// Counts a cell that turned from air into liquid or back. Within the chunk, and in the halo which is
+		// written back with its own count, that is the count of this chunk. Neighbours have to be told right away
+		void levelFilled(int x, int y, int z, int filled) {
+			if (HALO || isInside(x, y, z)) {
+				chunk.addFilledCells(filled);
+				return;
+			}
+
+			sim::Chunk* other = neighbourChunk(x, y, z);
+
+			other->addFilledCells(filled);
+			other->markChanged();
+		}
+
+		// Viscous liquids only spread sideways on some ticks, the others never draw for it
+		bool spreads(const sim::Cell& cell, int x, int y, int z) {
+			uint8_t viscosity = sim::getMaterialViscosity(cell.material);
+
+			return viscosity == 0 || (sim::randomForCell(seed, tick, baseX + x, baseY + y, baseZ + z, sim::RANDOM_SALT_VISCOSITY) & 0xFF) >= viscosity;
+		}
+
+		// Position relative to this chunk, may be up to one chunk outside of it
+		void wakeBrick(int x, int y, int z) {
+			if (isInside(x, y, z)) {
+				localWakes |= 1ull << sim::Chunk::brickIndex(x, y, z);
+				return;
+			}
+
+			sim::Chunk* other = neighbourChunk(x, y, z);
+
+			if (other != nullptr)
+				other->wakeBricks(1ull << sim::Chunk::brickIndex(x & sim::CHUNK_MASK, y & sim::CHUNK_MASK, z & sim::CHUNK_MASK));
+		}
+
+		void wakeAround(int x, int y, int z) {
+			// Most moves happen away from the chunk faces, those only need to touch the local mask
+			if (x > 0 && x < sim::CHUNK_MASK && y > 0 && y < sim::CHUNK_MASK && z > 0 && z < sim::CHUNK_MASK) {
+				for (int i = 0; i < 8; i++) {
+					localWakes |= 1ull << sim::Chunk::brickIndex(x + ((i & 1) ? 1 : -1), y + ((i & 2) ? 1 : -1), z + ((i & 4) ? 1 : -1));
+				}
+			}
+			else {
+				for (int i = 0; i < 8; i++) {
+					wakeBrick(x + ((i & 1) ? 1 : -1), y + ((i & 2) ? 1 : -1), z + ((i & 4) ? 1 : -1));
+				}
+			}
+		}
+
+		// Wakes the bricks around a whole layer of falls at once. The emptied cells are at y and the filled ones at
+		// y - 1, so their neighbourhoods span y - 2 to y + 1, plus one brick over wherever a fall touched a brick face
+		void wakeFallen(uint64_t fell, int startX, int y, int startZ) {
+			const uint64_t FIRST_COLUMN = 0x0101010101010101ull;
+			const uint64_t FIRST_ROW = 0xFFull;
+
+			int brickX = startX >> sim::BRICK_SHIFT;
+			int brickZ = startZ >> sim::BRICK_SHIFT;
+
+			int minBrickX = brickX - ((fell & FIRST_COLUMN) != 0 ? 1 : 0);
+			int maxBrickX = brickX + ((fell & (FIRST_COLUMN << (sim::BRICK_SIZE - 1))) != 0 ? 1 : 0);
+			int minBrickZ = brickZ - ((fell & FIRST_ROW) != 0 ? 1 : 0);
+			int maxBrickZ = brickZ + ((fell & (FIRST_ROW << (sim::BRICK_SIZE * (sim::BRICK_SIZE - 1)))) != 0 ? 1 : 0);
+			int minBrickY = (y - 2) >> sim::BRICK_SHIFT;
+			int maxBrickY = (y + 1) >> sim::BRICK_SHIFT;
+
+			for (int by = minBrickY; by <= maxBrickY; by++) {
+				for (int bz = minBrickZ; bz <= maxBrickZ; bz++) {
+					for (int bx = minBrickX; bx <= maxBrickX; bx++) {
+						wakeBrick(bx * sim::BRICK_SIZE, by * sim::BRICK_SIZE, bz * sim::BRICK_SIZE);
+					}
+				}
+			}
+		}
+
+		// Runs a bulk kernel over one 8x8 layer of a brick and the layer below it. Only used above the bottom
+		// of the chunk, where the layer below is in the same cell array. The kernel returns whether it changed
+		// anything
+		template<typename Kernel>
+		void runLayerKernel(int startX, int y, int startZ, Kernel kernel) {
+			if (HALO || sim::CellLayout::CONTIGUOUS_ROWS) {
+				sim::Cell* layer = &cells[cellIndex(startX, y, startZ)];
+				kernel(layer, layer - LAYER_STRIDE, ROW_STRIDE);
+				return;
+			}
+
+			// The kernels need rows along x in one piece, so other layouts go through a linear copy of both layers
+			sim::Cell layer[sim::BRICK_SIZE * sim::BRICK_SIZE];
+			sim::Cell below[sim::BRICK_SIZE * sim::BRICK_SIZE];
+
+			for (int z = 0; z < sim::BRICK_SIZE; z++) {
+				for (int x = 0; x < sim::BRICK_SIZE; x++) {
+					layer[x + z * sim::BRICK_SIZE] = cells[cellIndex(startX + x, y, startZ + z)];
+					below[x + z * sim::BRICK_SIZE] = cells[cellIndex(startX + x, y - 1, startZ + z)];
+				}
+			}
+
+			if (!kernel(layer, below, sim::BRICK_SIZE))
+				return;
+
+			for (int z = 0; z < sim::BRICK_SIZE; z++) {
+				for (int x = 0; x < sim::BRICK_SIZE; x++) {
+					cells[cellIndex(startX + x, y, startZ + z)] = layer[x + z * sim::BRICK_SIZE];
+					cells[cellIndex(startX + x, y - 1, startZ + z)] = below[x + z * sim::BRICK_SIZE];
+				}
+			}
+		}
+
+		// Drops every granular cell of the layer that has air right below it
+		void fallLayerInBulk(int startX, int y, int startZ) {
+			runLayerKernel(startX, y, startZ, [&](sim::Cell* layer, sim::Cell* below, int rowStride) {
+				return fallLayers(layer, below, rowStride, startX, y, startZ);
+			});
+		}
+
+		// Runs the fall kernel for every granular material, returns whether anything fell
+		bool fallLayers(sim::Cell* layer, sim::Cell* below, int rowStride, int startX, int y, int startZ) {
+			const sim::MaterialTables& tables = sim::MaterialRegistry::getTables();
+			bool anyFell = false;
+
+			for (int i = 0; i < tables.granularCount; i++) {
+				uint8_t material = tables.granularMaterials[i];
+				uint64_t fell = fallLayer(layer, below, rowStride, material, stamp);
+
+				if (fell == 0)
+					continue;
+
+				anyFell = true;
+				brickMoved = true;
+				cellsMoved += util::popCount(fell);
+
+				wakeFallen(fell, startX, y, startZ);
+			}
+
+			return anyFell;
+		}
+
+		// Lets the liquid levels of the layer flow into the layer below it
+		void flowLayerDown(int startX, int y, int startZ) {
+			if (y == 0) {
+				flowChunkBottom(startX, startZ);
+				return;
+			}
+
+			runLayerKernel(startX, y, startZ, [&](sim::Cell* layer, sim::Cell* below, int rowStride) {
+				return flowLayers(layer, below, rowStride, startX, y, startZ);
+			});
+		}
+
+		// Runs the flow kernel for every liquid material, returns whether anything flowed
+		bool flowLayers(sim::Cell* layer, sim::Cell* below, int rowStride, int startX, int y, int startZ) {
+			const sim::MaterialTables& tables = sim::MaterialRegistry::getTables();
+			bool anyFlowed = false;
+
+			for (int i = 0; i < tables.liquidCount; i++) {
+				sim::LayerFlow flow = flowLayer(layer, below, rowStride, tables.liquidMaterials[i], stamp);
+
+				if (flow.changed == 0)
+					continue;
+
+				// Both layers are in this chunk
+				if (flow.filled != 0)
+					chunk.addFilledCells(flow.filled);
+
+				anyFlowed = true;
+				brickMoved = true;
+				cellsMoved += util::popCount(flow.changed);
+
+				wakeFallen(flow.changed, startX, y, startZ);
+			}
+
+			return anyFlowed;
+		}
+
+		// The bottom layer of the chunk flows into the chunk below one cell at a time
+		void flowChunkBottom(int startX, int startZ) {
+			flowChunkFace(startX, startZ, 0, -1, sim::MATERIAL_STATE_LIQUID);
+		}
+
+		// Gas of the top layer of the chunk rises into the chunk above one cell at a time
+		void riseChunkTop(int startX, int startZ) {
+			flowChunkFace(startX, startZ, sim::CHUNK_SIZE - 1, sim::CHUNK_SIZE, sim::MATERIAL_STATE_GAS);
+		}
+
+		// Runs flowDown for the columns of a brick from layer y of the chunk into layer targetY of the neighbour
+		// above or below, for whichever material of the state each column holds
+		void flowChunkFace(int startX, int startZ, int y, int targetY, sim::MaterialState state) {
+			// Neighbours ticking at the same time only take whole cells
+			if (OUTBOX)
+				return;
+
+			uint64_t changed = 0;
+
+			for (int z = startZ; z < startZ + sim::BRICK_SIZE; z++) {
+				for (int x = startX; x < startX + sim::BRICK_SIZE; x++) {
+					sim::Cell& cell = cells[cellIndex(x, y, z)];
+					sim::Cell* target = neighbour(x, targetY, z);
+
+					if (target == nullptr)
+						continue;
+
+					uint8_t material = sim::getMaterialState(cell.material) == state ? cell.material : target->material;
+
+					if (material == sim::MATERIAL_AIR || sim::getMaterialState(material) != state)
+						continue;
+
+					bool wasFilled = cell.material != sim::MATERIAL_AIR;
+					bool targetWasFilled = target->material != sim::MATERIAL_AIR;
+					bool flowed = false;
+
+					sim::flowDown(cell, *target, material, stamp, flowed);
+
+					if (!flowed)
+						continue;
+
+					int filled = (cell.material != sim::MATERIAL_AIR ? 1 : 0) - (wasFilled ? 1 : 0);
+					int targetFilled = (target->material != sim::MATERIAL_AIR ? 1 : 0) - (targetWasFilled ? 1 : 0);
+
+					if (filled != 0)
+						chunk.addFilledCells(filled);
+
+					levelFilled(x, targetY, z, targetFilled);
+
+					changed |= 1ull << ((x - startX) + (z - startZ) * sim::BRICK_SIZE);
+				}
+			}
+
+			if (changed == 0)
+				return;
+
+			brickMoved = true;
+			cellsMoved += util::popCount(changed);
+
+			wakeFallen(changed, startX, std::max(y, targetY), startZ);
+		}
+
+		// Lets the gas of the layer below y rise into layer y
+		void riseLayerUp(int startX, int y, int startZ) {
+			if (y == sim::CHUNK_SIZE) {
+				riseChunkTop(startX, startZ);
+				return;
+			}
+
+			runLayerKernel(startX, y, startZ, [&](sim::Cell* layer, sim::Cell* below, int rowStride) {
+				return riseLayers(layer, below, rowStride, startX, y, startZ);
+			});
+		}
+
+		// Runs the flow kernel the other way up for every gas, returns whether anything rose
+		bool riseLayers(sim::Cell* layer, sim::Cell* below, int rowStride, int startX, int y, int startZ) {
+			const sim::MaterialTables& tables = sim::MaterialRegistry::getTables();
+			bool anyRose = false;
+
+			for (int i = 0; i < tables.gasCount; i++) {
+				sim::LayerFlow flow = riseLayer(below, layer, rowStride, tables.gasMaterials[i], stamp);
+
+				if (flow.changed == 0)
+					continue;
+
+				// Both layers are in this chunk
+				if (flow.filled != 0)
+					chunk.addFilledCells(flow.filled);
+
+				anyRose = true;
+				brickMoved = true;
+				cellsMoved += util::popCount(flow.changed);
+
+				wakeFallen(flow.changed, startX, y, startZ);
+			}
+
+			return anyRose;
+		}
+
+		// Gas rises one cell before anything else moves. Bricks go from the top down and so do the layers within
+		// them, so gas that rose into a layer is never lifted again on the same tick and a column rises as one.
+		// Each brick lifts its own top layer into the one above it
+		void riseGas(uint64_t activeBricks) {
+			while (activeBricks != 0) {
+				int brick = 63 - util::countLeadingZeros(activeBricks);
+				activeBricks &= ~(1ull << brick);
+
+				int startX = (brick & 3) << sim::BRICK_SHIFT;
+				int startZ = ((brick >> 2) & 3) << sim::BRICK_SHIFT;
+				int startY = (brick >> 4) << sim::BRICK_SHIFT;
+
+				for (int y = startY + sim::BRICK_SIZE; y > startY; y--) {
+					riseLayerUp(startX, y, startZ);
+				}
+			}
+		}
+
+		// The kernel of one state. Every material of a state shares it, so new materials add no branches
+		template<sim::MaterialState STATE>
+		void updateCellAs(sim::Cell& cell, int x, int y, int z) {
+			static_assert(STATE != sim::MATERIAL_STATE_SOLID, "Solid cells never move");
+
+			// Already moved this tick. A brick that just woke up can hold cells with a stamp left over from
+			// before it fell asleep, those cells wait one extra tick
+			if ((cell.flags & CELL_FLAG_STAMP) == stamp)
+				return;
+
+			cell.flags = (cell.flags & ~CELL_FLAG_STAMP) | stamp;
+
+			if (OUTBOX) {
+				sourceX = x;
+				sourceY = y;
+				sourceZ = z;
+			}
+
+			bool moved;
+
+			if constexpr (STATE == sim::MATERIAL_STATE_GRANULAR) {
+				moved = updateGranular(cell, x, y, z);
+			}
+			else if constexpr (STATE == sim::MATERIAL_STATE_GAS) {
+				moved = updateGas(cell, x, y, z);
+			}
+			else {
+				moved = flowLayer != nullptr ? updateLevels(cell, x, y, z) : updateLiquid(cell, x, y, z);
+			}
+
+			if (moved) {
+				cellsMoved++;
+
+				// Both the emptied and the filled position may let their neighbours move again
+				wakeAround(x, y, z);
+				wakeAround(targetX, targetY, targetZ);
+			}
+		}
+
+		// Moves the cells of one 8x8 layer of a brick in x, z order, then runs the reactions of the layer
+		void updateLayer(int startX, int y, int startZ) {
+			for (int z = startZ; z < startZ + sim::BRICK_SIZE; z++) {
+				for (int x = startX; x < startX + sim::BRICK_SIZE; x++) {
+					sim::Cell& cell = cells[cellIndex(x, y, z)];
+					sim::MaterialState state = sim::getMaterialState(cell.material);
+
+					if (state == sim::MATERIAL_STATE_GRANULAR) {
+						updateCellAs<sim::MATERIAL_STATE_GRANULAR>(cell, x, y, z);
+					}
+					else if (state == sim::MATERIAL_STATE_LIQUID) {
+						updateCellAs<sim::MATERIAL_STATE_LIQUID>(cell, x, y, z);
+					}
+					else if (state == sim::MATERIAL_STATE_GAS && cell.material != sim::MATERIAL_AIR) {
+						updateCellAs<sim::MATERIAL_STATE_GAS>(cell, x, y, z);
+					}
+				}
+			}
+
+			if (!sim::MaterialRegistry::getTables().reactions.empty())
+				reactLayer(startX, y, startZ);
+		}
+
+		// A cell in or next to this chunk as the tick sees it, MATERIAL_NONE where there is none
+		sim::Cell peekCell(int x, int y, int z) {
+			if (HALO || isInside(x, y, z))
+				return cells[cellIndex(x, y, z)];
+
+			sim::Chunk* other = neighbourChunk(x, y, z);
+
+			if (other == nullptr || !other->isDense())
+				return sim::Cell{ sim::MATERIAL_NONE, 0 };
+
+			// Neighbours ticking at the same time only have their faces to show
+			if (OUTBOX)
+				return other->getBorderCell(x & sim::CHUNK_MASK, y & sim::CHUNK_MASK, z & sim::CHUNK_MASK);
+
+			return other->at(x & sim::CHUNK_MASK, y & sim::CHUNK_MASK, z & sim::CHUNK_MASK);
+		}
+
+		uint8_t peekMaterial(int x, int y, int z) {
+			return peekCell(x, y, z).material;
+		}
+
+		bool touches(int x, int y, int z, uint8_t material) {
+			const int FACES[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+
+			for (const int* face : FACES) {
+				if (peekMaterial(x + face[0], y + face[1], z + face[2]) == material)
+					return true;
+			}
+
+			return false;
+		}
+
+		// Runs the reactions of the registry for the cells of a layer once they are done moving. Each cell draws
+		// one random number per tick, the first of its reactions that it passes and whose trigger it touches wins
+		void reactLayer(int startX, int y, int startZ) {
+			const sim::MaterialTables& tables = sim::MaterialRegistry::getTables();
+
+			for (int z = startZ; z < startZ + sim::BRICK_SIZE; z++) {
+				for (int x = startX; x < startX + sim::BRICK_SIZE; x++) {
+					sim::Cell& cell = cells[cellIndex(x, y, z)];
+					int count = tables.reactionCounts[cell.material];
+
+					if (count == 0)
+						continue;
+
+					const sim::MaterialReaction* reactions = &tables.reactions[tables.firstReactions[cell.material]];
+					uint32_t roll = sim::randomForCell(seed, tick, baseX + x, baseY + y, baseZ + z, sim::RANDOM_SALT_REACTION) & 0xFFFF;
+					uint8_t result = sim::MATERIAL_NONE;
+
+					for (int i = 0; i < count && result == sim::MATERIAL_NONE; i++) {
+						if (roll < reactions[i].chance && touches(x, y, z, reactions[i].trigger))
+							result = reactions[i].result;
+					}
+
+					if (result == sim::MATERIAL_NONE)
+						continue;
+
+					// Only this chunk holds the cell, even in a halo
+					int filled = (result != sim::MATERIAL_AIR ? 1 : 0) - (cell.material != sim::MATERIAL_AIR ? 1 : 0);
+
+					if (filled != 0)
+						chunk.addFilledCells(filled);
+
+					// Whatever it turns into is a whole cell
+					cell.material = result;
+					cell.flags = (cell.flags & ~(CELL_FLAG_STAMP | CELL_LEVEL_MASK)) | stamp;
+
+					brickMoved = true;
+					wakeAround(x, y, z);
+				}
+			}
+		}
+
+		// Copies a run of cells along x, all in the same chunk, into the halo or back out of it
+		void copyRun(int x, int count, int y, int z, bool writeBack) {
+			sim::Cell* halo = &cells[cellIndex(x, y, z)];
+			sim::Chunk* other = neighbourChunk(x, y, z);
+
+			if (other == nullptr || !other->isDense()) {
+				if (!writeBack)
+					std::fill(halo, halo + count, HALO_WALL);
+
+				return;
+			}
+
+			int localX = x & sim::CHUNK_MASK;
+			int localY = y & sim::CHUNK_MASK;
+			int localZ = z & sim::CHUNK_MASK;
+
+			if (!sim::CellLayout::CONTIGUOUS_ROWS) {
+				copyCellByCell(other, halo, localX, localY, localZ, count, writeBack);
+				return;
+			}
+
+			sim::Cell* source = &other->at(localX, localY, localZ);
+
+			if (!writeBack) {
+				memcpy(halo, source, sizeof(sim::Cell) * count);
+				return;
+			}
+
+			if (other == &chunk) {
+				memcpy(source, halo, sizeof(sim::Cell) * count);
+				return;
+			}
+
+			// Moves across a chunk face change how many filled cells each side holds. Boxes of neighbouring
+			// bricks overlap, a cell written back once already matches the second time
+			int filled = 0;
+			bool changed = false;
+
+			for (int i = 0; i < count; i++) {
+				if (halo[i].material == source[i].material && halo[i].flags == source[i].flags)
+					continue;
+
+				filled += (halo[i].material != sim::MATERIAL_AIR ? 1 : 0) - (source[i].material != sim::MATERIAL_AIR ? 1 : 0);
+				source[i] = halo[i];
+				changed = true;
+			}
+
+			if (filled != 0) {
+				other->addFilledCells(filled);
+				chunk.addFilledCells(-filled);
+			}
+
+			if (changed)
+				other->markChanged();
+		}
+
+		// Same as copyRun for layouts that don't keep rows along x together
+		void copyCellByCell(sim::Chunk* other, sim::Cell* halo, int localX, int localY, int localZ, int count, bool writeBack) {
+			int filled = 0;
+			bool changed = false;
+
+			for (int i = 0; i < count; i++) {
+				sim::Cell& source = other->at(localX + i, localY, localZ);
+
+				if (!writeBack) {
+					halo[i] = source;
+					continue;
+				}
+
+				if (halo[i].material == source.material && halo[i].flags == source.flags)
+					continue;
+
+				filled += (halo[i].material != sim::MATERIAL_AIR ? 1 : 0) - (source.material != sim::MATERIAL_AIR ? 1 : 0);
+				source = halo[i];
+				changed = true;
+			}
+
+			if (other == &chunk || !changed)
+				return;
+
+			if (filled != 0) {
+				other->addFilledCells(filled);
+				chunk.addFilledCells(-filled);
+			}
+
+			other->markChanged();
+		}
+
+		// Every cell a brick can read or move into is in the brick or one cell around it
+		void copyBrickBox(int brick, bool writeBack) {
+			int startX = (brick & 3) << sim::BRICK_SHIFT;
+			int startZ = ((brick >> 2) & 3) << sim::BRICK_SHIFT;
+			int startY = (brick >> 4) << sim::BRICK_SHIFT;
+
+			int minX = startX > 0 ? startX - 1 : 0;
+			int endX = startX + sim::BRICK_SIZE < sim::CHUNK_SIZE ? startX + sim::BRICK_SIZE + 1 : sim::CHUNK_SIZE;
+
+			for (int y = startY - 1; y <= startY + sim::BRICK_SIZE; y++) {
+				for (int z = startZ - 1; z <= startZ + sim::BRICK_SIZE; z++) {
+					// Rows only leave the chunk by a single cell at either end
+					if (startX == 0)
+						copyRun(-1, 1, y, z, writeBack);
+
+					copyRun(minX, endX - minX, y, z, writeBack);
+
+					if (endX == sim::CHUNK_SIZE)
+						copyRun(sim::CHUNK_SIZE, 1, y, z, writeBack);
+				}
+			}
+		}
+
+		// The whole chunk and its halo, cheaper than a box per brick once most of the chunk is awake
+		void copyChunk(bool writeBack) {
+			for (int y = -1; y <= sim::CHUNK_SIZE; y++) {
+				for (int z = -1; z <= sim::CHUNK_SIZE; z++) {
+					copyRun(-1, 1, y, z, writeBack);
+					copyRun(0, sim::CHUNK_SIZE, y, z, writeBack);
+					copyRun(sim::CHUNK_SIZE, 1, y, z, writeBack);
+				}
+			}
+		}
+
+		void copyHalo(uint64_t bricks, bool writeBack) {
+			if (util::popCount(bricks) >= HALO_WHOLE_CHUNK_BRICKS) {
+				copyChunk(writeBack);
+				return;
+			}
+
+			for (; bricks != 0; bricks &= bricks - 1) {
+				copyBrickBox(util::countTrailingZeros(bricks), writeBack);
+			}
+		}
+
+		sim::TickStats run() {
+			sim::TickStats stats;
+
+			// With outboxes every chunk began the tick before any of them ran, so wakes from neighbours that
+			// are already running wait for the next tick no matter how the threads are timed
+			uint64_t activeBricks = OUTBOX ? chunk.getActiveBricks() : chunk.beginTick();
+
+			// Levels look further along the surface than the box around a brick, see spreadLevels
+			uint64_t haloBricks = flowLayer != nullptr || riseLayer != nullptr ? ~0ull : activeBricks;
+
+			if (HALO)
+				copyHalo(haloBricks, false);
+
+			if (flowLayer != nullptr) {
+				tPressureSearch += sim::CHUNK_SIZE;
+
+				if (tPressureSearch == 0) {
+					memset(tPressureVisits, 0, sizeof(tPressureVisits));
+					tPressureSearch = sim::CHUNK_SIZE;
+				}
+
+				pressureSearch = tPressureSearch;
+			}
+
+			if (riseLayer != nullptr)
+				riseGas(activeBricks);
+
+			// Bricks are visited in index order, which keeps the bottom up scan order of the cells
+			while (activeBricks != 0) {
+				int brick = util::countTrailingZeros(activeBricks);
+				activeBricks &= activeBricks - 1;
+
+				int startX = (brick & 3) << sim::BRICK_SHIFT;
+				int startZ = ((brick >> 2) & 3) << sim::BRICK_SHIFT;
+				int startY = (brick >> 4) << sim::BRICK_SHIFT;
+
+				brickMoved = false;
+
+				for (int y = startY; y < startY + sim::BRICK_SIZE; y++) {
+					// Straight falls go first for the whole layer, whatever is left over goes through the full rules
+					if (fallLayer != nullptr && y > 0)
+						fallLayerInBulk(startX, y, startZ);
+
+					if (flowLayer != nullptr)
+						flowLayerDown(startX, y, startZ);
+
+					updateLayer(startX, y, startZ);
+				}
+
+				chunk.endBrick(brick, brickMoved);
+
+				stats.bricksUpdated++;
+			}
+
+			if (HALO)
+				copyHalo(haloBricks, true);
+
+			if (localWakes != 0)
+				chunk.wakeBricks(localWakes);
+
+			if (cellsMoved != 0)
+				chunk.markChanged();
+
+			stats.cellsUpdated = stats.bricksUpdated * sim::BRICK_VOLUME;
+			stats.cellsMoved = cellsMoved;
+
+			return stats;
+		}
+	};
+
+	template<bool HALO, bool OUTBOX>
+	sim::TickStats updateChunkWith(sim::World& world, sim::Chunk& chunk, uint64_t tick) {
+		ChunkUpdater<HALO, OUTBOX> updater{
+			world,
+			chunk,
+			HALO ? tHaloCells + HALO_ORIGIN : chunk.getCells(),
+			chunk.getX() * sim::CHUNK_SIZE,
+			chunk.getY() * sim::CHUNK_SIZE,
+			chunk.getZ() * sim::CHUNK_SIZE,
+			getTickStamp(tick),
+			world.getSeed(),
+			tick,
+			0,
+			false,
+			0,
+			world.getFastFalls() ? nullptr : sim::getFallLayerFunction(world.getFallKernel()),
+			world.getLiquidModel() == sim::LIQUID_MODEL_LEVELS ? sim::getFlowLayerFunction(world.getFallKernel()) : nullptr,
+			sim::MaterialRegistry::getTables().gasCount > 0 ? sim::getFlowLayerFunction(world.getFallKernel()) : nullptr,
+			world.getFastFalls(),
+			0,
+			0, 0, 0,
+			0, 0, 0
+		};
+
+		return updater.run();
+	}
+}
+
+namespace sim {
+	TickStats applyOutboxes(const std::vector<Chunk*>& chunks, uint64_t tick) {
+		TickStats stats;
+		uint8_t stamp = getTickStamp(tick);
+
+		for (Chunk* chunk : chunks) {
+			for (const OutboxMove& move : chunk->getOutbox()) {
+				Cell& source = chunk->at(move.sourceX, move.sourceY, move.sourceZ);
+				Cell& target = move.target->at(move.targetX, move.targetY, move.targetZ);
+
+				stats.movesQueued++;
+
+				// Every successful move changes the material of the target, so a second move into the same
+				// cell never finds what it expects
+				if (target.material != move.expected.material || (target.flags & CELL_FLAG_OUTBOX) != 0) {
+					source.flags &= ~CELL_FLAG_OUTBOX;
+					stats.movesRejected++;
+					continue;
+				}
+
+				Cell moved = source;
+				moved.flags &= ~CELL_FLAG_OUTBOX;
+
+				source = target;
+				source.flags = (source.flags & ~CELL_FLAG_STAMP) | stamp;
+				target = moved;
+
+				int filled = (moved.material != MATERIAL_AIR ? 1 : 0) - (source.material != MATERIAL_AIR ? 1 : 0);
+
+				if (filled != 0) {
+					move.target->addFilledCells(filled);
+					chunk->addFilledCells(-filled);
+				}
+
+				move.target->markChanged();
+
+				wakeAround(*chunk, move.sourceX, move.sourceY, move.sourceZ);
+				wakeAround(*move.target, move.targetX, move.targetY, move.targetZ);
+			}
+
+			chunk->getOutbox().clear();
+		}
+
+		for (Chunk* chunk : chunks) {
+			chunk->releaseBorder();
+		}
+
+		return stats;
+	}
+
+	TickStats updateChunk(World& world, Chunk& chunk, uint64_t tick) {
+		if (world.getRuleExecutor() == RULE_EXECUTOR_MARGOLUS)
+			return updateChunkMargolus(world, chunk, tick);
+
+		if (world.usesMoveOutboxes())
+			return updateChunkWith<false, true>(world, chunk, tick);
+
+		// Fast falls reach further into the chunk below than the halo
+		if (world.getChunkHalos() && !world.getFastFalls())
+			return updateChunkWith<true, false>(world, chunk, tick);
+
+		return updateChunkWith<false, false>(world, chunk, tick);
+	}
+}
\ No newline at end of file
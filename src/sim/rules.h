@@ -0,0 +1,21 @@
+#pragma once
+
+#include "world.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace sim {
+	// Runs the material rules for every cell of a chunk. Cells on the edge of the
+	// chunk may move into the neighbouring chunks
+	TickStats updateChunk(World& world, Chunk& chunk, uint64_t tick);
+
+	// Moves the cells of a chunk with the Margolus blocks of this tick instead of the per cell rules, see
+	// MargolusTable. The chunk has to have begun the tick already
+	TickStats updateChunkMargolus(World& world, Chunk& chunk, uint64_t tick);
+
+	// Second phase of a tick with outboxes. Goes through the outbox of every chunk in order and makes each move
+	// whose target still holds what the tick started with and isn't waiting to leave itself. The others stay
+	// put and try again next tick. Also releases the borders the chunks captured. Only call between ticks
+	TickStats applyOutboxes(const std::vector<Chunk*>& chunks, uint64_t tick);
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "scenario.h"
+#include "../util/debug.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+	bool parseFailed(const char* filename, int lineNumber, const std::string& line, const std::string& reason) {
+		util::displayMessage(std::string(filename) + ":" + std::to_string(lineNumber) + ": " + reason + " in '" + line + "'", DISPLAY_TYPE_ERR);
+
+		return false;
+	}
+}
+
+namespace sim {
+	bool Scenario::loadFromFile(const char* filename) {
+		std::ifstream file(filename);
+
+		if (!file.is_open()) {
+			util::displayMessage(std::string("File not found: ") + filename, DISPLAY_TYPE_ERR);
+			return false;
+		}
+
+		std::string line;
+		int lineNumber = 0;
+
+		while (std::getline(file, line)) {
+			lineNumber++;
+
+			// Strip comments
+			std::string content = line.substr(0, line.find('#'));
+
+			std::istringstream stream(content);
+
+			std::string command;
+			if (!(stream >> command))
+				continue;
+
+			if (command == "world") {
+				if (!(stream >> chunksX >> chunksY >> chunksZ) || chunksX < 0 || chunksY < 0 || chunksZ < 0)
+					return parseFailed(filename, lineNumber, line, "Expected three chunk counts, 0 for unbounded");
+			}
+			else if (command == "ticks") {
+				if (!(stream >> ticks))
+					return parseFailed(filename, lineNumber, line, "Expected a tick count");
+			}
+			else if (command == "threads") {
+				if (!(stream >> threads) || threads < 0)
+					return parseFailed(filename, lineNumber, line, "Expected a thread count");
+			}
+			else if (command == "seed") {
+				if (!(stream >> seed))
+					return parseFailed(filename, lineNumber, line, "Expected a seed");
+			}
+			else if (command == "fill" || command == "set") {
+				std::string materialName;
+				uint8_t material;
+				int x, y, z;
+
+				if (!(stream >> materialName) || !findMaterial(materialName.c_str(), material))
+					return parseFailed(filename, lineNumber, line, "Unknown material");
+
+				if (!(stream >> x >> y >> z))
+					return parseFailed(filename, lineNumber, line, "Expected a position");
+
+				if (command == "fill") {
+					int maxX, maxY, maxZ;
+
+					if (!(stream >> maxX >> maxY >> maxZ))
+						return parseFailed(filename, lineNumber, line, "Expected a second corner");
+
+					edits.push_back(EditCommand::fillBox(x, y, z, maxX, maxY, maxZ, material));
+				}
+				else {
+					edits.push_back(EditCommand::setCell(x, y, z, material));
+				}
+			}
+			else if (command == "explode") {
+				int x, y, z, radius;
+
+				if (!(stream >> x >> y >> z >> radius) || radius < 0)
+					return parseFailed(filename, lineNumber, line, "Expected a position and a radius");
+
+				edits.push_back(EditCommand::explode(x, y, z, radius));
+			}
+			else {
+				return parseFailed(filename, lineNumber, line, "Unknown command '" + command + "'");
+			}
+		}
+
+		return true;
+	}
+
+	void Scenario::apply(World& world) const {
+		world.setSeed(seed);
+
+		for (const EditCommand& edit : edits) {
+			world.applyEdit(edit);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "world.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sim {
+	// A world setup read from a text file, one command per line and # for comments:
+	//   world <chunks x> <chunks y> <chunks z>     0 leaves that axis unbounded
+	//   ticks <count>
+	//   threads <count>
+	//   seed <value>
+	//   fill <material> <min x> <min y> <min z> <max x> <max y> <max z>
+	//   set <material> <x> <y> <z>
+	//   explode <x> <y> <z> <radius>
+	struct Scenario {
+		int chunksX{ 4 };
+		int chunksY{ 2 };
+		int chunksZ{ 4 };
+
+		uint64_t ticks{ 1000 };
+
+		// Total threads ticking the world, 0 uses every hardware thread
+		int threads{ 0 };
+
+		uint64_t seed{ 0 };
+
+		// Applied in order before the first tick
+		std::vector<EditCommand> edits;
+
+		// Returns false and prints the offending line if the file can't be read or parsed
+		bool loadFromFile(const char* filename);
+
+		void apply(World& world) const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "scheduler.h"
+#include "heat.h"
+#include "rules.h"
+
+#include <chrono>
+
+namespace sim {
+	TickScheduler::TickScheduler(engine::jobs::JobSystem& jobSystem) : rJobSystem{ jobSystem }, mWorkerStats(jobSystem.getParticipantCount()) {
+	}
+
+	TickStats TickScheduler::tick(World& world) {
+		auto start = std::chrono::steady_clock::now();
+
+		// Edits from other threads land between ticks, never while cells are moving. Falling islands move
+		// before any cell does
+		TickStats serialStats;
+		world.beginTick(serialStats);
+
+		// Worker stats accumulate across ticks, so remember where this tick started
+		TickStats before;
+		for (auto& worker : mWorkerStats) {
+			before.bricksUpdated += worker.bricksUpdated;
+			before.cellsUpdated += worker.cellsUpdated;
+			before.cellsMoved += worker.cellsMoved;
+		}
+
+		uint64_t tick = world.getTickCount();
+
+		if (world.ticksInOneWave()) {
+			tickInOneWave(world, tick, serialStats);
+
+			world.updateParticles(serialStats);
+			tickHeat(world, tick);
+			world.finishTick();
+
+			return finishStats(before, serialStats, start);
+		}
+
+		for (int parityClass = 0; parityClass < PARITY_CLASS_COUNT; parityClass++) {
+			// Fully asleep chunks cost one check each. Earlier classes may have woken chunks in this
+			// one, so the list has to be built right before the class runs. A compressed chunk woken
+			// that way waits for the next tick, when it is expanded
+			mActiveChunks.clear();
+
+			for (Chunk* chunk : world.getParityClass(parityClass)) {
+				if (chunk->isActive() && chunk->isDense())
+					mActiveChunks.push_back(chunk);
+			}
+
+			// parallelFor returns once every chunk is done, which is the barrier between classes
+			updateActiveChunks(world, tick);
+		}
+
+		world.updateParticles(serialStats);
+
+		tickHeat(world, tick);
+		world.finishTick();
+
+		return finishStats(before, serialStats, start);
+	}
+
+	void TickScheduler::tickInOneWave(World& world, uint64_t tick, TickStats& serialStats) {
+		world.collectActiveChunks(mActiveChunks);
+
+		const std::vector<Chunk*>& chunks = mActiveChunks;
+		bool outboxes = world.usesMoveOutboxes();
+
+		// Every chunk has to begin the tick, and copy its faces for outboxes, before any neighbour starts moving cells
+		rJobSystem.parallelFor(chunks.size(), 4, [&](size_t begin, size_t end, int) {
+			for (size_t i = begin; i < end; i++) {
+				chunks[i]->beginTick();
+
+				if (outboxes)
+					chunks[i]->captureBorder();
+			}
+		});
+
+		// One wave for every chunk instead of one per parity class
+		updateActiveChunks(world, tick);
+
+		if (outboxes) {
+			TickStats outboxStats = applyOutboxes(chunks, tick);
+
+			serialStats.movesQueued = outboxStats.movesQueued;
+			serialStats.movesRejected = outboxStats.movesRejected;
+		}
+	}
+
+	void TickScheduler::updateActiveChunks(World& world, uint64_t tick) {
+		const std::vector<Chunk*>& chunks = mActiveChunks;
+
+		rJobSystem.parallelFor(chunks.size(), 1, [&](size_t begin, size_t end, int participant) {
+			auto chunkStart = std::chrono::steady_clock::now();
+
+			WorkerStats& stats = mWorkerStats[participant];
+
+			for (size_t i = begin; i < end; i++) {
+				TickStats chunkStats = updateChunk(world, *chunks[i], tick);
+
+				stats.chunksUpdated++;
+				stats.bricksUpdated += chunkStats.bricksUpdated;
+				stats.cellsUpdated += chunkStats.cellsUpdated;
+				stats.cellsMoved += chunkStats.cellsMoved;
+			}
+
+			stats.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - chunkStart).count();
+		});
+	}
+
+	void TickScheduler::tickHeat(World& world, uint64_t tick) {
+		if (!world.beginHeat())
+			return;
+
+		const std::vector<Chunk*>& scanned = world.getHeatScanChunks();
+
+		rJobSystem.parallelFor(scanned.size(), 4, [&](size_t begin, size_t end, int) {
+			for (size_t i = begin; i < end; i++) {
+				scanHeatSources(*scanned[i]);
+			}
+		});
+
+		world.spreadHeat();
+
+		const std::vector<Chunk*>& heated = world.getHeatChunks();
+
+		rJobSystem.parallelFor(heated.size(), 1, [&](size_t begin, size_t end, int) {
+			for (size_t i = begin; i < end; i++) {
+				updateHeat(world, *heated[i], tick);
+			}
+		});
+
+		world.finishHeat();
+	}
+
+	TickStats TickScheduler::finishStats(const TickStats& before, const TickStats& serialStats,
+		std::chrono::steady_clock::time_point start) {
+		TickStats stats;
+		for (auto& worker : mWorkerStats) {
+			stats.bricksUpdated += worker.bricksUpdated;
+			stats.cellsUpdated += worker.cellsUpdated;
+			stats.cellsMoved += worker.cellsMoved;
+		}
+
+		stats.bricksUpdated -= before.bricksUpdated;
+		stats.cellsUpdated -= before.cellsUpdated;
+		stats.cellsMoved -= before.cellsMoved;
+		stats.editsApplied = serialStats.editsApplied;
+		stats.movesQueued = serialStats.movesQueued;
+		stats.movesRejected = serialStats.movesRejected;
+		stats.particlesLanded = serialStats.particlesLanded;
+		stats.particlesLost = serialStats.particlesLost;
+		stats.bodiesDetached = serialStats.bodiesDetached;
+		stats.bodiesLanded = serialStats.bodiesLanded;
+
+		mTickSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		return stats;
+	}
+
+	double TickScheduler::getParallelEfficiency() const {
+		if (mTickSeconds <= 0.0)
+			return 0.0;
+
+		double busy = 0.0;
+
+		for (auto& worker : mWorkerStats) {
+			busy += worker.busySeconds;
+		}
+
+		return busy / (mTickSeconds * getThreadCount());
+	}
+
+	void TickScheduler::resetStats() {
+		for (auto& worker : mWorkerStats) {
+			worker = WorkerStats{};
+		}
+
+		mTickSeconds = 0.0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "world.h"
+#include "../engine/jobs/job_system.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace sim {
+	// Timing for a single job system participant, accumulated over every tick since the last reset.
+	// Aligned to a cache line so workers don't fight over each other's counters
+	struct alignas(64) WorkerStats {
+		double busySeconds{ 0.0 };
+		uint64_t chunksUpdated{ 0 };
+		uint64_t bricksUpdated{ 0 };
+		uint64_t cellsUpdated{ 0 };
+		uint64_t cellsMoved{ 0 };
+	};
+
+	// Ticks a world on the engine job system. Each parity class is spread over the pool chunk by
+	// chunk, and every chunk of a class is finished before the next class starts
+	class TickScheduler {
+	public:
+		explicit TickScheduler(engine::jobs::JobSystem& jobSystem);
+
+		TickScheduler(const TickScheduler&) = delete;
+		TickScheduler& operator=(const TickScheduler&) = delete;
+
+		TickStats tick(World& world);
+
+		// Worker threads plus the thread that calls tick()
+		int getThreadCount() const { return rJobSystem.getWorkerCount() + 1; }
+
+		// One per job system participant, the workers first and then the threads outside of the pool
+		const std::vector<WorkerStats>& getWorkerStats() const { return mWorkerStats; }
+
+		// Wall clock time spent in tick(), the denominator for per worker utilisation
+		double getTickSeconds() const { return mTickSeconds; }
+
+		// Busy time of all workers over the time they could have been busy, 1.0 is perfect scaling
+		double getParallelEfficiency() const;
+
+		void resetStats();
+	private:
+		engine::jobs::JobSystem& rJobSystem;
+
+		std::vector<WorkerStats> mWorkerStats;
+		double mTickSeconds{ 0.0 };
+
+		// Chunks of the current parity class that have active bricks, or every active chunk with outboxes
+		std::vector<Chunk*> mActiveChunks;
+
+		// Every active chunk at once, then with outboxes the moves between chunks on the calling thread, counted
+		// in serialStats
+		void tickInOneWave(World& world, uint64_t tick, TickStats& serialStats);
+
+		// Spreads mActiveChunks over the pool and returns once all of them are done
+		void updateActiveChunks(World& world, uint64_t tick);
+
+		// Scans and then updates the heat of every chunk on the pool, see heat.h
+		void tickHeat(World& world, uint64_t tick);
+
+		// Totals the worker stats of the tick, the edit, body, outbox and particle counts come from the serial phases
+		TickStats finishStats(const TickStats& before, const TickStats& serialStats,
+			std::chrono::steady_clock::time_point start);
+	};
+}
\ No newline at end of file
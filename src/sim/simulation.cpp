@@ -0,0 +1,57 @@
+#include "simulation.h"
+#include "../util/debug.h"
+
+#include <chrono>
+
+namespace sim {
+	Simulation::Simulation(engine::jobs::JobSystem& jobSystem, int chunksX, int chunksY, int chunksZ, double ticksPerSecond) : mWorld(chunksX, chunksY, chunksZ), mScheduler(jobSystem) {
+		if (ticksPerSecond <= 0.0) {
+			util::displayError("The simulation tick rate must be positive");
+		}
+
+		mTickInterval = 1.0 / ticksPerSecond;
+	}
+
+	int Simulation::update(double elapsedSeconds) {
+		if (mPaused)
+			return 0;
+
+		mAccumulator += elapsedSeconds;
+
+		int ticksRun = 0;
+
+		while (mAccumulator >= mTickInterval && ticksRun < mMaxTicksPerUpdate) {
+			step();
+
+			mAccumulator -= mTickInterval;
+			ticksRun++;
+		}
+
+		// Drop the time we couldn't catch up on instead of carrying it into later frames
+		if (ticksRun == mMaxTicksPerUpdate && mAccumulator >= mTickInterval) {
+			mAccumulator = 0.0;
+		}
+
+		return ticksRun;
+	}
+
+	void Simulation::step() {
+		auto start = std::chrono::steady_clock::now();
+
+		TickStats tickStats = mScheduler.tick(mWorld);
+
+		auto end = std::chrono::steady_clock::now();
+
+		mStats.ticks++;
+		mStats.bricksUpdated += tickStats.bricksUpdated;
+		mStats.cellsUpdated += tickStats.cellsUpdated;
+		mStats.cellsMoved += tickStats.cellsMoved;
+		mStats.tickSeconds += std::chrono::duration<double>(end - start).count();
+	}
+
+	void Simulation::resetStats() {
+		mStats = SimulationStats{};
+
+		mScheduler.resetStats();
+	}
+}
\ No newline at end of file
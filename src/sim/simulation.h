@@ -0,0 +1,66 @@
+#pragma once
+
+#include "world.h"
+#include "scheduler.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace sim {
+	struct SimulationStats {
+		uint64_t ticks{ 0 };
+		uint64_t bricksUpdated{ 0 };
+		uint64_t cellsUpdated{ 0 };
+		uint64_t cellsMoved{ 0 };
+
+		// Wall clock time spent inside ticks
+		double tickSeconds{ 0.0 };
+
+		double getCellsPerSecond() const { return tickSeconds > 0.0 ? cellsUpdated / tickSeconds : 0.0; }
+		double getTicksPerSecond() const { return tickSeconds > 0.0 ? ticks / tickSeconds : 0.0; }
+	};
+
+	// Advances a world on a fixed timestep that is independent from the frame rate
+	class Simulation {
+	public:
+		// Ticks are spread over the given job system, which has to outlive the simulation
+		Simulation(engine::jobs::JobSystem& jobSystem, int chunksX, int chunksY, int chunksZ, double ticksPerSecond = 60.0);
+
+		// Feed elapsed wall clock time, runs as many fixed ticks as have accumulated
+		// Returns the number of ticks that were run
+		int update(double elapsedSeconds);
+
+		// Run exactly one tick, ignoring the accumulator
+		void step();
+
+		World& getWorld() { return mWorld; }
+		const World& getWorld() const { return mWorld; }
+
+		const SimulationStats& getStats() const { return mStats; }
+		void resetStats();
+
+		const TickScheduler& getScheduler() const { return mScheduler; }
+
+		double getTickInterval() const { return mTickInterval; }
+
+		// Time left before update() would run another tick
+		double getTimeUntilNextTick() const { return mPaused ? mTickInterval : std::max(mTickInterval - mAccumulator, 0.0); }
+
+		// Ticks run by a single update are capped so a slow tick can't snowball into more and more ticks
+		void setMaxTicksPerUpdate(int maxTicks) { mMaxTicksPerUpdate = maxTicks; }
+
+		void setPaused(bool paused) { mPaused = paused; }
+		bool isPaused() const { return mPaused; }
+	private:
+		World mWorld;
+		TickScheduler mScheduler;
+
+		double mTickInterval;
+		double mAccumulator{ 0.0 };
+		int mMaxTicksPerUpdate{ 4 };
+
+		bool mPaused{ false };
+
+		SimulationStats mStats;
+	};
+}
\ No newline at end of file
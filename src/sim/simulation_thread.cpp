@@ -0,0 +1,55 @@
+#include "simulation_thread.h"
+
+#include <chrono>
+
+namespace sim {
+	SimulationThread::SimulationThread(Simulation& simulation) : rSimulation{ simulation } {
+	}
+
+	SimulationThread::~SimulationThread() {
+		stop();
+	}
+
+	void SimulationThread::start() {
+		if (isRunning())
+			return;
+
+		// Readers get the starting state before the first tick has run
+		publishSnapshot();
+
+		mStopping.store(false);
+		mThread = std::thread(&SimulationThread::threadLoop, this);
+	}
+
+	void SimulationThread::stop() {
+		if (!isRunning())
+			return;
+
+		mStopping.store(true);
+		mThread.join();
+	}
+
+	void SimulationThread::threadLoop() {
+		auto lastUpdate = std::chrono::steady_clock::now();
+
+		while (!mStopping.load()) {
+			auto now = std::chrono::steady_clock::now();
+			double elapsed = std::chrono::duration<double>(now - lastUpdate).count();
+			lastUpdate = now;
+
+			if (rSimulation.update(elapsed) > 0)
+				publishSnapshot();
+
+			// Sleep until the next tick is due instead of spinning on the accumulator
+			double wait = rSimulation.getTimeUntilNextTick();
+
+			if (wait > 0.0)
+				std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+		}
+	}
+
+	void SimulationThread::publishSnapshot() {
+		mSnapshots.getWriteBuffer().capture(rSimulation);
+		mSnapshots.publish();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "simulation.h"
+#include "snapshot.h"
+#include "../util/triple_buffer.h"
+
+#include <atomic>
+#include <thread>
+
+namespace sim {
+	// Ticks a simulation on its own thread so slow frames and slow ticks don't hold each other up. After
+	// every batch of ticks the thread publishes a snapshot that one reader thread can pick up at its own pace
+	//
+	// Once started, the simulation belongs to this thread. Other threads may only queue edits on the world
+	class SimulationThread {
+	public:
+		explicit SimulationThread(Simulation& simulation);
+		~SimulationThread();
+
+		SimulationThread(const SimulationThread&) = delete;
+		SimulationThread& operator=(const SimulationThread&) = delete;
+
+		void start();
+
+		// Blocks until the tick in progress is done
+		void stop();
+
+		bool isRunning() const { return mThread.joinable(); }
+
+		// For the reader thread. Picks up the newest snapshot, returns false if it is the same as last time
+		bool acquireSnapshot() { return mSnapshots.acquire(); }
+
+		// Stays valid and unchanged until the next acquireSnapshot
+		const WorldSnapshot& getSnapshot() const { return mSnapshots.getReadBuffer(); }
+	private:
+		Simulation& rSimulation;
+
+		std::thread mThread;
+		std::atomic<bool> mStopping{ false };
+
+		util::TripleBuffer<WorldSnapshot> mSnapshots;
+
+		void threadLoop();
+
+		void publishSnapshot();
+	};
+}
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+	// Snapshots live on the thread that captures them and the one reading them, so the total is shared
+	std::atomic<size_t> gLiveSnapshotBytes{ 0 };
+}
+
+namespace sim {
+	WorldSnapshot::~WorldSnapshot() {
+		for (ChunkCells& cells : mCells) {
+			if (cells.denseCells != nullptr)
+				freeChunkCells(cells.denseCells);
+		}
+
+		gLiveSnapshotBytes.fetch_sub(mCountedBytes, std::memory_order_relaxed);
+	}
+
+	size_t WorldSnapshot::capture(const Simulation& simulation) {
+		const World& world = simulation.getWorld();
+		const std::vector<std::unique_ptr<Chunk>>& chunks = world.getChunks();
+
+		mCaptures++;
+
+		size_t copied = 0;
+
+		for (size_t i = 0; i < chunks.size(); i++) {
+			const Chunk& chunk = *chunks[i];
+			auto found = mSlots.find(chunk.getId());
+			uint32_t slot;
+
+			if (found != mSlots.end()) {
+				slot = found->second;
+			}
+			else if (!mFreeSlots.empty()) {
+				slot = mFreeSlots.back();
+				mFreeSlots.pop_back();
+				mSlots.emplace(chunk.getId(), slot);
+			}
+			else {
+				// Ids start at 1, so new slots never match a real chunk
+				slot = (uint32_t)mChunks.size();
+				mChunks.push_back(SnapshotChunk{ 0, 0, 0, 0, 0 });
+				mCells.emplace_back();
+				mSeenCaptures.push_back(0);
+				mSlots.emplace(chunk.getId(), slot);
+			}
+
+			mSeenCaptures[slot] = mCaptures;
+
+			SnapshotChunk& entry = mChunks[slot];
+
+			if (entry.id == chunk.getId() && entry.revision == chunk.getRevision())
+				continue;
+
+			ChunkCells& cells = mCells[slot];
+			cells.storage = chunk.getStorage();
+
+			if (cells.storage == CHUNK_STORAGE_DENSE) {
+				if (cells.denseCells == nullptr)
+					cells.denseCells = allocateChunkCells();
+
+				memcpy(cells.denseCells, chunk.getCells(), sizeof(Cell) * CHUNK_VOLUME);
+				cells.packedCells.reset();
+			}
+			else {
+				if (cells.denseCells != nullptr) {
+					freeChunkCells(cells.denseCells);
+					cells.denseCells = nullptr;
+				}
+
+				cells.uniformCell = chunk.getUniformCell();
+				cells.packedCells = chunk.getPackedCells();
+			}
+
+			entry = SnapshotChunk{ chunk.getX(), chunk.getY(), chunk.getZ(), chunk.getId(), chunk.getRevision() };
+
+			copied++;
+		}
+
+		// Chunks freed since the last capture hand their cells back and leave their slot to the next new one
+		for (uint32_t slot = 0; slot < mChunks.size(); slot++) {
+			if (mChunks[slot].id == 0 || mSeenCaptures[slot] == mCaptures)
+				continue;
+
+			ChunkCells& cells = mCells[slot];
+
+			if (cells.denseCells != nullptr)
+				freeChunkCells(cells.denseCells);
+
+			mSlots.erase(mChunks[slot].id);
+			mChunks[slot] = SnapshotChunk{ 0, 0, 0, 0, 0 };
+			cells = ChunkCells();
+			mFreeSlots.push_back(slot);
+		}
+
+		const ParticleBuffer& particles = world.getParticles();
+
+		mParticlePositionsX = particles.positionsX;
+		mParticlePositionsY = particles.positionsY;
+		mParticlePositionsZ = particles.positionsZ;
+		mParticleMaterials = particles.materials;
+
+		// The cells of falling islands are drawn the same way, at the centers of their turned cells
+		for (const RigidBody& body : world.getBodies()) {
+			for (size_t i = 0; i < body.size(); i++) {
+				float x, y, z;
+				body.getCellCenter(i, x, y, z);
+
+				mParticlePositionsX.push_back(x);
+				mParticlePositionsY.push_back(y);
+				mParticlePositionsZ.push_back(z);
+				mParticleMaterials.push_back(body.materials[i]);
+			}
+		}
+
+		size_t memoryBytes = getMemoryBytes();
+		gLiveSnapshotBytes.fetch_add(memoryBytes - mCountedBytes, std::memory_order_relaxed);
+		mCountedBytes = memoryBytes;
+
+		mTick = world.getTickCount();
+		mStats = simulation.getStats();
+		mThreadCount = simulation.getScheduler().getThreadCount();
+		mParallelEfficiency = simulation.getScheduler().getParallelEfficiency();
+		mWorldMemory = world.getMemoryStats();
+		mWorldMemory.snapshotBytes = getLiveMemoryBytes();
+
+		return copied;
+	}
+
+	int WorldSnapshot::findSlot(uint64_t id) const {
+		auto found = mSlots.find(id);
+
+		return found != mSlots.end() ? (int)found->second : -1;
+	}
+
+	Cell WorldSnapshot::getChunkCell(size_t chunk, int x, int y, int z) const {
+		const ChunkCells& cells = mCells[chunk];
+
+		if (cells.storage == CHUNK_STORAGE_DENSE)
+			return cells.denseCells[Chunk::index(x, y, z)];
+
+		return cells.packedCells != nullptr ? cells.packedCells->get(Chunk::index(x, y, z)) : cells.uniformCell;
+	}
+
+	void WorldSnapshot::copyChunkCells(size_t chunk, Cell* outCells) const {
+		const ChunkCells& cells = mCells[chunk];
+
+		switch (cells.storage) {
+		case CHUNK_STORAGE_DENSE:
+			memcpy(outCells, cells.denseCells, sizeof(Cell) * CHUNK_VOLUME);
+			break;
+		case CHUNK_STORAGE_UNIFORM:
+			std::fill(outCells, outCells + CHUNK_VOLUME, cells.uniformCell);
+			break;
+		case CHUNK_STORAGE_PACKED:
+			cells.packedCells->unpack(outCells);
+			break;
+		}
+	}
+
+	size_t WorldSnapshot::getMemoryBytes() const {
+		size_t blockBytes = util::getBlockPool(sizeof(Cell) * CHUNK_VOLUME).getBlockSize();
+		size_t cellBytes = 0;
+
+		for (const ChunkCells& cells : mCells) {
+			if (cells.denseCells != nullptr)
+				cellBytes += blockBytes;
+
+			if (cells.packedCells != nullptr)
+				cellBytes += cells.packedCells->getMemoryBytes() / cells.packedCells.use_count();
+		}
+
+		size_t particleBytes = (mParticlePositionsX.capacity() + mParticlePositionsY.capacity() + mParticlePositionsZ.capacity()) * sizeof(float)
+			+ mParticleMaterials.capacity();
+
+		// Roughly what the map allocates, a bucket pointer each and a node per chunk
+		size_t slotBytes = mSlots.bucket_count() * sizeof(void*) + mSlots.size() * (sizeof(std::pair<const uint64_t, uint32_t>) + sizeof(void*))
+			+ mFreeSlots.capacity() * sizeof(uint32_t) + mSeenCaptures.capacity() * sizeof(uint64_t);
+
+		return mChunks.capacity() * sizeof(SnapshotChunk) + mCells.capacity() * sizeof(ChunkCells) + slotBytes + cellBytes + particleBytes;
+	}
+
+	size_t WorldSnapshot::getLiveMemoryBytes() {
+		return gLiveSnapshotBytes.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "simulation.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace sim {
+	struct SnapshotChunk {
+		int chunkX;
+		int chunkY;
+		int chunkZ;
+
+		// A chunk is unchanged only if both match, ids tell apart a chunk that was freed and created again. 0 for
+		// a free slot
+		uint64_t id;
+		uint64_t revision;
+	};
+
+	// Read only copy of a world for other threads, such as the renderer. Each chunk keeps its slot for as long as
+	// it exists, however other chunks come and go, and the revision it was copied at, so readers can tell what
+	// changed. Slots of freed chunks are handed to new ones
+	class WorldSnapshot {
+	public:
+		WorldSnapshot() = default;
+		~WorldSnapshot();
+
+		WorldSnapshot(const WorldSnapshot&) = delete;
+		WorldSnapshot& operator=(const WorldSnapshot&) = delete;
+
+		// Copies every chunk whose revision moved on since this snapshot last saw it. Has to run on the
+		// thread that ticks the simulation, between ticks. Returns the number of chunks copied
+		size_t capture(const Simulation& simulation);
+
+		uint64_t getTick() const { return mTick; }
+
+		// Every slot, including free ones
+		size_t getSlotCount() const { return mChunks.size(); }
+
+		// Slot of the chunk with the id, or -1 if the snapshot doesn't have it
+		int findSlot(uint64_t id) const;
+
+		// The rest take a slot
+		const SnapshotChunk& getChunk(size_t chunk) const { return mChunks[chunk]; }
+
+		// Chunks are kept in the form they had in the world, only dense ones are copied
+		ChunkStorage getChunkStorage(size_t chunk) const { return mCells[chunk].storage; }
+
+		// In the order of Chunk::index, nullptr unless the chunk was dense
+		const Cell* getChunkCells(size_t chunk) const { return mCells[chunk].denseCells; }
+
+		// Works with every kind of storage
+		Cell getChunkCell(size_t chunk, int x, int y, int z) const;
+
+		// Writes all CHUNK_VOLUME cells to outCells in the order of Chunk::index, whatever the storage
+		void copyChunkCells(size_t chunk, Cell* outCells) const;
+
+		// Positions and materials of the free particles followed by the cells of the falling islands, one entry per
+		// particle in each array, so they can be uploaded as they are and drawn as instances
+		size_t getParticleCount() const { return mParticleMaterials.size(); }
+		const float* getParticlePositionsX() const { return mParticlePositionsX.data(); }
+		const float* getParticlePositionsY() const { return mParticlePositionsY.data(); }
+		const float* getParticlePositionsZ() const { return mParticlePositionsZ.data(); }
+		const uint8_t* getParticleMaterials() const { return mParticleMaterials.data(); }
+
+		// Totals since the simulation started, take the difference of two snapshots for a rate
+		const SimulationStats& getStats() const { return mStats; }
+
+		int getThreadCount() const { return mThreadCount; }
+		double getParallelEfficiency() const { return mParallelEfficiency; }
+
+		// Memory of the world at the time of the capture, including every snapshot that was alive then
+		const WorldMemoryStats& getWorldMemory() const { return mWorldMemory; }
+
+		// Memory of this snapshot. Packed cells shared with the world are split evenly between the chunks and
+		// snapshots holding them
+		size_t getMemoryBytes() const;
+
+		// Memory of every snapshot alive, as of their last capture
+		static size_t getLiveMemoryBytes();
+	private:
+		// Cells of one chunk in the form the chunk had when it was copied
+		struct ChunkCells {
+			ChunkStorage storage{ CHUNK_STORAGE_UNIFORM };
+			Cell uniformCell{ MATERIAL_AIR, 0 };
+
+			// A pooled block, kept while the slot holds dense chunks, so a snapshot that grows or shrinks never
+			// copies the cells it keeps and hands what it drops back for the world to reuse
+			Cell* denseCells{ nullptr };
+
+			// Nothing changes packed cells, so they are shared with the world instead of copied
+			std::shared_ptr<const PackedCells> packedCells;
+		};
+
+		uint64_t mTick{ 0 };
+
+		std::vector<SnapshotChunk> mChunks;
+		std::vector<ChunkCells> mCells;
+
+		// Chunk ids to slots, and slots whose chunk was freed. The chunk vector of the world closes the gaps
+		// of freed chunks, so its order can't be kept without copying every chunk after the gap again
+		std::unordered_map<uint64_t, uint32_t> mSlots;
+		std::vector<uint32_t> mFreeSlots;
+
+		// Capture each slot was last seen in, slots that weren't seen in the latest one lost their chunk
+		std::vector<uint64_t> mSeenCaptures;
+		uint64_t mCaptures{ 0 };
+
+		// What this snapshot added to the live total at its last capture
+		size_t mCountedBytes{ 0 };
+
+		// Particles and bodies change every tick they are in the air, so they are copied whole
+		std::vector<float> mParticlePositionsX;
+		std::vector<float> mParticlePositionsY;
+		std::vector<float> mParticlePositionsZ;
+		std::vector<uint8_t> mParticleMaterials;
+
+		SimulationStats mStats;
+
+		int mThreadCount{ 0 };
+		double mParallelEfficiency{ 0.0 };
+
+		WorldMemoryStats mWorldMemory;
+	};
+}
\ No newline at end of file
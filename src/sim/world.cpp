@@ -0,0 +1,1172 @@
+#include "world.h"
+#include "heat.h"
+#include "rules.h"
+#include "random.h"
+#include "line_walk.h"
+#include "../util/debug.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	bool hasActiveNeighbour(const sim::Chunk& chunk) {
+		for (int offsetY = -1; offsetY <= 1; offsetY++) {
+			for (int offsetZ = -1; offsetZ <= 1; offsetZ++) {
+				for (int offsetX = -1; offsetX <= 1; offsetX++) {
+					sim::Chunk* neighbour = chunk.getNeighbour(offsetX, offsetY, offsetZ);
+
+					if (neighbour != nullptr && neighbour != &chunk && neighbour->isActive())
+						return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	// Mixes in the exact bits, so positions that differ in the last place give different checksums
+	uint64_t mixFloat(uint64_t checksum, float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		return sim::mixBits(checksum ^ bits);
+	}
+}
+
+namespace sim {
+	World::World(int chunksX, int chunksY, int chunksZ) : mChunksX{ chunksX }, mChunksY{ chunksY }, mChunksZ{ chunksZ } {
+		int counts[3] = { chunksX, chunksY, chunksZ };
+
+		for (int axis = 0; axis < 3; axis++) {
+			if (counts[axis] < 0 || counts[axis] > CHUNK_COORD_LIMIT) {
+				util::displayError("A world needs a chunk count between 0 (unbounded) and " + std::to_string(CHUNK_COORD_LIMIT) + " along every axis");
+			}
+
+			if (counts[axis] == WORLD_UNBOUNDED) {
+				mMinChunk[axis] = -CHUNK_COORD_LIMIT;
+				mMaxChunk[axis] = CHUNK_COORD_LIMIT - 1;
+			}
+			else {
+				mMinChunk[axis] = 0;
+				mMaxChunk[axis] = counts[axis] - 1;
+			}
+
+			mMinCell[axis] = mMinChunk[axis] * CHUNK_SIZE;
+			mMaxCell[axis] = mMaxChunk[axis] * CHUNK_SIZE + CHUNK_MASK;
+		}
+	}
+
+	bool World::isInBounds(int chunkX, int chunkY, int chunkZ) const {
+		return chunkX >= mMinChunk[0] && chunkX <= mMaxChunk[0] && chunkY >= mMinChunk[1] && chunkY <= mMaxChunk[1] && chunkZ >= mMinChunk[2] && chunkZ <= mMaxChunk[2];
+	}
+
+	Chunk* World::getChunk(int chunkX, int chunkY, int chunkZ) const {
+		if (!isInBounds(chunkX, chunkY, chunkZ))
+			return nullptr;
+
+		return mChunkMap.find(packChunkKey(chunkX, chunkY, chunkZ));
+	}
+
+	Chunk* World::getOrCreateChunk(int chunkX, int chunkY, int chunkZ) {
+		if (!isInBounds(chunkX, chunkY, chunkZ))
+			return nullptr;
+
+		uint64_t key = packChunkKey(chunkX, chunkY, chunkZ);
+
+		Chunk* chunk = mChunkMap.find(key);
+
+		if (chunk != nullptr)
+			return chunk;
+
+		mChunks.push_back(std::make_unique<Chunk>(chunkX, chunkY, chunkZ, mNextChunkId++));
+		chunk = mChunks.back().get();
+
+		// Link both ways, so neither side has to go through the map to reach the other
+		for (int offsetY = -1; offsetY <= 1; offsetY++) {
+			for (int offsetZ = -1; offsetZ <= 1; offsetZ++) {
+				for (int offsetX = -1; offsetX <= 1; offsetX++) {
+					if (offsetX == 0 && offsetY == 0 && offsetZ == 0)
+						continue;
+
+					Chunk* neighbour = getChunk(chunkX + offsetX, chunkY + offsetY, chunkZ + offsetZ);
+
+					if (neighbour != nullptr) {
+						chunk->setNeighbour(offsetX, offsetY, offsetZ, neighbour);
+						neighbour->setNeighbour(-offsetX, -offsetY, -offsetZ, chunk);
+					}
+				}
+			}
+		}
+
+		mChunkMap.insert(key, chunk);
+		mChunksChanged = true;
+
+		return chunk;
+	}
+
+	Cell* World::getCell(int x, int y, int z) {
+		Chunk* chunk = getChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+
+		if (chunk == nullptr)
+			return nullptr;
+
+		chunk->decompress();
+
+		return &chunk->at(x & CHUNK_MASK, y & CHUNK_MASK, z & CHUNK_MASK);
+	}
+
+	uint8_t World::getMaterial(int x, int y, int z) {
+		if (!isInBounds(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, z >> CHUNK_SHIFT))
+			return MATERIAL_STONE;
+
+		// Reading doesn't need the chunk expanded
+		Chunk* chunk = getChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+
+		return chunk != nullptr ? chunk->getCell(x & CHUNK_MASK, y & CHUNK_MASK, z & CHUNK_MASK).material : (uint8_t)MATERIAL_AIR;
+	}
+
+	void World::setMaterial(int x, int y, int z, uint8_t material) {
+		int chunkX = x >> CHUNK_SHIFT;
+		int chunkY = y >> CHUNK_SHIFT;
+		int chunkZ = z >> CHUNK_SHIFT;
+
+		// Air over a missing chunk is already there
+		Chunk* chunk = material != MATERIAL_AIR ? getOrCreateChunk(chunkX, chunkY, chunkZ) : getChunk(chunkX, chunkY, chunkZ);
+
+		if (chunk == nullptr)
+			return;
+
+		chunk->decompress();
+
+		Cell& cell = chunk->at(x & CHUNK_MASK, y & CHUNK_MASK, z & CHUNK_MASK);
+
+		chunk->addFilledCells((material != MATERIAL_AIR ? 1 : 0) - (cell.material != MATERIAL_AIR ? 1 : 0));
+
+		cell.material = material;
+		cell.flags = 0;
+
+		chunk->markChanged();
+		wakeAround(x, y, z);
+	}
+
+	void World::fillBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, uint8_t material) {
+		applyEdit(EditCommand::fillBox(minX, minY, minZ, maxX, maxY, maxZ, material));
+	}
+
+	void World::applyEdit(const EditCommand& edit) {
+		int minX, minY, minZ, maxX, maxY, maxZ;
+
+		if (!clipEdit(edit, minX, minY, minZ, maxX, maxY, maxZ))
+			return;
+
+		for (int chunkY = minY >> CHUNK_SHIFT; chunkY <= maxY >> CHUNK_SHIFT; chunkY++) {
+			for (int chunkZ = minZ >> CHUNK_SHIFT; chunkZ <= maxZ >> CHUNK_SHIFT; chunkZ++) {
+				for (int chunkX = minX >> CHUNK_SHIFT; chunkX <= maxX >> CHUNK_SHIFT; chunkX++) {
+					Chunk* chunk = getEditChunk(edit, chunkX, chunkY, chunkZ);
+
+					if (chunk != nullptr)
+						applyEditToChunk(*chunk, edit);
+				}
+			}
+		}
+
+		checkSupportAfter(edit, minX, minY, minZ, maxX, maxY, maxZ);
+	}
+
+	size_t World::applyQueuedEdits() {
+		mDrainedEdits.clear();
+
+		// Stop after one queue's worth so producers that keep pushing can't hold up the tick
+		EditCommand edit;
+		while (mDrainedEdits.size() < mEditQueue.getCapacity() && mEditQueue.pop(edit)) {
+			mDrainedEdits.push_back(edit);
+		}
+
+		if (mDrainedEdits.empty())
+			return 0;
+
+		mEditPieces.clear();
+
+		for (size_t i = 0; i < mDrainedEdits.size(); i++) {
+			int minX, minY, minZ, maxX, maxY, maxZ;
+
+			if (!clipEdit(mDrainedEdits[i], minX, minY, minZ, maxX, maxY, maxZ))
+				continue;
+
+			// Runs once every edit of the tick is in
+			checkSupportAfter(mDrainedEdits[i], minX, minY, minZ, maxX, maxY, maxZ);
+
+			for (int chunkY = minY >> CHUNK_SHIFT; chunkY <= maxY >> CHUNK_SHIFT; chunkY++) {
+				for (int chunkZ = minZ >> CHUNK_SHIFT; chunkZ <= maxZ >> CHUNK_SHIFT; chunkZ++) {
+					for (int chunkX = minX >> CHUNK_SHIFT; chunkX <= maxX >> CHUNK_SHIFT; chunkX++) {
+						mEditPieces.push_back(EditPiece{ packChunkKey(chunkX, chunkY, chunkZ), chunkX, chunkY, chunkZ, (uint32_t)i });
+					}
+				}
+			}
+		}
+
+		// Pieces of one chunk stay in queue order, so overlapping edits still end up the way they were queued
+		std::sort(mEditPieces.begin(), mEditPieces.end(), [](const EditPiece& a, const EditPiece& b) {
+			return a.key != b.key ? a.key < b.key : a.edit < b.edit;
+		});
+
+		for (const EditPiece& piece : mEditPieces) {
+			const EditCommand& pieceEdit = mDrainedEdits[piece.edit];
+
+			Chunk* chunk = getEditChunk(pieceEdit, piece.chunkX, piece.chunkY, piece.chunkZ);
+
+			if (chunk != nullptr)
+				applyEditToChunk(*chunk, pieceEdit);
+		}
+
+		return mDrainedEdits.size();
+	}
+
+	void World::checkSupportAfter(const EditCommand& edit, int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+		if (!mDetachIslands || edit.type == EDIT_TYPE_IMPULSE)
+			return;
+
+		// Putting solid cells in can only hold more up
+		if (edit.type != EDIT_TYPE_EXPLODE && getMaterialState(edit.material) == MATERIAL_STATE_SOLID)
+			return;
+
+		// Spheres leave the corners of their box as they were, solid cells there may have lost their neighbours
+		mConnectivity.addCheck(minX, minY, minZ, maxX, maxY, maxZ, edit.type == EDIT_TYPE_SET_CELL || edit.type == EDIT_TYPE_FILL_BOX);
+	}
+
+	Chunk* World::getEditChunk(const EditCommand& edit, int chunkX, int chunkY, int chunkZ) {
+		if (edit.type == EDIT_TYPE_IMPULSE || edit.type == EDIT_TYPE_EXPLODE || edit.material == MATERIAL_AIR)
+			return getChunk(chunkX, chunkY, chunkZ);
+
+		return getOrCreateChunk(chunkX, chunkY, chunkZ);
+	}
+
+	bool World::clipEdit(const EditCommand& edit, int& minX, int& minY, int& minZ, int& maxX, int& maxY, int& maxZ) const {
+		minX = std::max(edit.minX, mMinCell[0]);
+		minY = std::max(edit.minY, mMinCell[1]);
+		minZ = std::max(edit.minZ, mMinCell[2]);
+		maxX = std::min(edit.maxX, mMaxCell[0]);
+		maxY = std::min(edit.maxY, mMaxCell[1]);
+		maxZ = std::min(edit.maxZ, mMaxCell[2]);
+
+		return minX <= maxX && minY <= maxY && minZ <= maxZ;
+	}
+
+	void World::applyEditToChunk(Chunk& chunk, const EditCommand& edit) {
+		int baseX = chunk.getX() * CHUNK_SIZE;
+		int baseY = chunk.getY() * CHUNK_SIZE;
+		int baseZ = chunk.getZ() * CHUNK_SIZE;
+
+		// Part of the edit inside this chunk, in world coordinates
+		int minX = std::max(edit.minX, baseX);
+		int minY = std::max(edit.minY, baseY);
+		int minZ = std::max(edit.minZ, baseZ);
+		int maxX = std::min(edit.maxX, baseX + CHUNK_MASK);
+		int maxY = std::min(edit.maxY, baseY + CHUNK_MASK);
+		int maxZ = std::min(edit.maxZ, baseZ + CHUNK_MASK);
+
+		if (minX > maxX || minY > maxY || minZ > maxZ)
+			return;
+
+		bool wholeChunk = minX == baseX && minY == baseY && minZ == baseZ && maxX == baseX + CHUNK_MASK && maxY == baseY + CHUNK_MASK
+			&& maxZ == baseZ + CHUNK_MASK;
+
+		if (edit.type == EDIT_TYPE_FILL_BOX && wholeChunk) {
+			// Stays uniform, nothing has to be allocated until something next to it moves
+			chunk.fill(edit.material);
+		}
+		else if (edit.type == EDIT_TYPE_EXPLODE) {
+			chunk.decompress();
+
+			chunk.addFilledCells(ejectCells(chunk, edit, minX, minY, minZ, maxX, maxY, maxZ));
+			chunk.markChanged();
+		}
+		else if (edit.type != EDIT_TYPE_IMPULSE) {
+			int64_t radiusSquared = (int64_t)edit.radius * edit.radius;
+			int filled = edit.material != MATERIAL_AIR ? 1 : 0;
+			int filledChange = 0;
+
+			chunk.decompress();
+
+			for (int y = minY; y <= maxY; y++) {
+				for (int z = minZ; z <= maxZ; z++) {
+					for (int x = minX; x <= maxX; x++) {
+						if (edit.type == EDIT_TYPE_FILL_SPHERE) {
+							int64_t dx = x - edit.centerX;
+							int64_t dy = y - edit.centerY;
+							int64_t dz = z - edit.centerZ;
+
+							if (dx * dx + dy * dy + dz * dz > radiusSquared)
+								continue;
+						}
+
+						Cell& cell = chunk.at(x - baseX, y - baseY, z - baseZ);
+
+						filledChange += filled - (cell.material != MATERIAL_AIR ? 1 : 0);
+
+						cell.material = edit.material;
+						cell.flags = 0;
+					}
+				}
+			}
+
+			chunk.addFilledCells(filledChange);
+			chunk.markChanged();
+		}
+
+		// Same bricks wakeAround would have woken for every changed cell
+		wakeBox(minX - 1, minY - 1, minZ - 1, maxX + 1, maxY + 1, maxZ + 1);
+	}
+
+	int World::ejectCells(Chunk& chunk, const EditCommand& edit, int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+		int baseX = chunk.getX() * CHUNK_SIZE;
+		int baseY = chunk.getY() * CHUNK_SIZE;
+		int baseZ = chunk.getZ() * CHUNK_SIZE;
+
+		int64_t radiusSquared = (int64_t)edit.radius * edit.radius;
+		int filledChange = 0;
+
+		for (int y = minY; y <= maxY; y++) {
+			for (int z = minZ; z <= maxZ; z++) {
+				for (int x = minX; x <= maxX; x++) {
+					int64_t dx = x - edit.centerX;
+					int64_t dy = y - edit.centerY;
+					int64_t dz = z - edit.centerZ;
+					int64_t distanceSquared = dx * dx + dy * dy + dz * dz;
+
+					if (distanceSquared > radiusSquared)
+						continue;
+
+					Cell& cell = chunk.at(x - baseX, y - baseY, z - baseZ);
+
+					if (cell.material == MATERIAL_AIR)
+						continue;
+
+					if (getMaterialState(cell.material) != MATERIAL_STATE_GAS && mParticles.size() < PARTICLE_CAPACITY) {
+						// Straight out from the center and a little to either side, the center cell only goes up
+						float distance = std::sqrt((float)distanceSquared);
+						float speed = EXPLOSION_SPEED * (1.0f - distance / (edit.radius + 1));
+						float scale = distance > 0.0f ? speed / distance : 0.0f;
+
+						uint32_t roll = randomForCell(mSeed, mTickCount, x, y, z, RANDOM_SALT_EXPLOSION);
+						float jitterX = ((roll & 0xFF) / 255.0f - 0.5f) * 0.25f;
+						float jitterZ = (((roll >> 8) & 0xFF) / 255.0f - 0.5f) * 0.25f;
+
+						mParticles.add(x, y, z, dx * scale + jitterX, dy * scale + EXPLOSION_LIFT, dz * scale + jitterZ, cell.material);
+					}
+
+					cell.material = MATERIAL_AIR;
+					cell.flags = 0;
+					filledChange--;
+				}
+			}
+		}
+
+		return filledChange;
+	}
+
+	Chunk* World::setUniformChunk(int chunkX, int chunkY, int chunkZ, Cell cell) {
+		Chunk* chunk = getOrCreateChunk(chunkX, chunkY, chunkZ);
+
+		if (chunk != nullptr)
+			chunk->setUniform(cell);
+
+		return chunk;
+	}
+
+	Chunk* World::setSharedChunk(int chunkX, int chunkY, int chunkZ, std::shared_ptr<const PackedCells> cells) {
+		Chunk* chunk = getOrCreateChunk(chunkX, chunkY, chunkZ);
+
+		if (chunk != nullptr)
+			chunk->setSharedCells(std::move(cells));
+
+		return chunk;
+	}
+
+	void World::wakeAround(int x, int y, int z) {
+		// Bricks are wider than two cells, so the bricks of the corners x +- 1, y +- 1, z +- 1 cover the whole neighbourhood
+		for (int i = 0; i < 8; i++) {
+			int cornerX = x + ((i & 1) ? 1 : -1);
+			int cornerY = y + ((i & 2) ? 1 : -1);
+			int cornerZ = z + ((i & 4) ? 1 : -1);
+
+			wakeBrick(cornerX, cornerY, cornerZ);
+		}
+	}
+
+	void World::wakeBrick(int x, int y, int z) {
+		Chunk* chunk = getChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+
+		if (chunk != nullptr) {
+			chunk->wakeBricks(1ull << Chunk::brickIndex(x & CHUNK_MASK, y & CHUNK_MASK, z & CHUNK_MASK));
+		}
+	}
+
+	void World::wakeBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+		minX = std::max(minX, mMinCell[0]);
+		minY = std::max(minY, mMinCell[1]);
+		minZ = std::max(minZ, mMinCell[2]);
+		maxX = std::min(maxX, mMaxCell[0]);
+		maxY = std::min(maxY, mMaxCell[1]);
+		maxZ = std::min(maxZ, mMaxCell[2]);
+
+		for (int chunkY = minY >> CHUNK_SHIFT; chunkY <= maxY >> CHUNK_SHIFT; chunkY++) {
+			for (int chunkZ = minZ >> CHUNK_SHIFT; chunkZ <= maxZ >> CHUNK_SHIFT; chunkZ++) {
+				for (int chunkX = minX >> CHUNK_SHIFT; chunkX <= maxX >> CHUNK_SHIFT; chunkX++) {
+					// Missing chunks are all air, there is nothing in them to wake
+					Chunk* chunk = getChunk(chunkX, chunkY, chunkZ);
+
+					if (chunk == nullptr)
+						continue;
+
+					// Brick range of the box inside this chunk
+					int minBrickX = (std::max(minX, chunkX * CHUNK_SIZE) & CHUNK_MASK) >> BRICK_SHIFT;
+					int minBrickY = (std::max(minY, chunkY * CHUNK_SIZE) & CHUNK_MASK) >> BRICK_SHIFT;
+					int minBrickZ = (std::max(minZ, chunkZ * CHUNK_SIZE) & CHUNK_MASK) >> BRICK_SHIFT;
+					int maxBrickX = (std::min(maxX, chunkX * CHUNK_SIZE + CHUNK_MASK) & CHUNK_MASK) >> BRICK_SHIFT;
+					int maxBrickY = (std::min(maxY, chunkY * CHUNK_SIZE + CHUNK_MASK) & CHUNK_MASK) >> BRICK_SHIFT;
+					int maxBrickZ = (std::min(maxZ, chunkZ * CHUNK_SIZE + CHUNK_MASK) & CHUNK_MASK) >> BRICK_SHIFT;
+
+					uint64_t bricks = 0;
+
+					for (int by = minBrickY; by <= maxBrickY; by++) {
+						for (int bz = minBrickZ; bz <= maxBrickZ; bz++) {
+							for (int bx = minBrickX; bx <= maxBrickX; bx++) {
+								bricks |= 1ull << (bx | (bz << 2) | (by << 4));
+							}
+						}
+					}
+
+					chunk->wakeBricks(bricks);
+				}
+			}
+		}
+	}
+
+	void World::beginTick(TickStats& stats) {
+		stats.editsApplied = applyQueuedEdits();
+
+		updateBodies(stats);
+
+		// Cells only ever move one step, so an active chunk with all of its neighbours in place never has to create
+		// one mid tick. A chunk that wakes up during the tick may still be missing some, those faces act as walls
+		// until the next tick. Chunks created here are empty and asleep, so they don't need visiting themselves.
+		// Compressed chunks are expanded the same way, the rules only work on dense cells
+		size_t chunkCount = mChunks.size();
+
+		for (size_t i = 0; i < chunkCount; i++) {
+			Chunk* chunk = mChunks[i].get();
+
+			if (!chunk->isActive())
+				continue;
+
+			for (int offsetY = -1; offsetY <= 1; offsetY++) {
+				for (int offsetZ = -1; offsetZ <= 1; offsetZ++) {
+					for (int offsetX = -1; offsetX <= 1; offsetX++) {
+						Chunk* neighbour = chunk->getNeighbour(offsetX, offsetY, offsetZ);
+
+						if (neighbour == nullptr)
+							neighbour = getOrCreateChunk(chunk->getX() + offsetX, chunk->getY() + offsetY, chunk->getZ() + offsetZ);
+
+						if (neighbour != nullptr)
+							neighbour->decompress();
+					}
+				}
+			}
+		}
+
+		if (mChunksChanged)
+			rebuildParityClasses();
+	}
+
+	TickStats World::tick() {
+		TickStats stats;
+		beginTick(stats);
+
+		if (ticksInOneWave()) {
+			// Same phases as the parallel scheduler, every chunk begins the tick before any of them runs
+			collectActiveChunks(mWaveChunks);
+
+			for (Chunk* chunk : mWaveChunks) {
+				chunk->beginTick();
+
+				if (usesMoveOutboxes())
+					chunk->captureBorder();
+			}
+
+			for (Chunk* chunk : mWaveChunks) {
+				TickStats chunkStats = updateChunk(*this, *chunk, mTickCount);
+
+				stats.bricksUpdated += chunkStats.bricksUpdated;
+				stats.cellsUpdated += chunkStats.cellsUpdated;
+				stats.cellsMoved += chunkStats.cellsMoved;
+			}
+
+			if (usesMoveOutboxes()) {
+				TickStats outboxStats = applyOutboxes(mWaveChunks, mTickCount);
+				stats.movesQueued = outboxStats.movesQueued;
+				stats.movesRejected = outboxStats.movesRejected;
+			}
+
+			updateParticles(stats);
+			tickHeat();
+			finishTick();
+
+			return stats;
+		}
+
+		// Walk the parity classes in the same order as the parallel scheduler so both produce the same world
+		for (int parityClass = 0; parityClass < PARITY_CLASS_COUNT; parityClass++) {
+			for (Chunk* chunk : mParityClasses[parityClass]) {
+				if (!chunk->isActive() || !chunk->isDense())
+					continue;
+
+				TickStats chunkStats = updateChunk(*this, *chunk, mTickCount);
+
+				stats.bricksUpdated += chunkStats.bricksUpdated;
+				stats.cellsUpdated += chunkStats.cellsUpdated;
+				stats.cellsMoved += chunkStats.cellsMoved;
+			}
+		}
+
+		updateParticles(stats);
+		tickHeat();
+		finishTick();
+
+		return stats;
+	}
+
+	void World::updateParticles(TickStats& stats) {
+		if (mParticles.empty())
+			return;
+
+		getIntegrateParticlesFunction(mFallKernel)(mParticles);
+
+		// Landing changes the grid the particles after it trace through, so this goes one particle at a time in
+		// the order they were thrown, which keeps it deterministic
+		size_t count = mParticles.size();
+		size_t kept = 0;
+
+		for (size_t i = 0; i < count; i++) {
+			int fromX = mParticles.cellsX[i];
+			int fromY = mParticles.cellsY[i];
+			int fromZ = mParticles.cellsZ[i];
+
+			// The crater an explosion leaves fills in from the sides on the first ticks. Out of the top it is lost
+			if (!pushParticleUp(fromX, fromY, fromZ)) {
+				stats.particlesLost++;
+				continue;
+			}
+
+			LineWalk line(fromX, fromY, fromZ, (int)std::floor(mParticles.positionsX[i]), (int)std::floor(mParticles.positionsY[i]),
+				(int)std::floor(mParticles.positionsZ[i]));
+
+			int freeX = fromX;
+			int freeY = fromY;
+			int freeZ = fromZ;
+			bool hit = false;
+
+			while (line.next()) {
+				if (getMaterial(line.getX(), line.getY(), line.getZ()) != MATERIAL_AIR) {
+					hit = true;
+					break;
+				}
+
+				freeX = line.getX();
+				freeY = line.getY();
+				freeZ = line.getZ();
+			}
+
+			if (hit || ++mParticles.ages[i] >= PARTICLE_MAX_AGE) {
+				landParticle(i, freeX, freeY, freeZ);
+				stats.particlesLanded++;
+				continue;
+			}
+
+			mParticles.cellsX[i] = freeX;
+			mParticles.cellsY[i] = freeY;
+			mParticles.cellsZ[i] = freeZ;
+
+			if (kept != i)
+				mParticles.move(i, kept);
+
+			kept++;
+		}
+
+		mParticles.resize(kept);
+	}
+
+	bool World::pushParticleUp(int x, int& y, int z) {
+		while (y <= mMaxCell[1] && getMaterial(x, y, z) != MATERIAL_AIR) {
+			y++;
+		}
+
+		return y <= mMaxCell[1];
+	}
+
+	void World::settleTransients() {
+		for (size_t i = 0; i < mParticles.size(); i++) {
+			int x = mParticles.cellsX[i];
+			int y = mParticles.cellsY[i];
+			int z = mParticles.cellsZ[i];
+
+			if (pushParticleUp(x, y, z))
+				landParticle(i, x, y, z);
+		}
+
+		mParticles.clear();
+
+		for (const RigidBody& body : mBodies) {
+			landBody(body);
+		}
+
+		mBodies.clear();
+	}
+
+	void World::landParticle(size_t particle, int x, int y, int z) {
+		uint8_t material = mParticles.materials[particle];
+
+		setMaterial(x, y, z, material);
+
+		if (!mFastFalls || getMaterialState(material) != MATERIAL_STATE_GRANULAR)
+			return;
+
+		// Falls on as a cell as fast as it came down, drifting towards the side it was mostly going to
+		float velocityX = mParticles.velocitiesX[particle];
+		float velocityZ = mParticles.velocitiesZ[particle];
+		int speed = std::min((int)-mParticles.velocitiesY[particle], FALL_SPEED_MAX);
+		int drift = FALL_NO_DRIFT;
+
+		// Sides in the order of FALL_DRIFT_OFFSETS
+		if (std::max(std::abs(velocityX), std::abs(velocityZ)) >= PARTICLE_DRIFT_SPEED) {
+			if (std::abs(velocityX) >= std::abs(velocityZ))
+				drift = velocityX > 0.0f ? 0 : 2;
+			else
+				drift = velocityZ > 0.0f ? 1 : 3;
+		}
+
+		Cell* cell = getCell(x, y, z);
+
+		if (cell != nullptr)
+			setFallVelocity(*cell, std::max(speed, 0), drift);
+	}
+
+	void World::updateBodies(TickStats& stats) {
+		while (mConnectivity.runNextCheck(*this, mIslands)) {
+			for (const std::vector<CellPosition>& island : mIslands) {
+				// Turns around the cell nearest the middle of the island
+				int64_t sumX = 0;
+				int64_t sumY = 0;
+				int64_t sumZ = 0;
+
+				for (const CellPosition& cell : island) {
+					sumX += cell.x;
+					sumY += cell.y;
+					sumZ += cell.z;
+				}
+
+				int64_t count = (int64_t)island.size();
+				int pivotX = (int)std::floor((double)sumX / count + 0.5);
+				int pivotY = (int)std::floor((double)sumY / count + 0.5);
+				int pivotZ = (int)std::floor((double)sumZ / count + 0.5);
+
+				mBodies.emplace_back();
+				RigidBody& body = mBodies.back();
+
+				body.pose.position[0] = pivotX + 0.5f;
+				body.pose.position[1] = pivotY + 0.5f;
+				body.pose.position[2] = pivotZ + 0.5f;
+
+				for (const CellPosition& cell : island) {
+					body.add(cell.x - pivotX, cell.y - pivotY, cell.z - pivotZ, getMaterial(cell.x, cell.y, cell.z));
+					setMaterial(cell.x, cell.y, cell.z, MATERIAL_AIR);
+				}
+
+				stats.bodiesDetached++;
+			}
+		}
+
+		if (mBodies.empty())
+			return;
+
+		// Landing changes the grid the bodies after it fall through, so they go one at a time in the order they
+		// came loose
+		size_t kept = 0;
+
+		for (size_t i = 0; i < mBodies.size(); i++) {
+			if (moveBody(mBodies[i])) {
+				landBody(mBodies[i]);
+				stats.bodiesLanded++;
+				continue;
+			}
+
+			if (kept != i)
+				mBodies[kept] = std::move(mBodies[i]);
+
+			kept++;
+		}
+
+		mBodies.erase(mBodies.begin() + kept, mBodies.end());
+	}
+
+	bool World::isFreeForBody(int x, int y, int z) {
+		uint8_t material = getMaterial(x, y, z);
+
+		return material == MATERIAL_AIR || getMaterialState(material) == MATERIAL_STATE_GAS;
+	}
+
+	bool World::bodyFits(const RigidBody& body) {
+		for (size_t i = 0; i < body.size(); i++) {
+			int x, y, z;
+			body.getCell(i, x, y, z);
+
+			if (!isFreeForBody(x, y, z))
+				return false;
+		}
+
+		return true;
+	}
+
+	bool World::rotateBody(RigidBody& body, int axis, float angle, float pivotX, float pivotY, float pivotZ) {
+		// Cells far from the pivot would otherwise skip over whatever is in their way
+		float distance = std::abs(angle) * (body.radius + std::abs(body.pose.position[1] - pivotY) + 2.0f);
+		int steps = std::max(1, (int)std::ceil(distance));
+
+		for (int step = 0; step < steps; step++) {
+			BodyPose last = body.pose;
+
+			body.rotate(axis, angle / steps, pivotX, pivotY, pivotZ);
+
+			if (!bodyFits(body)) {
+				body.pose = last;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool World::moveBody(RigidBody& body) {
+		body.ticks++;
+		body.fallSpeed = std::min(body.fallSpeed + 1, FALL_SPEED_MAX);
+
+		int fallen = 0;
+
+		while (fallen < body.fallSpeed) {
+			body.pose.position[1] -= 1.0f;
+
+			if (!bodyFits(body)) {
+				body.pose.position[1] += 1.0f;
+				break;
+			}
+
+			fallen++;
+		}
+
+		if (fallen == body.fallSpeed) {
+			// Still in the air, keeps turning the way it tipped over
+			if (body.spin != 0.0f && !rotateBody(body, body.spinAxis, body.spin, body.pose.position[0], body.pose.position[1], body.pose.position[2]))
+				body.spin = 0.0f;
+
+			return body.ticks >= BODY_MAX_TICKS;
+		}
+
+		body.fallSpeed = 0;
+
+		// Resting on something. Lands if its center is over the cells holding it up, and tips over the edge it is
+		// furthest past otherwise
+		int minX = INT32_MAX;
+		int minZ = INT32_MAX;
+		int maxX = INT32_MIN;
+		int maxZ = INT32_MIN;
+		int bottom = INT32_MAX;
+
+		for (size_t i = 0; i < body.size(); i++) {
+			int x, y, z;
+			body.getCell(i, x, y, z);
+
+			if (isFreeForBody(x, y - 1, z))
+				continue;
+
+			minX = std::min(minX, x);
+			minZ = std::min(minZ, z);
+			maxX = std::max(maxX, x + 1);
+			maxZ = std::max(maxZ, z + 1);
+			bottom = std::min(bottom, y);
+		}
+
+		float centerX = body.pose.position[0];
+		float centerZ = body.pose.position[2];
+
+		float pastX = centerX < minX ? minX - centerX : std::max(centerX - maxX, 0.0f);
+		float pastZ = centerZ < minZ ? minZ - centerZ : std::max(centerZ - maxZ, 0.0f);
+
+		if (pastX == 0.0f && pastZ == 0.0f)
+			return true;
+
+		// Turning around z lowers the side towards +x for a negative angle, turning around x lowers the side
+		// towards +z for a positive one
+		int axis;
+		float direction;
+		float pivotX = centerX;
+		float pivotZ = centerZ;
+
+		if (pastX >= pastZ) {
+			axis = 2;
+			direction = centerX > maxX ? -1.0f : 1.0f;
+			pivotX = centerX > maxX ? (float)maxX : (float)minX;
+		}
+		else {
+			axis = 0;
+			direction = centerZ > maxZ ? 1.0f : -1.0f;
+			pivotZ = centerZ > maxZ ? (float)maxZ : (float)minZ;
+		}
+
+		float speed = axis == body.spinAxis ? std::abs(body.spin) : 0.0f;
+
+		body.spinAxis = axis;
+		body.spin = direction * std::min(speed + BODY_TIP_ACCELERATION, BODY_MAX_SPIN);
+
+		// Stuck against something while tipping over, stays where it got to
+		if (!rotateBody(body, axis, body.spin, pivotX, (float)bottom, pivotZ))
+			return true;
+
+		return body.ticks >= BODY_MAX_TICKS;
+	}
+
+	void World::landBody(const RigidBody& body) {
+		for (size_t i = 0; i < body.size(); i++) {
+			int x, y, z;
+			body.getCell(i, x, y, z);
+
+			// Gas is pushed up out of the way rather than replaced, so a body landing in a plume keeps it
+			while (y <= mMaxCell[1] && getMaterial(x, y, z) != MATERIAL_AIR && !(isFreeForBody(x, y, z) && liftGas(x, y, z))) {
+				y++;
+			}
+
+			// Only out of the top of a bounded world is there no free cell above
+			if (y <= mMaxCell[1])
+				setMaterial(x, y, z, body.materials[i]);
+		}
+	}
+
+	bool World::liftGas(int x, int y, int z) {
+		for (int above = y + 1; above <= mMaxCell[1]; above++) {
+			uint8_t material = getMaterial(x, above, z);
+
+			if (material != MATERIAL_AIR) {
+				if (getMaterialState(material) != MATERIAL_STATE_GAS)
+					return false;
+
+				continue;
+			}
+
+			// Keeps its density, setMaterial clears the flags
+			Cell gas = *getCell(x, y, z);
+
+			setMaterial(x, above, z, gas.material);
+			getCell(x, above, z)->flags = gas.flags & CELL_LEVEL_MASK;
+			setMaterial(x, y, z, MATERIAL_AIR);
+
+			return true;
+		}
+
+		return false;
+	}
+
+	void World::tickHeat() {
+		if (!beginHeat())
+			return;
+
+		for (Chunk* chunk : mHeatScanChunks) {
+			scanHeatSources(*chunk);
+		}
+
+		spreadHeat();
+
+		for (Chunk* chunk : mHeatChunks) {
+			updateHeat(*this, *chunk, mTickCount);
+		}
+
+		finishHeat();
+	}
+
+	bool World::beginHeat() {
+		mHeatScanChunks.clear();
+
+		if (MaterialRegistry::getTables().heatSourceCount == 0 && mHeatFields == 0)
+			return false;
+
+		// Whatever sleeps has been scanned before, compressed chunks are read through getCell
+		for (auto& chunk : mChunks) {
+			if (chunk->isActive())
+				mHeatScanChunks.push_back(chunk.get());
+		}
+
+		return true;
+	}
+
+	void World::spreadHeat() {
+		mHeatChunks.clear();
+
+		for (auto& chunk : mChunks) {
+			if (chunk->getHeat() != nullptr)
+				mHeatChunks.push_back(chunk.get());
+		}
+
+		// Fields handed out here start at ambient, they spread further once they have warmed up themselves
+		size_t fieldCount = mHeatChunks.size();
+
+		for (size_t i = 0; i < fieldCount; i++) {
+			Chunk* chunk = mHeatChunks[i];
+			uint8_t warmFaces = chunk->getHeat()->warmFaces;
+
+			if (warmFaces == 0)
+				continue;
+
+			// Only across faces, edge and corner neighbours get theirs from the face neighbours once those warm up
+			for (int face = 0; face < 6; face++) {
+				if ((warmFaces & (1 << face)) == 0)
+					continue;
+
+				const int* offset = HEAT_FACE_OFFSETS[face];
+				Chunk* neighbour = chunk->getNeighbour(offset[0], offset[1], offset[2]);
+
+				if (neighbour == nullptr || neighbour->getHeat() != nullptr)
+					continue;
+
+				neighbour->createHeat();
+				mHeatChunks.push_back(neighbour);
+			}
+		}
+	}
+
+	void World::finishHeat() {
+		mHeatFields = 0;
+
+		for (Chunk* chunk : mHeatChunks) {
+			HeatField* field = chunk->getHeat();
+			field->current ^= 1;
+
+			if (field->settledTicks >= HEAT_SETTLE_TICKS)
+				chunk->freeHeat();
+			else
+				mHeatFields++;
+		}
+
+		// Chunks may be freed before the next tick
+		mHeatChunks.clear();
+	}
+
+	float World::getTemperature(int x, int y, int z) const {
+		Chunk* chunk = getChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+
+		if (chunk == nullptr || chunk->getHeat() == nullptr)
+			return HEAT_AMBIENT;
+
+		return chunk->getHeat()->getTemperatures()[HeatField::index((x & CHUNK_MASK) >> HEAT_SHIFT, (y & CHUNK_MASK) >> HEAT_SHIFT, (z & CHUNK_MASK) >> HEAT_SHIFT)];
+	}
+
+	void World::collectActiveChunks(std::vector<Chunk*>& outChunks) const {
+		outChunks.clear();
+
+		for (const std::vector<Chunk*>& parityClass : mParityClasses) {
+			for (Chunk* chunk : parityClass) {
+				if (chunk->isActive() && chunk->isDense())
+					outChunks.push_back(chunk);
+			}
+		}
+	}
+
+	void World::finishTick() {
+		freeEmptyChunks();
+
+		if (mCompressIdleChunks)
+			compressIdleChunks();
+
+		mTickCount++;
+	}
+
+	void World::rebuildParityClasses() {
+		for (auto& parityClass : mParityClasses) {
+			parityClass.clear();
+		}
+
+		for (auto& chunk : mChunks) {
+			int parityClass = (chunk->getX() & 1) | ((chunk->getZ() & 1) << 1) | ((chunk->getY() & 1) << 2);
+
+			mParityClasses[parityClass].push_back(chunk.get());
+		}
+
+		mChunksChanged = false;
+	}
+
+	void World::freeEmptyChunks() {
+		// Decide first, so unlinking one chunk can't change the answer for another
+		mFreeing.assign(mChunks.size(), false);
+		bool anyFreed = false;
+
+		for (size_t i = 0; i < mChunks.size(); i++) {
+			// An empty chunk next to an active one would only be created again at the start of the next tick
+			mFreeing[i] = mChunks[i]->isEmpty() && !hasActiveNeighbour(*mChunks[i]);
+			anyFreed = anyFreed || mFreeing[i];
+		}
+
+		if (!anyFreed)
+			return;
+
+		size_t kept = 0;
+
+		for (size_t i = 0; i < mChunks.size(); i++) {
+			Chunk* chunk = mChunks[i].get();
+
+			if (!mFreeing[i]) {
+				// Keep creation order, iteration order has to stay the same from run to run
+				if (kept != i)
+					mChunks[kept] = std::move(mChunks[i]);
+
+				kept++;
+				continue;
+			}
+
+			for (int offsetY = -1; offsetY <= 1; offsetY++) {
+				for (int offsetZ = -1; offsetZ <= 1; offsetZ++) {
+					for (int offsetX = -1; offsetX <= 1; offsetX++) {
+						Chunk* neighbour = chunk->getNeighbour(offsetX, offsetY, offsetZ);
+
+						if (neighbour != nullptr && neighbour != chunk)
+							neighbour->setNeighbour(-offsetX, -offsetY, -offsetZ, nullptr);
+					}
+				}
+			}
+
+			mChunkMap.erase(packChunkKey(chunk->getX(), chunk->getY(), chunk->getZ()));
+			mChunks[i].reset();
+		}
+
+		mChunks.resize(kept);
+		mChunksChanged = true;
+	}
+
+	void World::compressIdleChunks() {
+		for (auto& chunk : mChunks) {
+			// Counted for every chunk, so turning compression on later doesn't have to wait for the count to build up
+			if (chunk->updateIdleTicks() < CHUNK_COMPRESS_TICKS || !chunk->isDense())
+				continue;
+
+			// Would only be expanded again at the start of the next tick
+			if (!hasActiveNeighbour(*chunk))
+				chunk->compress();
+		}
+	}
+
+	WorldMemoryStats World::getMemoryStats() const {
+		WorldMemoryStats stats;
+
+		for (auto& chunk : mChunks) {
+			switch (chunk->getStorage()) {
+			case CHUNK_STORAGE_DENSE:
+				stats.denseChunks++;
+				stats.denseCellBytes += chunk->getCellMemoryBytes();
+				break;
+			case CHUNK_STORAGE_UNIFORM:
+				stats.uniformChunks++;
+				break;
+			case CHUNK_STORAGE_PACKED:
+				stats.compressedChunks++;
+				stats.compressedCellBytes += chunk->getCellMemoryBytes();
+				break;
+			}
+
+			if (chunk->getHeat() != nullptr) {
+				stats.heatFields++;
+				stats.heatBytes += util::getBlockPool(sizeof(HeatField)).getBlockSize();
+			}
+		}
+
+		stats.particles = mParticles.size();
+		stats.particleBytes = mParticles.getMemoryBytes();
+
+		stats.bodies = mBodies.size();
+		stats.bodyBytes = mBodies.capacity() * sizeof(RigidBody) + mConnectivity.getMemoryBytes();
+
+		for (const RigidBody& body : mBodies) {
+			stats.bodyBytes += body.getMemoryBytes() - sizeof(RigidBody);
+		}
+
+		for (const std::vector<CellPosition>& island : mIslands) {
+			stats.bodyBytes += island.capacity() * sizeof(CellPosition);
+		}
+
+		stats.chunkBytes = mChunks.capacity() * sizeof(std::unique_ptr<Chunk>) + mChunks.size() * util::getBlockPool(sizeof(Chunk)).getBlockSize();
+		stats.chunkMapBytes = mChunkMap.getMemoryBytes();
+
+		for (auto& parityClass : mParityClasses) {
+			stats.tickBytes += parityClass.capacity() * sizeof(Chunk*);
+		}
+
+		stats.tickBytes += mFreeing.capacity() / 8;
+		stats.tickBytes += (mHeatScanChunks.capacity() + mHeatChunks.capacity()) * sizeof(Chunk*);
+		stats.tickBytes += mDrainedEdits.capacity() * sizeof(EditCommand) + mEditPieces.capacity() * sizeof(EditPiece);
+		stats.editQueueBytes = mEditQueue.getMemoryBytes();
+
+		return stats;
+	}
+
+	uint64_t World::computeChecksum() const {
+		// Creation order depends on how the world was built, so go by position instead
+		std::vector<std::pair<uint64_t, uint64_t>> chunkChecksums;
+
+		for (auto& chunk : mChunks) {
+			if (!chunk->isEmpty())
+				chunkChecksums.emplace_back(packChunkKey(chunk->getX(), chunk->getY(), chunk->getZ()), chunk->computeChecksum());
+		}
+
+		std::sort(chunkChecksums.begin(), chunkChecksums.end());
+
+		uint64_t checksum = mixBits(mTickCount);
+
+		for (auto& chunkChecksum : chunkChecksums) {
+			checksum = mixBits(checksum ^ chunkChecksum.second);
+		}
+
+		// Particles are outside of the grid, in the order they were thrown
+		for (size_t i = 0; i < mParticles.size(); i++) {
+			checksum = mixFloat(checksum, mParticles.positionsX[i]);
+			checksum = mixFloat(checksum, mParticles.positionsY[i]);
+			checksum = mixFloat(checksum, mParticles.positionsZ[i]);
+			checksum = mixFloat(checksum, mParticles.velocitiesX[i]);
+			checksum = mixFloat(checksum, mParticles.velocitiesY[i]);
+			checksum = mixFloat(checksum, mParticles.velocitiesZ[i]);
+			checksum = mixBits(checksum ^ (uint32_t)mParticles.cellsX[i]);
+			checksum = mixBits(checksum ^ (uint32_t)mParticles.cellsY[i]);
+			checksum = mixBits(checksum ^ (uint32_t)mParticles.cellsZ[i]);
+			checksum = mixBits(checksum ^ ((uint64_t)mParticles.materials[i] << 16 | mParticles.ages[i]));
+		}
+
+		// So are the cells of falling islands, in the order they came loose
+		for (const RigidBody& body : mBodies) {
+			for (float value : body.pose.position) {
+				checksum = mixFloat(checksum, value);
+			}
+
+			for (float value : body.pose.rotation) {
+				checksum = mixFloat(checksum, value);
+			}
+
+			checksum = mixFloat(checksum, body.spin);
+			checksum = mixBits(checksum ^ ((uint64_t)(uint32_t)body.fallSpeed | ((uint64_t)(uint32_t)body.spinAxis << 32)));
+			checksum = mixBits(checksum ^ (uint32_t)body.ticks);
+
+			for (size_t i = 0; i < body.size(); i++) {
+				checksum = mixBits(checksum ^ (uint32_t)body.offsetsX[i]);
+				checksum = mixBits(checksum ^ (uint32_t)body.offsetsY[i]);
+				checksum = mixBits(checksum ^ (uint32_t)body.offsetsZ[i]);
+				checksum = mixBits(checksum ^ body.materials[i]);
+			}
+		}
+
+		return checksum;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,427 @@
+#pragma once
+
+#include "chunk.h"
+#include "chunk_map.h"
+#include "connectivity.h"
+#include "fall_kernel.h"
+#include "liquid_kernel.h"
+#include "margolus.h"
+#include "particles.h"
+#include "rigid_body.h"
+#include "edit.h"
+#include "../util/mpsc_ring.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sim {
+	constexpr int PARITY_CLASS_COUNT = 8;
+
+	// Chunk count for an axis that has no end
+	constexpr int WORLD_UNBOUNDED = 0;
+
+	// Edits that can wait for the next tick before producers start getting turned away
+	constexpr size_t EDIT_QUEUE_CAPACITY = 1 << 16;
+
+	struct TickStats {
+		uint64_t bricksUpdated{ 0 };
+		uint64_t cellsUpdated{ 0 };
+		uint64_t cellsMoved{ 0 };
+
+		// Queued edits applied at the start of the tick
+		uint64_t editsApplied{ 0 };
+
+		// Moves into neighbouring chunks that went through the outboxes, they count as moved as well. Rejected
+		// ones found their target taken by the time the outboxes were applied
+		uint64_t movesQueued{ 0 };
+		uint64_t movesRejected{ 0 };
+
+		// Particles that hit something and turned back into cells, and ones that found the cell they were in
+		// taken and had nowhere to go
+		uint64_t particlesLanded{ 0 };
+		uint64_t particlesLost{ 0 };
+
+		// Islands of solid cells that lost their support and started falling, and ones that landed again
+		uint64_t bodiesDetached{ 0 };
+		uint64_t bodiesLanded{ 0 };
+	};
+
+	// Bytes held by each part of a world
+	struct WorldMemoryStats {
+		size_t denseChunks{ 0 };
+		size_t compressedChunks{ 0 };
+
+		// All one cell, they take no memory beyond the chunk object
+		size_t uniformChunks{ 0 };
+
+		size_t denseCellBytes{ 0 };
+		// Packed cells shared by several chunks count once
+		size_t compressedCellBytes{ 0 };
+
+		// The chunk objects themselves, without their cells
+		size_t chunkBytes{ 0 };
+		size_t chunkMapBytes{ 0 };
+
+		// Parity classes and the buffers kept between ticks
+		size_t tickBytes{ 0 };
+		size_t editQueueBytes{ 0 };
+
+		// Temperature fields, only chunks near something hot or cold have one
+		size_t heatFields{ 0 };
+		size_t heatBytes{ 0 };
+
+		// Cells thrown out of the grid
+		size_t particles{ 0 };
+		size_t particleBytes{ 0 };
+
+		// Falling islands, and what the connectivity checks keep between ticks
+		size_t bodies{ 0 };
+		size_t bodyBytes{ 0 };
+
+		// Every WorldSnapshot alive, which only copy dense chunks and share packed cells with the world. A world
+		// doesn't know about its snapshots, WorldSnapshot::capture fills this in
+		size_t snapshotBytes{ 0 };
+
+		size_t getTotalBytes() const {
+			return denseCellBytes + compressedCellBytes + chunkBytes + chunkMapBytes + tickBytes + editQueueBytes + heatBytes + particleBytes
+				+ bodyBytes + snapshotBytes;
+		}
+	};
+
+	// A sparse world of chunks kept in a hash map. Only chunks that hold something, or sit next to a chunk that is
+	// moving, exist at all. Missing chunks read as air, so memory follows the occupied volume and not the bounds
+	//
+	// Each axis either runs from chunk 0 to its count - 1 or, with WORLD_UNBOUNDED, as far as chunk keys reach.
+	// Everything outside of the bounds behaves like stone, so the edges of a bounded world act as walls
+	class World {
+	public:
+		World(int chunksX, int chunksY, int chunksZ);
+
+		World(const World&) = delete;
+		World& operator=(const World&) = delete;
+
+		// Returns nullptr if the chunk is out of bounds or doesn't exist
+		Chunk* getChunk(int chunkX, int chunkY, int chunkZ) const;
+
+		// Creates an empty chunk if there isn't one yet and links it to its neighbours. Returns nullptr out of
+		// bounds. Only call between ticks
+		Chunk* getOrCreateChunk(int chunkX, int chunkY, int chunkZ);
+
+		// Every chunk that exists, in the order they were created
+		const std::vector<std::unique_ptr<Chunk>>& getChunks() const { return mChunks; }
+
+		size_t getChunkCount() const { return mChunks.size(); }
+
+		bool isInBounds(int chunkX, int chunkY, int chunkZ) const;
+
+		// Returns nullptr if the position is out of bounds or its chunk doesn't exist. Expands the chunk if it
+		// is compressed, so only call between ticks
+		Cell* getCell(int x, int y, int z);
+
+		// Stone out of bounds and air where there is no chunk
+		uint8_t getMaterial(int x, int y, int z);
+
+		void setMaterial(int x, int y, int z, uint8_t material);
+
+		void fillBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, uint8_t material);
+
+		// Applies an edit right away. Only safe while no tick is running, other threads should queue their edits
+		void applyEdit(const EditCommand& edit);
+
+		// Safe from any thread, the edit is applied at the start of the next tick. Returns false and drops
+		// the edit if the queue is full
+		bool queueEdit(const EditCommand& edit) { return mEditQueue.push(edit); }
+
+		// Applies the edits queued so far in the order they were queued. They are split up and sorted by
+		// chunk first, so every chunk is visited once no matter how many edits touch it. Called at the
+		// start of every tick by whoever ticks the world, returns the number of edits applied
+		size_t applyQueuedEdits();
+
+		// For world generation and loading, neither allocates a cell array. The chunk is created if needed and
+		// replaced as a whole. It isn't woken, call wakeBox for anything that should start moving. Returns nullptr
+		// out of bounds. Only call between ticks
+		Chunk* setUniformChunk(int chunkX, int chunkY, int chunkZ, Cell cell);
+
+		// Chunks given the same packed cells share them until one of them is written to, which gives that one
+		// its own dense copy. Use Chunk::getSharedCells of a finished chunk, or PackedCells::pack, to make them
+		Chunk* setSharedChunk(int chunkX, int chunkY, int chunkZ, std::shared_ptr<const PackedCells> cells);
+
+		// Wakes every brick that holds a cell next to the given position, including the position itself
+		void wakeAround(int x, int y, int z);
+
+		// Wakes the brick holding the given position, if it is in bounds
+		void wakeBrick(int x, int y, int z);
+
+		// Wakes every brick that overlaps the box, clamped to the world
+		void wakeBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+
+		// Advance the whole world by a single tick on the calling thread
+		TickStats tick();
+
+		// Called before any chunk is updated. Applies the queued edits, moves the falling islands and creates the
+		// missing neighbours of every active chunk, so cells can move out of an active chunk without creating
+		// chunks in the middle of a tick. Counts the edits applied and the islands that came loose or landed
+		void beginTick(TickStats& stats);
+
+		// Chunks are split into a 2x2x2 checkerboard by the parity of their coordinates. Two chunks of the
+		// same class never share a neighbour cell, so a whole class can be updated concurrently
+		const std::vector<Chunk*>& getParityClass(int parityClass) const { return mParityClasses[parityClass]; }
+
+		// Called once every parity class has been updated for the current tick. Frees the chunks that are
+		// all air and have no active neighbours, and compresses the ones that have been asleep for a while
+		void finishTick();
+
+		// Heat runs once every cell of the tick has moved and before finishTick, see heat.h. Returns false, and
+		// the rest can be skipped, when no material gives off heat and no chunk has a field. Otherwise collects
+		// the chunks that were awake, for scanHeatSources
+		bool beginHeat();
+		const std::vector<Chunk*>& getHeatScanChunks() const { return mHeatScanChunks; }
+
+		// Called once every chunk was scanned. Gives the neighbours on the warm faces of a field a field of their
+		// own, and collects every chunk with a field for updateHeat. Neighbours that don't exist stay at ambient
+		void spreadHeat();
+		const std::vector<Chunk*>& getHeatChunks() const { return mHeatChunks; }
+
+		// Called once every field was updated. Makes the new temperatures current and frees the fields that
+		// have settled
+		void finishHeat();
+
+		// HEAT_AMBIENT where the chunk has no field or doesn't exist
+		float getTemperature(int x, int y, int z) const;
+
+		// Runs on the calling thread once every cell of the tick has moved and before the heat. Integrates the
+		// particles in bulk, then traces the line each one moved along through the grid. A particle that hits a
+		// cell, or the edge of the world, turns back into a cell in the last free one on its line
+		void updateParticles(TickStats& stats);
+
+		// Cells thrown out by explosions, in the order they were thrown
+		const ParticleBuffer& getParticles() const { return mParticles; }
+
+		// Islands of solid cells falling outside of the grid, in the order they came loose
+		const std::vector<RigidBody>& getBodies() const { return mBodies; }
+
+		// Puts every particle and falling body back into the grid where it is, the way it would land. They live
+		// outside of the grid, so anything that only reads chunks, like a save, would lose their cells otherwise.
+		// Gives a different world than ticking on would. Only call between ticks
+		void settleTransients();
+
+		// Chunks that stay asleep for CHUNK_COMPRESS_TICKS, with no active neighbour, are palette compressed and
+		// expanded again before anything next to them moves. Compressed chunks only ever sit next to chunks that
+		// woke up during the current tick, which see them as walls until the next one, just like missing chunks.
+		// Turning it off leaves chunks that are already compressed as they are
+		void setCompressIdleChunks(bool compress) { mCompressIdleChunks = compress; }
+		bool getCompressIdleChunks() const { return mCompressIdleChunks; }
+
+		WorldMemoryStats getMemoryStats() const;
+
+		uint64_t getTickCount() const { return mTickCount; }
+
+		// For loading a saved world, which carries on from the tick it was saved at
+		void setTickCount(uint64_t tickCount) { mTickCount = tickCount; }
+
+		// Every random choice is derived from the seed, the tick and the cell position, so the same seed and
+		// starting state give a bit identical world after N ticks no matter how many threads run them
+		void setSeed(uint64_t seed) { mSeed = seed; }
+		uint64_t getSeed() const { return mSeed; }
+
+		// Which kernel moves falling granular cells in bulk before the per cell rules run. Changing it
+		// changes the update order, so runs that are compared must use the same kernel. Scalar and
+		// AVX2 give the same results, auto stays deterministic across machines
+		void setFallKernel(FallKernel kernel) { mFallKernel = kernel; }
+		FallKernel getFallKernel() const { return mFallKernel; }
+
+		// Updates each chunk through a copy with a one cell halo around it, so the rules never check whether a
+		// neighbour is in the same chunk. Costs a copy of every active brick in and out, gives the same world
+		void setChunkHalos(bool halos) { mChunkHalos = halos; }
+		bool getChunkHalos() const { return mChunkHalos; }
+
+		// Granular cells carry a fall speed that grows by one cell per tick up to FALL_SPEED_MAX, and a sideways
+		// drift from sliding off a slope or landing as a particle, and move that far along a line every tick.
+		// A long fall takes a few ticks instead of one per cell. Falls go through the per cell rules, the fall
+		// kernel and halos are not used, and with outboxes a fall stops where it leaves the chunk. Gives a
+		// different world, only applies to the scan order
+		void setFastFalls(bool fastFalls) { mFastFalls = fastFalls; }
+		bool getFastFalls() const { return mFastFalls; }
+
+		// Edits that take solid cells away check whether the solid cells around them are still held up, see
+		// SolidConnectivity. An island that isn't is taken out of the grid as a rigid body, which falls, tips over
+		// edges and turns, and is put back as cells where it lands. Bodies move at the start of the tick, before
+		// any cell, so cells above an island follow it down instead of falling into it. Only edits are checked,
+		// solids that melt or burn away leave what they held up in place
+		void setDetachIslands(bool detach) { mDetachIslands = detach; }
+		bool getDetachIslands() const { return mDetachIslands; }
+
+		// Ticks every active chunk at the same time instead of one parity class after another. Moves into other
+		// chunks wait in the outbox of their chunk and are applied in a short serial phase once every chunk is
+		// done, see applyOutboxes. Gives a different world than parity classes, and the same one on any number
+		// of threads. Halos are not used with outboxes
+		void setMoveOutboxes(bool outboxes) { mMoveOutboxes = outboxes; }
+		bool getMoveOutboxes() const { return mMoveOutboxes; }
+
+		// Outboxes only apply to the scan order, Margolus blocks don't need them
+		bool usesMoveOutboxes() const { return mMoveOutboxes && mRuleExecutor == RULE_EXECUTOR_SCAN; }
+
+		// How cells are moved. The scan order updates one cell at a time and is what everything else is tuned
+		// for. Margolus blocks never share a cell, so every active chunk is ticked at once. Each executor is
+		// deterministic on its own, but the two give different worlds. Halos and the fall kernel only apply to the
+		// scan order
+		void setRuleExecutor(RuleExecutor executor) { mRuleExecutor = executor; }
+		RuleExecutor getRuleExecutor() const { return mRuleExecutor; }
+
+		// How liquids move in the scan order. Whole cells keep sliding about and never quite settle, so bricks
+		// holding liquid stay awake. Fill levels flow down and sideways and, under pressure, back up until a
+		// body of liquid is level, and then go to sleep. The two give different worlds. Margolus blocks always
+		// move whole cells
+		void setLiquidModel(LiquidModel model) { mLiquidModel = model; }
+		LiquidModel getLiquidModel() const { return mLiquidModel; }
+
+		// Whether every active chunk is updated at the same time instead of one parity class after another
+		bool ticksInOneWave() const { return mRuleExecutor == RULE_EXECUTOR_MARGOLUS || usesMoveOutboxes(); }
+
+		// Every active dense chunk, in the order of the parity classes, for ticks in one wave
+		void collectActiveChunks(std::vector<Chunk*>& outChunks) const;
+
+		// Hash of every cell, the particles, the falling bodies and the tick count, for checking that two runs ended in the same state.
+		// Chunks that are all air count the same as missing ones
+		uint64_t computeChecksum() const;
+
+		// WORLD_UNBOUNDED for axes without an end
+		int getChunksX() const { return mChunksX; }
+		int getChunksY() const { return mChunksY; }
+		int getChunksZ() const { return mChunksZ; }
+
+		// Zero along unbounded axes
+		int getSizeX() const { return mChunksX * CHUNK_SIZE; }
+		int getSizeY() const { return mChunksY * CHUNK_SIZE; }
+		int getSizeZ() const { return mChunksZ * CHUNK_SIZE; }
+
+		// Cells in chunks that exist
+		uint64_t getCellCount() const { return (uint64_t)mChunks.size() * CHUNK_VOLUME; }
+
+		const ChunkMap& getChunkMap() const { return mChunkMap; }
+	private:
+		int mChunksX;
+		int mChunksY;
+		int mChunksZ;
+
+		// Inclusive bounds in chunks and in cells
+		int mMinChunk[3];
+		int mMaxChunk[3];
+		int mMinCell[3];
+		int mMaxCell[3];
+
+		uint64_t mTickCount{ 0 };
+		uint64_t mSeed{ 0 };
+
+		FallKernel mFallKernel{ FALL_KERNEL_AUTO };
+		RuleExecutor mRuleExecutor{ RULE_EXECUTOR_SCAN };
+		LiquidModel mLiquidModel{ LIQUID_MODEL_CELLS };
+
+		bool mCompressIdleChunks{ true };
+		bool mChunkHalos{ false };
+		bool mMoveOutboxes{ false };
+		bool mFastFalls{ false };
+		bool mDetachIslands{ false };
+
+		// Chunks ticked in one wave on the calling thread
+		std::vector<Chunk*> mWaveChunks;
+
+		ChunkMap mChunkMap;
+		std::vector<std::unique_ptr<Chunk>> mChunks;
+
+		uint64_t mNextChunkId{ 1 };
+
+		std::vector<Chunk*> mParityClasses[PARITY_CLASS_COUNT];
+
+		// Set when chunks were created or freed, the parity classes are rebuilt before the next tick
+		bool mChunksChanged{ false };
+
+		std::vector<bool> mFreeing;
+
+		// Chunks with a field after the last tick, may be off by the fields of chunks that were freed since
+		size_t mHeatFields{ 0 };
+
+		std::vector<Chunk*> mHeatScanChunks;
+		std::vector<Chunk*> mHeatChunks;
+
+		ParticleBuffer mParticles;
+
+		SolidConnectivity mConnectivity;
+		std::vector<RigidBody> mBodies;
+
+		// Kept between ticks, like the drained edits
+		std::vector<std::vector<CellPosition>> mIslands;
+
+		// The part of one queued edit that falls inside one chunk
+		struct EditPiece {
+			uint64_t key;
+			int chunkX;
+			int chunkY;
+			int chunkZ;
+			uint32_t edit;
+		};
+
+		util::MpscRing<EditCommand> mEditQueue{ EDIT_QUEUE_CAPACITY };
+
+		// Kept between ticks so draining the queue doesn't allocate
+		std::vector<EditCommand> mDrainedEdits;
+		std::vector<EditPiece> mEditPieces;
+
+		// Clamps the box of an edit to the world, returns false if nothing is left
+		bool clipEdit(const EditCommand& edit, int& minX, int& minY, int& minZ, int& maxX, int& maxY, int& maxZ) const;
+
+		void applyEditToChunk(Chunk& chunk, const EditCommand& edit);
+
+		// Turns the cells of an explosion inside the box, which is within the chunk, into particles. Returns the
+		// change in cells that aren't air
+		int ejectCells(Chunk& chunk, const EditCommand& edit, int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+
+		// Turns particle into a cell of its material at the position, which has to be air
+		void landParticle(size_t particle, int x, int y, int z);
+
+		// Moves the start of a particle up to the first free cell at or above it, where a cell that moved into the
+		// one it was in pushes it. Returns false out of the top of the world
+		bool pushParticleUp(int x, int& y, int z);
+
+		// Adds a connectivity check for an edit that may have taken solid cells away
+		void checkSupportAfter(const EditCommand& edit, int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+
+		// Takes the islands found by the connectivity checks out of the grid, then moves every body and puts the
+		// ones that landed back
+		void updateBodies(TickStats& stats);
+
+		// Air and gas, which a body falls through and pushes up when it lands
+		bool isFreeForBody(int x, int y, int z);
+
+		// Moves the gas cell at the position up to the first air above it, through any gas in between. Returns
+		// false, and leaves it where it is, if something else or the top of the world is in the way
+		bool liftGas(int x, int y, int z);
+
+		bool bodyFits(const RigidBody& body);
+
+		// Turns the body in steps of at most a cell at its edge, and stops at the last one that fits. Returns
+		// false if it had to stop early
+		bool rotateBody(RigidBody& body, int axis, float angle, float pivotX, float pivotY, float pivotZ);
+
+		// Returns true once the body has landed
+		bool moveBody(RigidBody& body);
+
+		// Puts the cells of the body into the grid, lifting the gas they land in. Cells that end up on an occupied
+		// cell, where two turned cells round to the same one or gas has nowhere to go, go to the first free cell
+		// above it
+		void landBody(const RigidBody& body);
+
+		// Chunk an edit has to be applied to, created if the edit puts something into it
+		Chunk* getEditChunk(const EditCommand& edit, int chunkX, int chunkY, int chunkZ);
+
+		void rebuildParityClasses();
+
+		// Every phase of the heat on the calling thread
+		void tickHeat();
+
+		void freeEmptyChunks();
+
+		void compressIdleChunks();
+	};
+}
\ No newline at end of file
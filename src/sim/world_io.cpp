@@ -0,0 +1,530 @@
+#include "world_io.h"
+#include "region_file.h"
+#include "../util/debug.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+	struct RegionChunks {
+		sim::RegionPosition position;
+
+		// Sorted by their index in the region, so files are written front to back
+		std::vector<std::pair<int, const sim::Chunk*>> chunks;
+	};
+
+	// What each participant of the job system keeps while it encodes or decodes regions
+	struct alignas(64) ParticipantState {
+		std::vector<sim::Cell> scratch;
+		std::vector<uint8_t> payload;
+		size_t payloadBytes{ 0 };
+		size_t fileBytes{ 0 };
+	};
+
+	struct LoadedChunk {
+		int chunkX;
+		int chunkY;
+		int chunkZ;
+		sim::DecodedChunk chunk;
+	};
+
+	uint64_t packRegionKey(int regionX, int regionY, int regionZ) {
+		return ((uint64_t)(uint32_t)regionX << 42) ^ ((uint64_t)(uint32_t)regionY << 21) ^ (uint64_t)(uint32_t)regionZ;
+	}
+
+	std::string getRegionPath(const std::string& directory, int regionX, int regionY, int regionZ) {
+		return (std::filesystem::path(directory) / sim::RegionFile::getFileName(regionX, regionY, regionZ)).string();
+	}
+
+	bool parseFailed(const std::string& filename, int lineNumber, const std::string& line, const std::string& reason) {
+		util::displayMessage(filename + ":" + std::to_string(lineNumber) + ": " + reason + " in '" + line + "'", DISPLAY_TYPE_ERR);
+
+		return false;
+	}
+
+	bool sameSize(const sim::World& world, const sim::WorldInfo& info) {
+		return world.getChunksX() == info.chunksX && world.getChunksY() == info.chunksY && world.getChunksZ() == info.chunksZ;
+	}
+
+	// Puts a decoded chunk into the world in the form it was decoded to
+	void installChunk(sim::World& world, int chunkX, int chunkY, int chunkZ, const sim::DecodedChunk& decoded) {
+		if (decoded.storage == sim::CHUNK_STORAGE_UNIFORM) {
+			world.setUniformChunk(chunkX, chunkY, chunkZ, decoded.uniformCell);
+			return;
+		}
+
+		if (decoded.storage == sim::CHUNK_STORAGE_PACKED) {
+			world.setSharedChunk(chunkX, chunkY, chunkZ, decoded.packedCells);
+			return;
+		}
+
+		sim::Chunk* chunk = world.setUniformChunk(chunkX, chunkY, chunkZ, sim::Cell{ sim::MATERIAL_AIR, 0 });
+
+		if (chunk == nullptr)
+			return;
+
+		chunk->decompress();
+		memcpy(chunk->getCells(), decoded.denseCells.data(), sizeof(sim::Cell) * sim::CHUNK_VOLUME);
+
+		int filledCells = (int)std::count_if(decoded.denseCells.begin(), decoded.denseCells.end(),
+			[](const sim::Cell& cell) { return cell.material != sim::MATERIAL_AIR; });
+
+		chunk->addFilledCells(filledCells);
+		chunk->markChanged();
+	}
+
+	// Moves the finished save in place of the previous one, which is only removed once the new one is there
+	bool replaceDirectory(const std::filesystem::path& target, const std::filesystem::path& staging) {
+		std::filesystem::path previous = target;
+		previous += ".old";
+
+		std::error_code error;
+		std::filesystem::remove_all(previous, error);
+
+		bool hadPrevious = std::filesystem::exists(target, error);
+
+		if (hadPrevious)
+			std::filesystem::rename(target, previous, error);
+
+		if (!error)
+			std::filesystem::rename(staging, target, error);
+
+		if (error) {
+			util::displayMessage("Could not move " + staging.string() + " to " + target.string() + ": " + error.message(), DISPLAY_TYPE_ERR);
+
+			// Puts the previous save back if it was already moved out of the way
+			std::error_code restoreError;
+
+			if (hadPrevious && !std::filesystem::exists(target, restoreError))
+				std::filesystem::rename(previous, target, restoreError);
+
+			return false;
+		}
+
+		std::filesystem::remove_all(previous, error);
+
+		return true;
+	}
+
+	void wakeChunk(sim::World& world, int chunkX, int chunkY, int chunkZ, int margin) {
+		int minX = chunkX * sim::CHUNK_SIZE;
+		int minY = chunkY * sim::CHUNK_SIZE;
+		int minZ = chunkZ * sim::CHUNK_SIZE;
+
+		world.wakeBox(minX - margin, minY - margin, minZ - margin, minX + sim::CHUNK_MASK + margin, minY + sim::CHUNK_MASK + margin,
+			minZ + sim::CHUNK_MASK + margin);
+	}
+}
+
+namespace sim {
+	bool readWorldInfo(const std::string& directory, WorldInfo& outInfo) {
+		std::string filename = (std::filesystem::path(directory) / WORLD_INFO_FILE).string();
+		std::ifstream file(filename);
+
+		if (!file.is_open()) {
+			util::displayMessage("File not found: " + filename, DISPLAY_TYPE_ERR);
+			return false;
+		}
+
+		outInfo = WorldInfo();
+
+		std::string line;
+		int lineNumber = 0;
+		bool foundWorld = false;
+
+		while (std::getline(file, line)) {
+			lineNumber++;
+
+			std::istringstream stream(line);
+
+			std::string command;
+			if (!(stream >> command))
+				continue;
+
+			if (command == "world") {
+				if (!(stream >> outInfo.chunksX >> outInfo.chunksY >> outInfo.chunksZ) || outInfo.chunksX < 0 || outInfo.chunksY < 0 || outInfo.chunksZ < 0)
+					return parseFailed(filename, lineNumber, line, "Expected three chunk counts, 0 for unbounded");
+
+				foundWorld = true;
+			}
+			else if (command == "seed") {
+				if (!(stream >> outInfo.seed))
+					return parseFailed(filename, lineNumber, line, "Expected a seed");
+			}
+			else if (command == "tick") {
+				if (!(stream >> outInfo.tick))
+					return parseFailed(filename, lineNumber, line, "Expected a tick count");
+			}
+			else if (command == "region") {
+				RegionPosition region;
+
+				if (!(stream >> region.x >> region.y >> region.z))
+					return parseFailed(filename, lineNumber, line, "Expected a region position");
+
+				outInfo.regions.push_back(region);
+			}
+			else {
+				return parseFailed(filename, lineNumber, line, "Unknown command '" + command + "'");
+			}
+		}
+
+		if (!foundWorld) {
+			util::displayMessage(filename + ": Missing the world size", DISPLAY_TYPE_ERR);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool writeWorldInfo(const std::string& directory, const WorldInfo& info) {
+		std::string filename = (std::filesystem::path(directory) / WORLD_INFO_FILE).string();
+		std::ofstream file(filename);
+
+		file << "world " << info.chunksX << " " << info.chunksY << " " << info.chunksZ << "\n";
+		file << "seed " << info.seed << "\n";
+		file << "tick " << info.tick << "\n";
+
+		for (const RegionPosition& region : info.regions) {
+			file << "region " << region.x << " " << region.y << " " << region.z << "\n";
+		}
+
+		file.close();
+
+		if (!file) {
+			util::displayMessage("Could not write " + filename, DISPLAY_TYPE_ERR);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool saveWorld(const World& world, const std::string& directory, engine::jobs::JobSystem& jobSystem, WorldIOStats& outStats) {
+		auto start = std::chrono::steady_clock::now();
+
+		outStats = WorldIOStats();
+
+		// Everything is written to a sibling directory first and swapped in once it is complete, so a save that
+		// fails halfway leaves the previous one as it was. Regions that no longer hold anything go with it
+		std::filesystem::path target = std::filesystem::path(directory).lexically_normal();
+
+		if (!target.has_filename())
+			target = target.parent_path();
+
+		std::filesystem::path staging = target;
+		staging += ".saving";
+
+		std::error_code error;
+		std::filesystem::remove_all(staging, error);
+		std::filesystem::create_directories(staging, error);
+
+		if (error) {
+			util::displayMessage("Could not create " + staging.string() + ": " + error.message(), DISPLAY_TYPE_ERR);
+			return false;
+		}
+
+		std::string stagingDirectory = staging.string();
+
+		std::vector<RegionChunks> regions;
+		std::unordered_map<uint64_t, size_t> regionIndices;
+
+		for (const auto& chunk : world.getChunks()) {
+			if (chunk->isEmpty())
+				continue;
+
+			int regionX = chunk->getX() >> REGION_SHIFT;
+			int regionY = chunk->getY() >> REGION_SHIFT;
+			int regionZ = chunk->getZ() >> REGION_SHIFT;
+
+			auto found = regionIndices.emplace(packRegionKey(regionX, regionY, regionZ), regions.size());
+
+			if (found.second)
+				regions.push_back(RegionChunks{ RegionPosition{ regionX, regionY, regionZ }, {} });
+
+			int index = RegionFile::chunkIndex(chunk->getX() & REGION_MASK, chunk->getY() & REGION_MASK, chunk->getZ() & REGION_MASK);
+			regions[found.first->second].chunks.emplace_back(index, chunk.get());
+		}
+
+		// Creation order depends on how the world was built, so go by position instead
+		std::sort(regions.begin(), regions.end(), [](const RegionChunks& a, const RegionChunks& b) {
+			if (a.position.y != b.position.y)
+				return a.position.y < b.position.y;
+
+			return a.position.z != b.position.z ? a.position.z < b.position.z : a.position.x < b.position.x;
+		});
+
+		std::vector<ParticipantState> participants(jobSystem.getParticipantCount());
+		std::atomic<bool> failed{ false };
+
+		jobSystem.parallelFor(regions.size(), 1, [&](size_t begin, size_t end, int participant) {
+			ParticipantState& state = participants[participant];
+
+			if (state.scratch.empty())
+				state.scratch.resize(CHUNK_VOLUME);
+
+			for (size_t i = begin; i < end; i++) {
+				RegionChunks& region = regions[i];
+				std::sort(region.chunks.begin(), region.chunks.end());
+
+				RegionFile file;
+
+				if (!file.create(getRegionPath(stagingDirectory, region.position.x, region.position.y, region.position.z), region.position.x,
+					region.position.y, region.position.z)) {
+					failed = true;
+					continue;
+				}
+
+				for (auto& chunk : region.chunks) {
+					encodeChunk(*chunk.second, state.payload, state.scratch.data());
+
+					if (!file.writeChunk(chunk.first, state.payload))
+						failed = true;
+
+					state.payloadBytes += state.payload.size();
+				}
+
+				if (!file.flush())
+					failed = true;
+
+				state.fileBytes += file.getFileBytes();
+			}
+		});
+
+		if (failed) {
+			util::displayMessage("Could not write the regions of " + directory, DISPLAY_TYPE_ERR);
+			std::filesystem::remove_all(staging, error);
+			return false;
+		}
+
+		WorldInfo info;
+		info.chunksX = world.getChunksX();
+		info.chunksY = world.getChunksY();
+		info.chunksZ = world.getChunksZ();
+		info.seed = world.getSeed();
+		info.tick = world.getTickCount();
+
+		for (const RegionChunks& region : regions) {
+			info.regions.push_back(region.position);
+			outStats.chunks += region.chunks.size();
+		}
+
+		if (!writeWorldInfo(stagingDirectory, info)) {
+			std::filesystem::remove_all(staging, error);
+			return false;
+		}
+
+		if (!replaceDirectory(target, staging))
+			return false;
+
+		for (const ParticipantState& state : participants) {
+			outStats.payloadBytes += state.payloadBytes;
+			outStats.fileBytes += state.fileBytes;
+		}
+
+		outStats.regions = regions.size();
+		outStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		return true;
+	}
+
+	bool loadWorld(World& world, const std::string& directory, engine::jobs::JobSystem& jobSystem, WorldIOStats& outStats) {
+		auto start = std::chrono::steady_clock::now();
+
+		outStats = WorldIOStats();
+
+		WorldInfo info;
+
+		if (!readWorldInfo(directory, info))
+			return false;
+
+		if (!sameSize(world, info) || world.getChunkCount() != 0) {
+			util::displayMessage("The save in " + directory + " needs an empty world of " + std::to_string(info.chunksX) + "x"
+				+ std::to_string(info.chunksY) + "x" + std::to_string(info.chunksZ) + " chunks", DISPLAY_TYPE_ERR);
+			return false;
+		}
+
+		std::vector<ParticipantState> participants(jobSystem.getParticipantCount());
+		std::vector<std::vector<LoadedChunk>> regions(info.regions.size());
+		std::atomic<bool> failed{ false };
+
+		jobSystem.parallelFor(info.regions.size(), 1, [&](size_t begin, size_t end, int participant) {
+			ParticipantState& state = participants[participant];
+
+			if (state.scratch.empty())
+				state.scratch.resize(CHUNK_VOLUME);
+
+			for (size_t i = begin; i < end; i++) {
+				const RegionPosition& position = info.regions[i];
+				RegionFile file;
+
+				if (!file.open(getRegionPath(directory, position.x, position.y, position.z)) || file.getRegionX() != position.x
+					|| file.getRegionY() != position.y || file.getRegionZ() != position.z) {
+					failed = true;
+					continue;
+				}
+
+				for (int index = 0; index < REGION_CHUNKS; index++) {
+					if (!file.hasChunk(index))
+						continue;
+
+					LoadedChunk loaded;
+					loaded.chunkX = (position.x << REGION_SHIFT) + (index & REGION_MASK);
+					loaded.chunkZ = (position.z << REGION_SHIFT) + ((index >> REGION_SHIFT) & REGION_MASK);
+					loaded.chunkY = (position.y << REGION_SHIFT) + (index >> (REGION_SHIFT * 2));
+
+					if (!file.readChunk(index, state.payload)
+						|| !decodeChunk(state.payload.data(), state.payload.size(), loaded.chunk, state.scratch.data())) {
+						failed = true;
+						break;
+					}
+
+					state.payloadBytes += state.payload.size();
+					regions[i].push_back(std::move(loaded));
+				}
+
+				state.fileBytes += file.getFileBytes();
+			}
+		});
+
+		if (failed) {
+			util::displayMessage("Could not read the regions of " + directory, DISPLAY_TYPE_ERR);
+			return false;
+		}
+
+		// The world isn't thread safe, decoding is what takes the time anyway
+		for (const std::vector<LoadedChunk>& region : regions) {
+			for (const LoadedChunk& loaded : region) {
+				if (!world.isInBounds(loaded.chunkX, loaded.chunkY, loaded.chunkZ)) {
+					util::displayMessage("The save in " + directory + " has chunks out of bounds", DISPLAY_TYPE_ERR);
+					return false;
+				}
+
+				installChunk(world, loaded.chunkX, loaded.chunkY, loaded.chunkZ, loaded.chunk);
+				outStats.chunks++;
+			}
+		}
+
+		for (const std::vector<LoadedChunk>& region : regions) {
+			for (const LoadedChunk& loaded : region) {
+				if (loaded.chunk.flags & CHUNK_PAYLOAD_AWAKE)
+					wakeChunk(world, loaded.chunkX, loaded.chunkY, loaded.chunkZ, 0);
+			}
+		}
+
+		world.setSeed(info.seed);
+		world.setTickCount(info.tick);
+
+		for (const ParticipantState& state : participants) {
+			outStats.payloadBytes += state.payloadBytes;
+			outStats.fileBytes += state.fileBytes;
+		}
+
+		outStats.regions = info.regions.size();
+		outStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		return true;
+	}
+
+	bool saveChunk(const World& world, int chunkX, int chunkY, int chunkZ, const std::string& directory) {
+		WorldInfo info;
+
+		if (!readWorldInfo(directory, info))
+			return false;
+
+		int regionX = chunkX >> REGION_SHIFT;
+		int regionY = chunkY >> REGION_SHIFT;
+		int regionZ = chunkZ >> REGION_SHIFT;
+		int index = RegionFile::chunkIndex(chunkX & REGION_MASK, chunkY & REGION_MASK, chunkZ & REGION_MASK);
+
+		std::string path = getRegionPath(directory, regionX, regionY, regionZ);
+		const Chunk* chunk = world.getChunk(chunkX, chunkY, chunkZ);
+		bool empty = chunk == nullptr || chunk->isEmpty();
+
+		bool known = std::any_of(info.regions.begin(), info.regions.end(), [&](const RegionPosition& region) {
+			return region.x == regionX && region.y == regionY && region.z == regionZ;
+		});
+
+		RegionFile file;
+
+		if (!known) {
+			// Nothing to remove from a region the save doesn't have
+			if (empty)
+				return true;
+
+			info.regions.push_back(RegionPosition{ regionX, regionY, regionZ });
+
+			if (!file.create(path, regionX, regionY, regionZ) || !writeWorldInfo(directory, info)) {
+				util::displayMessage("Could not create " + path, DISPLAY_TYPE_ERR);
+				return false;
+			}
+		}
+		else if (!file.open(path)) {
+			util::displayMessage("Could not open " + path, DISPLAY_TYPE_ERR);
+			return false;
+		}
+
+		if (empty) {
+			file.removeChunk(index);
+		}
+		else {
+			std::vector<Cell> scratch(CHUNK_VOLUME);
+			std::vector<uint8_t> payload;
+
+			encodeChunk(*chunk, payload, scratch.data());
+
+			if (!file.writeChunk(index, payload)) {
+				util::displayMessage("Could not write to " + path, DISPLAY_TYPE_ERR);
+				return false;
+			}
+		}
+
+		return file.flush();
+	}
+
+	bool loadChunk(World& world, int chunkX, int chunkY, int chunkZ, const std::string& directory) {
+		if (!world.isInBounds(chunkX, chunkY, chunkZ))
+			return false;
+
+		int regionX = chunkX >> REGION_SHIFT;
+		int regionY = chunkY >> REGION_SHIFT;
+		int regionZ = chunkZ >> REGION_SHIFT;
+		int index = RegionFile::chunkIndex(chunkX & REGION_MASK, chunkY & REGION_MASK, chunkZ & REGION_MASK);
+
+		std::string path = getRegionPath(directory, regionX, regionY, regionZ);
+		DecodedChunk decoded{ CHUNK_STORAGE_UNIFORM, Cell{ MATERIAL_AIR, 0 }, nullptr, {}, 0 };
+
+		// A save without the region doesn't have the chunk either
+		RegionFile file;
+
+		if (std::filesystem::exists(path)) {
+			std::vector<uint8_t> payload;
+			std::vector<Cell> scratch(CHUNK_VOLUME);
+
+			if (!file.open(path) || !file.readChunk(index, payload)) {
+				util::displayMessage("Could not read " + path, DISPLAY_TYPE_ERR);
+				return false;
+			}
+
+			if (!payload.empty() && !decodeChunk(payload.data(), payload.size(), decoded, scratch.data())) {
+				util::displayMessage("Chunk " + std::to_string(index) + " of " + path + " is broken", DISPLAY_TYPE_ERR);
+				return false;
+			}
+		}
+
+		// Only a chunk that is there has to be replaced by air
+		if (decoded.storage == CHUNK_STORAGE_UNIFORM && decoded.uniformCell.material == MATERIAL_AIR && world.getChunk(chunkX, chunkY, chunkZ) == nullptr)
+			return true;
+
+		installChunk(world, chunkX, chunkY, chunkZ, decoded);
+
+		// Cells around the chunk may have lost what held them, or have somewhere to go now
+		wakeChunk(world, chunkX, chunkY, chunkZ, 1);
+
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "world.h"
+#include "../engine/jobs/job_system.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sim {
+	// Written next to the region files of a save
+	constexpr const char* WORLD_INFO_FILE = "world.txt";
+
+	struct RegionPosition {
+		int x;
+		int y;
+		int z;
+	};
+
+	// Everything a save holds besides the chunks, kept as text, one command per line:
+	//   world <chunks x> <chunks y> <chunks z>     0 for unbounded axes
+	//   seed <value>
+	//   tick <count>
+	//   region <x> <y> <z>                         for every region file
+	struct WorldInfo {
+		int chunksX{ 0 };
+		int chunksY{ 0 };
+		int chunksZ{ 0 };
+
+		uint64_t seed{ 0 };
+		uint64_t tick{ 0 };
+
+		std::vector<RegionPosition> regions;
+	};
+
+	struct WorldIOStats {
+		size_t chunks{ 0 };
+		size_t regions{ 0 };
+
+		// Encoded chunks, and the region files including headers and the padding up to each sector
+		size_t payloadBytes{ 0 };
+		size_t fileBytes{ 0 };
+
+		double seconds{ 0.0 };
+
+		// What the chunks take as dense cells
+		size_t getCellBytes() const { return chunks * CHUNK_VOLUME * sizeof(Cell); }
+	};
+
+	// Returns false and prints why if the file can't be read or parsed
+	bool readWorldInfo(const std::string& directory, WorldInfo& outInfo);
+	bool writeWorldInfo(const std::string& directory, const WorldInfo& info);
+
+	// Writes every chunk that isn't all air to region files in the directory, which is created if needed, and
+	// replaces whatever save was there. The save is written next to the directory, as <directory>.saving, and only
+	// takes its place once it is complete, so a save that fails keeps the previous one. Regions are encoded and
+	// written on every participant of the job system, one region file per job. Only call between ticks. Heat isn't
+	// saved, and neither are particles and falling bodies, whose cells are lost unless World::settleTransients
+	// puts them back into the grid first
+	bool saveWorld(const World& world, const std::string& directory, engine::jobs::JobSystem& jobSystem, WorldIOStats& outStats);
+
+	// Loads a save into a world of the same size that has no chunks yet, and sets its seed and tick count.
+	// Region files are read and decoded on every participant of the job system, the chunks are then put into the
+	// world on the calling thread. Chunks that were awake when they were saved are woken as a whole
+	bool loadWorld(World& world, const std::string& directory, engine::jobs::JobSystem& jobSystem, WorldIOStats& outStats);
+
+	// Writes a single chunk into an existing save without touching any other, adding its region if the save
+	// doesn't have it yet. A chunk that is all air or doesn't exist is removed from its region
+	bool saveChunk(const World& world, int chunkX, int chunkY, int chunkZ, const std::string& directory);
+
+	// Replaces a single chunk of the world with the one in the save, air if the save doesn't have it. Wakes the
+	// chunk and the cells around it, like an edit would. Only call between ticks
+	bool loadChunk(World& world, int chunkX, int chunkY, int chunkZ, const std::string& directory);
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace util {
+	// Index of the lowest set bit, the value must not be zero
+	inline int countTrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return (int)index;
+#else
+		return __builtin_ctzll(value);
+#endif
+	}
+
+	// Zero bits above the highest set bit, the value must not be zero
+	inline int countLeadingZeros(uint64_t value) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return 63 - (int)index;
+#else
+		return __builtin_clzll(value);
+#endif
+	}
+
+	inline int popCount(uint64_t value) {
+#ifdef _MSC_VER
+		return (int)__popcnt64(value);
+#else
+		return __builtin_popcountll(value);
+#endif
+	}
+}
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include "block_pool.h"
+#include "debug.h"
+
+#include <cstdlib>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+	const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+	// Bytes a thread may keep on its own free list in each pool
+	const size_t THREAD_LIST_BYTES = 256 * 1024;
+
+	void* allocateSlab(size_t bytes) {
+		size_t alignment = bytes % HUGE_PAGE_SIZE == 0 ? HUGE_PAGE_SIZE : 64;
+
+#ifdef _MSC_VER
+		void* slab = _aligned_malloc(bytes, alignment);
+#else
+		void* slab = aligned_alloc(alignment, bytes);
+
+#ifdef MADV_HUGEPAGE
+		// Only a hint, the slab works the same without huge pages
+		if (slab != nullptr && alignment == HUGE_PAGE_SIZE)
+			madvise(slab, bytes, MADV_HUGEPAGE);
+#endif
+#endif
+
+		if (slab == nullptr)
+			util::displayError("Out of memory for a block pool slab of " + std::to_string(bytes) + " bytes");
+
+		return slab;
+	}
+
+	// Every size class, created the first time it is used and never destroyed
+	std::atomic<util::BlockPool*> gPools[util::BLOCK_POOL_CLASS_COUNT];
+	std::mutex gPoolsMutex;
+
+	// Threads are numbered so they can find their free list in every pool. Numbers of threads that
+	// exited are handed out again, after their free lists went back to the central ones
+	std::mutex gThreadMutex;
+	std::vector<int> gFreeThreadIndices;
+	int gNextThreadIndex = 0;
+
+	struct ThreadIndex {
+		int index;
+
+		ThreadIndex() {
+			std::lock_guard<std::mutex> lock(gThreadMutex);
+
+			if (!gFreeThreadIndices.empty()) {
+				index = gFreeThreadIndices.back();
+				gFreeThreadIndices.pop_back();
+			}
+			else {
+				index = gNextThreadIndex < util::BLOCK_POOL_MAX_THREADS ? gNextThreadIndex++ : -1;
+			}
+		}
+
+		~ThreadIndex() {
+			if (index < 0)
+				return;
+
+			for (auto& pool : gPools) {
+				util::BlockPool* existing = pool.load(std::memory_order_acquire);
+
+				if (existing != nullptr)
+					existing->flushThread(index);
+			}
+
+			std::lock_guard<std::mutex> lock(gThreadMutex);
+			gFreeThreadIndices.push_back(index);
+
+			// Anything this thread still frees from other destructors goes straight to the central lists
+			index = -1;
+		}
+	};
+
+	// -1 for threads past BLOCK_POOL_MAX_THREADS, they always go through the central list
+	int getThreadIndex() {
+		thread_local ThreadIndex threadIndex;
+		return threadIndex.index;
+	}
+
+	int getSizeClass(size_t bytes) {
+		int sizeClass = 0;
+
+		while ((util::BLOCK_POOL_MIN_SIZE << sizeClass) < bytes) {
+			sizeClass++;
+		}
+
+		return sizeClass;
+	}
+}
+
+namespace util {
+	BlockPool::BlockPool(size_t blockSize, size_t slabBytes) : mBlockSize{ blockSize }, mSlabBytes{ slabBytes } {
+		mThreadLimit = THREAD_LIST_BYTES / blockSize < 4 ? 4 : THREAD_LIST_BYTES / blockSize;
+		mBatchSize = mThreadLimit / 2;
+	}
+
+	void* BlockPool::allocate() {
+		int thread = getThreadIndex();
+
+		if (thread >= 0) {
+			ThreadList& list = mThreadLists[thread];
+
+			if (list.head == nullptr) {
+				// Refill with a batch, so the lock is taken once for many allocations
+				std::lock_guard<std::mutex> lock(mMutex);
+
+				for (size_t i = 0; i < mBatchSize; i++) {
+					if (mFreeHead == nullptr)
+						addSlab();
+
+					FreeBlock* block = mFreeHead;
+					mFreeHead = block->next;
+
+					block->next = list.head;
+					list.head = block;
+					list.count++;
+				}
+			}
+
+			FreeBlock* block = list.head;
+			list.head = block->next;
+			list.count--;
+
+			countAllocation();
+
+			return block;
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		if (mFreeHead == nullptr)
+			addSlab();
+
+		FreeBlock* block = mFreeHead;
+		mFreeHead = block->next;
+
+		countAllocation();
+
+		return block;
+	}
+
+	void BlockPool::deallocate(void* pointer) {
+		if (pointer == nullptr)
+			return;
+
+		FreeBlock* block = static_cast<FreeBlock*>(pointer);
+		mLiveBlocks.fetch_sub(1, std::memory_order_relaxed);
+
+		int thread = getThreadIndex();
+
+		if (thread < 0) {
+			std::lock_guard<std::mutex> lock(mMutex);
+
+			block->next = mFreeHead;
+			mFreeHead = block;
+			return;
+		}
+
+		ThreadList& list = mThreadLists[thread];
+
+		block->next = list.head;
+		list.head = block;
+		list.count++;
+
+		if (list.count <= mThreadLimit)
+			return;
+
+		// Keep half, so a thread that frees and allocates around the limit doesn't take the lock every time
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		while (list.count > mThreadLimit - mBatchSize) {
+			FreeBlock* moved = list.head;
+			list.head = moved->next;
+			list.count--;
+
+			moved->next = mFreeHead;
+			mFreeHead = moved;
+		}
+	}
+
+	void BlockPool::flushThread(int thread) {
+		ThreadList& list = mThreadLists[thread];
+
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		while (list.head != nullptr) {
+			FreeBlock* moved = list.head;
+			list.head = moved->next;
+
+			moved->next = mFreeHead;
+			mFreeHead = moved;
+		}
+
+		list.count = 0;
+	}
+
+	BlockPoolStats BlockPool::getStats() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		BlockPoolStats stats;
+		stats.blockSize = mBlockSize;
+		stats.slabs = mSlabs.size();
+		stats.reservedBytes = mSlabs.size() * mSlabBytes;
+		stats.liveBlocks = mLiveBlocks.load(std::memory_order_relaxed);
+		stats.peakBlocks = mPeakBlocks.load(std::memory_order_relaxed);
+
+		// Blocks on the thread lists count as free as well
+		size_t total = stats.reservedBytes / mBlockSize;
+		stats.freeBlocks = total > stats.liveBlocks ? total - stats.liveBlocks : 0;
+
+		return stats;
+	}
+
+	void BlockPool::addSlab() {
+		char* slab = static_cast<char*>(allocateSlab(mSlabBytes));
+		mSlabs.push_back(slab);
+
+		for (size_t offset = 0; offset + mBlockSize <= mSlabBytes; offset += mBlockSize) {
+			FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + offset);
+
+			block->next = mFreeHead;
+			mFreeHead = block;
+		}
+	}
+
+	void BlockPool::countAllocation() {
+		size_t live = mLiveBlocks.fetch_add(1, std::memory_order_relaxed) + 1;
+		size_t peak = mPeakBlocks.load(std::memory_order_relaxed);
+
+		while (live > peak && !mPeakBlocks.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+		}
+	}
+
+	BlockPool& getBlockPool(size_t bytes) {
+		if (bytes > BLOCK_POOL_MAX_SIZE)
+			displayError("Blocks of " + std::to_string(bytes) + " bytes are larger than the biggest pool");
+
+		int sizeClass = getSizeClass(bytes);
+		BlockPool* pool = gPools[sizeClass].load(std::memory_order_acquire);
+
+		if (pool != nullptr)
+			return *pool;
+
+		std::lock_guard<std::mutex> lock(gPoolsMutex);
+
+		pool = gPools[sizeClass].load(std::memory_order_relaxed);
+
+		if (pool == nullptr) {
+			size_t blockSize = BLOCK_POOL_MIN_SIZE << sizeClass;
+
+			// Large blocks get slabs that can be backed by a single huge page
+			pool = new BlockPool(blockSize, blockSize >= 8 * 1024 ? HUGE_PAGE_SIZE : 256 * 1024);
+			gPools[sizeClass].store(pool, std::memory_order_release);
+		}
+
+		return *pool;
+	}
+
+	std::vector<BlockPoolStats> getBlockPoolStats() {
+		std::vector<BlockPoolStats> stats;
+
+		for (auto& pool : gPools) {
+			BlockPool* existing = pool.load(std::memory_order_acquire);
+
+			if (existing == nullptr)
+				continue;
+
+			BlockPoolStats poolStats = existing->getStats();
+
+			if (poolStats.slabs > 0)
+				stats.push_back(poolStats);
+		}
+
+		return stats;
+	}
+}
\ No newline at end of file
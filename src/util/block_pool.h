@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace util {
+	// Blocks come in powers of two from the smallest to the largest size class
+	constexpr size_t BLOCK_POOL_MIN_SIZE = 64;
+	constexpr size_t BLOCK_POOL_MAX_SIZE = 64 * 1024;
+	constexpr int BLOCK_POOL_CLASS_COUNT = 11;
+
+	// Threads that get a free list of their own in every pool, any others share the central one
+	constexpr int BLOCK_POOL_MAX_THREADS = 64;
+
+	struct BlockPoolStats {
+		size_t blockSize;
+
+		size_t liveBlocks;
+		size_t freeBlocks;
+		size_t peakBlocks;
+
+		size_t slabs;
+		size_t reservedBytes;
+	};
+
+	// Fixed size blocks carved out of large slabs. Slabs are never handed back, so once a pool has grown to
+	// what a program needs, allocating and freeing blocks never touches the heap again. Every thread keeps a
+	// short free list of its own and only takes the lock to move blocks to or from the central list in batches.
+	// Blocks are at least cache line aligned, and slabs of large blocks are backed by huge pages where the
+	// system allows it
+	class BlockPool {
+	public:
+		BlockPool(size_t blockSize, size_t slabBytes);
+
+		BlockPool(const BlockPool&) = delete;
+		BlockPool& operator=(const BlockPool&) = delete;
+
+		void* allocate();
+
+		// Safe from any thread, not just the one that allocated the block
+		void deallocate(void* block);
+
+		size_t getBlockSize() const { return mBlockSize; }
+
+		BlockPoolStats getStats() const;
+
+		// Hands the free list of a thread back to the central list, called when the thread exits
+		void flushThread(int thread);
+	private:
+		struct FreeBlock {
+			FreeBlock* next;
+		};
+
+		struct alignas(64) ThreadList {
+			FreeBlock* head{ nullptr };
+			size_t count{ 0 };
+		};
+
+		size_t mBlockSize;
+		size_t mSlabBytes;
+
+		// Blocks a thread keeps before returning half of them, and how many it takes at once when it runs out
+		size_t mThreadLimit;
+		size_t mBatchSize;
+
+		ThreadList mThreadLists[BLOCK_POOL_MAX_THREADS];
+
+		mutable std::mutex mMutex;
+		FreeBlock* mFreeHead{ nullptr };
+		std::vector<void*> mSlabs;
+
+		std::atomic<size_t> mLiveBlocks{ 0 };
+		std::atomic<size_t> mPeakBlocks{ 0 };
+
+		// Carves a new slab into blocks on the central list, the lock has to be held
+		void addSlab();
+
+		void countAllocation();
+	};
+
+	// Pool of the smallest size class that fits, bytes can't be more than BLOCK_POOL_MAX_SIZE. Pools live as long
+	// as the process, so blocks can be freed from static destructors and exiting threads in any order
+	BlockPool& getBlockPool(size_t bytes);
+
+	inline void* allocateBlock(size_t bytes) { return getBlockPool(bytes).allocate(); }
+	inline void freeBlock(void* block, size_t bytes) { getBlockPool(bytes).deallocate(block); }
+
+	// Every size class that has reserved a slab so far
+	std::vector<BlockPoolStats> getBlockPoolStats();
+
+	// Standard allocator on top of the size classes, mainly so std::allocate_shared can keep the object and its
+	// reference count in a pooled block
+	template<typename T>
+	class PoolAllocator {
+	public:
+		using value_type = T;
+
+		PoolAllocator() = default;
+
+		template<typename U>
+		PoolAllocator(const PoolAllocator<U>&) {}
+
+		T* allocate(size_t count) {
+			size_t bytes = count * sizeof(T);
+
+			if (bytes > BLOCK_POOL_MAX_SIZE)
+				return static_cast<T*>(::operator new(bytes));
+
+			return static_cast<T*>(allocateBlock(bytes));
+		}
+
+		void deallocate(T* pointer, size_t count) {
+			size_t bytes = count * sizeof(T);
+
+			if (bytes > BLOCK_POOL_MAX_SIZE) {
+				::operator delete(pointer);
+			}
+			else {
+				freeBlock(pointer, bytes);
+			}
+		}
+
+		template<typename U>
+		bool operator==(const PoolAllocator<U>&) const { return true; }
+
+		template<typename U>
+		bool operator!=(const PoolAllocator<U>&) const { return false; }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#pragma once
+
+namespace util {
+	// True when both the processor and the operating system support AVX2. Checked once and cached
+	bool cpuSupportsAVX2();
+}
\ No newline at end of file
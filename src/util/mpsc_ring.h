@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace util {
+	// Bounded lock free queue for any number of producers and a single consumer. Every slot carries a
+	// sequence number that tells producers whether it is free and the consumer whether it is filled,
+	// so neither side ever waits on the other
+	template<typename T>
+	class MpscRing {
+	public:
+		// The capacity is rounded up to a power of two
+		explicit MpscRing(size_t capacity) {
+			size_t size = 2;
+			while (size < capacity) {
+				size <<= 1;
+			}
+
+			mMask = size - 1;
+			mSlots = std::make_unique<Slot[]>(size);
+
+			for (size_t i = 0; i < size; i++) {
+				mSlots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		MpscRing(const MpscRing&) = delete;
+		MpscRing& operator=(const MpscRing&) = delete;
+
+		// Safe from any thread. Returns false without blocking if the ring is full
+		bool push(const T& value) {
+			size_t position = mTail.load(std::memory_order_relaxed);
+
+			while (true) {
+				Slot& slot = mSlots[position & mMask];
+				size_t sequence = slot.sequence.load(std::memory_order_acquire);
+				intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+				if (difference == 0) {
+					// The slot is free for this position, claim it before another producer does
+					if (mTail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						slot.value = value;
+						slot.sequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0) {
+					// The consumer hasn't freed this slot from the previous lap yet
+					return false;
+				}
+				else {
+					position = mTail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// Only ever call from the consumer thread
+		bool pop(T& outValue) {
+			Slot& slot = mSlots[mHead & mMask];
+
+			if (slot.sequence.load(std::memory_order_acquire) != mHead + 1)
+				return false;
+
+			outValue = slot.value;
+
+			// Hand the slot to the producer one lap ahead
+			slot.sequence.store(mHead + mMask + 1, std::memory_order_release);
+			mHead++;
+
+			return true;
+		}
+
+		size_t getCapacity() const { return mMask + 1; }
+
+		size_t getMemoryBytes() const { return getCapacity() * sizeof(Slot); }
+	private:
+		struct Slot {
+			std::atomic<size_t> sequence;
+			T value;
+		};
+
+		std::unique_ptr<Slot[]> mSlots;
+		size_t mMask;
+
+		// Producers and the consumer work on different ends, keep them on separate cache lines
+		alignas(64) std::atomic<size_t> mTail{ 0 };
+		alignas(64) size_t mHead{ 0 };
+	};
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace util {
+	// Hands the latest value from one producer thread to one consumer thread without locks. The producer
+	// always has a buffer to write into and the consumer always has a complete one to read, the third
+	// sits in the middle holding the newest published value until one of them swaps it out
+	template<typename T>
+	class TripleBuffer {
+	public:
+		TripleBuffer() = default;
+
+		TripleBuffer(const TripleBuffer&) = delete;
+		TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+		// Producer side. The buffer still holds whatever was last written into it, which is a few publishes old
+		T& getWriteBuffer() { return mBuffers[mWriteIndex]; }
+
+		void publish() {
+			uint8_t previous = mMiddle.exchange((uint8_t)(mWriteIndex | FRESH_BIT), std::memory_order_acq_rel);
+
+			mWriteIndex = previous & INDEX_MASK;
+		}
+
+		// Consumer side. Swaps in the newest published buffer, returns false if nothing was published since the last call
+		bool acquire() {
+			if ((mMiddle.load(std::memory_order_relaxed) & FRESH_BIT) == 0)
+				return false;
+
+			uint8_t previous = mMiddle.exchange(mReadIndex, std::memory_order_acq_rel);
+
+			mReadIndex = previous & INDEX_MASK;
+
+			return true;
+		}
+
+		const T& getReadBuffer() const { return mBuffers[mReadIndex]; }
+	private:
+		static constexpr uint8_t INDEX_MASK = 0x03;
+		static constexpr uint8_t FRESH_BIT = 0x04;
+
+		T mBuffers[3];
+
+		// Each index is only touched by its own thread, the middle one is what they trade through
+		alignas(64) uint8_t mWriteIndex{ 0 };
+		alignas(64) std::atomic<uint8_t> mMiddle{ 1 };
+		alignas(64) uint8_t mReadIndex{ 2 };
+	};
+}
\ No newline at end of file